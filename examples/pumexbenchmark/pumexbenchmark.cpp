@@ -0,0 +1,480 @@
+//
+// Copyright(c) 2017-2018 Paweł Księżopolski ( pumexx )
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+
+#include <iomanip>
+#include <random>
+#include <set>
+#include <cmath>
+#include <functional>
+#include <thread>
+#include <pumex/Pumex.h>
+#include <args.hxx>
+
+// pumexbenchmark measures performance of selected pumex components. Each benchmark is chosen with its own command line flag :
+// - render workflow compilation on randomly generated workflows with 10 to 500 operations
+// - memory used by attachments of random workflows with and without resource aliasing
+// - allocation strategies of DeviceMemoryAllocator driven by random allocations and deallocations ( no Vulkan device is needed )
+// - contention of DeviceMemoryAllocator when 1 to 32 threads allocate small blocks at the same time ( first Vulkan device is used )
+// - upload throughput of staging buffers taken from the staging ring and of dedicated staging buffers ( first Vulkan device is used )
+
+const std::vector<float> ATTACHMENT_SCALES = { 1.0f, 0.5f, 0.25f };
+
+// Random workflow is a directed acyclic graph : each operation reads results of a few operations that were added shortly before it.
+// Graphics operations render to a color attachment ( one of three sizes ), compute operations write to a buffer.
+// Results that nobody reads are gathered by the last operation that renders to a surface
+std::shared_ptr<pumex::RenderWorkflow> createRandomWorkflow(std::mt19937& generator, uint32_t operationCount, std::shared_ptr<pumex::DeviceMemoryAllocator> frameBufferAllocator, const std::vector<pumex::QueueTraits>& queueTraits)
+{
+  std::shared_ptr<pumex::RenderWorkflow> workflow = std::make_shared<pumex::RenderWorkflow>("random_workflow", frameBufferAllocator, queueTraits);
+  for (uint32_t i = 0; i < ATTACHMENT_SCALES.size(); ++i)
+    workflow->addResourceType("color_" + std::to_string(i), false, VK_FORMAT_R8G8B8A8_UNORM, VK_SAMPLE_COUNT_1_BIT, pumex::atColor, pumex::AttachmentSize{ pumex::AttachmentSize::SurfaceDependent, glm::vec2(ATTACHMENT_SCALES[i]) }, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+  workflow->addResourceType("compute_results", false, pumex::RenderWorkflowResourceType::Buffer);
+  workflow->addResourceType("surface",         true, VK_FORMAT_B8G8R8A8_UNORM, VK_SAMPLE_COUNT_1_BIT, pumex::atSurface, pumex::AttachmentSize{ pumex::AttachmentSize::SurfaceDependent, glm::vec2(1.0f,1.0f) }, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT);
+
+  const uint32_t inputWindow = 8;
+  std::uniform_real_distribution<float>   typeDistribution(0.0f, 1.0f);
+  std::uniform_int_distribution<uint32_t> scaleDistribution(0, static_cast<uint32_t>(ATTACHMENT_SCALES.size() - 1));
+  std::uniform_int_distribution<uint32_t> inputCountDistribution(1, 3);
+
+  struct OperationResult
+  {
+    std::string name;
+    bool        graphics;
+    uint32_t    scale;
+    bool        consumed;
+  };
+  std::vector<OperationResult> results;
+  auto addInput = [&workflow](const std::string& opName, bool graphicsOperation, OperationResult& result)
+  {
+    if (result.graphics)
+      workflow->addImageInput(opName, "color_" + std::to_string(result.scale), result.name, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    else
+      workflow->addBufferInput(opName, "compute_results", result.name, graphicsOperation ? VK_PIPELINE_STAGE_VERTEX_SHADER_BIT : VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+    result.consumed = true;
+  };
+
+  for (uint32_t i = 0; i < operationCount; ++i)
+  {
+    std::string opName     = "operation_" + std::to_string(i);
+    std::string resultName = "result_" + std::to_string(i);
+    bool graphics          = typeDistribution(generator) < 0.75f;
+    uint32_t scale         = scaleDistribution(generator);
+    if (graphics)
+    {
+      workflow->addRenderOperation(opName, pumex::RenderOperation::Graphics, 0x0, pumex::AttachmentSize{ pumex::AttachmentSize::SurfaceDependent, glm::vec2(ATTACHMENT_SCALES[scale]) });
+      workflow->addAttachmentOutput(opName, "color_" + std::to_string(scale), resultName, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, pumex::loadOpClear(glm::vec4(0.0f)));
+    }
+    else
+    {
+      workflow->addRenderOperation(opName, pumex::RenderOperation::Compute);
+      workflow->addBufferOutput(opName, "compute_results", resultName, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+    }
+    if (!results.empty())
+    {
+      uint32_t firstInput = (results.size() > inputWindow) ? static_cast<uint32_t>(results.size()) - inputWindow : 0;
+      std::uniform_int_distribution<uint32_t> inputDistribution(firstInput, static_cast<uint32_t>(results.size() - 1));
+      std::set<uint32_t> inputs;
+      uint32_t inputCount = inputCountDistribution(generator);
+      for (uint32_t j = 0; j < inputCount; ++j)
+        inputs.insert(inputDistribution(generator));
+      for (auto input : inputs)
+        addInput(opName, graphics, results[input]);
+    }
+    results.push_back({ resultName, graphics, scale, false });
+  }
+
+  workflow->addRenderOperation("final", pumex::RenderOperation::Graphics);
+  for (auto& result : results)
+    if (!result.consumed)
+      addInput("final", true, result);
+  workflow->addAttachmentOutput("final", "surface", "color", VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, pumex::loadOpClear(glm::vec4(0.0f)));
+  return workflow;
+}
+
+void benchmarkWorkflowCompilation(uint32_t workflowCount)
+{
+  // workflow compilation does not allocate any memory, so the allocator does not need a device
+  std::shared_ptr<pumex::DeviceMemoryAllocator> frameBufferAllocator = std::make_shared<pumex::DeviceMemoryAllocator>(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 16 * 1024 * 1024, pumex::DeviceMemoryAllocator::FIRST_FIT);
+  std::vector<pumex::QueueTraits> queueTraits{ { VK_QUEUE_GRAPHICS_BIT, 0, 0.75f } };
+  std::mt19937 generator(1234);
+
+  LOG_INFO << "Render workflow compilation ( average of " << workflowCount << " random workflows )" << std::endl;
+  for (uint32_t operationCount : { 10, 25, 50, 100, 250, 500 })
+  {
+    double compileTime     = 0.0;
+    size_t renderPassCount = 0;
+    for (uint32_t i = 0; i < workflowCount; ++i)
+    {
+      auto workflow = createRandomWorkflow(generator, operationCount, frameBufferAllocator, queueTraits);
+      auto compileStart = pumex::HPClock::now();
+      workflow->compile(std::make_shared<pumex::SingleQueueWorkflowCompiler>());
+      compileTime += pumex::inSeconds(pumex::HPClock::now() - compileStart);
+      renderPassCount += workflow->workflowResults->frameBuffers.size();
+    }
+    LOG_INFO << std::setw(4) << operationCount << " operations : " << std::fixed << std::setprecision(3) << 1000.0 * compileTime / workflowCount << " ms, " << std::setprecision(1) << static_cast<double>(renderPassCount) / workflowCount << " render passes" << std::endl;
+  }
+}
+
+// all attachments in a random workflow use VK_FORMAT_R8G8B8A8_UNORM format
+VkDeviceSize getAttachmentByteSize(const pumex::RenderWorkflowResourceType::AttachmentData& attachment, const glm::vec2& surfaceSize)
+{
+  return static_cast<VkDeviceSize>(surfaceSize.x * attachment.attachmentSize.imageSize.x) * static_cast<VkDeviceSize>(surfaceSize.y * attachment.attachmentSize.imageSize.y) * 4;
+}
+
+void benchmarkResourceAliasing(uint32_t workflowCount)
+{
+  std::shared_ptr<pumex::DeviceMemoryAllocator> frameBufferAllocator = std::make_shared<pumex::DeviceMemoryAllocator>(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 16 * 1024 * 1024, pumex::DeviceMemoryAllocator::FIRST_FIT);
+  std::vector<pumex::QueueTraits> queueTraits{ { VK_QUEUE_GRAPHICS_BIT, 0, 0.75f } };
+  std::mt19937 generator(1234);
+  const glm::vec2 surfaceSize(1920.0f, 1080.0f);
+  const double    megabyte = 1024.0 * 1024.0;
+
+  LOG_INFO << "Attachment memory for " << surfaceSize.x << "x" << surfaceSize.y << " surface ( average of " << workflowCount << " random workflows )" << std::endl;
+  LOG_INFO << "operations : no aliasing / resource aliasing / resource and memory aliasing" << std::endl;
+  for (uint32_t operationCount : { 10, 25, 50, 100, 250, 500 })
+  {
+    VkDeviceSize noAliasingSize       = 0;
+    VkDeviceSize resourceAliasingSize = 0;
+    VkDeviceSize memoryAliasingSize   = 0;
+    for (uint32_t i = 0; i < workflowCount; ++i)
+    {
+      auto workflow = createRandomWorkflow(generator, operationCount, frameBufferAllocator, queueTraits);
+      workflow->compile(std::make_shared<pumex::SingleQueueWorkflowCompiler>());
+      auto workflowResults = workflow->workflowResults;
+
+      // resources aliased to other resources do not have their own images. Images from the same memory alias group use memory of the largest image
+      std::map<std::string, VkDeviceSize> memoryGroupSize;
+      for (const auto& resourceName : workflow->getResourceNames())
+      {
+        auto resourceType = workflow->getResource(resourceName)->resourceType;
+        if (resourceType->metaType != pumex::RenderWorkflowResourceType::Attachment || resourceType->attachment.attachmentType == pumex::atSurface)
+          continue;
+        VkDeviceSize imageSize = getAttachmentByteSize(resourceType->attachment, surfaceSize);
+        noAliasingSize += imageSize;
+        if (workflowResults->resourceAlias.at(resourceName) != resourceName)
+          continue;
+        resourceAliasingSize += imageSize;
+        auto mait = workflowResults->memoryAlias.find(resourceName);
+        if (mait == end(workflowResults->memoryAlias))
+          memoryAliasingSize += imageSize;
+        else
+          memoryGroupSize[mait->second] = std::max(memoryGroupSize[mait->second], imageSize);
+      }
+      for (const auto& mgs : memoryGroupSize)
+        memoryAliasingSize += mgs.second;
+    }
+    LOG_INFO << std::setw(10) << operationCount << " : " << std::fixed << std::setprecision(1) << noAliasingSize / megabyte / workflowCount << " MB / " << resourceAliasingSize / megabyte / workflowCount << " MB / " << memoryAliasingSize / megabyte / workflowCount << " MB" << std::endl;
+  }
+}
+
+// Allocation strategies do not touch the memory they manage, so fake memory handle is enough.
+// Each test fills the memory with liveCount allocations and then randomly deallocates and allocates blocks of 256 B - 1 MB
+void benchmarkAllocationStrategies(uint32_t operationCount)
+{
+  const VkDeviceSize   memorySize = VkDeviceSize(2048) * 1024 * 1024;
+  const VkDeviceMemory fakeMemory = (VkDeviceMemory)(0x1000);
+  const std::vector<std::pair<std::string, std::function<std::unique_ptr<pumex::AllocationStrategy>()>>> strategies =
+  {
+    { "FIRST_FIT", [memorySize]() { return std::unique_ptr<pumex::AllocationStrategy>(new pumex::FirstFitAllocationStrategy(memorySize)); } },
+    { "TLSF",      [memorySize]() { return std::unique_ptr<pumex::AllocationStrategy>(new pumex::TLSFAllocationStrategy(memorySize)); } },
+    { "BUDDY",     [memorySize]() { return std::unique_ptr<pumex::AllocationStrategy>(new pumex::BuddyAllocationStrategy(memorySize)); } }
+  };
+  const std::vector<VkDeviceSize> alignments = { 16, 256, 4096 };
+
+  LOG_INFO << "Allocation strategies ( " << operationCount << " random allocations and deallocations in " << memorySize / (1024 * 1024) << " MB )" << std::endl;
+  LOG_INFO << "live allocations : strategy : time per operation / failed allocations / fragmentation" << std::endl;
+  for (uint32_t liveCount : { 500, 2000, 8000 })
+  {
+    for (auto& strategyDef : strategies)
+    {
+      // each strategy gets the same sequence of operations
+      std::mt19937 generator(1234);
+      std::uniform_real_distribution<double>  sizeDistribution(std::log2(256.0), std::log2(1024.0 * 1024.0));
+      std::uniform_int_distribution<uint32_t> alignmentDistribution(0, static_cast<uint32_t>(alignments.size() - 1));
+      std::uniform_real_distribution<float>   operationDistribution(0.0f, 1.0f);
+      auto strategy = strategyDef.second();
+      auto randomRequirements = [&]() -> VkMemoryRequirements
+      {
+        VkMemoryRequirements memoryRequirements;
+        memoryRequirements.size           = static_cast<VkDeviceSize>(std::exp2(sizeDistribution(generator)));
+        memoryRequirements.alignment      = alignments[alignmentDistribution(generator)];
+        memoryRequirements.memoryTypeBits = 1;
+        return memoryRequirements;
+      };
+
+      std::vector<pumex::DeviceMemoryBlock> liveBlocks;
+      for (uint32_t i = 0; i < liveCount; ++i)
+      {
+        auto block = strategy->allocate(fakeMemory, randomRequirements());
+        if (block.alignedSize > 0)
+          liveBlocks.push_back(block);
+      }
+
+      uint32_t failedAllocations = 0;
+      auto benchmarkStart = pumex::HPClock::now();
+      for (uint32_t i = 0; i < operationCount; ++i)
+      {
+        // keep the number of live allocations close to liveCount
+        if (!liveBlocks.empty() && (liveBlocks.size() >= liveCount || operationDistribution(generator) < 0.5f))
+        {
+          std::uniform_int_distribution<size_t> blockDistribution(0, liveBlocks.size() - 1);
+          size_t blockIndex = blockDistribution(generator);
+          strategy->deallocate(liveBlocks[blockIndex]);
+          liveBlocks[blockIndex] = liveBlocks.back();
+          liveBlocks.pop_back();
+        }
+        else
+        {
+          auto block = strategy->allocate(fakeMemory, randomRequirements());
+          if (block.alignedSize > 0)
+            liveBlocks.push_back(block);
+          else
+            failedAllocations++;
+        }
+      }
+      double benchmarkTime = pumex::inSeconds(pumex::HPClock::now() - benchmarkStart);
+
+      pumex::DeviceMemoryStatistics statistics;
+      strategy->collectFreeSpace(statistics);
+      LOG_INFO << std::setw(16) << liveCount << " : " << std::setw(9) << strategyDef.first << " : " << std::fixed << std::setprecision(1) << 1.0e9 * benchmarkTime / operationCount << " ns / " << failedAllocations << " / " << std::setprecision(3) << statistics.getFragmentation() << std::endl;
+      for (auto& block : liveBlocks)
+        strategy->deallocate(block);
+    }
+  }
+}
+
+// Each thread keeps up to 64 live allocations of 256 B - 16 kB and randomly allocates and deallocates them.
+// BUDDY allocator serves these sizes from per-thread caches, TLSF allocator locks its mutex on each operation
+void benchmarkAllocatorContention(std::shared_ptr<pumex::Device> device, uint32_t operationsPerThread)
+{
+  const std::vector<std::pair<std::string, pumex::DeviceMemoryAllocator::EnumStrategy>> strategies =
+  {
+    { "TLSF",  pumex::DeviceMemoryAllocator::TLSF },
+    { "BUDDY", pumex::DeviceMemoryAllocator::BUDDY }
+  };
+  const uint32_t liveCount = 64;
+
+  LOG_INFO << "DeviceMemoryAllocator contention ( " << operationsPerThread << " random allocations and deallocations per thread )" << std::endl;
+  LOG_INFO << "threads : strategy : time per operation / operations per second" << std::endl;
+  for (uint32_t threadCount : { 1, 2, 4, 8, 16, 32 })
+  {
+    for (auto& strategyDef : strategies)
+    {
+      auto allocator = std::make_shared<pumex::DeviceMemoryAllocator>(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 32 * 1024 * 1024, strategyDef.second);
+      auto threadFunction = [&allocator, &device, operationsPerThread, liveCount](uint32_t threadIndex)
+      {
+        std::mt19937 generator(1234 + threadIndex);
+        std::uniform_real_distribution<double> sizeDistribution(std::log2(256.0), std::log2(16.0 * 1024.0));
+        std::uniform_real_distribution<float>  operationDistribution(0.0f, 1.0f);
+        std::vector<pumex::DeviceMemoryBlock>  liveBlocks;
+        for (uint32_t i = 0; i < operationsPerThread; ++i)
+        {
+          if (!liveBlocks.empty() && (liveBlocks.size() >= liveCount || operationDistribution(generator) < 0.5f))
+          {
+            std::uniform_int_distribution<size_t> blockDistribution(0, liveBlocks.size() - 1);
+            size_t blockIndex = blockDistribution(generator);
+            allocator->deallocate(device->device, liveBlocks[blockIndex]);
+            liveBlocks[blockIndex] = liveBlocks.back();
+            liveBlocks.pop_back();
+          }
+          else
+            liveBlocks.push_back(allocator->allocate(device.get(), VkMemoryRequirements{ static_cast<VkDeviceSize>(std::exp2(sizeDistribution(generator))), 256, 0xFFFFFFFF }, false));
+        }
+        for (auto& block : liveBlocks)
+          allocator->deallocate(device->device, block);
+      };
+
+      std::vector<std::thread> threads;
+      auto benchmarkStart = pumex::HPClock::now();
+      for (uint32_t i = 0; i < threadCount; ++i)
+        threads.emplace_back(threadFunction, i);
+      for (auto& thread : threads)
+        thread.join();
+      double benchmarkTime  = pumex::inSeconds(pumex::HPClock::now() - benchmarkStart);
+      double operationCount = static_cast<double>(operationsPerThread) * threadCount;
+      LOG_INFO << std::setw(7) << threadCount << " : " << std::setw(8) << strategyDef.first << " : " << std::fixed << std::setprecision(1) << 1.0e9 * benchmarkTime / operationCount << " ns / " << std::setprecision(0) << operationCount / benchmarkTime << std::endl;
+    }
+  }
+}
+
+// Each frame uploads 8 MB of data divided into uploads of the same size to device local buffer and waits for the queue.
+// Staging buffers are either taken from the staging ring of a device, or created for each upload ( dedicated staging buffers )
+void benchmarkUploadThroughput(std::shared_ptr<pumex::Device> device, uint32_t frameCount)
+{
+  const VkDeviceSize frameUploadSize = 8 * 1024 * 1024;
+  auto queue = device->getQueue(pumex::QueueTraits{ VK_QUEUE_GRAPHICS_BIT, 0, 0.75f }, true);
+  CHECK_LOG_THROW(queue == nullptr, "Cannot get the queue for upload benchmark");
+  auto commandPool = std::make_shared<pumex::CommandPool>(queue->familyIndex);
+  commandPool->validate(device.get());
+  auto commandBuffer = std::make_shared<pumex::CommandBuffer>(VK_COMMAND_BUFFER_LEVEL_PRIMARY, device.get(), commandPool);
+
+  auto allocator = std::make_shared<pumex::DeviceMemoryAllocator>(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, frameUploadSize, pumex::DeviceMemoryAllocator::FIRST_FIT);
+  VkBufferCreateInfo bufferCreateInfo{};
+    bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufferCreateInfo.size  = frameUploadSize;
+  VkBuffer dstBuffer;
+  VK_CHECK_LOG_THROW(vkCreateBuffer(device->device, &bufferCreateInfo, nullptr, &dstBuffer), "Cannot create a buffer");
+  VkMemoryRequirements memoryRequirements;
+  vkGetBufferMemoryRequirements(device->device, dstBuffer, &memoryRequirements);
+  pumex::DeviceMemoryBlock memoryBlock = allocator->allocate(device.get(), memoryRequirements, false);
+  allocator->bindBufferMemory(device.get(), dstBuffer, memoryBlock);
+
+  std::vector<unsigned char> data(frameUploadSize, 0x5A);
+  uint64_t frameNumber = 1;
+
+  LOG_INFO << "Upload throughput ( " << frameCount << " frames, " << frameUploadSize / (1024 * 1024) << " MB uploaded per frame )" << std::endl;
+  LOG_INFO << "upload size : staging : CPU time per upload / throughput" << std::endl;
+  for (VkDeviceSize uploadSize : { VkDeviceSize(4 * 1024), VkDeviceSize(64 * 1024), VkDeviceSize(1024 * 1024), VkDeviceSize(4 * 1024 * 1024) })
+  {
+    for (bool useRing : { true, false })
+    {
+      uint32_t uploadCount = static_cast<uint32_t>(frameUploadSize / uploadSize);
+      double   cpuTime     = 0.0;
+      auto benchmarkStart  = pumex::HPClock::now();
+      for (uint32_t f = 0; f < frameCount; ++f)
+      {
+        // previous frame was waited for, so its staging memory may be reused
+        device->beginFrame(frameNumber, frameNumber - 1);
+        frameNumber++;
+
+        auto cpuStart = pumex::HPClock::now();
+        std::vector<std::shared_ptr<pumex::StagingBuffer>> stagingBuffers;
+        commandBuffer->cmdBegin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+        for (uint32_t i = 0; i < uploadCount; ++i)
+        {
+          std::shared_ptr<pumex::StagingBuffer> stagingBuffer;
+          if (useRing)
+            stagingBuffer = device->acquireStagingBuffer(data.data() + i * uploadSize, uploadSize);
+          else
+          {
+            stagingBuffer = std::make_shared<pumex::StagingBuffer>(device.get(), uploadSize);
+            stagingBuffer->fillBuffer(data.data() + i * uploadSize, uploadSize);
+          }
+          commandBuffer->cmdCopyBuffer(stagingBuffer->buffer, dstBuffer, VkBufferCopy{ stagingBuffer->offset, i * uploadSize, uploadSize });
+          stagingBuffers.push_back(stagingBuffer);
+        }
+        commandBuffer->cmdEnd();
+        cpuTime += pumex::inSeconds(pumex::HPClock::now() - cpuStart);
+
+        commandBuffer->queueSubmit(queue->queue);
+        VK_CHECK_LOG_THROW(vkQueueWaitIdle(queue->queue), "Cannot wait for the queue");
+        if (useRing)
+        {
+          for (auto& stagingBuffer : stagingBuffers)
+            device->releaseStagingBuffer(stagingBuffer);
+        }
+      }
+      double benchmarkTime = pumex::inSeconds(pumex::HPClock::now() - benchmarkStart);
+      LOG_INFO << std::setw(8) << uploadSize / 1024 << " kB : " << std::setw(9) << (useRing ? "ring" : "dedicated") << " : " << std::fixed << std::setprecision(2) << 1.0e6 * cpuTime / (frameCount * uploadCount) << " us / " << std::setprecision(1) << (frameCount * frameUploadSize) / (1024.0 * 1024.0 * benchmarkTime) << " MB/s" << std::endl;
+    }
+  }
+
+  commandBuffer = nullptr;
+  commandPool   = nullptr;
+  vkDestroyBuffer(device->device, dstBuffer, nullptr);
+  allocator->deallocate(device->device, memoryBlock);
+  device->releaseQueue(queue);
+}
+
+int main( int argc, char * argv[] )
+{
+  SET_LOG_INFO;
+
+  args::ArgumentParser      parser("pumex example : benchmarks of pumex components");
+  args::HelpFlag            help(parser, "help", "display this help menu", { 'h', "help" });
+  args::Flag                workflowBenchmark(parser, "workflow", "measure compilation time of random render workflows with 10 to 500 operations", { 's' });
+  args::Flag                aliasingBenchmark(parser, "aliasing", "measure attachment memory of random render workflows with and without resource aliasing", { 'a' });
+  args::Flag                strategyBenchmark(parser, "strategy", "measure allocation strategies of DeviceMemoryAllocator", { 't' });
+  args::Flag                contentionBenchmark(parser, "contention", "measure DeviceMemoryAllocator contention with 1 to 32 threads", { 'm' });
+  args::Flag                uploadBenchmark(parser, "upload", "measure upload throughput of staging ring and dedicated staging buffers", { 'u' });
+  args::ValueFlag<uint32_t> workflowCountArg(parser, "workflow_count", "number of random workflows compiled for each workflow size", { 'w' }, 20);
+  try
+  {
+    parser.ParseCLI(argc, argv);
+  }
+  catch (const args::Help&)
+  {
+    LOG_ERROR << parser;
+    FLUSH_LOG;
+    return 0;
+  }
+  catch (const args::ParseError& e)
+  {
+    LOG_ERROR << e.what() << std::endl;
+    LOG_ERROR << parser;
+    FLUSH_LOG;
+    return 1;
+  }
+  catch (const args::ValidationError& e)
+  {
+    LOG_ERROR << e.what() << std::endl;
+    LOG_ERROR << parser;
+    FLUSH_LOG;
+    return 1;
+  }
+  if (!workflowBenchmark && !aliasingBenchmark && !strategyBenchmark && !contentionBenchmark && !uploadBenchmark)
+  {
+    LOG_ERROR << "No benchmark selected" << std::endl;
+    LOG_ERROR << parser;
+    FLUSH_LOG;
+    return 1;
+  }
+
+  std::shared_ptr<pumex::Viewer> viewer;
+  std::shared_ptr<pumex::Device> device;
+  try
+  {
+    // benchmarks that need Vulkan device share the same device. There are no surfaces, so device is realized with single graphics queue
+    if (contentionBenchmark || uploadBenchmark)
+    {
+      pumex::ViewerTraits viewerTraits{ "pumex benchmark", std::vector<std::string>(), std::vector<std::string>(), 60 };
+      viewer = std::make_shared<pumex::Viewer>(viewerTraits);
+      device = viewer->addDevice(0, std::vector<std::string>());
+      device->addRequestedQueue(pumex::QueueTraits{ VK_QUEUE_GRAPHICS_BIT, 0, 0.75f });
+      device->realize();
+    }
+    if (workflowBenchmark)
+      benchmarkWorkflowCompilation(std::max(1U, args::get(workflowCountArg)));
+    if (aliasingBenchmark)
+      benchmarkResourceAliasing(std::max(1U, args::get(workflowCountArg)));
+    if (strategyBenchmark)
+      benchmarkAllocationStrategies(200000);
+    if (contentionBenchmark)
+      benchmarkAllocatorContention(device, 200000);
+    if (uploadBenchmark)
+      benchmarkUploadThroughput(device, 100);
+  }
+  catch (const std::exception& e)
+  {
+    LOG_ERROR << "Exception thrown : " << e.what() << std::endl;
+  }
+  catch (...)
+  {
+    LOG_ERROR << "Unknown error" << std::endl;
+  }
+  device = nullptr;
+  if (viewer != nullptr)
+    viewer->cleanup();
+  FLUSH_LOG;
+  return 0;
+}
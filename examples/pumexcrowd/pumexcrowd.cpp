@@ -31,6 +31,8 @@
 #include <tbb/tbb.h>
 #include <pumex/Pumex.h>
 #include <pumex/AssetLoaderAssimp.h>
+#include <pumex/AssetLoaderCache.h>
+#include <pumex/AsyncAssetLoader.h>
 #include <args.hxx>
 
 
@@ -237,9 +239,8 @@ struct CrowdApplicationData
 
   std::shared_ptr<pumex::Buffer<pumex::Camera>>             cameraBuffer;
   std::shared_ptr<pumex::Buffer<pumex::Camera>>             textCameraBuffer;
-  std::shared_ptr<std::vector<PositionData>>                positionData;
   std::shared_ptr<std::vector<InstanceData>>                instanceData;
-  std::shared_ptr<pumex::Buffer<std::vector<PositionData>>> positionBuffer;
+  std::shared_ptr<pumex::StreamingBuffer<PositionData>>     positionBuffer;
   std::shared_ptr<pumex::Buffer<std::vector<InstanceData>>> instanceBuffer;
 
   //std::shared_ptr<pumex::QueryPool>                         timeStampQueryPool;
@@ -252,9 +253,7 @@ struct CrowdApplicationData
   {
     cameraBuffer     = std::make_shared<pumex::Buffer<pumex::Camera>>(buffersAllocator, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, pumex::pbPerSurface, pumex::swOnce, true);
     textCameraBuffer = std::make_shared<pumex::Buffer<pumex::Camera>>(buffersAllocator, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, pumex::pbPerSurface, pumex::swOnce, true);
-    positionData     = std::make_shared<std::vector<PositionData>>();
     instanceData     = std::make_shared<std::vector<InstanceData>>();
-    positionBuffer   = std::make_shared<pumex::Buffer<std::vector<PositionData>>>(positionData, buffersAllocator, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, pumex::pbPerDevice, pumex::swForEachImage);
     instanceBuffer   = std::make_shared<pumex::Buffer<std::vector<InstanceData>>>(instanceData, buffersAllocator, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, pumex::pbPerDevice, pumex::swForEachImage);
   }
 
@@ -263,22 +262,40 @@ struct CrowdApplicationData
     camHandler = bcamHandler;
   }
 
-  void setupModels(std::shared_ptr<pumex::Viewer> viewer, std::shared_ptr<pumex::AssetBuffer> assetBuffer, std::shared_ptr<pumex::MaterialSet> materialSet, const std::vector<pumex::VertexSemantic>& vertexSemantic)
+  void setupModels(std::shared_ptr<pumex::Viewer> viewer, std::shared_ptr<pumex::AssetBuffer> assetBuffer, std::shared_ptr<pumex::MaterialSet> materialSet, const std::vector<pumex::VertexSemantic>& vertexSemantic, const std::string& cacheDirectory)
   {
     skeletalAssetBuffer = assetBuffer;
 
-    pumex::AssetLoaderAssimp      loader;
-
-    // We assume that animations use the same skeleton as skeletal models
+    // all animations and models are loaded concurrently. Models loaded by Assimp may be stored in binary asset cache
+    pumex::AsyncAssetLoader loader([cacheDirectory]() -> std::shared_ptr<pumex::AssetLoader>
+    {
+      std::shared_ptr<pumex::AssetLoader> assimpLoader = std::make_shared<pumex::AssetLoaderAssimp>();
+      if (cacheDirectory.empty())
+        return assimpLoader;
+      return std::make_shared<pumex::AssetLoaderCache>(assimpLoader, cacheDirectory);
+    });
+    std::vector<std::future<std::shared_ptr<pumex::Asset>>> animationAssets;
     for (auto& animDef : animationDefinitions)
+      animationAssets.push_back(loader.load(viewer, std::get<0>(animDef), true));
+    std::vector<std::vector<std::future<std::shared_ptr<pumex::Asset>>>> modelAssets;
+    for (auto& modelDef : modelDefinitions)
     {
-      std::shared_ptr<pumex::Asset> asset(loader.load(viewer, std::get<0>(animDef), true));
-      animations.push_back(asset->animations[0]);
+      std::vector<std::string> fileNames{ std::get<3>(modelDef), std::get<4>(modelDef), std::get<5>(modelDef) };
+      std::vector<std::future<std::shared_ptr<pumex::Asset>>> lodAssets;
+      for (auto& fileName : fileNames)
+        lodAssets.push_back(fileName.empty() ? std::future<std::shared_ptr<pumex::Asset>>() : loader.load(viewer, fileName, false, vertexSemantic));
+      modelAssets.push_back(std::move(lodAssets));
     }
 
+    // We assume that animations use the same skeleton as skeletal models
+    for (auto& animAsset : animationAssets)
+      animations.push_back(animAsset.get()->animations[0]);
+
+    // assets are registered in definition order, so that LODs and materials do not depend on loading time
     skeletons.push_back(pumex::Skeleton()); // empty skeleton for null type
-    for (auto& modelDef : modelDefinitions)
+    for (uint32_t i = 0; i < modelDefinitions.size(); ++i)
     {
+      auto& modelDef = modelDefinitions[i];
       uint32_t                               typeID;
       std::string                            typeName;
       bool                                   isMain;
@@ -290,7 +307,7 @@ struct CrowdApplicationData
       {
         if (fileNames[j].empty())
           continue;
-        std::shared_ptr<pumex::Asset> asset(loader.load(viewer, fileNames[j],false,vertexSemantic));
+        std::shared_ptr<pumex::Asset> asset(modelAssets[i][j].get());
         if( j == 0 )
         {
           skeletons.push_back(asset->skeleton);
@@ -506,15 +523,19 @@ struct CrowdApplicationData
 
     filterNode->setTypeCount(typeCount);
 
-    positionData->resize(0);
+    // positions are written directly into memory used by GPU in this frame
+    std::vector<uint32_t> deviceIDs = viewer->getDeviceIDs();
+    uint64_t frameNumber = viewer->getFrameNumber();
+    pumex::StreamingBufferView<PositionData> positions = positionBuffer->getFrameView(viewer->getDevice(deviceIDs[0]), frameNumber);
+
     instanceData->resize(0);
     std::vector<uint32_t> animIndex;
     std::vector<float> animOffset;
-    for (auto it = begin(rData.people); it != end(rData.people); ++it)
+    uint32_t positionCount = 0;
+    for (auto it = begin(rData.people); it != end(rData.people); ++it, ++positionCount)
     {
-      uint32_t index = positionData->size();
-      positionData->emplace_back(PositionData(pumex::extrapolate(it->kinematic, deltaTime)));
-      instanceData->emplace_back(InstanceData(index, it->typeID, it->materialVariant, 1));
+      positions[positionCount] = PositionData(pumex::extrapolate(it->kinematic, deltaTime));
+      instanceData->emplace_back(InstanceData(positionCount, it->typeID, it->materialVariant, 1));
 
       animIndex.emplace_back(it->animation);
       animOffset.emplace_back(it->animationOffset);
@@ -523,7 +544,7 @@ struct CrowdApplicationData
     // calculate bone matrices for the people
     tbb::parallel_for
     (
-      tbb::blocked_range<size_t>(0, positionData->size()),
+      tbb::blocked_range<size_t>(0, positionCount),
       [&](const tbb::blocked_range<size_t>& r)
       {
         for (size_t i = r.begin(); i != r.end(); ++i)
@@ -562,7 +583,7 @@ struct CrowdApplicationData
             globalTransforms[boneIndex] = globalTransforms[skel.bones[boneIndex].parentIndex] * localCurrentTransform;
           }
           for (uint32_t boneIndex = 0; boneIndex < numSkelBones; ++boneIndex)
-            (*positionData)[i].bones[boneIndex] = globalTransforms[boneIndex] * skel.bones[boneIndex].offsetMatrix;
+            positions[i].bones[boneIndex] = globalTransforms[boneIndex] * skel.bones[boneIndex].offsetMatrix;
 
         }
       }
@@ -573,7 +594,14 @@ struct CrowdApplicationData
     {
       instanceData->emplace_back(InstanceData(rData.clothOwners[ii], it->typeID, it->materialVariant, 0));
     }
-    positionBuffer->invalidateData();
+    // other devices receive a copy of the positions
+    for (uint32_t i = 1; i < deviceIDs.size(); ++i)
+    {
+      pumex::StreamingBufferView<PositionData> devicePositions = positionBuffer->getFrameView(viewer->getDevice(deviceIDs[i]), frameNumber);
+      std::copy(positions.begin(), positions.begin() + positionCount, devicePositions.begin());
+    }
+    for (auto deviceID : deviceIDs)
+      positionBuffer->flushFrameView(viewer->getDevice(deviceID), frameNumber, positionCount);
     instanceBuffer->invalidateData();
   }
 
@@ -604,6 +632,7 @@ int main(int argc, char * argv[])
   args::ValueFlag<uint32_t>                    updatesPerSecond(parser, "update_frequency", "number of update calls per second", { 'u' }, 60);
   args::Flag                                   renderVRwindows(parser, "vrwindows", "create two halfscreen windows for VR", { 'v' });
   args::Flag                                   render3windows(parser, "three_windows", "render in three windows", {'t'});
+  args::ValueFlag<std::string>                 assetCacheDirectory(parser, "cache_directory", "directory for binary asset cache", { 'c' });
   try
   {
     parser.ParseCLI(argc, argv);
@@ -630,6 +659,7 @@ int main(int argc, char * argv[])
   }
   VkPresentModeKHR presentMode = args::get(presentationMode);
   uint32_t updateFrequency     = std::max(1U, args::get(updatesPerSecond));
+  std::string cacheDirectory   = args::get(assetCacheDirectory);
 
   LOG_INFO << "Crowd rendering";
   if (enableDebugging)
@@ -711,7 +741,9 @@ int main(int argc, char * argv[])
     std::shared_ptr<CrowdApplicationData> applicationData = std::make_shared<CrowdApplicationData>(buffersAllocator);
 
     std::vector<pumex::VertexSemantic> vertexSemantic = { { pumex::VertexSemantic::Position, 3 },{ pumex::VertexSemantic::Normal, 3 },{ pumex::VertexSemantic::TexCoord, 3 },{ pumex::VertexSemantic::BoneWeight, 4 },{ pumex::VertexSemantic::BoneIndex, 4 } };
-    std::vector<pumex::AssetBufferVertexSemantics> assetSemantics = { { MAIN_RENDER_MASK, vertexSemantic } };
+    // vertices in a vertex buffer are quantized : 36 bytes per vertex instead of 68
+    std::vector<pumex::VertexSemantic> bufferSemantic = { { pumex::VertexSemantic::Position, 3 },{ pumex::VertexSemantic::Normal, 3, pumex::VertexSemantic::SNorm16 },{ pumex::VertexSemantic::TexCoord, 3, pumex::VertexSemantic::Float16 },{ pumex::VertexSemantic::BoneWeight, 4, pumex::VertexSemantic::UNorm8 },{ pumex::VertexSemantic::BoneIndex, 4, pumex::VertexSemantic::UInt8 } };
+    std::vector<pumex::AssetBufferVertexSemantics> assetSemantics = { { MAIN_RENDER_MASK, bufferSemantic } };
 
     auto skeletalAssetBuffer      = std::make_shared<pumex::AssetBuffer>(assetSemantics, buffersAllocator, verticesAllocator);
 
@@ -723,7 +755,7 @@ int main(int argc, char * argv[])
     std::shared_ptr<pumex::MaterialRegistry<MaterialData>> materialRegistry = std::make_shared<pumex::MaterialRegistry<MaterialData>>(buffersAllocator);
     std::shared_ptr<pumex::MaterialSet>                    materialSet      = std::make_shared<pumex::MaterialSet>(viewer, materialRegistry, textureRegistry, buffersAllocator, textureSemantic);
 
-    applicationData->setupModels(viewer, skeletalAssetBuffer, materialSet, vertexSemantic);
+    applicationData->setupModels(viewer, skeletalAssetBuffer, materialSet, vertexSemantic, cacheDirectory);
 
     // build a compute tree
 
@@ -738,7 +770,7 @@ int main(int argc, char * argv[])
       { 0, 1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT },
       { 1, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT },
       { 2, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT },
-      { 3, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT },
+      { 3, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, VK_SHADER_STAGE_COMPUTE_BIT },
       { 4, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT },
       { 5, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT },
       { 6, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT }
@@ -762,6 +794,11 @@ int main(int argc, char * argv[])
     workflow->associateMemoryObject("indirect_draw", assetBufferFilterNode->getDrawIndexedIndirectBuffer(MAIN_RENDER_MASK));
 
     applicationData->setupInstances(glm::vec3(-25, -25, 0), glm::vec3(25, 25, 0), 200000, assetBufferFilterNode);
+    // positions and bones of all people are streamed to GPU in each frame. Each frame in flight has its own region of the buffer
+    uint32_t streamingFrameCount = surfaces[0]->getFramesInFlight();
+    for (auto& surface : surfaces)
+      CHECK_LOG_THROW(surface->getFramesInFlight() != streamingFrameCount, "All surfaces must use the same number of frames in flight");
+    applicationData->positionBuffer = std::make_shared<pumex::StreamingBuffer<PositionData>>(buffersAllocator, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, applicationData->updateData.people.size(), streamingFrameCount);
 
     // TODO : instance count
     uint32_t instanceCount = applicationData->updateData.people.size() + applicationData->updateData.clothes.size();
@@ -778,7 +815,7 @@ int main(int argc, char * argv[])
     filterDescriptorSet->setDescriptor(0, cameraUbo);
     filterDescriptorSet->setDescriptor(1, std::make_shared<pumex::StorageBuffer>(skeletalAssetBuffer->getTypeBuffer(MAIN_RENDER_MASK)));
     filterDescriptorSet->setDescriptor(2, std::make_shared<pumex::StorageBuffer>(skeletalAssetBuffer->getLodBuffer(MAIN_RENDER_MASK)));
-    filterDescriptorSet->setDescriptor(3, positionSbo);
+    filterDescriptorSet->setDescriptor(3, positionSbo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC);
     filterDescriptorSet->setDescriptor(4, instanceSbo);
     filterDescriptorSet->setDescriptor(5, std::make_shared<pumex::StorageBuffer>(assetBufferFilterNode->getDrawIndexedIndirectBuffer(MAIN_RENDER_MASK)));
     filterDescriptorSet->setDescriptor(6, resultsSbo);
@@ -795,7 +832,7 @@ int main(int argc, char * argv[])
     std::vector<pumex::DescriptorSetLayoutBinding> instancedRenderLayoutBindings =
     {
       { 0, 1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT },
-      { 1, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT },
+      { 1, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT },
       { 2, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT },
       { 3, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT },
       { 4, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT },
@@ -815,7 +852,7 @@ int main(int argc, char * argv[])
     };
     instancedRenderPipeline->vertexInput =
     {
-      { 0, VK_VERTEX_INPUT_RATE_VERTEX, vertexSemantic }
+      { 0, VK_VERTEX_INPUT_RATE_VERTEX, bufferSemantic }
     };
     instancedRenderPipeline->blendAttachments =
     {
@@ -834,7 +871,7 @@ int main(int argc, char * argv[])
 
     auto instancedRenderDescriptorSet = std::make_shared<pumex::DescriptorSet>(descriptorPool, instancedRenderDescriptorSetLayout);
     instancedRenderDescriptorSet->setDescriptor(0, cameraUbo);
-    instancedRenderDescriptorSet->setDescriptor(1, positionSbo);
+    instancedRenderDescriptorSet->setDescriptor(1, positionSbo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC);
     instancedRenderDescriptorSet->setDescriptor(2, instanceSbo);
     instancedRenderDescriptorSet->setDescriptor(3, resultsSbo);
     instancedRenderDescriptorSet->setDescriptor(4, std::make_shared<pumex::StorageBuffer>(materialSet->typeDefinitionBuffer));
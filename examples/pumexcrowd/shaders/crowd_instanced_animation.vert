@@ -9,7 +9,7 @@ layout (location = 0) in vec3 inPos;
 layout (location = 1) in vec3 inNormal;
 layout (location = 2) in vec3 inUV;
 layout (location = 3) in vec4 inBoneWeight;
-layout (location = 4) in vec4 inBoneIndex;
+layout (location = 4) in uvec4 inBoneIndex;
 
 struct PositionData
 {
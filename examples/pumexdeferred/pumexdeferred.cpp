@@ -25,6 +25,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <pumex/Pumex.h>
 #include <pumex/AssetLoaderAssimp.h>
+#include <pumex/AssetLoaderCache.h>
 #include <pumex/utils/Shapes.h>
 #include <args.hxx>
 
@@ -220,6 +221,7 @@ int main( int argc, char * argv[] )
   args::ValueFlag<uint32_t>                         updatesPerSecond(parser, "update_frequency", "number of update calls per second", { 'u' }, 60);
   args::Flag                                        skipDepthPrepass(parser, "nodp", "skip depth prepass", { 'n' });
   args::MapFlag<std::string, VkSampleCountFlagBits> samplesPerPixel(parser, "samples", "samples per pixel (1,2,4,8)", { 's' }, availableSamplesPerPixel, VK_SAMPLE_COUNT_4_BIT);
+  args::ValueFlag<std::string>                      assetCacheDirectory(parser, "cache_directory", "directory for binary asset cache", { 'c' });
   try
   {
     parser.ParseCLI(argc, argv);
@@ -247,6 +249,7 @@ int main( int argc, char * argv[] )
   VkPresentModeKHR presentMode      = args::get(presentationMode);
   uint32_t updateFrequency          = std::max(1U, args::get(updatesPerSecond));
   VkSampleCountFlagBits sampleCount = args::get(samplesPerPixel);
+  std::string cacheDirectory        = args::get(assetCacheDirectory);
 
   LOG_INFO << "Deferred rendering with physically based rendering and antialiasing : ";
   if (enableDebugging)
@@ -334,8 +337,10 @@ int main( int argc, char * argv[] )
     auto pipelineCache = std::make_shared<pumex::PipelineCache>();
 
     std::vector<pumex::VertexSemantic> requiredSemantic = { { pumex::VertexSemantic::Position, 3 },{ pumex::VertexSemantic::Normal, 3 },{ pumex::VertexSemantic::Tangent, 3 },{ pumex::VertexSemantic::TexCoord, 3 },{ pumex::VertexSemantic::BoneIndex, 1 },{ pumex::VertexSemantic::BoneWeight, 1 } };
+    // vertices in a vertex buffer are quantized : 44 bytes per vertex instead of 56. Texture coordinates store material index in z component ( exact in 16 bit float )
+    std::vector<pumex::VertexSemantic> bufferSemantic = { { pumex::VertexSemantic::Position, 3 },{ pumex::VertexSemantic::Normal, 3, pumex::VertexSemantic::SNorm16 },{ pumex::VertexSemantic::Tangent, 3, pumex::VertexSemantic::SNorm16 },{ pumex::VertexSemantic::TexCoord, 3, pumex::VertexSemantic::Float16 },{ pumex::VertexSemantic::BoneIndex, 1, pumex::VertexSemantic::UInt8 },{ pumex::VertexSemantic::BoneWeight, 1, pumex::VertexSemantic::UNorm8 } };
 
-    std::vector<pumex::AssetBufferVertexSemantics> assetSemantics = { { 1, requiredSemantic } };
+    std::vector<pumex::AssetBufferVertexSemantics> assetSemantics = { { 1, bufferSemantic } };
     std::shared_ptr<pumex::AssetBuffer> assetBuffer = std::make_shared<pumex::AssetBuffer>(assetSemantics, buffersAllocator, verticesAllocator);
 
     std::vector<pumex::TextureSemantic> textureSemantic = { { pumex::TextureSemantic::Diffuse, 0 },{ pumex::TextureSemantic::Specular, 1 },{ pumex::TextureSemantic::LightMap, 2 },{ pumex::TextureSemantic::Normals, 3 } };
@@ -347,9 +352,12 @@ int main( int argc, char * argv[] )
     std::shared_ptr<pumex::MaterialRegistry<MaterialData>> materialRegistry = std::make_shared<pumex::MaterialRegistry<MaterialData>>(buffersAllocator);
     std::shared_ptr<pumex::MaterialSet> materialSet = std::make_shared<pumex::MaterialSet>(viewer, materialRegistry, textureRegistry, buffersAllocator, textureSemantic);
 
-    pumex::AssetLoaderAssimp loader;
-    loader.setImportFlags(loader.getImportFlags() | aiProcess_CalcTangentSpace );
-    std::shared_ptr<pumex::Asset> asset(loader.load(viewer, "sponza/sponza.dae", false, requiredSemantic));
+    std::shared_ptr<pumex::AssetLoaderAssimp> assimpLoader = std::make_shared<pumex::AssetLoaderAssimp>();
+    assimpLoader->setImportFlags(assimpLoader->getImportFlags() | aiProcess_CalcTangentSpace );
+    std::shared_ptr<pumex::AssetLoader> loader = assimpLoader;
+    if (!cacheDirectory.empty())
+      loader = std::make_shared<pumex::AssetLoaderCache>(assimpLoader, cacheDirectory);
+    std::shared_ptr<pumex::Asset> asset(loader->load(viewer, "sponza/sponza.dae", false, requiredSemantic));
 
     pumex::BoundingBox bbox = pumex::calculateBoundingBox(*asset, 1);
 
@@ -407,7 +415,7 @@ int main( int argc, char * argv[] )
       };
       buildzPipeline->vertexInput =
       {
-        { 0, VK_VERTEX_INPUT_RATE_VERTEX, requiredSemantic }
+        { 0, VK_VERTEX_INPUT_RATE_VERTEX, bufferSemantic }
       };
       buildzPipeline->rasterizationSamples = sampleCount;
 
@@ -469,7 +477,7 @@ int main( int argc, char * argv[] )
     };
     gbufferPipeline->vertexInput =
     {
-      { 0, VK_VERTEX_INPUT_RATE_VERTEX, requiredSemantic }
+      { 0, VK_VERTEX_INPUT_RATE_VERTEX, bufferSemantic }
     };
     gbufferPipeline->blendAttachments =
     {
@@ -9,8 +9,8 @@ layout (location = 0) in vec3 inPos;
 layout (location = 1) in vec3 inNormal;
 layout (location = 2) in vec3 inTangent;
 layout (location = 3) in vec3 inUV;
-layout (location = 4) in float inBoneWeight;
-layout (location = 5) in float inBoneIndex;
+layout (location = 4) in uint  inBoneIndex;
+layout (location = 5) in float inBoneWeight;
 
 struct MaterialTypeDefinition
 {
@@ -55,7 +55,7 @@ layout (location = 1) flat out uint materialID;
 
 void main() 
 {
-  mat4 boneTransform = object.bones[int(inBoneIndex)] * inBoneWeight;
+  mat4 boneTransform = object.bones[inBoneIndex] * inBoneWeight;
   mat4 modelMatrix   = object.position * boneTransform;
   vec4 outPosition   = modelMatrix * vec4(inPos.xyz, 1.0);
   gl_Position        = camera.projectionMatrix * camera.viewMatrix * outPosition;
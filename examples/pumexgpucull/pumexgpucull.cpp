@@ -866,12 +866,12 @@ struct GpuCullApplicationData
   std::unordered_map<uint32_t, glm::mat4>                             slaveViewMatrix;
   std::shared_ptr<pumex::BasicCameraHandler>                          camHandler;
 
-  GpuCullApplicationData(std::shared_ptr<pumex::DeviceMemoryAllocator> buffersAllocator)
+  GpuCullApplicationData(std::shared_ptr<pumex::DeviceMemoryAllocator> buffersAllocator, std::shared_ptr<pumex::DeviceMemoryAllocator> dynamicBuffersAllocator)
     : _randomTime2NextTurn{ 0.1f }, _randomRotation(-glm::pi<float>(), glm::pi<float>())
   {
     cameraBuffer          = std::make_shared<pumex::Buffer<pumex::Camera>>(buffersAllocator, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, pumex::pbPerSurface, pumex::swOnce, true);
     textCameraBuffer      = std::make_shared<pumex::Buffer<pumex::Camera>>(buffersAllocator, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, pumex::pbPerSurface, pumex::swOnce, true);
-    dynamicInstanceBuffer = std::make_shared<pumex::Buffer<std::vector<DynamicInstanceData>>>(std::make_shared<std::vector<DynamicInstanceData>>(), buffersAllocator, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, pumex::pbPerDevice, pumex::swForEachImage);
+    dynamicInstanceBuffer = std::make_shared<pumex::Buffer<std::vector<DynamicInstanceData>>>(std::make_shared<std::vector<DynamicInstanceData>>(), dynamicBuffersAllocator, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, pumex::pbPerDevice, pumex::swForEachImage);
   }
 
   void setCameraHandler(std::shared_ptr<pumex::BasicCameraHandler> bcamHandler)
@@ -1253,6 +1253,8 @@ int main(int argc, char * argv[])
   args::ValueFlag<float>                       densityModifierArg(parser, "density-modifier", "instance density [%]", { "density-modifier" }, 100.0f);
   args::ValueFlag<float>                       triangleModifierArg(parser, "triangle-modifier", "instance triangle quantity [%]", { "triangle-modifier" }, 100.0f);
   args::ValueFlag<uint32_t>                    instancesPerCellArg(parser, "instances-per-cell", "how many static instances per cell", { "instances-per-cell" }, 4096);
+  args::Flag                                   showVisibleCountsArg(parser, "show-counts", "periodically log the number of visible static objects", { "show-counts" });
+  args::Flag                                   uploadQueueArg(parser, "upload-queue", "keep dynamic instances in device local memory and update them on a dedicated transfer queue", { "upload-queue" });
   try
   {
     parser.ParseCLI(argc, argv);
@@ -1287,6 +1289,8 @@ int main(int argc, char * argv[])
   float densityModifier        = args::get(densityModifierArg) / 100.0f;  // density of objects is multiplied by this parameter
   float triangleModifier       = args::get(triangleModifierArg) / 100.0f; // the number of triangles on geometries is multiplied by this parameter
   uint32_t instancesPerCell    = args::get(instancesPerCellArg);
+  bool showVisibleCounts       = showVisibleCountsArg;
+  bool useUploadQueue          = uploadQueueArg;
 
   LOG_INFO << "Object culling on GPU";
   if (enableDebugging)
@@ -1329,6 +1333,15 @@ int main(int argc, char * argv[])
     // all created surfaces will use the same device
     std::vector<std::string> requestDeviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
     std::shared_ptr<pumex::Device> device = viewer->addDevice(0, requestDeviceExtensions);
+    // dynamic instances are sent to GPU on a dedicated transfer queue, so that copies do not wait for rendering of frames in flight
+    if (useUploadQueue)
+    {
+      auto physicalDevice = device->physical.lock();
+      if (std::any_of(begin(physicalDevice->queueFamilyProperties), end(physicalDevice->queueFamilyProperties), [](const VkQueueFamilyProperties& qfp) { return (qfp.queueFlags & VK_QUEUE_TRANSFER_BIT) && !(qfp.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)); }))
+        device->setUploadQueue({ VK_QUEUE_TRANSFER_BIT, VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT, 0.5f });
+      else
+        LOG_WARNING << "Device has no dedicated transfer queue. Dynamic instances will be updated on rendering queue" << std::endl;
+    }
 
     pumex::SurfaceTraits surfaceTraits{ 3, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR, 1, presentMode, VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR, VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR };
     std::vector<std::shared_ptr<pumex::Surface>> surfaces;
@@ -1339,6 +1352,10 @@ int main(int argc, char * argv[])
     std::shared_ptr<pumex::DeviceMemoryAllocator> frameBufferAllocator = std::make_shared<pumex::DeviceMemoryAllocator>(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 32 * 1024 * 1024, pumex::DeviceMemoryAllocator::FIRST_FIT);
     // alocate 256 MB for uniform and storage buffers
     std::shared_ptr<pumex::DeviceMemoryAllocator> buffersAllocator = std::make_shared<pumex::DeviceMemoryAllocator>(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 256 * 1024 * 1024, pumex::DeviceMemoryAllocator::FIRST_FIT);
+    // dynamic instances are placed in device local memory when they are sent through upload queue
+    std::shared_ptr<pumex::DeviceMemoryAllocator> dynamicBuffersAllocator = buffersAllocator;
+    if (useUploadQueue)
+      dynamicBuffersAllocator = std::make_shared<pumex::DeviceMemoryAllocator>(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 64 * 1024 * 1024, pumex::DeviceMemoryAllocator::FIRST_FIT);
     // allocate 32 MB for vertex and index buffers
     std::shared_ptr<pumex::DeviceMemoryAllocator> verticesAllocator = std::make_shared<pumex::DeviceMemoryAllocator>(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 32 * 1024 * 1024, pumex::DeviceMemoryAllocator::FIRST_FIT);
     // allocate 4 MB memory for font textures
@@ -1347,6 +1364,10 @@ int main(int argc, char * argv[])
     std::shared_ptr<pumex::DescriptorPool> descriptorPool = std::make_shared<pumex::DescriptorPool>();
 
     std::vector<pumex::QueueTraits> queueTraits{ { VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT, 0, 0.75f } };
+    // culling may be performed on a dedicated compute queue when device has one
+    auto physicalDevice = device->physical.lock();
+    if (std::any_of(begin(physicalDevice->queueFamilyProperties), end(physicalDevice->queueFamilyProperties), [](const VkQueueFamilyProperties& qfp) { return (qfp.queueFlags & VK_QUEUE_COMPUTE_BIT) && !(qfp.queueFlags & VK_QUEUE_GRAPHICS_BIT); }))
+      queueTraits.push_back({ VK_QUEUE_COMPUTE_BIT, VK_QUEUE_GRAPHICS_BIT, 0.75f });
 
     std::shared_ptr<pumex::RenderWorkflow> workflow = std::make_shared<pumex::RenderWorkflow>("gpucull_workflow", frameBufferAllocator, queueTraits);
       workflow->addResourceType("depth_samples", false, VK_FORMAT_D32_SFLOAT,    VK_SAMPLE_COUNT_1_BIT, pumex::atDepth,   pumex::AttachmentSize{ pumex::AttachmentSize::SurfaceDependent, glm::vec2(1.0f,1.0f) }, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT);
@@ -1379,7 +1400,7 @@ int main(int argc, char * argv[])
       workflow->addBufferInput( "rendering",      "compute_results", "dynamic_indirect_draw",    VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,  VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
     }
 
-    std::shared_ptr<GpuCullApplicationData> applicationData = std::make_shared<GpuCullApplicationData>(buffersAllocator);
+    std::shared_ptr<GpuCullApplicationData> applicationData = std::make_shared<GpuCullApplicationData>(buffersAllocator, dynamicBuffersAllocator);
 
     auto renderingRoot = std::make_shared<pumex::Group>();
     renderingRoot->setName("renderingRoot");
@@ -1396,6 +1417,7 @@ int main(int argc, char * argv[])
 
     std::shared_ptr<pumex::PipelineCache>                     pipelineCache = std::make_shared<pumex::PipelineCache>();
     std::vector<uint32_t>                                     staticTypeIDs;
+    std::shared_ptr<pumex::MemoryBuffer>                      staticDrawBuffer;
     std::unordered_map<uint32_t, std::shared_ptr<XXX>>        dynamicTypeIDs;
     std::vector<DynamicObjectData>                            dynamicObjectData;
     std::default_random_engine                                randomEngine;
@@ -1455,7 +1477,8 @@ int main(int argc, char * argv[])
       auto staticAssetBufferFilterNode = std::make_shared<pumex::AssetBufferFilterNode>(staticAssetBuffer, buffersAllocator);
       staticAssetBufferFilterNode->setEventResizeOutputs(std::bind(resizeStaticOutputBuffers, staticResultsBuffer, staticResultsIndexBuffer, std::placeholders::_1, std::placeholders::_2));
       staticAssetBufferFilterNode->setName("staticAssetBufferFilterNode");
-      workflow->associateMemoryObject("static_indirect_draw", staticAssetBufferFilterNode->getDrawIndexedIndirectBuffer(MAIN_RENDER_MASK));
+      staticDrawBuffer = staticAssetBufferFilterNode->getDrawIndexedIndirectBuffer(MAIN_RENDER_MASK);
+      workflow->associateMemoryObject("static_indirect_draw", staticDrawBuffer);
       
       staticFilterPipeline->addChild(staticAssetBufferFilterNode);
 
@@ -1650,7 +1673,7 @@ int main(int argc, char * argv[])
     }
 
     // connecting workflow to all surfaces
-    std::shared_ptr<pumex::SingleQueueWorkflowCompiler> workflowCompiler = std::make_shared<pumex::SingleQueueWorkflowCompiler>();
+    std::shared_ptr<pumex::MultiQueueWorkflowCompiler> workflowCompiler = std::make_shared<pumex::MultiQueueWorkflowCompiler>();
     for (auto& surf : surfaces)
       surf->setRenderWorkflow(workflow, workflowCompiler);
 
@@ -1676,6 +1699,28 @@ int main(int argc, char * argv[])
       surf->setEventSurfacePrepareStatistics(std::bind(&pumex::TimeStatisticsHandler::collectData, tsHandler, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
     }
 
+    // number of visible objects is read from indirect draw commands filled by static filter. Data arrives a few frames later, so GPU is never stalled
+    if (showVisibleCounts && staticDrawBuffer != nullptr)
+    {
+      for (auto& surf : surfaces)
+      {
+        surf->setEventSurfaceRenderFinish([staticDrawBuffer](std::shared_ptr<pumex::Surface> surface)
+        {
+          if (surface->viewer.lock()->getFrameNumber() % 60 != 0)
+            return;
+          uint32_t surfaceID = surface->getID();
+          surface->getReadbackManager()->readBuffer(staticDrawBuffer, 0, VK_WHOLE_SIZE, [surfaceID](const void* data, VkDeviceSize size)
+          {
+            auto commands = static_cast<const pumex::DrawIndexedIndirectCommand*>(data);
+            LOG_INFO << "Surface " << surfaceID << " visible static objects for each type and LOD :";
+            for (uint32_t i = 0; i < size / sizeof(pumex::DrawIndexedIndirectCommand); ++i)
+              LOG_INFO << " " << commands[i].instanceCount;
+            LOG_INFO << std::endl;
+          });
+        });
+      }
+    }
+
     viewer->run();
   }
   catch (const std::exception& e)
@@ -25,7 +25,9 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <pumex/Pumex.h>
 #include <pumex/AssetLoaderAssimp.h>
+#include <pumex/AssetLoaderCache.h>
 #include <pumex/utils/Shapes.h>
+#include <pumex/utils/GeometryOptimizer.h>
 #include <args.hxx>
 
 // pumexviewer is a very basic program, that performs textureless rendering of a 3D asset provided in a command line
@@ -50,11 +52,15 @@ struct ViewerApplicationData
 {
   ViewerApplicationData( std::shared_ptr<pumex::DeviceMemoryAllocator> buffersAllocator )
   {
-    // create buffers visible from renderer
+    // create buffers visible from renderer. Small uniform buffers are placed in a single VkBuffer
+    uniformBufferPool = std::make_shared<pumex::BufferPool>(buffersAllocator, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, 256 * 1024);
     cameraBuffer     = std::make_shared<pumex::Buffer<pumex::Camera>>(buffersAllocator, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, pumex::pbPerSurface, pumex::swOnce, true);
     textCameraBuffer = std::make_shared<pumex::Buffer<pumex::Camera>>(buffersAllocator, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, pumex::pbPerSurface, pumex::swOnce, true);
     positionData     = std::make_shared<PositionData>();
     positionBuffer   = std::make_shared<pumex::Buffer<PositionData>>(positionData, buffersAllocator, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, pumex::pbPerDevice, pumex::swOnce);
+    cameraBuffer->setBufferPool(uniformBufferPool);
+    textCameraBuffer->setBufferPool(uniformBufferPool);
+    positionBuffer->setBufferPool(uniformBufferPool);
   }
 
   void setCameraHandler(std::shared_ptr<pumex::BasicCameraHandler> bcamHandler)
@@ -128,6 +134,7 @@ struct ViewerApplicationData
     positionBuffer->invalidateData();
   }
 
+  std::shared_ptr<pumex::BufferPool>            uniformBufferPool;
   std::shared_ptr<pumex::Buffer<pumex::Camera>> cameraBuffer;
   std::shared_ptr<pumex::Buffer<pumex::Camera>> textCameraBuffer;
   std::shared_ptr<PositionData>                 positionData;
@@ -153,6 +160,10 @@ int main( int argc, char * argv[] )
   args::Flag                                   useFullScreen(parser, "fullscreen", "create fullscreen window", { 'f' });
   args::MapFlag<std::string, VkPresentModeKHR> presentationMode(parser, "presentation_mode", "presentation mode (immediate, mailbox, fifo, fifo_relaxed)", { 'p' }, availablePresentationModes, VK_PRESENT_MODE_MAILBOX_KHR);
   args::ValueFlag<uint32_t>                    updatesPerSecond(parser, "update_frequency", "number of update calls per second", { 'u' }, 60);
+  args::ValueFlag<std::string>                 assetCacheDirectory(parser, "cache_directory", "directory for binary asset cache", { 'c' });
+  args::Flag                                   benchmarkLoading(parser, "benchmark", "compare model loading time of Assimp loader and binary asset cache, then exit", { 'b' });
+  args::Flag                                   optimizeGeometry(parser, "optimize", "optimize model geometry for vertex cache, overdraw and vertex fetch", { 'o' });
+  args::ValueFlag<uint32_t>                    framesInFlightArg(parser, "frames_in_flight", "number of frames in flight ( 0 means one frame for each swapchain image )", { 'i' }, 2);
   args::Positional<std::string>                modelNameArg(parser, "model", "3D model filename");
   args::Positional<std::string>                animationNameArg(parser, "animation", "3D model with animation");
   try
@@ -189,6 +200,8 @@ int main( int argc, char * argv[] )
   uint32_t updateFrequency      = std::max(1U, args::get(updatesPerSecond));
   std::string modelFileName     = args::get(modelNameArg);
   std::string animationFileName = args::get(animationNameArg);
+  std::string cacheDirectory    = args::get(assetCacheDirectory);
+  uint32_t framesInFlight       = args::get(framesInFlightArg);
   std::string windowName        = "Pumex viewer : ";
   windowName += modelFileName;
 
@@ -209,16 +222,54 @@ int main( int argc, char * argv[] )
     // vertex semantic defines how a single vertex in an asset will look like
     std::vector<pumex::VertexSemantic> requiredSemantic = { { pumex::VertexSemantic::Position, 3 },{ pumex::VertexSemantic::Normal, 3 },{ pumex::VertexSemantic::TexCoord, 2 },{ pumex::VertexSemantic::BoneWeight, 4 },{ pumex::VertexSemantic::BoneIndex, 4 } };
 
-    // we load an asset using Assimp asset loader
-    pumex::AssetLoaderAssimp loader;
-    std::shared_ptr<pumex::Asset> asset(loader.load(viewer, modelFileName, false, requiredSemantic));
+    if (benchmarkLoading)
+    {
+      if (cacheDirectory.empty())
+        cacheDirectory = "pumex_asset_cache";
+      const uint32_t repetitions = 5;
+      std::shared_ptr<pumex::AssetLoaderAssimp> assimpLoader = std::make_shared<pumex::AssetLoaderAssimp>();
+      pumex::AssetLoaderCache cacheLoader(assimpLoader, cacheDirectory);
+      // first call creates cache file
+      cacheLoader.load(viewer, modelFileName, false, requiredSemantic);
+
+      auto assimpStart = pumex::HPClock::now();
+      for (uint32_t i = 0; i < repetitions; ++i)
+        assimpLoader->load(viewer, modelFileName, false, requiredSemantic);
+      auto cacheStart  = pumex::HPClock::now();
+      for (uint32_t i = 0; i < repetitions; ++i)
+        cacheLoader.load(viewer, modelFileName, false, requiredSemantic);
+      auto cacheEnd    = pumex::HPClock::now();
+
+      LOG_INFO << "Model " << modelFileName << " loading time ( average of " << repetitions << " loads )" << std::endl;
+      LOG_INFO << "Assimp loader       : " << 1000.0 * pumex::inSeconds(cacheStart - assimpStart) / repetitions << " ms" << std::endl;
+      LOG_INFO << "Binary asset cache  : " << 1000.0 * pumex::inSeconds(cacheEnd - cacheStart) / repetitions << " ms" << std::endl;
+      viewer->cleanup();
+      FLUSH_LOG;
+      return 0;
+    }
+
+    // we load an asset using Assimp asset loader. Loaded assets may be stored in binary asset cache
+    std::shared_ptr<pumex::AssetLoader> loader = std::make_shared<pumex::AssetLoaderAssimp>();
+    if (!cacheDirectory.empty())
+      loader = std::make_shared<pumex::AssetLoaderCache>(loader, cacheDirectory);
+    std::shared_ptr<pumex::Asset> asset(loader->load(viewer, modelFileName, false, requiredSemantic));
 
     if (!animationFileName.empty() )
     {
-      std::shared_ptr<pumex::Asset> animAsset(loader.load(viewer, animationFileName, true, requiredSemantic));
+      std::shared_ptr<pumex::Asset> animAsset(loader->load(viewer, animationFileName, true, requiredSemantic));
       asset->animations = animAsset->animations;
     }
 
+    if (optimizeGeometry)
+    {
+      std::vector<float> acmrBefore;
+      for (const auto& geometry : asset->geometries)
+        acmrBefore.push_back(pumex::calculateACMR(geometry));
+      pumex::optimizeAsset(*asset);
+      for (uint32_t i = 0; i < asset->geometries.size(); ++i)
+        LOG_INFO << "Geometry " << i << " ( " << asset->geometries[i].getPrimitiveCount() << " triangles ) ACMR : " << acmrBefore[i] << " -> " << pumex::calculateACMR(asset->geometries[i]) << std::endl;
+    }
+
     // now is the time to create devices, windows and surfaces.
     std::vector<std::string> requestDeviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
     std::shared_ptr<pumex::Device> device = viewer->addDevice(0, requestDeviceExtensions);
@@ -227,7 +278,8 @@ int main( int argc, char * argv[] )
     pumex::WindowTraits windowTraits{ 0, 100, 100, 640, 480, useFullScreen ? pumex::WindowTraits::FULLSCREEN : pumex::WindowTraits::WINDOW, windowName };
     std::shared_ptr<pumex::Window> window = pumex::Window::createWindow(windowTraits);
 
-    pumex::SurfaceTraits surfaceTraits{ 3, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR, 1, presentMode, VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR, VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR };
+    // 3 swapchain images, but only framesInFlight copies of per frame resources
+    pumex::SurfaceTraits surfaceTraits{ 3, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR, 1, presentMode, VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR, VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR, framesInFlight };
     std::shared_ptr<pumex::Surface> surface = viewer->addSurface(window, device, surfaceTraits);
 
     // alocate 16 MB for frame buffers
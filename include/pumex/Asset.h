@@ -70,26 +70,42 @@ public:
 };
 
 // struct defining contents of a single vertex
+// Geometry always stores vertex values as floats. Format defines how the attribute is stored in a vertex buffer - vertices are quantized
+// to that format by copyAndConvertVertices() ( e.g. when AssetBuffer builds its vertex buffers ). Attributes in a vertex buffer are aligned to 4 bytes.
+// Available formats :
+// - Float32           : 32 bit float
+// - Float16           : 16 bit float. Attributes with 3 components are padded to 4 components
+// - SNorm8 .. UNorm16 : normalized integers, read by shader as floats in range [-1,1] or [0,1]. Attributes with 3 components are padded to 4 components
+// - UInt8, UInt16     : integers ( e.g. bone indices ) - shader must read them as uint/uvec
+// - SNorm10_10_10_2   : 3 or 4 components packed in 32 bits ( VK_FORMAT_A2B10G10R10_SNORM_PACK32 - check vertex buffer support on a device )
+// - OctahedralSNorm16 : normalized vector with 3 components stored as 2 snorm16 values. Shader must decode it ( see decodeOctahedral() )
 struct PUMEX_EXPORT VertexSemantic
 {
   enum Type { Position, Normal, TexCoord, Color, Tangent, Bitangent, BoneIndex, BoneWeight };
+  enum Format { Float32, Float16, SNorm8, UNorm8, SNorm16, UNorm16, UInt8, UInt16, SNorm10_10_10_2, OctahedralSNorm16 };
 
-  VertexSemantic(const Type& t, uint32_t s)
-    : type{t}, size{s}
+  VertexSemantic(const Type& t, uint32_t s, Format f = Float32)
+    : type{t}, size{s}, format{f}
   {
   }
   Type     type;
   uint32_t size;
+  Format   format;
 
   VkFormat getVertexFormat() const;
+  // size of the attribute in a vertex buffer ( in bytes )
+  uint32_t getByteSize() const;
 };
 
 inline bool operator==(const VertexSemantic& lhs, const VertexSemantic& rhs)
 {
-  return (lhs.type == rhs.type) && (lhs.size == rhs.size);
+  return (lhs.type == rhs.type) && (lhs.size == rhs.size) && (lhs.format == rhs.format);
 }
 
+// number of floats used by a single vertex in Geometry
 PUMEX_EXPORT uint32_t calcVertexSize(const std::vector<VertexSemantic>& layout);
+// size of a single vertex in a vertex buffer ( in bytes )
+PUMEX_EXPORT uint32_t calcVertexByteSize(const std::vector<VertexSemantic>& layout);
 PUMEX_EXPORT uint32_t calcPrimitiveSize(VkPrimitiveTopology topology);
 
 // helper class to deal with vertices having different vertex semantics
@@ -238,6 +254,11 @@ class PUMEX_EXPORT AssetLoader
 {
 public:
   virtual std::shared_ptr<Asset> load(std::shared_ptr<Viewer> viewer, const std::string& fileName, bool animationOnly = false, const std::vector<VertexSemantic>& requiredSemantic = std::vector<VertexSemantic>()) = 0;
+  // value identifying loader settings that change loaded assets ( AssetLoaderCache uses it to name cache files )
+  virtual uint64_t getSettingsID() const
+  {
+    return 0;
+  }
 };
 
 uint32_t VertexAccumulator::getOffset(VertexSemantic::Type semanticType, uint32_t channel) const
@@ -278,8 +299,13 @@ VkDeviceSize Geometry::getIndexCount() const     { return indices.size(); }
 VkDeviceSize Geometry::getIndexSize() const      { return indices.size() * sizeof(uint32_t); }
 VkDeviceSize Geometry::getPrimitiveCount() const { return indices.size() / calcPrimitiveSize(topology); }
 
-// convert vertices from one semantic to another
+// convert vertices from one semantic to another. Formats of target semantic are ignored - all values are stored as floats
 PUMEX_EXPORT void copyAndConvertVertices(std::vector<float>& targetBuffer, const std::vector<VertexSemantic>& targetSemantic, const std::vector<float>& sourceBuffer, const std::vector<VertexSemantic>& sourceSemantic);
+// convert vertices from one semantic to another and quantize them according to formats of target semantic
+PUMEX_EXPORT void copyAndConvertVertices(std::vector<unsigned char>& targetBuffer, const std::vector<VertexSemantic>& targetSemantic, const std::vector<float>& sourceBuffer, const std::vector<VertexSemantic>& sourceSemantic);
+// octahedral mapping of normalized vectors ( "A Survey of Efficient Representations for Independent Unit Vectors" by Cigolle et al. )
+PUMEX_EXPORT glm::vec2 encodeOctahedral(const glm::vec3& vector);
+PUMEX_EXPORT glm::vec3 decodeOctahedral(const glm::vec2& encoded);
 // transform vertices using matrix
 PUMEX_EXPORT void transformGeometry(const glm::mat4& matrix , Geometry& geometry);
 // merge two assets into one
@@ -52,6 +52,8 @@ class CommandBuffer;
 // To bind AssetBuffer resources to vulkan you may use cmdBindVertexIndexBuffer().
 // Each render aspect ( identified by render mask ) has its own vertex and index buffers, so the user is able to use different shaders to 
 // draw to different subpasses.
+// Index buffer of a render aspect uses 16 bit indices when every geometry in it has less than 65535 vertices ( indices are relative to
+// vertexOffset of a geometry ). Otherwise 32 bit indices are used. Check getIndexType() when binding index buffer manually.
 //
 // After vertex/index binding the user is ready to draw objects.
 // To draw a single object it is enough to use cmdDrawObject() method, but AssetBuffer was created with
@@ -171,6 +173,7 @@ public:
   std::shared_ptr<Buffer<std::vector<AssetTypeDefinition>>>     getTypeBuffer(uint32_t renderMask);
   std::shared_ptr<Buffer<std::vector<AssetLodDefinition>>>      getLodBuffer(uint32_t renderMask);
   std::shared_ptr<Buffer<std::vector<AssetGeometryDefinition>>> getGeomBuffer(uint32_t renderMask);
+  VkIndexType                                                   getIndexType(uint32_t renderMask) const;
 
 protected:
   struct PerRenderMaskData
@@ -178,10 +181,11 @@ protected:
     PerRenderMaskData() = default;
     PerRenderMaskData(std::shared_ptr<DeviceMemoryAllocator> bufferAllocator, std::shared_ptr<DeviceMemoryAllocator> vertexIndexAllocator);
 
-    std::shared_ptr<std::vector<float>>                           vertices;
-    std::shared_ptr<std::vector<uint32_t>>                        indices;
-    std::shared_ptr<Buffer<std::vector<float>>>                   vertexBuffer;
-    std::shared_ptr<Buffer<std::vector<uint32_t>>>                indexBuffer;
+    std::shared_ptr<std::vector<unsigned char>>                   vertices;
+    std::shared_ptr<std::vector<unsigned char>>                   indices;
+    std::shared_ptr<Buffer<std::vector<unsigned char>>>           vertexBuffer;
+    std::shared_ptr<Buffer<std::vector<unsigned char>>>           indexBuffer;
+    VkIndexType                                                   indexType = VK_INDEX_TYPE_UINT32;
 
     std::shared_ptr<std::vector<AssetTypeDefinition>>             aTypes;
     std::shared_ptr<std::vector<AssetLodDefinition>>              aLods;
@@ -0,0 +1,66 @@
+//
+// Copyright(c) 2017-2018 Paweł Księżopolski ( pumexx )
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include <pumex/Export.h>
+#include <pumex/Asset.h>
+
+namespace pumex
+{
+
+// Asset loader that stores assets loaded by other loader ( e.g. AssetLoaderAssimp ) in binary files placed in a cache directory.
+// Next time the same asset is requested - the binary file is memory mapped and the asset is built from it without calling the other loader.
+// Name of the cache file is created from a hash of the source file content, animationOnly flag, required vertex semantic and loader settings,
+// so that modified source files are loaded again. Files referenced by the source file ( e.g. OBJ materials ) are not taken into account.
+class PUMEX_EXPORT AssetLoaderCache : public AssetLoader
+{
+public:
+  explicit AssetLoaderCache(std::shared_ptr<AssetLoader> loader, const std::string& cacheDirectory);
+  std::shared_ptr<Asset> load(std::shared_ptr<Viewer> viewer, const std::string& fileName, bool animationOnly = false, const std::vector<VertexSemantic>& requiredSemantic = std::vector<VertexSemantic>()) override;
+  uint64_t               getSettingsID() const override;
+
+  // returns empty string when source file does not exist or cannot be memory mapped on this platform. Cache is not used then
+  std::string            getCacheFileName(const std::string& fullFileName, bool animationOnly, const std::vector<VertexSemantic>& requiredSemantic) const;
+
+  inline std::shared_ptr<AssetLoader> getLoader() const;
+  inline const std::string&           getCacheDirectory() const;
+protected:
+  std::shared_ptr<AssetLoader> loader;
+  std::string                  cacheDirectory;
+};
+
+// binary asset file format version. Files with different version are ignored by readAssetFile()
+const uint32_t ASSET_FILE_VERSION = 2;
+
+// writes asset to a binary file
+PUMEX_EXPORT void                   writeAssetFile(const Asset& asset, const std::string& fileName);
+// reads asset from memory mapped binary file. Returns nullptr when file does not exist or has different version
+PUMEX_EXPORT std::shared_ptr<Asset> readAssetFile(const std::string& fileName);
+
+std::shared_ptr<AssetLoader> AssetLoaderCache::getLoader() const         { return loader; }
+const std::string&           AssetLoaderCache::getCacheDirectory() const { return cacheDirectory; }
+
+}
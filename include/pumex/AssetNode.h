@@ -45,9 +45,9 @@ public:
   uint32_t                                       renderMask;
   uint32_t                                       vertexBinding;
 protected:
-  std::shared_ptr<std::vector<float>>            vertices;
+  std::shared_ptr<std::vector<unsigned char>>    vertices;
   std::shared_ptr<std::vector<uint32_t>>         indices;
-  std::shared_ptr<Buffer<std::vector<float>>>    vertexBuffer;
+  std::shared_ptr<Buffer<std::vector<unsigned char>>> vertexBuffer;
   std::shared_ptr<Buffer<std::vector<uint32_t>>> indexBuffer;
   bool                                           registered = false;
 };
@@ -0,0 +1,71 @@
+//
+// Copyright(c) 2017-2018 Paweł Księżopolski ( pumexx )
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include <future>
+#include <functional>
+#include <tbb/task_arena.h>
+#include <tbb/task_group.h>
+#include <tbb/enumerable_thread_specific.h>
+#include <pumex/Export.h>
+#include <pumex/Asset.h>
+
+namespace pumex
+{
+
+// AsyncAssetLoader loads many assets concurrently. Each asset is loaded by a separate task in a TBB task arena, so that loading time
+// of a batch of assets scales with the number of cores. Asset loaders are not thread safe ( e.g. AssetLoaderAssimp owns Assimp::Importer ),
+// so each worker thread receives its own loader created by loaderFactory.
+// Each load returns a future that receives loaded asset ( or exception thrown by the loader ). Optional callback is called on a worker thread
+// right after asset is loaded - it may be used to register asset in thread safe objects like AssetBuffer as soon as the asset is ready.
+class PUMEX_EXPORT AsyncAssetLoader
+{
+public:
+  typedef std::function<std::shared_ptr<AssetLoader>()>   LoaderFactory;
+  typedef std::function<void(std::shared_ptr<Asset>)>     LoadCallback;
+
+  AsyncAssetLoader()                                   = delete;
+  explicit AsyncAssetLoader(LoaderFactory loaderFactory, int maxConcurrency = tbb::task_arena::automatic);
+  AsyncAssetLoader(const AsyncAssetLoader&)            = delete;
+  AsyncAssetLoader& operator=(const AsyncAssetLoader&) = delete;
+  AsyncAssetLoader(AsyncAssetLoader&&)                 = delete;
+  AsyncAssetLoader& operator=(AsyncAssetLoader&&)      = delete;
+  // waits for all pending loads
+  ~AsyncAssetLoader();
+
+  std::future<std::shared_ptr<Asset>>              load(std::shared_ptr<Viewer> viewer, const std::string& fileName, bool animationOnly = false, const std::vector<VertexSemantic>& requiredSemantic = std::vector<VertexSemantic>(), LoadCallback callback = LoadCallback());
+  // futures are returned in the same order as file names
+  std::vector<std::future<std::shared_ptr<Asset>>> load(std::shared_ptr<Viewer> viewer, const std::vector<std::string>& fileNames, bool animationOnly = false, const std::vector<VertexSemantic>& requiredSemantic = std::vector<VertexSemantic>());
+  // waits for all pending loads
+  void                                             wait();
+protected:
+  LoaderFactory                                                   loaderFactory;
+  tbb::task_arena                                                 arena;
+  tbb::task_group                                                 taskGroup;
+  tbb::enumerable_thread_specific<std::shared_ptr<AssetLoader>>   loaders;
+};
+
+}
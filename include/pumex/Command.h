@@ -79,14 +79,15 @@ class PUMEX_EXPORT CommandBuffer
 {
 public:
   CommandBuffer()                                = delete;
-  explicit CommandBuffer(VkCommandBufferLevel bufferLevel, Device* device, std::shared_ptr<CommandPool> commandPool, uint32_t cbCount = 1);
+  // each of cbCount copies may be recorded in variantCount variants ( e.g. one for each swapchain image ). Sources invalidate all variants of a copy
+  explicit CommandBuffer(VkCommandBufferLevel bufferLevel, Device* device, std::shared_ptr<CommandPool> commandPool, uint32_t cbCount = 1, uint32_t variantCount = 1);
   CommandBuffer(const CommandBuffer&)            = delete;
   CommandBuffer& operator=(const CommandBuffer&) = delete;
   CommandBuffer(CommandBuffer&&)                 = delete;
   CommandBuffer& operator=(CommandBuffer&&)      = delete;
   virtual ~CommandBuffer();
 
-  inline void     setActiveIndex(uint32_t index);
+  inline void     setActiveIndex(uint32_t index, uint32_t variant = 0);
   inline uint32_t getActiveIndex() const;
 
   void            invalidate(uint32_t index);
@@ -125,6 +126,7 @@ public:
   void            cmdDispatch(uint32_t x, uint32_t y, uint32_t z) const;
 
   void            cmdCopyBufferToImage(VkBuffer srcBuffer, const Image& image, VkImageLayout dstImageLayout, const std::vector<VkBufferImageCopy>& regions) const;
+  void            cmdCopyImage(const Image& srcImage, VkImageLayout srcImageLayout, const Image& dstImage, VkImageLayout dstImageLayout, const std::vector<VkImageCopy>& regions) const;
   void            cmdClearColorImage(const Image& image, VkImageLayout imageLayout, VkClearValue color, std::vector<VkImageSubresourceRange> subresourceRanges);
   void            cmdClearDepthStencilImage(const Image& image, VkImageLayout imageLayout, VkClearValue depthStencil, std::vector<VkImageSubresourceRange> subresourceRanges);
 
@@ -145,10 +147,12 @@ protected:
   mutable std::mutex             mutex;
   std::set<CommandBufferSource*> sources;
   uint32_t                       activeIndex   = 0;
+  uint32_t                       copyCount     = 1;
+  uint32_t                       variantCount  = 1;
 };
 
-void     CommandBuffer::setActiveIndex(uint32_t index) { activeIndex = index % commandBuffer.size(); }
-uint32_t CommandBuffer::getActiveIndex() const         { return activeIndex; }
+void     CommandBuffer::setActiveIndex(uint32_t index, uint32_t variant) { activeIndex = (variant % variantCount) * copyCount + index % copyCount; }
+uint32_t CommandBuffer::getActiveIndex() const                           { return activeIndex % copyCount; }
 bool     CommandBuffer::isValid()                      { return valid[activeIndex]!=0; }
 
 // helper class defining pipeline barrier used later in CommandBuffer::cmdPipelineBarrier()
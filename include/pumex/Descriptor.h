@@ -143,6 +143,8 @@ public:
   void invalidateDescriptorSet();
   void notifyDescriptorSet(const RenderContext& renderContext);
   void getDescriptorValues(const RenderContext& renderContext, std::vector<DescriptorValue>& values) const;
+  // adds dynamic offsets of all resources when descriptor is dynamic
+  void getDynamicOffsets(const RenderContext& renderContext, std::vector<uint32_t>& offsets) const;
 
   std::weak_ptr<DescriptorSet>           owner;
   std::vector<std::shared_ptr<Resource>> resources;
@@ -177,6 +179,8 @@ public:
   void                        removeNode(std::shared_ptr<Node> node);
 
   VkDescriptorSet             getHandle(const RenderContext& renderContext) const;
+  // dynamic offsets of all dynamic descriptors, ordered by binding number
+  void                        getDynamicOffsets(const RenderContext& renderContext, std::vector<uint32_t>& offsets) const;
 protected:
   struct DescriptorSetInternal
   {
@@ -22,9 +22,12 @@
 
 #pragma once
 #include <vector>
+#include <list>
+#include <map>
 #include <memory>
 #include <tuple>
 #include <mutex>
+#include <functional>
 #include <vulkan/vulkan.h>
 #include <glm/glm.hpp>
 #include <pumex/Export.h>
@@ -38,6 +41,9 @@ class CommandPool;
 class DescriptorPool;
 class CommandBuffer;
 class StagingBuffer;
+class StagingRing;
+class UploadManager;
+class DeviceMemoryAllocator;
 
 // struct that represents queues that must be provided by Vulkan implementation during initialization
 struct PUMEX_EXPORT QueueTraits
@@ -95,6 +101,10 @@ public:
   void                            realize();
   void                            cleanup();
 
+  // when upload queue is set, data is uploaded on this queue by UploadManager. Upload queue must be set before device is realized
+  inline void                     setUploadQueue(const QueueTraits& queueTraits);
+  inline std::shared_ptr<UploadManager> getUploadManager() const;
+
   std::shared_ptr<CommandBuffer>  beginSingleTimeCommands(std::shared_ptr<CommandPool> commandPool);
   // if user knows that he generated no commands, but started single commands already - he may skip queue submission
   void                            endSingleTimeCommands(std::shared_ptr<CommandBuffer> commandBuffer, VkQueue queue, bool submit = true);
@@ -104,8 +114,27 @@ public:
 
   std::shared_ptr<DescriptorPool> getDescriptorPool();
 
+  // staging buffers are suballocated from a staging ring. Uploads larger than a quarter of the ring ( or made when the ring is full ) get dedicated buffers.
+  // Memory of released staging buffers is reused when GPU finishes the frame in which buffer was released
   std::shared_ptr<StagingBuffer>  acquireStagingBuffer( const void* data, VkDeviceSize size );
   void                            releaseStagingBuffer(std::shared_ptr<StagingBuffer> buffer);
+  // size of the staging ring must be set before first staging buffer is acquired. Size equal to 0 turns the staging ring off
+  inline void                     setStagingRingSize(VkDeviceSize size);
+  inline VkDeviceSize             getStagingRingSize() const;
+
+  // copies made during allocator defragmentation are recorded into one command buffer per queue family and sent to GPU once per frame by submitRelocations().
+  // releaseFunction frees the old place of relocated object when GPU finishes the frame in which the copies were submitted
+  void                            recordRelocation(std::shared_ptr<CommandPool> commandPool, const std::function<void(CommandBuffer*)>& recordFunction, std::function<void()> releaseFunction);
+  void                            submitRelocations(uint32_t queueFamilyIndex, VkQueue queue);
+
+  // allocators that reclaim memory per frame are informed about frames finished by GPU
+  void                            addFrameAllocator(std::shared_ptr<DeviceMemoryAllocator> allocator);
+  void                            beginFrame(uint64_t frameNumber, uint64_t completedFrameNumber, uint32_t framesInFlight = 0);
+  inline uint64_t                 getFrameNumber() const;
+  // last frame finished by GPU on all surfaces of this device
+  inline uint64_t                 getCompletedFrameNumber() const;
+  // number of frames in flight used by all surfaces of this device, 0 when surfaces use different numbers of frames in flight
+  inline uint32_t                 getFramesInFlight() const;
   
   inline void                     setID(uint32_t newID);
   inline uint32_t                 getID() const;
@@ -151,19 +180,44 @@ protected:
   std::vector<QueueTraits>                    requestedQueues;
   std::vector<std::shared_ptr<Queue>>         queues;
   std::shared_ptr<DescriptorPool>             descriptorPool;
-  std::vector<std::shared_ptr<StagingBuffer>> stagingBuffers;
+  std::shared_ptr<StagingRing>                stagingRing;
+  std::vector<QueueTraits>                    uploadQueueTraits;
+  std::shared_ptr<UploadManager>              uploadManager;
+  VkDeviceSize                                stagingRingSize = 32 * 1024 * 1024;
+  std::vector<std::pair<uint64_t, std::shared_ptr<StagingBuffer>>> releasedStagingBuffers; // dedicated staging buffers waiting for GPU to finish a frame
+  uint64_t                                    frameNumber          = 0;
+  uint64_t                                    completedFrameNumber = 0;
+  uint32_t                                    framesInFlight       = 0;
+  std::vector<std::weak_ptr<DeviceMemoryAllocator>> frameAllocators;
+  struct Relocations
+  {
+    std::shared_ptr<CommandBuffer>     commandBuffer;
+    std::vector<std::function<void()>> releaseFunctions;
+    uint64_t                           frameNumber = 0;    // frame in which command buffer was submitted
+  };
+  std::map<uint32_t, Relocations>             pendingRelocations;        // relocations not submitted yet for each queue family
+  std::list<Relocations>                      submittedRelocations;
 
   std::vector<const char*>                    requestedDeviceExtensions;
   std::vector<const char*>                    enabledDeviceExtensions;
 
   mutable std::mutex                          stagingMutex;
   mutable std::mutex                          submitMutex;
+  mutable std::mutex                          frameAllocatorMutex;
+  mutable std::mutex                          relocationMutex;
 };
 
 void     Device::resetRequestedQueues()                   { requestedQueues.clear(); }
 void     Device::addRequestedQueue(const QueueTraits& rq) { requestedQueues.push_back(rq); }
 bool     Device::isRealized() const                       { return device != VK_NULL_HANDLE; }
+void     Device::setUploadQueue(const QueueTraits& qt)    { uploadQueueTraits = { qt }; }
+std::shared_ptr<UploadManager> Device::getUploadManager() const { return uploadManager; }
 void     Device::setID(uint32_t newID)                    { id = newID; }
 uint32_t Device::getID() const                            { return id; }
+uint64_t Device::getFrameNumber() const                   { return frameNumber; }
+uint64_t Device::getCompletedFrameNumber() const          { return completedFrameNumber; }
+uint32_t Device::getFramesInFlight() const                { return framesInFlight; }
+void     Device::setStagingRingSize(VkDeviceSize size)    { stagingRingSize = size; }
+VkDeviceSize Device::getStagingRingSize() const           { return stagingRingSize; }
 
 }
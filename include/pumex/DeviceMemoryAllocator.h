@@ -24,15 +24,33 @@
 #include <memory>
 #include <vector>
 #include <list>
+#include <set>
+#include <map>
+#include <array>
+#include <deque>
 #include <unordered_map>
 #include <mutex>
+#include <atomic>
+#include <string>
 #include <vulkan/vulkan.h>
 #include <pumex/Export.h>
+#include <pumex/HPClock.h>
 
 namespace pumex
 {
 
 class Device;
+class TimeStatistics;
+
+// channels filled by DeviceMemoryAllocator::setTimeStatisticsValues(). IDs are relative to the first channel ID
+const uint32_t DMA_CHANNEL_USED_BYTES         = 0;
+const uint32_t DMA_CHANNEL_FREE_BYTES         = 1;
+const uint32_t DMA_CHANNEL_LARGEST_FREE_BLOCK = 2;
+const uint32_t DMA_CHANNEL_FREE_BLOCK_COUNT   = 3;
+const uint32_t DMA_CHANNEL_ALLOCATION_COUNT   = 4;
+const uint32_t DMA_CHANNEL_ALLOCATION_RATE    = 5;
+const uint32_t DMA_CHANNEL_DEALLOCATION_RATE  = 6;
+const uint32_t DMA_CHANNEL_COUNT              = 7;
 
 struct PUMEX_EXPORT DeviceMemoryBlock
 {
@@ -44,6 +62,10 @@ struct PUMEX_EXPORT DeviceMemoryBlock
   VkDeviceSize   alignedOffset;
   VkDeviceSize   realSize;
   VkDeviceSize   alignedSize;
+  uint32_t       blockIndex;          // index of DeviceMemoryAllocator memory block that stores this allocation
+  uint32_t       memoryTypeIndex;     // memory type of that memory block
+  void*          mappedMemory;        // pointer to alignedOffset when memory is persistently mapped, nullptr otherwise
+  VkDeviceSize   nonCoherentAtomSize; // 0 when memory is host coherent. Otherwise mapped memory must be flushed/invalidated with that granularity
 };
 
 struct FreeBlock
@@ -53,24 +75,83 @@ struct FreeBlock
   VkDeviceSize size;
 };
 
+// Snapshot of DeviceMemoryAllocator state. Used bytes contain alignment padding. Memory deallocated in RING strategy
+// that still waits for GPU is neither used nor free ( see getPendingBytes() )
+struct PUMEX_EXPORT DeviceMemoryStatistics
+{
+  uint32_t     memoryBlockCount   = 0;
+  VkDeviceSize memorySize         = 0;     // size of all memory blocks allocated by vkAllocateMemory()
+  VkDeviceSize usedBytes          = 0;
+  VkDeviceSize freeBytes          = 0;
+  VkDeviceSize largestFreeBlock   = 0;
+  uint32_t     freeBlockCount     = 0;
+  uint32_t     allocationCount    = 0;     // number of allocations that were not deallocated yet
+  uint64_t     totalAllocations   = 0;
+  uint64_t     totalDeallocations = 0;
+  uint64_t     failedAllocations  = 0;
+  double       allocationRate     = 0.0;   // allocations per second measured between two last frames
+  double       deallocationRate   = 0.0;   // deallocations per second measured between two last frames
+
+  inline VkDeviceSize getPendingBytes() const;
+  // 0.0 when all free memory forms a single block, close to 1.0 when free memory is scattered in many small blocks
+  inline double       getFragmentation() const;
+  void                accumulate(const DeviceMemoryStatistics& statistics);
+};
+
+// Allocation strategy manages free space in a single block of memory allocated by vkAllocateMemory().
+// DeviceMemoryAllocator creates separate strategy object for each memory block.
+// When there's not enough free space - allocate() returns DeviceMemoryBlock with alignedSize == 0
 class PUMEX_EXPORT AllocationStrategy
 {
 public:
   virtual ~AllocationStrategy();
-  virtual DeviceMemoryBlock allocate(VkDeviceMemory storageMemory, std::list<FreeBlock>& freeBlocks, VkMemoryRequirements memoryRequirements) = 0;
-  virtual void deallocate(std::list<FreeBlock>& freeBlocks, const DeviceMemoryBlock& block) = 0;
+  virtual DeviceMemoryBlock allocate(VkDeviceMemory storageMemory, VkMemoryRequirements memoryRequirements) = 0;
+  virtual void              deallocate(const DeviceMemoryBlock& block) = 0;
+  // strategies that reclaim memory per frame are informed which frame is started and which frame was already finished by GPU
+  virtual void              beginFrame(uint64_t frameNumber, uint64_t completedFrameNumber);
+  // returns true when deallocated memory still waits for GPU to finish using it
+  virtual bool              hasPendingMemory() const;
+  // adds free space of the memory block to freeBytes, largestFreeBlock and freeBlockCount
+  virtual void              collectFreeSpace(DeviceMemoryStatistics& statistics) const = 0;
 };
 
-// DeviceMemoryAllocator is a class that enables user to store different data ( Vulkan buffers and images ) in a single block of
+// Describes how DeviceMemoryAllocator adds new memory blocks when existing blocks are full.
+// Default growth policy does not allow to add new blocks - allocator uses only one memory block
+struct PUMEX_EXPORT MemoryGrowthPolicy
+{
+  MemoryGrowthPolicy();
+  MemoryGrowthPolicy(uint32_t maxBlockCount, float growthFactor, VkDeviceSize maxBlockSize, double emptyBlockLifetime);
+
+  uint32_t     maxBlockCount;       // maximum number of memory blocks allocated on a single device
+  float        growthFactor;        // each new block is growthFactor times larger than the previous one
+  VkDeviceSize maxBlockSize;        // size limit for new blocks ( 0 means no limit ). Allocation larger than the limit gets its own block
+  double       emptyBlockLifetime;  // time in seconds after which an empty block is released. Only one empty block is kept. First block is never released
+};
+
+// DeviceMemoryAllocator is a class that enables user to store different data ( Vulkan buffers and images ) in blocks of
 // GPU/host memory allocated by vkAllocateMemory(). User may define what type of memory he wants from the Vulkan ( VkMemoryPropertyFlags ),
-// how much of that memory should be allocated and what allocation strategy to use when allocating/deallocating memory.
-// For now only one strategy is implemented : first fit allocation.
-class PUMEX_EXPORT DeviceMemoryAllocator
+// how much of that memory should be allocated, how to add new memory blocks when the first one is full ( MemoryGrowthPolicy )
+// and what allocation strategy to use when allocating/deallocating memory.
+// Host visible memory blocks are mapped once, when they're created, and stay mapped until they're released.
+// Allocations in non-coherent memory are aligned to nonCoherentAtomSize, so that flushing one allocation never touches the other.
+// Available strategies :
+// - FIRST_FIT : first fit allocation. Free blocks are stored in a list sorted by offset
+// - TLSF      : two-level segregated fit allocation. Allocation and deallocation take constant time
+// - RING      : linear allocation in a ring buffer, memory is reclaimed per frame. Use it for data that is reallocated often ( streaming data )
+// - BUDDY     : power of two buddy allocation. Small allocations are served from per-thread caches of pre-split blocks without locking
+//               the allocator mutex. Each thread may hold up to THREAD_CACHE_MAX_CACHED_SIZE bytes per block size in its cache. Blocks held
+//               in caches are reported as used memory.
+// Allocator may defragment its memory incrementally. At the beginning of each frame it reserves new places for relocatable allocations
+// that may be moved to lower addresses. Owners of these allocations ( MemoryBuffer, MemoryImage ) call acquireRelocation() during validation,
+// copy their data to the new place and release the old memory. Defragmentation budget limits the number of bytes reserved per frame.
+// Allocator collects statistics that may be used to size its memory : getStatistics() returns a snapshot, getStatisticsJSON() returns
+// the snapshot of each device in JSON format and setTimeStatisticsValues() sends it to TimeStatistics channels.
+class PUMEX_EXPORT DeviceMemoryAllocator : public std::enable_shared_from_this<DeviceMemoryAllocator>
 {
 public:
-  enum EnumStrategy { FIRST_FIT };
+  enum EnumStrategy { FIRST_FIT, TLSF, RING, BUDDY };
   DeviceMemoryAllocator()                                        = delete;
-  explicit DeviceMemoryAllocator(VkMemoryPropertyFlags propertyFlags, VkDeviceSize size, EnumStrategy strategy);
+  explicit DeviceMemoryAllocator(VkMemoryPropertyFlags propertyFlags, VkDeviceSize size, EnumStrategy strategy, const MemoryGrowthPolicy& growthPolicy = MemoryGrowthPolicy());
   DeviceMemoryAllocator(const DeviceMemoryAllocator&)            = delete;
   DeviceMemoryAllocator& operator=(const DeviceMemoryAllocator&) = delete;
   DeviceMemoryAllocator(DeviceMemoryAllocator&&)                 = delete;
@@ -78,43 +159,254 @@ public:
   ~DeviceMemoryAllocator();
 
 
-  DeviceMemoryBlock            allocate(Device* device, VkMemoryRequirements memoryRequirements);
+  // relocatable allocations may be moved during defragmentation
+  DeviceMemoryBlock            allocate(Device* device, VkMemoryRequirements memoryRequirements, bool relocatable = false);
   void                         deallocate(VkDevice device, const DeviceMemoryBlock& block);
+  // release blocks that are empty for longer than MemoryGrowthPolicy::emptyBlockLifetime. Empty blocks are also released during deallocation
+  void                         releaseEmptyBlocks();
+  // called by Device at the beginning of each frame. completedFrameNumber is the last frame that GPU finished on all surfaces using that device
+  void                         beginFrame(VkDevice device, uint64_t frameNumber, uint64_t completedFrameNumber);
+  // called by Device before it is destroyed. All memory of the device is freed and blocks cached by threads for that device are forgotten,
+  // so that a new device with the same handle never receives them
+  void                         releaseDevice(VkDevice device);
+
+  // defragmentation is turned off when budget == 0
+  inline void                  setDefragmentationBudget(VkDeviceSize bytesPerFrame);
+  inline VkDeviceSize          getDefragmentationBudget() const;
+  // returns memory reserved for the block during defragmentation or empty block when block should stay in place. Caller takes ownership of returned
+  // memory, must copy data to it and deallocate the old block when GPU stops using it. Relocations not acquired in RELOCATION_TIMEOUT frames are cancelled
+  DeviceMemoryBlock            acquireRelocation(VkDevice device, const DeviceMemoryBlock& block);
+  static const uint64_t        RELOCATION_TIMEOUT = 8;
 
-  // method that makes vkMapMemory() / std::memcpy() / vkUnmapMemory() behind a mutex - use it instead of performing is yourself
-  void                         copyToDeviceMemory(Device* device, VkDeviceSize offset, const void* data, VkDeviceSize size, VkMemoryMapFlags flags);
-  void                         bindBufferMemory(Device* device, VkBuffer buffer, VkDeviceSize offset);
+  // per-thread caches of BUDDY strategy serve blocks of sizes from BuddyAllocationStrategy::MIN_BLOCK_SIZE to THREAD_CACHE_MAX_BLOCK_SIZE
+  static const VkDeviceSize    THREAD_CACHE_MAX_BLOCK_SIZE  = 16 * 1024;
+  static const VkDeviceSize    THREAD_CACHE_REFILL_SIZE     = 64 * 1024;
+  static const VkDeviceSize    THREAD_CACHE_MAX_CACHED_SIZE = 128 * 1024;
+  static const uint32_t        THREAD_CACHE_CLASS_COUNT     = 7;
 
-  inline VkMemoryPropertyFlags getMemoryPropertyFlags() const;
-  inline VkDeviceSize          getMemorySize() const;
+  // method that copies data to persistently mapped memory and flushes it if memory is not host coherent. Offset is measured from block.alignedOffset.
+  // Mutex is not used, so different threads may write to different blocks ( or disjoint ranges of the same block ) at the same time
+  void                         copyToDeviceMemory(Device* device, const DeviceMemoryBlock& block, VkDeviceSize offset, const void* data, VkDeviceSize size, VkMemoryMapFlags flags);
+  // make host writes visible to device ( flush ) and device writes visible to host ( invalidate ). Both do nothing for host coherent memory
+  void                         flushMappedMemory(VkDevice device, const DeviceMemoryBlock& block, VkDeviceSize offset, VkDeviceSize size);
+  void                         invalidateMappedMemory(VkDevice device, const DeviceMemoryBlock& block, VkDeviceSize offset, VkDeviceSize size);
+  void                         bindBufferMemory(Device* device, VkBuffer buffer, const DeviceMemoryBlock& block);
+
+  // statistics of a single device and statistics accumulated over all devices
+  DeviceMemoryStatistics       getStatistics(VkDevice device) const;
+  DeviceMemoryStatistics       getStatistics() const;
+  std::string                  getStatisticsJSON() const;
+  // registers a group and DMA_CHANNEL_COUNT channels starting from firstChannelID
+  void                         registerTimeStatistics(TimeStatistics* timeStatistics, uint32_t groupID, uint32_t firstChannelID, const std::wstring& groupName) const;
+  // statistics accumulated over all devices are stored in vtSize and vtCounter channels. Channel begin stores the time of measurement
+  void                         setTimeStatisticsValues(TimeStatistics* timeStatistics, uint32_t firstChannelID, double time) const;
+
+  inline VkMemoryPropertyFlags     getMemoryPropertyFlags() const;
+  inline VkDeviceSize              getMemorySize() const;
+  inline EnumStrategy              getStrategy() const;
+  inline const MemoryGrowthPolicy& getGrowthPolicy() const;
 
 protected:
+  struct Relocation
+  {
+    VkMemoryRequirements memoryRequirements;
+    DeviceMemoryBlock    targetBlock;           // memory reserved during defragmentation. alignedSize == 0 when nothing is reserved
+    uint64_t             reservationFrame = 0;
+  };
+  typedef std::pair<uint32_t, VkDeviceSize> AllocationKey;   // memory block index and aligned offset
+  struct ThreadCache;
+  struct MemoryBlock
+  {
+    VkDeviceMemory                      memory              = VK_NULL_HANDLE;
+    uint32_t                            memoryTypeIndex     = 0;
+    VkDeviceSize                        size                = 0;
+    void*                               mappedMemory        = nullptr;
+    VkDeviceSize                        nonCoherentAtomSize = 0;
+    std::unique_ptr<AllocationStrategy> allocationStrategy;
+    uint32_t                            allocationCount     = 0;
+    HPClock::time_point                 emptySince;
+  };
   struct PerDeviceData
   {
     PerDeviceData()
     {
     }
-    VkDeviceMemory       storageMemory = VK_NULL_HANDLE;
-    std::list<FreeBlock> freeBlocks;
+    uint64_t                            id                    = 0;     // unique identifier used by thread caches
+    std::vector<MemoryBlock>            memoryBlocks;                  // released blocks leave empty slots, so that DeviceMemoryBlock::blockIndex stays valid
+    VkDeviceSize                        nextBlockSize         = 0;
+    uint64_t                            frameNumber           = 0;
+    uint64_t                            completedFrameNumber  = 0;
+    std::map<AllocationKey, Relocation> relocatables;                  // sorted by address, so that defragmentation may start from the end of memory
+    bool                                defragmentationNeeded = false;
+    VkDeviceSize                        usedBytes             = 0;
+    uint64_t                            totalAllocations      = 0;
+    uint64_t                            totalDeallocations    = 0;
+    uint64_t                            failedAllocations     = 0;
+    uint64_t                            frameAllocations      = 0;     // value of totalAllocations at the beginning of last frame
+    uint64_t                            frameDeallocations    = 0;
+    HPClock::time_point                 frameTime;
+    double                              allocationRate        = 0.0;
+    double                              deallocationRate      = 0.0;
   };
   mutable std::mutex                          mutex;
   std::unordered_map<VkDevice, PerDeviceData> perDeviceData;
   VkMemoryPropertyFlags                       propertyFlags;
   VkDeviceSize                                size;
-  std::unique_ptr<AllocationStrategy>         allocationStrategy;
+  EnumStrategy                                strategy;
+  MemoryGrowthPolicy                          growthPolicy;
+  VkDeviceSize                                defragmentationBudget = 0;
+  std::atomic<uint32_t>                       reservedRelocations;
+  uint64_t                                    allocatorID;       // identifies thread caches of this allocator
+  std::atomic<uint64_t>                       releasedDevices;   // thread caches check their device after each releaseDevice() call
+
+  PerDeviceData&                              getPerDeviceData(Device* device);
+  DeviceMemoryBlock                           allocateBlock(Device* device, PerDeviceData& pdd, VkMemoryRequirements memoryRequirements);
+  bool                                        usesThreadCache(VkDeviceSize blockSize) const;
+  ThreadCache&                                getThreadCache(VkDevice device);
+  void                                        validateThreadCache(ThreadCache& cache, PerDeviceData* pdd);
+  DeviceMemoryBlock                           allocateFromThreadCache(Device* device, VkMemoryRequirements memoryRequirements);
+  bool                                        deallocateToThreadCache(VkDevice device, const DeviceMemoryBlock& block);
+  void                                        refillThreadCache(Device* device, ThreadCache& cache, uint32_t classIndex, uint32_t memoryTypeBits);
+  void                                        drainThreadCache(ThreadCache& cache, uint32_t classIndex, VkDeviceSize keptSize);
+
+  std::unique_ptr<AllocationStrategy>         createAllocationStrategy(VkDeviceSize blockSize) const;
+  uint32_t                                    createMemoryBlock(Device* device, PerDeviceData& pdd, VkMemoryRequirements memoryRequirements, VkDeviceSize minimumSize);
+  DeviceMemoryBlock                           allocateInMemoryBlock(PerDeviceData& pdd, uint32_t blockIndex, VkMemoryRequirements memoryRequirements);
+  void                                        deallocateInMemoryBlock(PerDeviceData& pdd, const DeviceMemoryBlock& block);
+  void                                        defragment(PerDeviceData& pdd);
+  DeviceMemoryStatistics                      getStatistics(const PerDeviceData& pdd) const;
+  void                                        updateRates(PerDeviceData& pdd);
+  static VkMemoryRequirements                 getBlockRequirements(const MemoryBlock& memoryBlock, VkMemoryRequirements memoryRequirements);
+  static VkMappedMemoryRange                  getMappedMemoryRange(const DeviceMemoryBlock& block, VkDeviceSize offset, VkDeviceSize size);
+  void                                        releaseEmptyBlocks(VkDevice device, PerDeviceData& pdd);
 };
 
-VkMemoryPropertyFlags DeviceMemoryAllocator::getMemoryPropertyFlags() const { return propertyFlags; }
-VkDeviceSize          DeviceMemoryAllocator::getMemorySize() const { return size; }
+VkDeviceSize              DeviceMemoryStatistics::getPendingBytes() const       { return memorySize - usedBytes - freeBytes; }
+double                    DeviceMemoryStatistics::getFragmentation() const      { return (freeBytes == 0) ? 0.0 : 1.0 - static_cast<double>(largestFreeBlock) / static_cast<double>(freeBytes); }
+
+VkMemoryPropertyFlags     DeviceMemoryAllocator::getMemoryPropertyFlags() const { return propertyFlags; }
+VkDeviceSize              DeviceMemoryAllocator::getMemorySize() const          { return size; }
+DeviceMemoryAllocator::EnumStrategy DeviceMemoryAllocator::getStrategy() const  { return strategy; }
+const MemoryGrowthPolicy& DeviceMemoryAllocator::getGrowthPolicy() const        { return growthPolicy; }
+void                      DeviceMemoryAllocator::setDefragmentationBudget(VkDeviceSize bpf) { defragmentationBudget = bpf; }
+VkDeviceSize              DeviceMemoryAllocator::getDefragmentationBudget() const { return defragmentationBudget; }
 
 class PUMEX_EXPORT FirstFitAllocationStrategy : public AllocationStrategy
 {
 public:
-  FirstFitAllocationStrategy();
+  explicit FirstFitAllocationStrategy(VkDeviceSize size);
   virtual ~FirstFitAllocationStrategy();
 
-  DeviceMemoryBlock allocate(VkDeviceMemory storageMemory, std::list<FreeBlock>& freeBlocks, VkMemoryRequirements memoryRequirements) override;
-  void              deallocate(std::list<FreeBlock>& freeBlocks, const DeviceMemoryBlock& block) override;
+  DeviceMemoryBlock allocate(VkDeviceMemory storageMemory, VkMemoryRequirements memoryRequirements) override;
+  void              deallocate(const DeviceMemoryBlock& block) override;
+  void              collectFreeSpace(DeviceMemoryStatistics& statistics) const override;
+protected:
+  std::list<FreeBlock> freeBlocks;
+};
+
+// Ring allocation strategy : memory is handed out by bumping a pointer that wraps around at the end of the memory block.
+// Allocations made in the same frame form a frame segment. Deallocated memory is not reused immediately - segments are reclaimed
+// in allocation order, when all their allocations are deallocated and GPU finished the frame in which the last deallocation happened.
+// Long living allocations stop the reclaim of all segments allocated after them, so the strategy should be used for streaming data only.
+class PUMEX_EXPORT FrameRingAllocationStrategy : public AllocationStrategy
+{
+public:
+  explicit FrameRingAllocationStrategy(VkDeviceSize size);
+  virtual ~FrameRingAllocationStrategy();
+
+  DeviceMemoryBlock allocate(VkDeviceMemory storageMemory, VkMemoryRequirements memoryRequirements) override;
+  void              deallocate(const DeviceMemoryBlock& block) override;
+  void              beginFrame(uint64_t frameNumber, uint64_t completedFrameNumber) override;
+  bool              hasPendingMemory() const override;
+  void              collectFreeSpace(DeviceMemoryStatistics& statistics) const override;
+protected:
+  struct FrameSegment
+  {
+    uint64_t     frameNumber;          // frame in which memory was allocated
+    VkDeviceSize begin;
+    VkDeviceSize end;
+    uint32_t     allocationCount;      // number of allocations not deallocated yet
+    uint64_t     releaseFrameNumber;   // frame in which the last deallocation took place
+  };
+
+  VkDeviceSize             size;
+  VkDeviceSize             head                 = 0;
+  uint64_t                 frameNumber          = 0;
+  uint64_t                 completedFrameNumber = 0;
+  std::deque<FrameSegment> segments;             // oldest segment first. Segments never cross the end of memory block
+
+  void reclaimSegments();
+};
+
+// Two-Level Segregated Fit allocation strategy ( M. Masmano, I. Ripoll, A. Crespo, J. Real : "TLSF: a New Dynamic Memory Allocator for Real-Time Systems" ).
+// Free blocks are stored in segregated lists. First level divides free blocks by power of two of their size, second level divides each
+// power of two range into SL_INDEX_COUNT linear ranges. Bitmaps are used to find nonempty list in constant time.
+// Physical neighbours are linked, so that free blocks may be coalesced in constant time.
+class PUMEX_EXPORT TLSFAllocationStrategy : public AllocationStrategy
+{
+public:
+  explicit TLSFAllocationStrategy(VkDeviceSize size);
+  virtual ~TLSFAllocationStrategy();
+
+  DeviceMemoryBlock allocate(VkDeviceMemory storageMemory, VkMemoryRequirements memoryRequirements) override;
+  void              deallocate(const DeviceMemoryBlock& block) override;
+  void              collectFreeSpace(DeviceMemoryStatistics& statistics) const override;
+
+  static const uint32_t SL_INDEX_COUNT_LOG2 = 5;
+  static const uint32_t SL_INDEX_COUNT      = 1 << SL_INDEX_COUNT_LOG2;
+  static const uint32_t FL_INDEX_COUNT      = 64;
+  static const uint32_t SMALL_BLOCK_SIZE    = SL_INDEX_COUNT;
+  static const uint32_t INVALID_BLOCK       = 0xFFFFFFFF;
+protected:
+  struct Block
+  {
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    uint32_t     prevPhysical = INVALID_BLOCK;
+    uint32_t     nextPhysical = INVALID_BLOCK;
+    uint32_t     prevFree     = INVALID_BLOCK;
+    uint32_t     nextFree     = INVALID_BLOCK;
+    bool         isFree       = false;
+  };
+
+  std::vector<Block>                                                   blocks;
+  std::vector<uint32_t>                                                unusedBlocks;
+  std::unordered_map<VkDeviceSize, uint32_t>                           usedBlocks;
+  uint64_t                                                             flBitmap = 0;
+  std::array<uint32_t, FL_INDEX_COUNT>                                 slBitmap;
+  std::array<std::array<uint32_t, SL_INDEX_COUNT>, FL_INDEX_COUNT>     freeLists;
+
+  uint32_t createBlock(VkDeviceSize offset, VkDeviceSize size);
+  void     destroyBlock(uint32_t blockIndex);
+  void     insertFreeBlock(uint32_t blockIndex);
+  void     removeFreeBlock(uint32_t blockIndex);
+  uint32_t findFreeBlock(VkDeviceSize size) const;
+  uint32_t splitBlock(uint32_t blockIndex, VkDeviceSize size);
+  void     mergeBlocks(uint32_t blockIndex, uint32_t nextBlockIndex);
+};
+
+// Buddy allocation strategy : memory is divided into power of two blocks, each block may be split into two halves ( buddies ).
+// Freed block is merged with its buddy when buddy is also free. Blocks are aligned to their size, so alignment costs no padding,
+// but allocation size is rounded up to the power of two. Memory block is covered by a few root blocks of decreasing power of two sizes.
+class PUMEX_EXPORT BuddyAllocationStrategy : public AllocationStrategy
+{
+public:
+  explicit BuddyAllocationStrategy(VkDeviceSize size);
+  virtual ~BuddyAllocationStrategy();
+
+  DeviceMemoryBlock allocate(VkDeviceMemory storageMemory, VkMemoryRequirements memoryRequirements) override;
+  void              deallocate(const DeviceMemoryBlock& block) override;
+  void              collectFreeSpace(DeviceMemoryStatistics& statistics) const override;
+  // divides allocated block into parts of given size. Each part must be deallocated separately
+  void              split(const DeviceMemoryBlock& block, VkDeviceSize partSize, std::vector<DeviceMemoryBlock>& parts);
+
+  static const VkDeviceSize MIN_BLOCK_SIZE = 256;
+protected:
+  std::vector<std::set<VkDeviceSize>>        freeBlocks;   // free block offsets for each level. Block on level L has size MIN_BLOCK_SIZE << L
+  std::unordered_map<VkDeviceSize, uint32_t> usedBlocks;   // level of each allocated block
+  std::map<VkDeviceSize, uint32_t>           rootBlocks;   // level of each root block
+
+  uint32_t getLevel(VkDeviceSize size) const;
 };
 
 // OK, last time I read a book about C++ templates about seven years ago, so this code may look ugly in 2017
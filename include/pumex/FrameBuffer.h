@@ -98,6 +98,8 @@ protected:
   std::vector<std::shared_ptr<ImageView>>           imageViews;
   mutable std::mutex                                mutex;
   uint32_t                                          activeCount;
+  // frame buffers that use swapchain image are created for each swapchain image, all other frame buffers - for each frame in flight
+  SwapChainImageBehaviour                           swapChainImageBehaviour;
 };
 
 size_t FrameBuffer::getNumImageDefinitions() const { return imageDefinitions.size(); }
@@ -21,6 +21,7 @@
 //
 
 #pragma once
+#include <map>
 #include <vulkan/vulkan.h>
 #include <gli/texture.hpp>
 #include <pumex/Export.h>
@@ -52,13 +53,34 @@ struct PUMEX_EXPORT ImageTraits
   VkSharingMode            sharingMode    = VK_SHARING_MODE_EXCLUSIVE;
 };
 
+class ImageMemoryAliasGroup;
+
+// Memory block shared by images that are never in use at the same time ( memory aliasing ).
+// Memory returns to allocator when the last image bound to it is destroyed
+struct PUMEX_EXPORT AliasedMemoryBlock
+{
+  AliasedMemoryBlock()                                     = delete;
+  explicit AliasedMemoryBlock(VkDevice device, std::shared_ptr<DeviceMemoryAllocator> allocator, const DeviceMemoryBlock& memoryBlock);
+  AliasedMemoryBlock(const AliasedMemoryBlock&)            = delete;
+  AliasedMemoryBlock& operator=(const AliasedMemoryBlock&) = delete;
+  ~AliasedMemoryBlock();
+
+  VkDevice                               device;
+  std::shared_ptr<DeviceMemoryAllocator> allocator;
+  DeviceMemoryBlock                      memoryBlock;
+};
+
 // Class implementing Vulkan image (VkImage ) on a single device/surface
 class PUMEX_EXPORT Image
 {
 public:
   Image()                            = delete;
-  // user creates VkImage and assigns memory to it
-  explicit Image(Device* device, const ImageTraits& imageTraits, std::shared_ptr<DeviceMemoryAllocator> allocator);
+  // user creates VkImage and assigns memory to it. Relocatable memory may be moved during allocator defragmentation
+  explicit Image(Device* device, const ImageTraits& imageTraits, std::shared_ptr<DeviceMemoryAllocator> allocator, bool relocatable = false);
+  // user creates VkImage and binds it to memory allocated earlier ( e.g. memory reserved during defragmentation ). Image takes ownership of that memory
+  explicit Image(Device* device, const ImageTraits& imageTraits, std::shared_ptr<DeviceMemoryAllocator> allocator, const DeviceMemoryBlock& memoryBlock);
+  // user creates VkImage and places it in memory shared with other images from the same alias group
+  explicit Image(Device* device, const ImageTraits& imageTraits, std::shared_ptr<ImageMemoryAliasGroup> aliasGroup, uint32_t aliasKey);
   // user delivers VkImage, Image does not own it, just creates VkImageView
   explicit Image(Device* device, VkImage image, VkFormat format, const VkExtent3D& extent, uint32_t mipLevels = 1, uint32_t arrayLayers = 1);
   Image(const Image&)                = delete;
@@ -67,30 +89,68 @@ public:
   Image& operator=(Image&&)          = delete;
   virtual ~Image();
 
-  inline VkDevice           getDevice() const;
-  inline VkImage            getHandleImage() const;
-  inline VkDeviceSize       getMemorySize() const;
-  inline const ImageTraits& getImageTraits() const;
+  inline VkDevice                 getDevice() const;
+  inline VkImage                  getHandleImage() const;
+  inline VkDeviceSize             getMemorySize() const;
+  inline const ImageTraits&       getImageTraits() const;
+  inline const DeviceMemoryBlock& getMemoryBlock() const;
 
-  void                      getImageSubresourceLayout(VkImageSubresource& subRes, VkSubresourceLayout& subResLayout) const;
-  void*                     mapMemory(size_t offset, size_t range, VkMemoryMapFlags flags=0);
-  void                      unmapMemory();
+  void                            getImageSubresourceLayout(VkImageSubresource& subRes, VkSubresourceLayout& subResLayout) const;
+  void*                           mapMemory(size_t offset, size_t range, VkMemoryMapFlags flags=0);
+  void                            unmapMemory();
 protected:
   ImageTraits                            imageTraits;
   VkDevice                               device       = VK_NULL_HANDLE;
   std::shared_ptr<DeviceMemoryAllocator> allocator;
   VkImage                                image        = VK_NULL_HANDLE;
   DeviceMemoryBlock                      memoryBlock;
+  std::shared_ptr<AliasedMemoryBlock>    aliasedMemory;
   bool                                   ownsImage    = true;
 };
 
+// ImageMemoryAliasGroup places images that are never in use at the same time in the same region of device memory ( memory aliasing ).
+// Images may have different formats, sizes and usages - each image registers its traits per surface/device ( key ) before creation,
+// so that the group is able to compute memory requirements common to all images before memory is allocated :
+// the largest size, the strictest alignment and memory types supported by all images.
+// When traits change ( e.g. after surface resize ) new memory is allocated. Old memory lives as long as images bound to it.
+class PUMEX_EXPORT ImageMemoryAliasGroup
+{
+public:
+  ImageMemoryAliasGroup()                                        = delete;
+  explicit ImageMemoryAliasGroup(std::shared_ptr<DeviceMemoryAllocator> allocator);
+  ImageMemoryAliasGroup(const ImageMemoryAliasGroup&)            = delete;
+  ImageMemoryAliasGroup& operator=(const ImageMemoryAliasGroup&) = delete;
+  ImageMemoryAliasGroup(ImageMemoryAliasGroup&&)                 = delete;
+  ImageMemoryAliasGroup& operator=(ImageMemoryAliasGroup&&)      = delete;
+  ~ImageMemoryAliasGroup();
+
+  void                                          setImageTraits(uint32_t key, const void* member, const ImageTraits& traits);
+  std::shared_ptr<AliasedMemoryBlock>           acquire(Device* device, uint32_t key, const VkMemoryRequirements& memoryRequirements);
+
+  inline std::shared_ptr<DeviceMemoryAllocator> getAllocator() const;
+protected:
+  struct PerKeyData
+  {
+    std::map<const void*, ImageTraits> memberTraits;
+    std::weak_ptr<AliasedMemoryBlock>  memory;
+    bool                               valid = false;
+  };
+  mutable std::mutex                       mutex;
+  std::shared_ptr<DeviceMemoryAllocator>   allocator;
+  std::unordered_map<uint32_t, PerKeyData> perKeyData;
+};
+
 // inlines 
-VkDevice             Image::getDevice() const      { return device; }
-VkImage              Image::getHandleImage() const { return image; }
-VkDeviceSize         Image::getMemorySize() const  { return memoryBlock.alignedSize; }
-const ImageTraits&   Image::getImageTraits() const { return imageTraits; }
+VkDevice                 Image::getDevice() const      { return device; }
+VkImage                  Image::getHandleImage() const { return image; }
+VkDeviceSize             Image::getMemorySize() const  { return memoryBlock.alignedSize; }
+const ImageTraits&       Image::getImageTraits() const { return imageTraits; }
+const DeviceMemoryBlock& Image::getMemoryBlock() const { return memoryBlock; }
+
+std::shared_ptr<DeviceMemoryAllocator> ImageMemoryAliasGroup::getAllocator() const { return allocator; }
 
 // helper functions
+PUMEX_EXPORT VkImage            createVulkanImage(VkDevice device, const ImageTraits& imageTraits);
 PUMEX_EXPORT ImageTraits        getImageTraitsFromTexture(const gli::texture& texture, VkImageUsageFlags usage);
 
 PUMEX_EXPORT VkFormat           vulkanFormatFromGliFormat(gli::texture::format_type format);
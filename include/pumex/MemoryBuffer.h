@@ -26,6 +26,7 @@
 #include <list>
 #include <mutex>
 #include <algorithm>
+#include <cstring>
 #include <vulkan/vulkan.h>
 #include <pumex/Export.h>
 #include <pumex/MemoryObject.h>
@@ -34,6 +35,7 @@
 #include <pumex/DeviceMemoryAllocator.h>
 #include <pumex/Surface.h>
 #include <pumex/Command.h>
+#include <pumex/UploadManager.h>
 #include <pumex/utils/Buffer.h>
 #include <pumex/utils/Log.h>
 
@@ -45,6 +47,7 @@ class Resource;
 class RenderContext;
 class CommandBuffer;
 class BufferView;
+class BufferPool;
 
 
 // struct defining subresource range for buffer
@@ -59,6 +62,28 @@ struct PUMEX_EXPORT BufferSubresourceRange
   VkDeviceSize range;
 };
 
+// adds range to a sorted vector of disjoint ranges. Ranges that overlap or touch each other are merged
+PUMEX_EXPORT void mergeBufferSubresourceRange(std::vector<BufferSubresourceRange>& ranges, const BufferSubresourceRange& range);
+// returns pipeline stages and access types that may touch a buffer created with given usage flags
+PUMEX_EXPORT void getBufferUsageScope(VkBufferUsageFlags bufferUsage, VkPipelineStageFlags& stageMask, VkAccessFlags& accessMask);
+
+// Capacity policy decides how big VkBuffer is created for data of a given size. Buffers grow geometrically ( by growthFactor ), so that
+// data growing one element at a time causes O(log n) buffer reallocations. Buffer shrinks only when data occupies less than shrinkThreshold
+// of its capacity. shrinkThreshold should be smaller than 1 / growthFactor, otherwise buffer may be reallocated on each resize.
+// growthFactor = 1.0 and shrinkThreshold = 0.0 mean that buffer grows exactly to the size of data and never shrinks.
+struct PUMEX_EXPORT BufferCapacityPolicy
+{
+  BufferCapacityPolicy();
+  BufferCapacityPolicy(float growthFactor, float shrinkThreshold, VkDeviceSize minimumCapacity = 1);
+
+  // returns currentCapacity when buffer should not be reallocated
+  VkDeviceSize getCapacity(VkDeviceSize currentCapacity, VkDeviceSize dataSize) const;
+
+  float        growthFactor;
+  float        shrinkThreshold;
+  VkDeviceSize minimumCapacity;
+};
+
 // class that manages buffer data in a memory. This class is not used directly - use Buffer<T> instead ( see below )
 class PUMEX_EXPORT MemoryBuffer : public MemoryObject
 {
@@ -77,11 +102,35 @@ public:
   inline const SwapChainImageBehaviour&         getSwapChainImageBehaviour() const;
   inline std::shared_ptr<DeviceMemoryAllocator> getAllocator() const;
   inline VkBufferUsageFlags                     getBufferUsage() const;
+  // buffer memory may be moved during allocator defragmentation
+  inline bool                                   isRelocatable() const;
+
+  // capacity policy is used when buffer is created or its data size changes
+  void                                          setCapacityPolicy(const BufferCapacityPolicy& capacityPolicy);
+  inline const BufferCapacityPolicy&            getCapacityPolicy() const;
+
+  // buffer pool must be set before the buffer is validated for the first time
+  void                                          setBufferPool(std::shared_ptr<BufferPool> bufferPool);
+  inline std::shared_ptr<BufferPool>            getBufferPool() const;
+
+  // buffers created per surface may be shared between surfaces on the same device that store identical data in it ( e.g. the same text
+  // displayed in many windows ). Data is uploaded once and each surface refers to the same VkBuffer. Must be set before the buffer is validated for the first time.
+  // Data larger than maxSharedDataSize is not compared between surfaces
+  void                                          setSurfaceDataSharing(bool shareSurfaceData, size_t maxSharedDataSize = 1024 * 1024);
+  inline bool                                   getSurfaceDataSharing() const;
 
   VkBuffer                                      getHandleBuffer(const RenderContext& renderContext) const;
+  // offset of the data in a buffer returned by getHandleBuffer(). It is not 0 only when buffer is placed in a buffer pool
+  VkDeviceSize                                  getBufferOffset(const RenderContext& renderContext) const;
+  // buffer is placed in a buffer pool ( pool may be full, so buffer with pool set is not always pooled )
+  bool                                          isPooledRC(const RenderContext& renderContext) const;
+  // logical size of the data - reported in descriptors and used by barriers. It may be smaller than buffer capacity
   size_t                                        getDataSizeRC(const RenderContext& renderContext) const;
+  VkDeviceSize                                  getCapacityRC(const RenderContext& renderContext) const;
 
-  void                                          validate(const RenderContext& renderContext);
+  virtual void                                  validate(const RenderContext& renderContext);
+  // offset added to the buffer offset when buffer is bound through dynamic descriptor ( VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC )
+  virtual uint32_t                              getDynamicOffset(const RenderContext& renderContext) const;
 
   void                                          addCommandBufferSource(std::shared_ptr<CommandBufferSource> cbSource);
   void                                          notifyCommandBufferSources(const RenderContext& renderContext);
@@ -96,13 +145,26 @@ public:
   struct MemoryBufferInternal
   {
     MemoryBufferInternal()
-      : buffer{ VK_NULL_HANDLE }, dataSize{ 0 }, memoryBlock()
+      : buffer{ VK_NULL_HANDLE }, bufferOffset{ 0 }, dataSize{ 0 }, capacity{ 0 }, memoryBlock(), pooled{ false }, inUse{ false }
     {
     }
     VkBuffer           buffer;
-    size_t             dataSize;
-    DeviceMemoryBlock  memoryBlock;
+    VkDeviceSize       bufferOffset;
+    size_t             dataSize;   // logical size of the data
+    VkDeviceSize       capacity;   // size of the buffer
+    DeviceMemoryBlock  memoryBlock; // when buffer is pooled - describes part of the pool memory that belongs to this buffer
+    bool               pooled;
+    bool               inUse;      // buffer was handed to rendering, so frames in flight may still read it
+    std::weak_ptr<UploadManager> uploadManager; // copies to this buffer sent through upload manager must be discarded when buffer is destroyed
   };
+  // creates buffer in a buffer pool or - when there is no pool or pool is full - a separate VkBuffer with its own memory
+  void                                          createBuffer(Device* device, MemoryBufferInternal& internals, VkDeviceSize size);
+  void                                          destroyBuffer(VkDevice device, MemoryBufferInternal& internals);
+  // sets logical data size. Buffer is ( re )created only when capacity policy demands it. Returns true when buffer was ( re )created and its content is lost
+  bool                                          resizeBuffer(const RenderContext& renderContext, MemoryBufferInternal& internals, VkDeviceSize dataSize);
+  // returns true when GPU does not use the buffer copy validated in current frame, so that upload queue may write to it without waiting for frames in flight
+  bool                                          isCopyIdle(const RenderContext& renderContext, const MemoryBufferInternal& internals) const;
+
   struct Operation
   {
     enum Type { SetBufferSize, SetData };
@@ -130,6 +192,11 @@ public:
     virtual void releaseResources(const RenderContext& renderContext)
     {
     }
+    // returns false when operation does not define the whole content of a buffer
+    virtual bool getSourceData(const void*& dataPointer, size_t& dataSize) const
+    {
+      return false;
+    }
 
     MemoryBuffer*          owner;
     Type                   type;
@@ -146,6 +213,16 @@ protected:
     std::list<std::shared_ptr<Operation>> bufferOperations;
   };
   typedef PerObjectData<MemoryBufferInternal, MemoryBufferLoadData> MemoryBufferData;
+  // buffer with data shared between surfaces. Data copy is used to compare it with data sent by other surfaces
+  struct SharedBuffer
+  {
+    VkDevice                   device;
+    uint64_t                   dataHash;
+    std::vector<unsigned char> data;
+    MemoryBufferInternal       internals;
+    uint32_t                   userCount;
+    uint64_t                   releaseFrameNumber = 0; // last frame in which a surface that stopped using the buffer might use it
+  };
 
   std::unordered_map<uint32_t, MemoryBufferData>  perObjectData;
   mutable std::mutex                              mutex;
@@ -154,11 +231,62 @@ protected:
   bool                                            sameDataPerObject;
   std::shared_ptr<DeviceMemoryAllocator>          allocator;
   VkBufferUsageFlags                              bufferUsage;
+  std::shared_ptr<BufferPool>                     bufferPool;
+  BufferCapacityPolicy                            capacityPolicy;
   uint32_t                                        activeCount;
+  bool                                            shareSurfaceData = false;
+  size_t                                          maxSharedDataSize = 0;
+  std::list<SharedBuffer>                         sharedBuffers;
+  std::list<SharedBuffer>                         releasedSharedBuffers; // buffers without users, waiting for GPU to finish frames that used them
   // objects that may own a buffer and must be informed when some changes happen
   std::vector<std::weak_ptr<CommandBufferSource>> commandBufferSources;
   std::vector<std::weak_ptr<Resource>>            resources;
   std::vector<std::weak_ptr<BufferView>>          bufferViews;
+
+  void relocate(const RenderContext& renderContext, MemoryBufferInternal& internals);
+  std::list<SharedBuffer>::iterator findSharedBuffer(VkDevice device, const MemoryBufferInternal& internals);
+  // buffer shared between surfaces is destroyed when its last user releases it and GPU finished all frames that used it
+  void releaseBuffer(const RenderContext& renderContext, MemoryBufferInternal& internals);
+  bool acquireSharedBuffer(const RenderContext& renderContext, MemoryBufferData& pdd, uint32_t activeIndex, uint64_t& dataHash, std::vector<unsigned char>& sharedData);
+};
+
+// BufferPool places many small MemoryBuffers in a single VkBuffer created per device ( buffer suballocation ), which reduces
+// the number of Vulkan objects and lets many descriptors and draw calls refer to the same buffer. Each MemoryBuffer receives
+// an offset in the pool buffer - code that uses the buffer must add MemoryBuffer::getBufferOffset() to its offsets.
+// Pool buffer usage must contain usage of all MemoryBuffers that use it ( transfer usage is added by default ). Offsets are aligned to the strictest
+// uniform/storage/texel buffer offset alignment of a device. Pooled buffers are not relocatable during defragmentation.
+class PUMEX_EXPORT BufferPool
+{
+public:
+  BufferPool()                             = delete;
+  explicit BufferPool(std::shared_ptr<DeviceMemoryAllocator> allocator, VkBufferUsageFlags bufferUsage, VkDeviceSize poolSize);
+  BufferPool(const BufferPool&)            = delete;
+  BufferPool& operator=(const BufferPool&) = delete;
+  BufferPool(BufferPool&&)                 = delete;
+  BufferPool& operator=(BufferPool&&)      = delete;
+  ~BufferPool();
+
+  // returns false when there's not enough free space in the pool
+  bool                                          allocate(Device* device, VkDeviceSize size, VkBuffer& buffer, VkDeviceSize& offset, DeviceMemoryBlock& memoryBlock);
+  void                                          deallocate(VkDevice device, VkDeviceSize offset);
+
+  inline std::shared_ptr<DeviceMemoryAllocator> getAllocator() const;
+  inline VkBufferUsageFlags                     getBufferUsage() const;
+  inline VkDeviceSize                           getPoolSize() const;
+protected:
+  struct PerDeviceData
+  {
+    VkBuffer                                            buffer    = VK_NULL_HANDLE;
+    DeviceMemoryBlock                                   memoryBlock;
+    VkDeviceSize                                        alignment = 1;
+    std::unique_ptr<TLSFAllocationStrategy>             strategy;
+    std::unordered_map<VkDeviceSize, DeviceMemoryBlock> allocations; // suballocations in a pool buffer, keyed by their offsets
+  };
+  mutable std::mutex                          mutex;
+  std::shared_ptr<DeviceMemoryAllocator>      allocator;
+  VkBufferUsageFlags                          bufferUsage;
+  VkDeviceSize                                poolSize;
+  std::unordered_map<VkDevice, PerDeviceData> perDeviceData;
 };
 
 // class that is an interface to MemoryBuffer. May store any structured data in a buffer
@@ -179,6 +307,9 @@ public:
   void               setBufferSize(Device* device, size_t bufferSize);
 
   void               invalidateData();
+  // only given range of data ( in bytes ) will be sent to buffers. Ranges invalidated before data is sent are merged
+  void               invalidateRange(size_t offset, size_t size);
+  void               setDataRange(size_t offset, const void* srcData, size_t size);
   void               setData(const T& data);
   void               setData(Surface* surface, std::shared_ptr<T> data);
   void               setData(Device* device, std::shared_ptr<T> data);
@@ -250,9 +381,11 @@ struct SetDataOperation : public MemoryBuffer::Operation
   SetDataOperation(MemoryBuffer* o, const BufferSubresourceRange& r, const BufferSubresourceRange& sr, std::shared_ptr<T> data, uint32_t ac);
   bool perform(const RenderContext& renderContext, MemoryBuffer::MemoryBufferInternal& internals, std::shared_ptr<CommandBuffer> commandBuffer) override;
   void releaseResources(const RenderContext& renderContext) override;
+  bool getSourceData(const void*& dataPointer, size_t& dataSize) const override;
 
   std::shared_ptr<T>                          data;
   BufferSubresourceRange                      sourceRange;
+  std::vector<BufferSubresourceRange>         dirtyRanges; // when empty - all data is sent
   std::vector<std::shared_ptr<StagingBuffer>> stagingBuffers;
 };
 
@@ -260,6 +393,14 @@ const PerObjectBehaviour&              MemoryBuffer::getPerObjectBehaviour() con
 const SwapChainImageBehaviour&         MemoryBuffer::getSwapChainImageBehaviour() const { return swapChainImageBehaviour; }
 std::shared_ptr<DeviceMemoryAllocator> MemoryBuffer::getAllocator() const               { return allocator; }
 VkBufferUsageFlags                     MemoryBuffer::getBufferUsage() const             { return bufferUsage; }
+bool                                   MemoryBuffer::isRelocatable() const              { return swapChainImageBehaviour == swForEachImage && (bufferUsage & VK_BUFFER_USAGE_TRANSFER_SRC_BIT) != 0 && bufferPool == nullptr; }
+std::shared_ptr<BufferPool>            MemoryBuffer::getBufferPool() const              { return bufferPool; }
+const BufferCapacityPolicy&            MemoryBuffer::getCapacityPolicy() const          { return capacityPolicy; }
+bool                                   MemoryBuffer::getSurfaceDataSharing() const      { return shareSurfaceData; }
+
+std::shared_ptr<DeviceMemoryAllocator> BufferPool::getAllocator() const                 { return allocator; }
+VkBufferUsageFlags                     BufferPool::getBufferUsage() const               { return bufferUsage; }
+VkDeviceSize                           BufferPool::getPoolSize() const                  { return poolSize; }
 
 template <typename T>
 Buffer<T>::Buffer(std::shared_ptr<DeviceMemoryAllocator> allocator, VkBufferUsageFlags bufferUsage, PerObjectBehaviour perObjectBehaviour, SwapChainImageBehaviour swapChainImageBehaviour, bool useSetDataMethods)
@@ -312,6 +453,50 @@ void Buffer<T>::invalidateData()
   invalidateResources();
 }
 
+template <typename T>
+void Buffer<T>::invalidateRange(size_t offset, size_t size)
+{
+  CHECK_LOG_THROW(!sameDataPerObject, "Cannot invalidate data - wrong constructor used to create an object");
+  CHECK_LOG_THROW((bufferUsage & VK_BUFFER_USAGE_TRANSFER_DST_BIT) == 0, "Cannot set data for this buffer - user declared it as not writeable");
+  std::lock_guard<std::mutex> lock(mutex);
+  BufferSubresourceRange fullRange(0, getDataSize());
+  BufferSubresourceRange range(offset, size);
+  CHECK_LOG_THROW(!fullRange.contains(range), "Cannot invalidate range ( " << offset << ", " << size << " ) of a buffer with size " << fullRange.range);
+  if (size == 0)
+    return;
+  for (auto& pdd : perObjectData)
+  {
+    // range is added to SetData operation that was not performed on any object yet
+    auto it = std::find_if(begin(pdd.second.commonData.bufferOperations), end(pdd.second.commonData.bufferOperations), [](std::shared_ptr<Operation> bufop)
+    {
+      return bufop->type == MemoryBuffer::Operation::SetData && std::none_of(begin(bufop->updated), end(bufop->updated), [](char u) { return u != 0; });
+    });
+    if (it != end(pdd.second.commonData.bufferOperations))
+    {
+      auto setDataOp = std::static_pointer_cast<SetDataOperation<T>>(*it);
+      if (!setDataOp->dirtyRanges.empty())
+        mergeBufferSubresourceRange(setDataOp->dirtyRanges, range);
+    }
+    else
+    {
+      auto setDataOp = std::make_shared<SetDataOperation<T>>(this, fullRange, fullRange, data, activeCount);
+      setDataOp->dirtyRanges.push_back(range);
+      pdd.second.commonData.bufferOperations.push_back(setDataOp);
+    }
+    pdd.second.invalidate();
+  }
+  invalidateResources();
+}
+
+template <typename T>
+void Buffer<T>::setDataRange(size_t offset, const void* srcData, size_t size)
+{
+  CHECK_LOG_THROW(!sameDataPerObject, "Cannot set data - wrong constructor used to create an object");
+  CHECK_LOG_THROW(offset + size > getDataSize(), "Cannot set range ( " << offset << ", " << size << " ) of a buffer with size " << getDataSize());
+  std::memcpy(static_cast<char*>(getDataPointer()) + offset, srcData, size);
+  invalidateRange(offset, size);
+}
+
 template <typename T>
 void Buffer<T>::setData(const T& dt)
 {
@@ -420,31 +605,8 @@ SetBufferSizeOperation<T>::SetBufferSizeOperation(MemoryBuffer* o, const BufferS
 template<typename T>
 bool SetBufferSizeOperation<T>::perform(const RenderContext& renderContext, MemoryBuffer::MemoryBufferInternal& internals, std::shared_ptr<CommandBuffer> commandBuffer)
 {
-  // release old buffer if exists
-  auto ownerAllocator = owner->getAllocator();
-  if (internals.buffer != VK_NULL_HANDLE)
-  {
-    vkDestroyBuffer(renderContext.vkDevice, internals.buffer, nullptr);
-    ownerAllocator->deallocate(renderContext.vkDevice, internals.memoryBlock);
-    internals.buffer      = VK_NULL_HANDLE;
-    internals.dataSize    = 0;
-    internals.memoryBlock = DeviceMemoryBlock();
-  }
-  VkBufferCreateInfo bufferCreateInfo{};
-    bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    bufferCreateInfo.usage = owner->getBufferUsage();
-    bufferCreateInfo.size  = std::max<VkDeviceSize>(1, bufferRange.range);
-  VK_CHECK_LOG_THROW(vkCreateBuffer(renderContext.vkDevice, &bufferCreateInfo, nullptr, &internals.buffer), "Cannot create a buffer");
-  VkMemoryRequirements memReqs;
-  vkGetBufferMemoryRequirements(renderContext.vkDevice, internals.buffer, &memReqs);
-  internals.dataSize    = bufferCreateInfo.size;
-  internals.memoryBlock = ownerAllocator->allocate(renderContext.device, memReqs);
-  CHECK_LOG_THROW(internals.memoryBlock.alignedSize == 0, "Cannot create a bufer");
-  ownerAllocator->bindBufferMemory(renderContext.device, internals.buffer, internals.memoryBlock.alignedOffset);
-
-  owner->notifyCommandBufferSources(renderContext);
-  owner->notifyBufferViews(renderContext, bufferRange);
-  owner->notifyResources(renderContext);
+  // buffer is recreated only when it's too small or too big for requested size
+  owner->resizeBuffer(renderContext, internals, bufferRange.range);
   return false;
 }
 
@@ -457,54 +619,79 @@ SetDataOperation<T>::SetDataOperation(MemoryBuffer* o, const BufferSubresourceRa
 template<typename T>
 bool SetDataOperation<T>::perform(const RenderContext& renderContext, MemoryBuffer::MemoryBufferInternal& internals, std::shared_ptr<CommandBuffer> commandBuffer)
 {
-  // if new data size is bigger than existing buffer size - we have to remove it
+  // buffer is recreated only when capacity policy demands it. New buffer has no data, so all data must be sent
   auto ownerAllocator = owner->getAllocator();
-  if (internals.buffer!=VK_NULL_HANDLE && internals.memoryBlock.alignedSize < uglyGetSize(*data))
+  VkDeviceSize dataSize = uglyGetSize(*data);
+  bool sendAllData = dirtyRanges.empty();
+  if (owner->resizeBuffer(renderContext, internals, dataSize))
+    sendAllData = true;
+
+  std::vector<BufferSubresourceRange> ranges;
+  if (sendAllData)
   {
-    vkDestroyBuffer(renderContext.vkDevice, internals.buffer, nullptr);
-    ownerAllocator->deallocate(renderContext.vkDevice, internals.memoryBlock);
-    internals.buffer      = VK_NULL_HANDLE;
-    internals.dataSize    = 0;
-    internals.memoryBlock = DeviceMemoryBlock();
+    ranges.push_back(BufferSubresourceRange(0, dataSize));
   }
-
-  if (internals.buffer == VK_NULL_HANDLE)
+  else
   {
-    VkBufferCreateInfo bufferCreateInfo{};
-      bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-      bufferCreateInfo.usage = owner->getBufferUsage();
-      bufferCreateInfo.size  = std::max<VkDeviceSize>(1, uglyGetSize(*data));
-    VK_CHECK_LOG_THROW(vkCreateBuffer(renderContext.vkDevice, &bufferCreateInfo, nullptr, &internals.buffer), "Cannot create a buffer");
-    VkMemoryRequirements memReqs;
-    vkGetBufferMemoryRequirements(renderContext.vkDevice, internals.buffer, &memReqs);
-    internals.dataSize    = bufferCreateInfo.size;
-    internals.memoryBlock = ownerAllocator->allocate(renderContext.device, memReqs);
-    CHECK_LOG_THROW(internals.memoryBlock.alignedSize == 0, "Cannot create a buffer");
-    ownerAllocator->bindBufferMemory(renderContext.device, internals.buffer, internals.memoryBlock.alignedOffset);
-
-    owner->notifyCommandBufferSources(renderContext);
-    owner->notifyBufferViews(renderContext, bufferRange);
-    owner->notifyResources(renderContext);
+    // data might have been shrunk after the range was invalidated
+    for (const auto& r : dirtyRanges)
+      if (r.offset < dataSize)
+        ranges.push_back(BufferSubresourceRange(r.offset, std::min(r.range, dataSize - r.offset)));
   }
+  VkDeviceSize rangeSize = 0;
+  for (const auto& r : ranges)
+    rangeSize += r.range;
+
   bool memoryIsLocal = ((ownerAllocator->getMemoryPropertyFlags() & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) == VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-  if (uglyGetSize(*data) > 0)
+  const unsigned char* srcData = reinterpret_cast<const unsigned char*>(uglyGetPointer(*data));
+  if (rangeSize > 0)
   {
     if (memoryIsLocal)
     {
-      std::shared_ptr<StagingBuffer> stagingBuffer = renderContext.device->acquireStagingBuffer(uglyGetPointer(*data), uglyGetSize(*data));
-      VkBufferCopy copyRegion{};
-      copyRegion.size = uglyGetSize(*data);
-      commandBuffer->cmdCopyBuffer(stagingBuffer->buffer, internals.buffer, copyRegion);
+      // all ranges are packed into one staging buffer
+      std::shared_ptr<StagingBuffer> stagingBuffer = renderContext.device->acquireStagingBuffer(nullptr, rangeSize);
+      unsigned char* mapAddress = static_cast<unsigned char*>(stagingBuffer->mapMemory(rangeSize));
+      std::vector<VkBufferCopy> copyRegions;
+      VkDeviceSize stagingOffset = 0;
+      for (const auto& r : ranges)
+      {
+        std::memcpy(mapAddress + stagingOffset, srcData + r.offset, r.range);
+        VkBufferCopy copyRegion{};
+          copyRegion.srcOffset = stagingBuffer->offset + stagingOffset;
+          copyRegion.dstOffset = internals.bufferOffset + r.offset;
+          copyRegion.size      = r.range;
+        copyRegions.push_back(copyRegion);
+        stagingOffset += r.range;
+      }
+      stagingBuffer->unmapMemory();
+      // upload manager sends the copy on upload queue and releases staging buffer when the copy is finished. Upload queue does not wait
+      // for frames in flight, so buffers that may be still read by GPU are updated in place on the queue of the surface
+      auto uploadManager = renderContext.device->getUploadManager();
+      if (uploadManager != nullptr && owner->isCopyIdle(renderContext, internals))
+      {
+        uploadManager->copyBuffer(stagingBuffer, internals.buffer, copyRegions);
+        return false;
+      }
+      // barriers cover commands of earlier frames submitted to the same queue, which may still use updated ranges of the buffer
+      VkPipelineStageFlags srcStageMask;
+      VkAccessFlags        srcAccessMask;
+      getBufferUsageScope(owner->getBufferUsage(), srcStageMask, srcAccessMask);
+      std::vector<PipelineBarrier> barriers;
+      for (const auto& copyRegion : copyRegions)
+        barriers.push_back(PipelineBarrier(srcAccessMask, VK_ACCESS_TRANSFER_WRITE_BIT, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, internals.buffer, copyRegion.dstOffset, copyRegion.size));
+      commandBuffer->cmdPipelineBarrier(srcStageMask, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, barriers);
+      commandBuffer->cmdCopyBuffer(stagingBuffer->buffer, internals.buffer, copyRegions);
       stagingBuffers.push_back(stagingBuffer);
     }
     else
     {
-      ownerAllocator->copyToDeviceMemory(renderContext.device, internals.memoryBlock.alignedOffset, uglyGetPointer(*data), uglyGetSize(*data), 0);
+      for (const auto& r : ranges)
+        ownerAllocator->copyToDeviceMemory(renderContext.device, internals.memoryBlock, r.offset, srcData + r.offset, r.range, 0);
     }
   }
 
   // if we sent some data and memory is not accessible from host ( is local ) - we generated no commands to command buffer
-  return uglyGetSize(*data) > 0 && memoryIsLocal;
+  return rangeSize > 0 && memoryIsLocal;
 }
 
 template<typename T>
@@ -515,4 +702,12 @@ void SetDataOperation<T>::releaseResources(const RenderContext& renderContext)
   stagingBuffers.clear();
 }
 
+template<typename T>
+bool SetDataOperation<T>::getSourceData(const void*& dataPointer, size_t& dataSize) const
+{
+  dataPointer = uglyGetPointer(*data);
+  dataSize    = uglyGetSize(*data);
+  return true;
+}
+
 }
\ No newline at end of file
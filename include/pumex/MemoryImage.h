@@ -76,6 +76,8 @@ public:
   void                                          setImageTraits(const ImageTraits& traits);
   void                                          setImageTraits(Surface* surface, const ImageTraits& traits);
   void                                          setImageTraits(Device* device, const ImageTraits& traits);
+  // images created after this call are placed in memory shared with other members of the alias group
+  void                                          setMemoryAliasGroup(std::shared_ptr<ImageMemoryAliasGroup> aliasGroup);
 
   void                                          invalidateImage();
   void                                          setImage(Surface* surface, std::shared_ptr<gli::texture> tex);
@@ -95,7 +97,10 @@ public:
   inline const PerObjectBehaviour&              getPerObjectBehaviour() const;
   inline const SwapChainImageBehaviour&         getSwapChainImageBehaviour() const;
   inline std::shared_ptr<DeviceMemoryAllocator> getAllocator() const;
+  inline std::shared_ptr<ImageMemoryAliasGroup> getMemoryAliasGroup() const;
   inline std::shared_ptr<gli::texture>          getTexture() const;
+  // image memory may be moved during allocator defragmentation
+  bool                                          isRelocatable(const ImageTraits& traits) const;
 
   void                                          validate(const RenderContext& renderContext);
 
@@ -111,6 +116,8 @@ public:
   struct MemoryImageInternal
   {
     std::shared_ptr<Image> image;
+    VkImageLayout          layout = VK_IMAGE_LAYOUT_UNDEFINED; // layout left by the last operation that filled the image
+    bool                   inUse  = false;                     // image was handed to rendering, so frames in flight may still read it
   };
   // struct that defines all operations that may be performed on that Texture ( set new image traits, clear it, set new data )
   struct Operation
@@ -161,6 +168,7 @@ protected:
   ImageTraits                                     imageTraits;
   std::shared_ptr<gli::texture>                   texture;
   std::shared_ptr<DeviceMemoryAllocator>          allocator;
+  std::shared_ptr<ImageMemoryAliasGroup>          memoryAliasGroup;
   VkImageAspectFlags                              aspectMask;
   uint32_t                                        activeCount;
   // objects that may own a texture and must be informed when some changes happen
@@ -171,6 +179,7 @@ protected:
   void internalSetImage(uint32_t key, VkDevice device, VkSurfaceKHR surface, std::shared_ptr<gli::texture> texture);
   void internalSetImages(uint32_t key, VkDevice device, VkSurfaceKHR surface, std::vector<std::shared_ptr<Image>>& images);
   void internalClearImage(uint32_t key, VkDevice device, VkSurfaceKHR surface, const glm::vec4& clearValue, const ImageSubresourceRange& range);
+  void relocate(const RenderContext& renderContext, MemoryImageInternal& internals);
 };
 
 class PUMEX_EXPORT ImageView : public std::enable_shared_from_this<ImageView>
@@ -222,6 +231,7 @@ VkImageAspectFlags                     MemoryImage::getAspectMask() const
 const PerObjectBehaviour&              MemoryImage::getPerObjectBehaviour() const      { return perObjectBehaviour; }
 const SwapChainImageBehaviour&         MemoryImage::getSwapChainImageBehaviour() const { return swapChainImageBehaviour; }
 std::shared_ptr<DeviceMemoryAllocator> MemoryImage::getAllocator() const               { return allocator; }
+std::shared_ptr<ImageMemoryAliasGroup> MemoryImage::getMemoryAliasGroup() const        { return memoryAliasGroup; }
 std::shared_ptr<gli::texture>          MemoryImage::getTexture() const                 { return texture; }
 
 }
@@ -36,6 +36,14 @@ namespace pumex
 class PUMEX_EXPORT MemoryObjectBarrier
 {
 public:
+  // Queue family ownership transfer is performed in two barriers : release barrier on the source queue and acquire barrier on the destination queue.
+  // Barriers created during workflow compilation do not know queue family indices ( workflow may be used by many surfaces ), so for release
+  // and acquire barriers srcQueueFamilyIndex and dstQueueFamilyIndex store queue numbers from RenderWorkflowResults::queueTraits instead.
+  // These numbers are translated into family indices when command buffer is built.
+  // qtReturnAcquire acquires the ownership returned at the end of previous frame. When resource was not used by any submitted frame yet,
+  // there is no matching release, so the barrier becomes a layout transition from VK_IMAGE_LAYOUT_UNDEFINED without ownership transfer.
+  enum QueueTransfer { qtNone, qtRelease, qtAcquire, qtReturnAcquire };
+
   MemoryObjectBarrier();
   MemoryObjectBarrier(VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask, uint32_t srcQueueFamilyIndex, uint32_t dstQueueFamilyIndex, std::shared_ptr<MemoryObject> memoryObject, VkImageLayout oldLayout, VkImageLayout newLayout, const ImageSubresourceRange& imageRange);
   MemoryObjectBarrier(VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask, uint32_t srcQueueFamilyIndex, uint32_t dstQueueFamilyIndex, std::shared_ptr<MemoryObject> memoryObject, const BufferSubresourceRange& bufferRange);
@@ -49,6 +57,7 @@ public:
   uint32_t                      srcQueueFamilyIndex;
   uint32_t                      dstQueueFamilyIndex;
   std::shared_ptr<MemoryObject> memoryObject;
+  QueueTransfer                 queueTransfer = qtNone;
 
   VkImageLayout                 oldLayout;   // used by images
   VkImageLayout                 newLayout;   // used by images
@@ -30,7 +30,10 @@ namespace pumex
 {
 
 enum PerObjectBehaviour { pbPerDevice, pbPerSurface };
-enum SwapChainImageBehaviour { swOnce, swForEachImage };
+// swOnce                  - one copy of the data shared by all frames
+// swForEachImage          - copy of the data for each frame in flight ( see SurfaceTraits::framesInFlight )
+// swForEachSwapChainImage - copy of the data for each swapchain image. Used by objects that refer to swapchain images directly
+enum SwapChainImageBehaviour { swOnce, swForEachImage, swForEachSwapChainImage };
 
 // helper class that stores info about internal data for many classes in a library
 template<typename T, typename U>
@@ -52,12 +55,15 @@ struct PerObjectData
 
 inline void* getKey(const RenderContext& renderContext, const PerObjectBehaviour& pob);
 uint32_t getKeyID(const RenderContext& renderContext, const PerObjectBehaviour& pob);
+// number of data copies and index of current copy for given swapchain image behaviour
+inline uint32_t getActiveCount(const RenderContext& renderContext, SwapChainImageBehaviour scib);
+inline uint32_t getActiveIndex(const RenderContext& renderContext, SwapChainImageBehaviour scib);
 
 template<typename T, typename U>
 PerObjectData<T,U>::PerObjectData(const RenderContext& renderContext, SwapChainImageBehaviour scib)
   : device{ renderContext.vkDevice }, surface{ renderContext.vkSurface }, commonData(), swapChainImageBehaviour{ scib }
 {
-  resize(swapChainImageBehaviour==swForEachImage ? renderContext.imageCount : 1);
+  resize(getActiveCount(renderContext, swapChainImageBehaviour));
 }
 
 template<typename T, typename U>
@@ -70,7 +76,7 @@ PerObjectData<T,U>::PerObjectData(VkDevice d, VkSurfaceKHR s, uint32_t ac, SwapC
 template<typename T, typename U>
 void PerObjectData<T,U>::resize(uint32_t ac)
 {
-  uint32_t newSize = (swapChainImageBehaviour == swForEachImage) ? ac : 1;
+  uint32_t newSize = (swapChainImageBehaviour != swOnce) ? ac : 1;
   valid.resize(newSize, false);
   data.resize(newSize, T());
 }
@@ -102,4 +108,24 @@ void* getKey(const RenderContext& renderContext, const PerObjectBehaviour& pob)
   return nullptr;
 }
 
+uint32_t getActiveCount(const RenderContext& renderContext, SwapChainImageBehaviour scib)
+{
+  switch (scib)
+  {
+  case swForEachImage:          return renderContext.activeCount;
+  case swForEachSwapChainImage: return renderContext.imageCount;
+  default:                      return 1;
+  }
+}
+
+uint32_t getActiveIndex(const RenderContext& renderContext, SwapChainImageBehaviour scib)
+{
+  switch (scib)
+  {
+  case swForEachImage:          return renderContext.activeIndex;
+  case swForEachSwapChainImage: return renderContext.imageIndex;
+  default:                      return 0;
+  }
+}
+
 }
\ No newline at end of file
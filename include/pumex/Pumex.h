@@ -36,6 +36,8 @@
 #include <pumex/Node.h>
 #include <pumex/NodeVisitor.h>
 #include <pumex/DeviceMemoryAllocator.h>
+#include <pumex/UploadManager.h>
+#include <pumex/ReadbackManager.h>
 #include <pumex/Image.h>
 #include <pumex/Resource.h>
 #include <pumex/Descriptor.h>
@@ -47,6 +49,7 @@
 #include <pumex/InputAttachment.h>
 #include <pumex/UniformBuffer.h>
 #include <pumex/StorageBuffer.h>
+#include <pumex/StreamingBuffer.h>
 #include <pumex/Pipeline.h>
 #include <pumex/RenderPass.h>
 #include <pumex/FrameBuffer.h>
@@ -0,0 +1,91 @@
+//
+// Copyright(c) 2017-2018 Paweł Księżopolski ( pumexx )
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+
+
+#pragma once
+#include <memory>
+#include <vector>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <vulkan/vulkan.h>
+#include <pumex/Export.h>
+
+namespace pumex
+{
+
+class Device;
+class RenderContext;
+class CommandBuffer;
+class MemoryBuffer;
+class StagingBuffer;
+class StagingRing;
+
+// ReadbackManager copies content of memory buffers to host visible memory without stalling the GPU. Each surface owns its own
+// ReadbackManager. Copies are recorded at the end of the next frame rendered on the surface ( into its present command buffer ) and
+// data is delivered a few frames later - when surface waits for the fence of that frame in Surface::beginFrame().
+// Callbacks are called from the render thread, so they should be short ( copy the data and return ).
+// Readback memory is suballocated from a ring of transfer destination buffers placed in host cached memory when available. Buffer being read must have VK_BUFFER_USAGE_TRANSFER_SRC_BIT usage.
+class PUMEX_EXPORT ReadbackManager
+{
+public:
+  typedef std::function<void(const void*, VkDeviceSize)> Callback;
+
+  ReadbackManager()                                  = delete;
+  explicit ReadbackManager(Device* device, uint32_t framesInFlight, VkDeviceSize ringSize = 4 * 1024 * 1024);
+  ReadbackManager(const ReadbackManager&)            = delete;
+  ReadbackManager& operator=(const ReadbackManager&) = delete;
+  ReadbackManager(ReadbackManager&&)                 = delete;
+  ReadbackManager& operator=(ReadbackManager&&)      = delete;
+  ~ReadbackManager();
+
+  // reads size bytes starting at offset. VK_WHOLE_SIZE reads everything up to the end of buffer data
+  void                              readBuffer(std::shared_ptr<MemoryBuffer> memoryBuffer, VkDeviceSize offset, VkDeviceSize size, Callback callback);
+  std::future<std::vector<uint8_t>> readBuffer(std::shared_ptr<MemoryBuffer> memoryBuffer, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+
+  // returns true when command buffer for given frame in flight must be recorded again : new requests arrived or it still contains old copies
+  bool                              needsRecording(uint32_t frameIndex) const;
+  // records copies for all pending requests. Requests for buffers that are not created yet wait for next frames
+  void                              recordCopies(const RenderContext& renderContext, CommandBuffer* commandBuffer);
+  // called when GPU finished frame that used given frame in flight resources - delivers data to the requesters
+  void                              frameFinished(uint32_t frameIndex, uint64_t frameNumber, uint64_t completedFrameNumber);
+protected:
+  struct Request
+  {
+    std::shared_ptr<MemoryBuffer>  memoryBuffer;
+    VkDeviceSize                   offset;
+    VkDeviceSize                   size;
+    Callback                       callback;
+    std::shared_ptr<StagingBuffer> readbackBuffer;
+    VkDeviceSize                   readbackSize = 0;
+  };
+
+  Device*                           device;
+  std::unique_ptr<StagingRing>      readbackRing;
+  mutable std::mutex                mutex;
+  std::vector<Request>              pendingRequests;
+  std::vector<std::vector<Request>> recordedRequests; // requests recorded for each frame in flight
+  std::vector<char>                 recordedCopies;   // true when command buffer for frame in flight contains copies
+};
+
+}
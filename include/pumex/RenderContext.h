@@ -61,7 +61,9 @@ public:
   Device*                          device                 = nullptr;
   VkDevice                         vkDevice               = VK_NULL_HANDLE;
   DescriptorPool*                  descriptorPool         = nullptr;
-  uint32_t                         activeIndex            = 0;
+  uint32_t                         activeIndex            = 0; // index of current frame in flight
+  uint32_t                         activeCount            = 1; // number of frames in flight
+  uint32_t                         imageIndex             = 0; // index of current swapchain image
   uint32_t                         imageCount             = 1;
 
   // elements of the context that may change during visitor work
@@ -34,6 +34,7 @@
 #include <pumex/PerObjectData.h>
 #include <pumex/MemoryBuffer.h>
 #include <pumex/MemoryImage.h>
+#include <pumex/MemoryObjectBarrier.h>
 
 namespace pumex
 {
@@ -250,6 +251,17 @@ public:
 inline void getPipelineStageMasks(std::shared_ptr<ResourceTransition> generatingTransition, std::shared_ptr<ResourceTransition> consumingTransition, VkPipelineStageFlags& srcStageMask, VkPipelineStageFlags& dstStageMask);
 inline void getAccessMasks(std::shared_ptr<ResourceTransition> generatingTransition, std::shared_ptr<ResourceTransition> consumingTransition, VkAccessFlags& srcAccessMask, VkAccessFlags& dstAccessMask);
 
+// Commands from RenderWorkflowResults::commands[i] are sent to a queue in a single vkQueueSubmit() call described by RenderWorkflowResults::submissions[i].
+// Submission starts its work when all submissions it waits for signal their semaphores. Submissions are sorted in order in which they must be submitted
+struct PUMEX_EXPORT QueueSubmission
+{
+  explicit QueueSubmission(uint32_t queueNumber);
+
+  uint32_t                          queueNumber;     // index of a queue in RenderWorkflowResults::queueTraits
+  std::vector<uint32_t>             waitSubmissions; // submissions that must finish their work before this one
+  std::vector<VkPipelineStageFlags> waitStages;      // pipeline stages waiting for each submission from waitSubmissions
+};
+
 class PUMEX_EXPORT RenderWorkflowResults
 {
 public:
@@ -257,7 +269,9 @@ public:
 
   std::vector<QueueTraits>                                                           queueTraits;
   std::vector<std::vector<std::shared_ptr<RenderCommand>>>                           commands;
+  std::vector<QueueSubmission>                                                       submissions;
   std::map<std::string, std::string>                                                 resourceAlias;
+  std::map<std::string, std::string>                                                 memoryAlias;
   std::shared_ptr<RenderPass>                                                        outputRenderPass;
   uint32_t                                                                           presentationQueueIndex = 0;
   std::map<std::string, std::shared_ptr<MemoryBuffer>>                               registeredMemoryBuffers;
@@ -368,7 +382,9 @@ class PUMEX_EXPORT SingleQueueWorkflowCompiler : public RenderWorkflowCompiler
 {
 public:
   std::shared_ptr<RenderWorkflowResults> compile(RenderWorkflow& workflow) override;
-private:
+protected:
+  virtual void                           createOperationSequences(const RenderWorkflow& workflow, std::vector<std::vector<std::shared_ptr<RenderOperation>>>& operationSequences);
+  void                                   createQueueSubmissions(const RenderWorkflow& workflow, const std::vector<std::vector<std::shared_ptr<RenderCommand>>>& commandSequences, std::shared_ptr<RenderWorkflowResults> workflowResults);
   void                                   verifyOperations(const RenderWorkflow& workflow);
   void                                   calculatePartialOrdering(const RenderWorkflow& workflow, std::vector<std::shared_ptr<RenderOperation>>& partialOrdering);
   void                                   calculateAttachmentLayouts(const RenderWorkflow& workflow, const std::vector<std::shared_ptr<RenderOperation>>& partialOrdering, std::map<std::string, uint32_t>& resourceMap, std::map<std::string, uint32_t>& operationMap, std::vector<std::vector<VkImageLayout>>& allLayouts);
@@ -376,12 +392,25 @@ private:
   void                                   createCommandSequence(const std::vector<std::shared_ptr<RenderOperation>>& operationSequence, std::vector<std::shared_ptr<RenderCommand>>& commands);
   void                                   buildFrameBuffersAndRenderPasses(const RenderWorkflow& workflow, const std::vector<std::shared_ptr<RenderOperation>>& partialOrdering, const std::map<std::string, uint32_t>& resourceMap, const std::map<std::string, uint32_t>& operationMap, const std::vector<std::vector<VkImageLayout>>& allLayouts, std::shared_ptr<RenderWorkflowResults> workflowResults);
   void                                   createPipelineBarriers(const RenderWorkflow& workflow, std::vector<std::vector<std::shared_ptr<RenderCommand>>>& commandSequences, std::shared_ptr<RenderWorkflowResults> workflowResults);
+  void                                   createMemoryAliasDependencies(const RenderWorkflow& workflow, std::vector<std::vector<std::shared_ptr<RenderCommand>>>& commandSequences, std::shared_ptr<RenderWorkflowResults> workflowResults);
   void                                   createSubpassDependency(std::shared_ptr<ResourceTransition> generatingTransition, std::shared_ptr<RenderCommand> generatingCommand, std::shared_ptr<ResourceTransition> consumingTransition, std::shared_ptr<RenderCommand> consumingCommand, uint32_t generatingQueueIndex, uint32_t consumingQueueIndex, std::shared_ptr<RenderWorkflowResults> workflowResults);
   void                                   createPipelineBarrier(std::shared_ptr<ResourceTransition> generatingTransition, std::shared_ptr<RenderCommand> generatingCommand, std::shared_ptr<ResourceTransition> consumingTransition, std::shared_ptr<RenderCommand> consumingCommand, uint32_t generatingQueueIndex, uint32_t consumingQueueIndex, std::shared_ptr<RenderWorkflowResults> workflowResults);
+  void                                   createQueueTransferBarriers(std::shared_ptr<ResourceTransition> generatingTransition, std::shared_ptr<RenderCommand> generatingCommand, const std::vector<std::shared_ptr<ResourceTransition>>& consumingTransitions, const std::vector<std::shared_ptr<RenderCommand>>& consumingCommands, uint32_t generatingQueueIndex, uint32_t consumingQueueIndex, std::shared_ptr<RenderWorkflowResults> workflowResults);
+  void                                   addPipelineBarrier(std::map<MemoryObjectBarrierGroup, std::vector<MemoryObjectBarrier>>& barriers, const MemoryObjectBarrierGroup& barrierGroup, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask, uint32_t srcQueueFamilyIndex, uint32_t dstQueueFamilyIndex, MemoryObjectBarrier::QueueTransfer queueTransfer, std::shared_ptr<MemoryObject> memoryObject, std::shared_ptr<ResourceTransition> generatingTransition, std::shared_ptr<ResourceTransition> consumingTransition);
 
   StandardRenderWorkflowCostCalculator   costCalculator;
 };
 
+// Second implementation of workflow compiler
+// Compute operations that do not depend on graphics operations are sent to compute queue ( if workflow defines queue that has VK_QUEUE_COMPUTE_BIT
+// without VK_QUEUE_GRAPHICS_BIT ), so that they may work in parallel with graphics operations. All other operations are sent to the first graphics queue.
+// Queues are synchronized by semaphores, resources used by both queues have their queue family ownership transferred.
+class PUMEX_EXPORT MultiQueueWorkflowCompiler : public SingleQueueWorkflowCompiler
+{
+protected:
+  void                                   createOperationSequences(const RenderWorkflow& workflow, std::vector<std::vector<std::shared_ptr<RenderOperation>>>& operationSequences) override;
+};
+
 LoadOp             loadOpLoad()                        { return LoadOp(LoadOp::Load, glm::vec4(0.0f)); }
 LoadOp             loadOpClear(const glm::vec2& color) { return LoadOp(LoadOp::Clear, glm::vec4(color.x, color.y, 0.0f, 0.0f)); }
 LoadOp             loadOpClear(const glm::vec4& color) { return LoadOp(LoadOp::Clear, color); }
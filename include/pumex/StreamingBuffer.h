@@ -0,0 +1,202 @@
+//
+// Copyright(c) 2017-2018 Paweł Księżopolski ( pumexx )
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#pragma once
+#include <memory>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include <pumex/Export.h>
+#include <pumex/MemoryBuffer.h>
+#include <pumex/Device.h>
+#include <pumex/Surface.h>
+#include <pumex/RenderContext.h>
+#include <pumex/utils/Log.h>
+
+namespace pumex
+{
+
+// view on the part of StreamingBuffer memory that belongs to a single frame
+template <typename T>
+struct StreamingBufferView
+{
+  StreamingBufferView(T* d = nullptr, size_t s = 0)
+    : data{ d }, size{ s }
+  {
+  }
+  inline T& operator[](size_t index) { return data[index]; }
+  inline T* begin()                  { return data; }
+  inline T* end()                    { return data + size; }
+
+  T*     data;
+  size_t size;
+};
+
+// StreamingBuffer stores data that is rewritten every frame ( per instance data for example ). Data is written directly into persistently mapped,
+// host visible memory, so there's no additional copy to a staging buffer nor to device local memory.
+// Buffer is divided into frameCount regions - one region for each frame in flight, so frameCount must be equal to the number of frames in flight of surfaces
+// that use the buffer. Frame writes to the region of its frame in flight ( Viewer calls render start event after surfaces waited for GPU to finish the previous
+// frame that used the same frame in flight ). Buffer is created once per device and must be bound through dynamic descriptor
+// ( VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC or VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC ) - region used by current frame is chosen by dynamic offset,
+// which stays the same for each frame in flight, so command buffers are not recorded again.
+template <typename T>
+class StreamingBuffer : public MemoryBuffer
+{
+public:
+  StreamingBuffer()                                  = delete;
+  explicit StreamingBuffer(std::shared_ptr<DeviceMemoryAllocator> allocator, VkBufferUsageFlags bufferUsage, size_t elementCount, uint32_t frameCount = 3);
+  StreamingBuffer(const StreamingBuffer&)            = delete;
+  StreamingBuffer& operator=(const StreamingBuffer&) = delete;
+  StreamingBuffer(StreamingBuffer&&)                 = delete;
+  StreamingBuffer& operator=(StreamingBuffer&&)      = delete;
+  virtual ~StreamingBuffer();
+
+  // returns region of the buffer used by a given frame ( see Viewer::getFrameNumber() ) - it is the region of frame in flight number frameNumber % frameCount. Buffer is created when necessary
+  StreamingBufferView<T> getFrameView(Device* device, uint64_t frameNumber);
+  // makes written elements visible to GPU when memory is not host coherent
+  void                   flushFrameView(Device* device, uint64_t frameNumber, size_t writtenElementCount);
+
+  inline size_t          getElementCount() const;
+  inline uint32_t        getFrameCount() const;
+
+  void                   validate(const RenderContext& renderContext) override;
+  uint32_t               getDynamicOffset(const RenderContext& renderContext) const override;
+
+  void*                  getDataPointer() override;
+  size_t                 getDataSize() override;
+  void                   sendDataToBuffer(uint32_t key, VkDevice device, VkSurfaceKHR surface) override;
+protected:
+  size_t                                              elementCount;
+  uint32_t                                            frameCount;
+  VkDeviceSize                                        regionSize;
+  VkDeviceSize                                        regionStride;
+
+  // returns true when buffer was created
+  bool                                                createStreamingBuffer(Device* device, MemoryBufferInternal*& internals);
+};
+
+template <typename T>
+StreamingBuffer<T>::StreamingBuffer(std::shared_ptr<DeviceMemoryAllocator> allocator, VkBufferUsageFlags bufferUsage, size_t ec, uint32_t fc)
+  : MemoryBuffer{ allocator, bufferUsage, pbPerDevice, swOnce, false, false }, elementCount{ ec }, frameCount{ fc }
+{
+  CHECK_LOG_THROW((allocator->getMemoryPropertyFlags() & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) == 0, "StreamingBuffer : allocator must use host visible memory");
+  CHECK_LOG_THROW(frameCount == 0, "StreamingBuffer : frame count must be greater than 0");
+  regionSize   = std::max<VkDeviceSize>(1, elementCount * sizeof(T));
+  // Vulkan guarantees that dynamic offset alignments and nonCoherentAtomSize are not greater than 256
+  regionStride = (regionSize + 255) & ~VkDeviceSize(255);
+}
+
+template <typename T>
+StreamingBuffer<T>::~StreamingBuffer()
+{
+}
+
+template <typename T>
+StreamingBufferView<T> StreamingBuffer<T>::getFrameView(Device* device, uint64_t frameNumber)
+{
+  bool created;
+  MemoryBufferInternal* internals;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    created = createStreamingBuffer(device, internals);
+  }
+  if (created)
+    invalidateResources();
+  uint8_t* regionData = static_cast<uint8_t*>(internals->memoryBlock.mappedMemory) + (frameNumber % frameCount) * regionStride;
+  return StreamingBufferView<T>(reinterpret_cast<T*>(regionData), elementCount);
+}
+
+template <typename T>
+void StreamingBuffer<T>::flushFrameView(Device* device, uint64_t frameNumber, size_t writtenElementCount)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  auto pddit = perObjectData.find(device->getID());
+  CHECK_LOG_THROW(pddit == end(perObjectData) || pddit->second.data[0].buffer == VK_NULL_HANDLE, "StreamingBuffer::flushFrameView() : buffer was not created for this device");
+  CHECK_LOG_THROW(writtenElementCount > elementCount, "StreamingBuffer::flushFrameView() : too many elements " << writtenElementCount << " > " << elementCount);
+  allocator->flushMappedMemory(device->device, pddit->second.data[0].memoryBlock, (frameNumber % frameCount) * regionStride, writtenElementCount * sizeof(T));
+}
+
+template <typename T>
+size_t StreamingBuffer<T>::getElementCount() const
+{
+  return elementCount;
+}
+
+template <typename T>
+uint32_t StreamingBuffer<T>::getFrameCount() const
+{
+  return frameCount;
+}
+
+template <typename T>
+void StreamingBuffer<T>::validate(const RenderContext& renderContext)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    // region is chosen by frame in flight, so regions written by CPU and read by GPU never overlap
+    CHECK_LOG_THROW(renderContext.activeCount != frameCount, "StreamingBuffer : frame count " << frameCount << " is different from the number of frames in flight " << renderContext.activeCount);
+    MemoryBufferInternal* internals;
+    if (createStreamingBuffer(renderContext.device, internals))
+      notifyResources(renderContext);
+  }
+  MemoryBuffer::validate(renderContext);
+}
+
+template <typename T>
+uint32_t StreamingBuffer<T>::getDynamicOffset(const RenderContext& renderContext) const
+{
+  return static_cast<uint32_t>((renderContext.activeIndex % frameCount) * regionStride);
+}
+
+template <typename T>
+void* StreamingBuffer<T>::getDataPointer()
+{
+  return nullptr;
+}
+
+template <typename T>
+size_t StreamingBuffer<T>::getDataSize()
+{
+  return regionSize;
+}
+
+template <typename T>
+void StreamingBuffer<T>::sendDataToBuffer(uint32_t key, VkDevice device, VkSurfaceKHR surface)
+{
+}
+
+template <typename T>
+bool StreamingBuffer<T>::createStreamingBuffer(Device* device, MemoryBufferInternal*& internals)
+{
+  auto pddit = perObjectData.find(device->getID());
+  if (pddit == end(perObjectData))
+    pddit = perObjectData.insert({ device->getID(), MemoryBufferData(device->device, VK_NULL_HANDLE, activeCount, swapChainImageBehaviour) }).first;
+  internals = &pddit->second.data[0];
+  if (internals->buffer != VK_NULL_HANDLE)
+    return false;
+  createBuffer(device, *internals, frameCount * regionStride);
+  CHECK_LOG_THROW(internals->memoryBlock.mappedMemory == nullptr, "StreamingBuffer : buffer memory is not persistently mapped");
+  // descriptors see only one region of the buffer
+  internals->dataSize = regionSize;
+  return true;
+}
+
+}
@@ -24,6 +24,8 @@
 #include <memory>
 #include <string>
 #include <vector>
+#include <set>
+#include <mutex>
 #include <vulkan/vulkan.h>
 #include <pumex/Export.h>
 #include <pumex/Device.h>
@@ -42,10 +44,12 @@ class CommandBuffer;
 class FrameBuffer;
 class MemoryBuffer;
 class MemoryImage;
+class MemoryObject;
 class ImageView;
 class Image;
 class Node;
 class TimeStatistics;
+class ReadbackManager;
 
 const uint32_t TSS_STAT_BASIC   = 1;
 const uint32_t TSS_STAT_BUFFERS = 2;
@@ -70,9 +74,10 @@ const uint32_t TSS_CHANNEL_EVENTSURFACERENDERFINISH     = 9;
 // struct representing information required to create a Vulkan surface
 struct PUMEX_EXPORT SurfaceTraits
 {
-  explicit SurfaceTraits(uint32_t imageCount, VkColorSpaceKHR imageColorSpace, uint32_t imageArrayLayers, VkPresentModeKHR swapchainPresentMode, VkSurfaceTransformFlagBitsKHR preTransform, VkCompositeAlphaFlagBitsKHR compositeAlpha);
+  explicit SurfaceTraits(uint32_t imageCount, VkColorSpaceKHR imageColorSpace, uint32_t imageArrayLayers, VkPresentModeKHR swapchainPresentMode, VkSurfaceTransformFlagBitsKHR preTransform, VkCompositeAlphaFlagBitsKHR compositeAlpha, uint32_t framesInFlight = 0);
 
   uint32_t                           imageCount;
+  uint32_t                           framesInFlight;   // number of copies of per frame resources ( buffers, descriptor sets, command buffers ). 0 means imageCount
   VkColorSpaceKHR                    imageColorSpace;
   uint32_t                           imageArrayLayers; // always 1 ( until VR )
   VkPresentModeKHR                   swapchainPresentMode;
@@ -109,6 +114,16 @@ public:
   void                          resizeSurface(uint32_t newWidth, uint32_t newHeight);
   inline uint32_t               getImageCount() const;
   inline uint32_t               getImageIndex() const;
+  // frames in flight may be less than swapchain images. Resources marked with swForEachImage are duplicated for each frame in flight
+  inline uint32_t               getFramesInFlight() const;
+  inline uint32_t               getFrameIndex() const;
+  // returns the last frame number that GPU finished rendering on this surface
+  inline uint64_t               getCompletedFrameNumber() const;
+  // asynchronous reads of memory buffers rendered on this surface
+  inline std::shared_ptr<ReadbackManager> getReadbackManager() const;
+  // returns true when queue family ownership of memory object copy was returned by a frame submitted earlier ( see MemoryObjectBarrier::qtReturnAcquire ).
+  // Otherwise the copy is used for the first time and command buffers of current frame in flight will be recorded again after submission
+  bool                          isOwnershipReturned(MemoryObject* memoryObject, uint32_t copyIndex);
 
   void                          setRenderWorkflow(std::shared_ptr<RenderWorkflow> workflow, std::shared_ptr<RenderWorkflowCompiler> compiler);
 
@@ -151,6 +166,8 @@ public:
 
   VkExtent2D                                    swapChainSize                = VkExtent2D{1,1};
   uint32_t                                      swapChainImageIndex          = 0;
+  uint32_t                                      framesInFlight               = 1;
+  uint32_t                                      frameIndex                   = 0;
   std::vector<std::shared_ptr<Image>>           swapChainImages;
 
   ActionQueue                                   actions;
@@ -162,18 +179,28 @@ protected:
   bool                                          realized                     = false;
   bool                                          resized                      = false;
 
-  std::vector<VkFence>                          waitFences;
+  std::vector<VkFence>                          waitFences;                 // one fence for each frame in flight
+  std::vector<uint64_t>                         waitFenceFrameNumbers;      // frame number submitted with each of waitFences
+  std::mutex                                    ownershipMutex;
+  std::set<std::pair<MemoryObject*, uint32_t>>  returnedOwnerships;         // memory object copies returned to generating queue by submitted frames
+  std::set<std::pair<MemoryObject*, uint32_t>>  firstOwnershipUses;         // memory object copies used for the first time by current frame
+  uint64_t                                      completedFrameNumber         = 0;
   std::shared_ptr<CommandBuffer>                prepareCommandBuffer;
-  std::vector<std::shared_ptr<CommandBuffer>>   primaryCommandBuffers;
+  std::vector<std::shared_ptr<CommandBuffer>>   primaryCommandBuffers;      // one command buffer for each RenderWorkflowResults::submissions
   std::shared_ptr<CommandBuffer>                presentCommandBuffer;
+  std::shared_ptr<ReadbackManager>              readbackManager;            // readback copies are recorded into presentCommandBuffer
 
   std::vector<Node*>                            secondaryCommandBufferNodes;
   std::vector<VkRenderPass>                     secondaryCommandBufferRenderPasses;
   std::vector<uint32_t>                         secondaryCommandBufferSubPasses;
 
   VkSemaphore                                   imageAvailableSemaphore      = VK_NULL_HANDLE;
-  std::vector<VkSemaphore>                      frameBufferReadySemaphores;
-  std::vector<VkSemaphore>                      renderCompleteSemaphores;
+  std::vector<VkSemaphore>                      frameBufferReadySemaphores; // signaled by prepareCommandBuffer for each submission that does not wait for other submissions
+  std::vector<VkSemaphore>                      renderCompleteSemaphores;   // signaled by each submission that no other submission waits for
+  std::vector<VkSemaphore>                      queueSemaphores;            // semaphores synchronizing submissions with each other
+  std::vector<std::vector<VkSemaphore>>          submissionWaitSemaphores;
+  std::vector<std::vector<VkPipelineStageFlags>> submissionWaitStages;
+  std::vector<std::vector<VkSemaphore>>          submissionSignalSemaphores;
   VkSemaphore                                   renderFinishedSemaphore      = VK_NULL_HANDLE;
 
   std::function<void(std::shared_ptr<Surface>)> eventSurfaceRenderStart;
@@ -182,6 +209,8 @@ protected:
 
   void                                          createSwapChain();
   bool                                          checkWorkflow();
+  void                                          createSubmissions();
+  void                                          destroySubmissions();
 };
 
 bool                         Surface::isRealized() const                                                               { return realized; }
@@ -189,6 +218,10 @@ void                         Surface::setID(uint32_t newID)
 uint32_t                     Surface::getID() const                                                                    { return id; }
 uint32_t                     Surface::getImageCount() const                                                            { return surfaceTraits.imageCount; }
 uint32_t                     Surface::getImageIndex() const                                                            { return swapChainImageIndex; }
+uint32_t                     Surface::getFramesInFlight() const                                                        { return framesInFlight; }
+uint32_t                     Surface::getFrameIndex() const                                                            { return frameIndex; }
+uint64_t                     Surface::getCompletedFrameNumber() const                                                  { return completedFrameNumber; }
+std::shared_ptr<ReadbackManager> Surface::getReadbackManager() const                                                   { return readbackManager; }
 void                         Surface::setEventSurfaceRenderStart(std::function<void(std::shared_ptr<Surface>)> event)  { eventSurfaceRenderStart = event; }
 void                         Surface::setEventSurfaceRenderFinish(std::function<void(std::shared_ptr<Surface>)> event) { eventSurfaceRenderFinish = event; }
 void                         Surface::setEventSurfacePrepareStatistics(std::function<void(Surface*, TimeStatistics*, TimeStatistics*)> event) { eventSurfacePrepareStatistics = event; }
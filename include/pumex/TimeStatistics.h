@@ -33,11 +33,14 @@ namespace pumex
 
 class Surface;
 
+// Channel stores durations by default. Channels of other value types store time of measurement as value begin and measured value
+// ( number of bytes, counter ) as value duration - such channels are not drawn as time bars
 class PUMEX_EXPORT TimeStatisticsChannel
 {
 public:
+  enum ValueType { vtDuration, vtSize, vtCounter };
   TimeStatisticsChannel() = delete;
-  explicit TimeStatisticsChannel(uint32_t valueCount, const std::wstring& channelName, const glm::vec4& color);
+  explicit TimeStatisticsChannel(uint32_t valueCount, const std::wstring& channelName, const glm::vec4& color, ValueType valueType = vtDuration);
 
   void                             setValues(double valueBegin, double valueDuration);
   void                             getLastValues(double& outValueBegin, double& outValueDuration) const;
@@ -45,6 +48,7 @@ public:
 
   inline std::wstring               getChannelName() const;
   inline glm::vec4                 getColor() const;
+  inline ValueType                 getValueType() const;
   inline double                    getAverageValue() const;
   inline double                    getMaxValue() const;
   inline double                    getMinValue() const;
@@ -54,6 +58,7 @@ public:
 protected:
   std::wstring                           channelName;
   glm::vec4                              color;
+  ValueType                              valueType;
   std::vector<std::pair<double, double>> values;   // start time and duration
   double                                 sumValue; // sum of all durations
   double                                 minValue;
@@ -69,7 +74,7 @@ public:
   void                                           registerGroup(uint32_t groupID, const std::wstring& groupName);
   void                                           unregisterGroup(uint32_t groupID);
 
-  void                                           registerChannel(uint32_t channelID, uint32_t groupID, const std::wstring& channelName, const glm::vec4& color);
+  void                                           registerChannel(uint32_t channelID, uint32_t groupID, const std::wstring& channelName, const glm::vec4& color, TimeStatisticsChannel::ValueType valueType = TimeStatisticsChannel::vtDuration);
   void                                           unregisterChannel(uint32_t channelID);
   void                                           unregisterChannels(uint32_t groupID);
   inline void                                    setFlags(uint32_t flags);
@@ -96,6 +101,7 @@ protected:
 
 std::wstring                            TimeStatisticsChannel::getChannelName() const                         { return channelName;}
 glm::vec4                               TimeStatisticsChannel::getColor() const                               { return color; }
+TimeStatisticsChannel::ValueType        TimeStatisticsChannel::getValueType() const                           { return valueType; }
 double                                  TimeStatisticsChannel::getAverageValue() const                        { return sumValue / values.size(); }
 double                                  TimeStatisticsChannel::getMaxValue() const                            { return maxValue; }
 double                                  TimeStatisticsChannel::getMinValue() const                            { return minValue; }
@@ -46,6 +46,7 @@ public:
   std::pair<bool, VkDescriptorType> getDefaultDescriptorType() override;
   void                              validate(const RenderContext& renderContext) override;
   DescriptorValue                   getDescriptorValue(const RenderContext& renderContext) override;
+  uint32_t                          getDynamicOffset(const RenderContext& renderContext) override;
 
   std::shared_ptr<MemoryBuffer> memoryBuffer;
 protected:
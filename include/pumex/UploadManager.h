@@ -0,0 +1,119 @@
+//
+// Copyright(c) 2017-2018 Paweł Księżopolski ( pumexx )
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+
+#pragma once
+#include <memory>
+#include <vector>
+#include <map>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vulkan/vulkan.h>
+#include <pumex/Export.h>
+
+namespace pumex
+{
+
+class Device;
+class Queue;
+class CommandPool;
+class CommandBuffer;
+class StagingBuffer;
+class Image;
+
+// UploadManager performs data uploads on a separate queue, so that copying large data does not stall frame recording.
+// Copies are collected during validation and sent in a single submission when a frame is drawn. Copies sharing source and
+// destination buffers are sent as a single vkCmdCopyBuffer call. Each waiter ( a surface ) registers itself in UploadManager
+// and receives semaphores that must be waited for before GPU uses uploaded data. Staging buffers are released when the submission
+// is finished, submission resources are released when frames waiting for them are finished.
+// When upload queue belongs to a different queue family than other queues on a device - buffers are created with concurrent sharing
+// mode ( see setSharingMode() ), while images are uploaded on queues used by surfaces ( see sharesQueueFamily() ).
+// Upload submissions do not wait for frames in flight, so only objects not read by GPU are sent to UploadManager : buffers and images
+// not used by rendering yet ( freshly created ones ) and buffer copies used by a single frame in flight, because the frame that used
+// such copy previously is finished before validation starts ( see MemoryBuffer::isCopyIdle() ). Buffers shared between queue families
+// use concurrent sharing mode, so they need no queue family ownership transfer. Other updates are performed on the queue of the surface.
+class PUMEX_EXPORT UploadManager
+{
+public:
+  UploadManager()                                = delete;
+  explicit UploadManager(Device* device, std::shared_ptr<Queue> queue, const std::vector<uint32_t>& deviceQueueFamilies);
+  UploadManager(const UploadManager&)            = delete;
+  UploadManager& operator=(const UploadManager&) = delete;
+  UploadManager(UploadManager&&)                 = delete;
+  UploadManager& operator=(UploadManager&&)      = delete;
+  ~UploadManager();
+
+  void                     copyBuffer(std::shared_ptr<StagingBuffer> stagingBuffer, VkBuffer dstBuffer, const std::vector<VkBufferCopy>& regions);
+  void                     copyBufferToImage(std::shared_ptr<StagingBuffer> stagingBuffer, std::shared_ptr<Image> image, VkImageAspectFlags aspectMask, const std::vector<VkBufferImageCopy>& regions);
+  // removes copies not submitted yet that write to given range of a destination buffer. Must be called before the buffer is destroyed
+  void                     discardBufferCopies(VkBuffer dstBuffer, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+  bool                     hasPendingCopies(VkBuffer dstBuffer) const;
+
+  void                     registerWaiter(uint32_t waiterID);
+  void                     unregisterWaiter(uint32_t waiterID);
+  // submits all pending copies and returns all semaphores that waiter did not wait for yet
+  std::vector<VkSemaphore> submit(uint32_t waiterID, uint64_t frameNumber);
+  void                     beginFrame(uint64_t frameNumber, uint64_t completedFrameNumber);
+
+  uint32_t                 getQueueFamilyIndex() const;
+  inline bool              sharesQueueFamily() const;
+  // sets concurrent sharing mode when upload queue family is different from families of other queues
+  void                     setSharingMode(VkBufferCreateInfo& bufferCreateInfo) const;
+protected:
+  struct ImageUpload
+  {
+    std::shared_ptr<Image>         image;
+    VkImageAspectFlags             aspectMask;
+    VkBuffer                       srcBuffer;
+    std::vector<VkBufferImageCopy> regions;
+  };
+  // copies in a copy group do not overlap, so that they may be sent in any order
+  typedef std::map<std::pair<VkBuffer, VkBuffer>, std::vector<VkBufferCopy>> CopyGroup;
+  struct Submission
+  {
+    std::shared_ptr<CommandBuffer>              commandBuffer;
+    VkFence                                     fence            = VK_NULL_HANDLE;
+    std::vector<VkSemaphore>                    semaphores;
+    std::vector<std::shared_ptr<StagingBuffer>> stagingBuffers;
+    std::vector<std::shared_ptr<Image>>         images;
+    uint64_t                                    lastWaitFrame    = 0;
+  };
+
+  Device*                                                 device;
+  std::shared_ptr<Queue>                                  queue;
+  std::shared_ptr<CommandPool>                            commandPool;
+  std::vector<uint32_t>                                   concurrentQueueFamilies;
+  mutable std::mutex                                      mutex;
+  std::vector<CopyGroup>                                  pendingCopies;
+  std::vector<ImageUpload>                                pendingImageUploads;
+  std::vector<std::shared_ptr<StagingBuffer>>             pendingStagingBuffers;
+  std::list<Submission>                                   submissions;
+  std::unordered_map<uint32_t, std::vector<VkSemaphore>>  waiterSemaphores;
+  uint64_t                                                completedFrameNumber = 0;
+
+  void releaseSubmissions();
+};
+
+bool UploadManager::sharesQueueFamily() const { return concurrentQueueFamilies.empty(); }
+
+}
@@ -48,16 +48,19 @@ class  Window;
 struct SurfaceTraits;
 class  Surface;
 class  TimeStatistics;
+class  DeviceMemoryAllocator;
 struct InputEvent;
 class  InputEventHandler;
 
 const uint32_t TSV_STAT_UPDATE                = 1;
 const uint32_t TSV_STAT_RENDER                = 2;
 const uint32_t TSV_STAT_RENDER_EVENTS         = 4;
+const uint32_t TSV_STAT_MEMORY                = 8;
 
 const uint32_t TSV_GROUP_UPDATE                = 1;
 const uint32_t TSV_GROUP_RENDER                = 2;
 const uint32_t TSV_GROUP_RENDER_EVENTS         = 3;
+const uint32_t TSV_GROUP_MEMORY                = 16; // each allocator added by Viewer::addMemoryStatistics() has its own group
 
 const uint32_t TSV_CHANNEL_INPUTEVENTS         = 1;
 const uint32_t TSV_CHANNEL_UPDATE              = 2;
@@ -65,6 +68,7 @@ const uint32_t TSV_CHANNEL_RENDER              = 3;
 const uint32_t TSV_CHANNEL_FRAME               = 4;
 const uint32_t TSV_CHANNEL_EVENT_RENDER_START  = 5;
 const uint32_t TSV_CHANNEL_EVENT_RENDER_FINISH = 6;
+const uint32_t TSV_CHANNEL_MEMORY              = 100; // allocator channels start at TSV_CHANNEL_MEMORY + 10 * allocator index
 
 
 // struct storing all info required to create or describe the viewer
@@ -106,12 +110,16 @@ public:
   inline uint32_t            getNumDevices() const;
   inline uint32_t            getNumSurfaces() const;
 
+  // render start event is called after all surfaces waited for GPU to finish the previous frame that used their current frame in flight
   inline void                setEventRenderStart(std::function<void(Viewer*)> event);
   inline void                setEventRenderFinish(std::function<void(Viewer*)> event);
 
   void                       addInputEventHandler(std::shared_ptr<InputEventHandler> eventHandler);
   void                       removeInputEventHandler(std::shared_ptr<InputEventHandler> eventHandler);
 
+  // allocator statistics are sent to viewer time statistics after each frame ( see DMA_CHANNEL_* for channel list )
+  void                       addMemoryStatistics(std::shared_ptr<DeviceMemoryAllocator> allocator, const std::wstring& name);
+
   void                       run();
   void                       cleanup();
   inline bool                isRealized() const;
@@ -162,6 +170,7 @@ protected:
   uint32_t                   getNextUpdateSlot() const;
   inline void                doNothing() const;
 
+  void                       beginDeviceFrames();
   void                       onEventRenderStart();
   void                       onEventRenderFinish();
   void                       handleInputEvents();
@@ -176,6 +185,7 @@ protected:
   std::function<void(Viewer*)>                           eventRenderStart;
   std::function<void(Viewer*)>                           eventRenderFinish;
   std::vector<std::shared_ptr<InputEventHandler>>        inputEventHandlers;
+  std::vector<std::weak_ptr<DeviceMemoryAllocator>>      statisticsAllocators;
   bool                                                   realized                           = false;
   bool                                                   viewerTerminate                    = false;
   VkInstance                                             instance                           = VK_NULL_HANDLE;
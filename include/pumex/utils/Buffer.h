@@ -25,6 +25,7 @@
 #include <vector>
 #include <vulkan/vulkan.h>
 #include <pumex/Export.h>
+#include <pumex/DeviceMemoryAllocator.h>
 
 namespace pumex
 {
@@ -57,11 +58,16 @@ PUMEX_EXPORT VkDeviceSize createBuffers(Device* device, std::vector<NBufferMemor
 PUMEX_EXPORT void         destroyBuffers(Device* device, std::vector<NBufferMemory>& multiBuffer, VkDeviceMemory memory);
 PUMEX_EXPORT void         destroyBuffers(VkDevice device, std::vector<NBufferMemory>& multiBuffer, VkDeviceMemory memory);
 
+// Staging buffer is a persistently mapped, host visible buffer used to transfer data to device local memory
+// ( or from device memory when created with VK_BUFFER_USAGE_TRANSFER_DST_BIT usage - such buffers prefer host cached memory, which may be not coherent ).
+// It either owns its VkBuffer and memory ( dedicated staging buffer ), or describes a part of a StagingRing buffer starting at offset.
+// Copy commands must use offset as a source offset.
 class StagingBuffer
 {
 public:
   StagingBuffer()                                = delete;
-  explicit StagingBuffer(Device* device, VkDeviceSize size);
+  explicit StagingBuffer(Device* device, VkDeviceSize size, VkBufferUsageFlags usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+  explicit StagingBuffer(VkDevice device, VkBuffer buffer, VkDeviceMemory memory, VkDeviceSize allocationSize, VkDeviceSize nonCoherentAtomSize, VkDeviceSize offset, VkDeviceSize size, void* mappedMemory);
   StagingBuffer(const StagingBuffer&)            = delete;
   StagingBuffer& operator=(const StagingBuffer&) = delete;
   StagingBuffer(StagingBuffer&&)                 = delete;
@@ -72,25 +78,67 @@ public:
   inline VkDeviceSize bufferSize() const;
   inline bool         isReserved() const;
   inline void         setReserved(bool value);
+  inline bool         isRingAllocated() const;
 
-  // method that maps buffer memory, copies data and unmaps it
+  // method that copies data to buffer memory
   void  fillBuffer(const void* data, VkDeviceSize size);
-  // methods for user to copy data by himself
+  // methods for user to copy data by himself. Memory is mapped persistently, so unmapMemory() does nothing
   void* mapMemory(VkDeviceSize size);
   void  unmapMemory();
+  // makes data written by GPU visible to host. Does nothing when memory is host coherent
+  void  invalidateMemory(VkDeviceSize size);
 
 
-  VkBuffer       buffer     = VK_NULL_HANDLE;
+  VkBuffer       buffer       = VK_NULL_HANDLE;
+  VkDeviceSize   offset       = 0;
 protected:
-  VkDevice       device     = VK_NULL_HANDLE;
-  VkDeviceMemory memory     = VK_NULL_HANDLE;
-  VkDeviceSize   memorySize = 0;
-  bool           reserved   = false;
+  VkDevice       device              = VK_NULL_HANDLE;
+  VkDeviceMemory memory              = VK_NULL_HANDLE;
+  VkDeviceSize   memorySize          = 0;
+  VkDeviceSize   allocationSize      = 0;     // size of the whole VkDeviceMemory
+  VkDeviceSize   nonCoherentAtomSize = 0;     // 0 when memory is host coherent
+  void*          mappedMemory        = nullptr;
+  bool           reserved            = false;
+  bool           ringAllocated       = false; // memory belongs to StagingRing
 };
 
-VkDeviceSize StagingBuffer::bufferSize() const { return memorySize; }
-bool         StagingBuffer::isReserved() const { return reserved; }
+// StagingRing is a large, persistently mapped staging buffer. Staging buffers are suballocated from it in a ring manner,
+// so that allocation costs no Vulkan calls. Memory released by the user is reused when GPU finishes the frame in which memory
+// was released ( frames are tracked by Device::beginFrame() ). When the ring is full - allocate() returns nullptr.
+class StagingRing
+{
+public:
+  StagingRing()                              = delete;
+  explicit StagingRing(Device* device, VkDeviceSize size, VkBufferUsageFlags usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+  StagingRing(const StagingRing&)            = delete;
+  StagingRing& operator=(const StagingRing&) = delete;
+  StagingRing(StagingRing&&)                 = delete;
+  StagingRing& operator=(StagingRing&&)      = delete;
+  ~StagingRing();
+
+  std::shared_ptr<StagingBuffer> allocate(VkDeviceSize size);
+  void                           deallocate(const StagingBuffer& stagingBuffer);
+  void                           beginFrame(uint64_t frameNumber, uint64_t completedFrameNumber);
+
+  inline VkDeviceSize            getSize() const;
+protected:
+  VkDevice                       device              = VK_NULL_HANDLE;
+  VkBuffer                       buffer              = VK_NULL_HANDLE;
+  VkDeviceMemory                 memory              = VK_NULL_HANDLE;
+  VkDeviceSize                   size                = 0;
+  VkDeviceSize                   allocationSize      = 0;
+  VkDeviceSize                   nonCoherentAtomSize = 0;
+  VkDeviceSize                   alignment           = 16;
+  void*                          mappedMemory        = nullptr;
+  FrameRingAllocationStrategy    strategy;
+};
+
+VkDeviceSize StagingBuffer::bufferSize() const      { return memorySize; }
+bool         StagingBuffer::isReserved() const      { return reserved; }
 void         StagingBuffer::setReserved(bool value) { reserved = value; }
+bool         StagingBuffer::isRingAllocated() const { return ringAllocated; }
+
+VkDeviceSize StagingRing::getSize() const           { return size; }
 
 
 
@@ -0,0 +1,57 @@
+//
+// Copyright(c) 2017-2018 Paweł Księżopolski ( pumexx )
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+
+#pragma once
+#include <vector>
+#include <pumex/Export.h>
+#include <pumex/Asset.h>
+
+namespace pumex
+{
+
+// Functions that reorder geometry for faster rendering. They work on triangle lists only - other geometries are left untouched.
+// Use them on assets before registering them in AssetBuffer ( geometries created by methods from Shapes.h and geometries loaded
+// without aiProcess_ImproveCacheLocality flag benefit the most ).
+//
+// Vertex cache optimization uses Tipsify algorithm described in "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw"
+// by Sander, Nehab and Barczak. The same paper describes overdraw optimization : triangles are divided into clusters that are
+// sorted, so that clusters facing outwards from the center of the model are drawn first.
+// Vertex fetch optimization orders vertices in the order of their first use by indices.
+//
+// Results may be measured on CPU using calculateACMR() - the average number of vertex shader invocations per triangle
+// for a FIFO vertex cache of a given size ( 3.0 is the worst, values close to 0.5 are possible for large regular meshes ).
+
+PUMEX_EXPORT float calculateACMR(const Geometry& geometry, uint32_t cacheSize = 16);
+
+// reorders triangles for post transform vertex cache. Indices of first triangles in each cluster are stored in clusters ( if not null )
+PUMEX_EXPORT void  optimizeVertexCache(Geometry& geometry, uint32_t cacheSize = 16, std::vector<uint32_t>* clusters = nullptr);
+// splits clusters created by optimizeVertexCache() into smaller ones when it does not raise ACMR above threshold * ACMR of a cluster.
+// Then sorts clusters to reduce overdraw. Geometry must have Position in its semantic
+PUMEX_EXPORT void  optimizeOverdraw(Geometry& geometry, const std::vector<uint32_t>& clusters, uint32_t cacheSize = 16, float threshold = 1.05f);
+// reorders vertices in the order of their first use. Unused vertices are moved to the end of vertex list
+PUMEX_EXPORT void  optimizeVertexFetch(Geometry& geometry);
+
+// performs all optimizations above on all geometries of the asset
+PUMEX_EXPORT void  optimizeAsset(Asset& asset, uint32_t cacheSize = 16, float overdrawThreshold = 1.05f);
+
+}
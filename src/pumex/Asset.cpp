@@ -30,6 +30,9 @@
 #include <pumex/utils/Log.h>
 #include <pumex/utils/Buffer.h>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
+#include <cstring>
+#include <cmath>
 
 namespace pumex
 {
@@ -51,18 +54,45 @@ void Skeleton::refreshChildren()
 
 VkFormat VertexSemantic::getVertexFormat() const
 {
-  switch (size)
+  if (size < 1 || size > 4)
+    return VK_FORMAT_UNDEFINED;
+  // 8 and 16 bit formats with 3 components are rarely supported in vertex buffers - 4 component formats are used instead
+  static const VkFormat formats[][4] =
   {
-  case 1:
-    return VK_FORMAT_R32_SFLOAT;
-  case 2:
-    return VK_FORMAT_R32G32_SFLOAT;
-  case 3:
-    return VK_FORMAT_R32G32B32_SFLOAT;
-  case 4:
-    return VK_FORMAT_R32G32B32A32_SFLOAT;
+    { VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT,    VK_FORMAT_R32G32B32A32_SFLOAT }, // Float32
+    { VK_FORMAT_R16_SFLOAT, VK_FORMAT_R16G16_SFLOAT, VK_FORMAT_R16G16B16A16_SFLOAT, VK_FORMAT_R16G16B16A16_SFLOAT }, // Float16
+    { VK_FORMAT_R8_SNORM,   VK_FORMAT_R8G8_SNORM,    VK_FORMAT_R8G8B8A8_SNORM,      VK_FORMAT_R8G8B8A8_SNORM },      // SNorm8
+    { VK_FORMAT_R8_UNORM,   VK_FORMAT_R8G8_UNORM,    VK_FORMAT_R8G8B8A8_UNORM,      VK_FORMAT_R8G8B8A8_UNORM },      // UNorm8
+    { VK_FORMAT_R16_SNORM,  VK_FORMAT_R16G16_SNORM,  VK_FORMAT_R16G16B16A16_SNORM,  VK_FORMAT_R16G16B16A16_SNORM },  // SNorm16
+    { VK_FORMAT_R16_UNORM,  VK_FORMAT_R16G16_UNORM,  VK_FORMAT_R16G16B16A16_UNORM,  VK_FORMAT_R16G16B16A16_UNORM },  // UNorm16
+    { VK_FORMAT_R8_UINT,    VK_FORMAT_R8G8_UINT,     VK_FORMAT_R8G8B8A8_UINT,       VK_FORMAT_R8G8B8A8_UINT },       // UInt8
+    { VK_FORMAT_R16_UINT,   VK_FORMAT_R16G16_UINT,   VK_FORMAT_R16G16B16A16_UINT,   VK_FORMAT_R16G16B16A16_UINT }    // UInt16
+  };
+  switch (format)
+  {
+  case SNorm10_10_10_2:
+    return (size >= 3) ? VK_FORMAT_A2B10G10R10_SNORM_PACK32 : VK_FORMAT_UNDEFINED;
+  case OctahedralSNorm16:
+    return (size == 3) ? VK_FORMAT_R16G16_SNORM : VK_FORMAT_UNDEFINED;
+  default:
+    return formats[format][size - 1];
+  }
+}
+
+uint32_t VertexSemantic::getByteSize() const
+{
+  switch (format)
+  {
+  case Float32:
+    return size * sizeof(float);
+  case Float16:
+  case SNorm16:
+  case UNorm16:
+  case UInt16:
+    return (size <= 2) ? 4 : 8;
+  default: // 8 bit formats and formats packed in 32 bits
+    return 4;
   }
-  return VK_FORMAT_UNDEFINED;
 }
 
 uint32_t calcVertexSize(const std::vector<VertexSemantic>& layout)
@@ -73,6 +103,14 @@ uint32_t calcVertexSize(const std::vector<VertexSemantic>& layout)
   return result;
 }
 
+uint32_t calcVertexByteSize(const std::vector<VertexSemantic>& layout)
+{
+  uint32_t result = 0;
+  for (const auto& l : layout)
+    result += l.getByteSize();
+  return result;
+}
+
 uint32_t calcPrimitiveSize(VkPrimitiveTopology topology)
 {
   switch (topology)
@@ -346,18 +384,11 @@ glm::vec4 Material::getProperty(const std::string& name, glm::vec4 defaultValue)
     return defaultValue;
 }
 
-void copyAndConvertVertices(std::vector<float>& targetBuffer, const std::vector<VertexSemantic>& targetSemantic, const std::vector<float>& sourceBuffer, const std::vector<VertexSemantic>& sourceSemantic)
+// prepares values of a target vertex used when source vertex has no such values and indices of source values used by each target value
+static void prepareVertexConversion(const std::vector<VertexSemantic>& targetSemantic, const std::vector<VertexSemantic>& sourceSemantic, std::vector<float>& defaultValues, std::vector<uint32_t>& sourceValuesIndex)
 {
-  // check if semantics are the same ( fast path )
-  if (targetSemantic == sourceSemantic)
-  {
-    std::copy(begin(sourceBuffer), end(sourceBuffer), std::back_inserter(targetBuffer));
-    return;
-  }
-  // semantics are different - we need to do remapping
-  std::vector<float>    defaultValues( calcVertexSize(targetSemantic) );
-  std::vector<float>    targetValues( calcVertexSize(targetSemantic) );
-  std::vector<uint32_t> sourceValuesIndex( calcVertexSize(targetSemantic) );
+  defaultValues.resize(calcVertexSize(targetSemantic));
+  sourceValuesIndex.resize(calcVertexSize(targetSemantic));
 
   // setup default values
   std::fill(begin(defaultValues), end(defaultValues), 0.0f);
@@ -434,6 +465,22 @@ void copyAndConvertVertices(std::vector<float>& targetBuffer, const std::vector<
 
     offset += t.size;
   }
+}
+
+void copyAndConvertVertices(std::vector<float>& targetBuffer, const std::vector<VertexSemantic>& targetSemantic, const std::vector<float>& sourceBuffer, const std::vector<VertexSemantic>& sourceSemantic)
+{
+  // check if semantics are the same ( fast path )
+  if (targetSemantic == sourceSemantic)
+  {
+    std::copy(begin(sourceBuffer), end(sourceBuffer), std::back_inserter(targetBuffer));
+    return;
+  }
+  // semantics are different - we need to do remapping
+  std::vector<float>    defaultValues;
+  std::vector<uint32_t> sourceValuesIndex;
+  prepareVertexConversion(targetSemantic, sourceSemantic, defaultValues, sourceValuesIndex);
+  std::vector<float>    targetValues(defaultValues.size());
+
   uint32_t sourceVertexSize = calcVertexSize(sourceSemantic);
   for (uint32_t i = 0; i < sourceBuffer.size(); i += sourceVertexSize)
   {
@@ -447,6 +494,120 @@ void copyAndConvertVertices(std::vector<float>& targetBuffer, const std::vector<
   }
 }
 
+template<typename T>
+static inline void storeVertexValue(unsigned char* target, uint32_t index, T value)
+{
+  std::memcpy(target + index * sizeof(T), &value, sizeof(T));
+}
+
+// stores attribute values in a format defined by semantic. Padding components are left untouched
+static void packVertexAttribute(const VertexSemantic& semantic, const float* values, unsigned char* target)
+{
+  switch (semantic.format)
+  {
+  case VertexSemantic::Float32:
+    std::memcpy(target, values, semantic.size * sizeof(float));
+    break;
+  case VertexSemantic::Float16:
+    for (uint32_t i = 0; i < semantic.size; ++i)
+      storeVertexValue<uint16_t>(target, i, glm::packHalf1x16(values[i]));
+    break;
+  case VertexSemantic::SNorm8:
+    for (uint32_t i = 0; i < semantic.size; ++i)
+      storeVertexValue<uint8_t>(target, i, glm::packSnorm1x8(values[i]));
+    break;
+  case VertexSemantic::UNorm8:
+    for (uint32_t i = 0; i < semantic.size; ++i)
+      storeVertexValue<uint8_t>(target, i, glm::packUnorm1x8(values[i]));
+    break;
+  case VertexSemantic::SNorm16:
+    for (uint32_t i = 0; i < semantic.size; ++i)
+      storeVertexValue<uint16_t>(target, i, glm::packSnorm1x16(values[i]));
+    break;
+  case VertexSemantic::UNorm16:
+    for (uint32_t i = 0; i < semantic.size; ++i)
+      storeVertexValue<uint16_t>(target, i, glm::packUnorm1x16(values[i]));
+    break;
+  case VertexSemantic::UInt8:
+    for (uint32_t i = 0; i < semantic.size; ++i)
+      storeVertexValue<uint8_t>(target, i, static_cast<uint8_t>(glm::clamp(std::round(values[i]), 0.0f, 255.0f)));
+    break;
+  case VertexSemantic::UInt16:
+    for (uint32_t i = 0; i < semantic.size; ++i)
+      storeVertexValue<uint16_t>(target, i, static_cast<uint16_t>(glm::clamp(std::round(values[i]), 0.0f, 65535.0f)));
+    break;
+  case VertexSemantic::SNorm10_10_10_2:
+    storeVertexValue<uint32_t>(target, 0, glm::packSnorm3x10_1x2(glm::vec4(values[0], values[1], values[2], (semantic.size > 3) ? values[3] : 0.0f)));
+    break;
+  case VertexSemantic::OctahedralSNorm16:
+    storeVertexValue<uint32_t>(target, 0, glm::packSnorm2x16(encodeOctahedral(glm::vec3(values[0], values[1], values[2]))));
+    break;
+  }
+}
+
+void copyAndConvertVertices(std::vector<unsigned char>& targetBuffer, const std::vector<VertexSemantic>& targetSemantic, const std::vector<float>& sourceBuffer, const std::vector<VertexSemantic>& sourceSemantic)
+{
+  for (const auto& t : targetSemantic)
+    CHECK_LOG_THROW(t.getVertexFormat() == VK_FORMAT_UNDEFINED, "copyAndConvertVertices() : vertex semantic has wrong size for its format");
+  // check if semantics are the same and no quantization is necessary ( fast path )
+  if (targetSemantic == sourceSemantic && std::all_of(begin(targetSemantic), end(targetSemantic), [](const VertexSemantic& t) { return t.format == VertexSemantic::Float32; }))
+  {
+    const unsigned char* sourceData = reinterpret_cast<const unsigned char*>(sourceBuffer.data());
+    targetBuffer.insert(end(targetBuffer), sourceData, sourceData + sourceBuffer.size() * sizeof(float));
+    return;
+  }
+  std::vector<float>    defaultValues;
+  std::vector<uint32_t> sourceValuesIndex;
+  prepareVertexConversion(targetSemantic, sourceSemantic, defaultValues, sourceValuesIndex);
+  std::vector<float>    targetValues(defaultValues.size());
+
+  uint32_t sourceVertexSize     = calcVertexSize(sourceSemantic);
+  uint32_t targetVertexByteSize = calcVertexByteSize(targetSemantic);
+  size_t   targetOffset         = targetBuffer.size();
+  targetBuffer.resize(targetOffset + (sourceBuffer.size() / sourceVertexSize) * targetVertexByteSize, 0);
+  for (uint32_t i = 0; i < sourceBuffer.size(); i += sourceVertexSize, targetOffset += targetVertexByteSize)
+  {
+    targetValues = defaultValues;
+    for (uint32_t j = 0; j<sourceValuesIndex.size(); ++j)
+    {
+      if (sourceValuesIndex[j] != std::numeric_limits<uint32_t>::max())
+        targetValues[j] = sourceBuffer[i + sourceValuesIndex[j]];
+    }
+    uint32_t       valueOffset = 0;
+    unsigned char* target      = targetBuffer.data() + targetOffset;
+    for (const auto& t : targetSemantic)
+    {
+      packVertexAttribute(t, &targetValues[valueOffset], target);
+      valueOffset += t.size;
+      target      += t.getByteSize();
+    }
+  }
+}
+
+glm::vec2 encodeOctahedral(const glm::vec3& vector)
+{
+  float length = std::abs(vector.x) + std::abs(vector.y) + std::abs(vector.z);
+  if (length == 0.0f)
+    return glm::vec2(0.0f, 0.0f);
+  glm::vec3 n = vector / length;
+  if (n.z >= 0.0f)
+    return glm::vec2(n.x, n.y);
+  // lower hemisphere is folded over the diagonals
+  return glm::vec2((1.0f - std::abs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f), (1.0f - std::abs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f));
+}
+
+glm::vec3 decodeOctahedral(const glm::vec2& encoded)
+{
+  glm::vec3 n(encoded.x, encoded.y, 1.0f - std::abs(encoded.x) - std::abs(encoded.y));
+  if (n.z < 0.0f)
+  {
+    float x = n.x;
+    n.x = (1.0f - std::abs(n.y)) * (x >= 0.0f ? 1.0f : -1.0f);
+    n.y = (1.0f - std::abs(x))   * (n.y >= 0.0f ? 1.0f : -1.0f);
+  }
+  return glm::normalize(n);
+}
+
 void transformGeometry(const glm::mat4& matrix, Geometry& geometry)
 {
   VertexAccumulator acc(geometry.semantic);
@@ -23,6 +23,8 @@
 #include <pumex/AssetBuffer.h>
 #include <set>
 #include <iterator>
+#include <algorithm>
+#include <cstring>
 #include <pumex/Device.h>
 #include <pumex/Node.h>
 #include <pumex/PhysicalDevice.h>
@@ -114,6 +116,52 @@ std::vector<uint32_t> AssetBuffer::getRenderMasks() const
   return results;
 }
 
+// appends indices to an index buffer storing them as 16 or 32 bit values
+static void appendIndices(std::vector<unsigned char>& target, VkIndexType indexType, const std::vector<uint32_t>& indices)
+{
+  size_t offset = target.size();
+  if (indexType == VK_INDEX_TYPE_UINT16)
+  {
+    target.resize(offset + indices.size() * sizeof(uint16_t));
+    uint16_t* targetIndices = reinterpret_cast<uint16_t*>(target.data() + offset);
+    for (size_t i = 0; i < indices.size(); ++i)
+      targetIndices[i] = static_cast<uint16_t>(indices[i]);
+  }
+  else
+  {
+    target.resize(offset + indices.size() * sizeof(uint32_t));
+    std::memcpy(target.data() + offset, indices.data(), indices.size() * sizeof(uint32_t));
+  }
+}
+
+// when the number of elements did not change - only ranges of changed elements are sent to GPU
+template<typename T>
+void updateDefinitionBuffer(Buffer<std::vector<T>>& buffer, std::vector<T>& bufferData, const std::vector<T>& newData)
+{
+  if (bufferData.size() != newData.size())
+  {
+    bufferData = newData;
+    buffer.invalidateData();
+    return;
+  }
+  size_t rangeBegin = newData.size();
+  for (size_t i = 0; i <= newData.size(); ++i)
+  {
+    bool changed = (i < newData.size()) && std::memcmp(&bufferData[i], &newData[i], sizeof(T)) != 0;
+    if (changed)
+    {
+      bufferData[i] = newData[i];
+      if (rangeBegin == newData.size())
+        rangeBegin = i;
+    }
+    else if (rangeBegin != newData.size())
+    {
+      buffer.invalidateRange(rangeBegin * sizeof(T), (i - rangeBegin) * sizeof(T));
+      rangeBegin = newData.size();
+    }
+  }
+}
+
 bool AssetBuffer::validate(const RenderContext& renderContext)
 {
   std::lock_guard<std::mutex> lock(mutex);
@@ -152,6 +200,9 @@ bool AssetBuffer::validate(const RenderContext& renderContext)
       VkDeviceSize     indicesSoFar = 0;
       rmData.vertices->resize(0);
       rmData.indices->resize(0);
+      // index 0xFFFF is not used, because it means primitive restart
+      bool smallGeometries = std::all_of(begin(gd.second), end(gd.second), [this](const InternalGeometryDefinition& def) { return assets[def.assetIndex]->geometries[def.geometryIndex].getVertexCount() < 0xFFFF; });
+      rmData.indexType     = smallGeometries ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
 
       std::vector<AssetTypeDefinition>     assetTypes = typeDefinitions;
       std::vector<AssetLodDefinition>      assetLods;
@@ -181,8 +232,7 @@ bool AssetBuffer::validate(const RenderContext& renderContext)
               // copying vertices to a vertex buffer
               copyAndConvertVertices(*(rmData.vertices), requiredSemantic, assets[it->assetIndex]->geometries[it->geometryIndex].vertices, assets[it->assetIndex]->geometries[it->geometryIndex].semantic);
               // copying indices to an index buffer
-              const auto& indices = assets[it->assetIndex]->geometries[it->geometryIndex].indices;
-              std::copy(begin(indices), end(indices), std::back_inserter(*(rmData.indices)));
+              appendIndices(*(rmData.indices), rmData.indexType, assets[it->assetIndex]->geometries[it->geometryIndex].indices);
             }
             lodDef.geomSize = assetGeometries.size() - lodDef.geomFirst;
             assetLods.push_back(lodDef);
@@ -192,12 +242,9 @@ bool AssetBuffer::validate(const RenderContext& renderContext)
       }
       rmData.vertexBuffer->invalidateData();
       rmData.indexBuffer->invalidateData();
-      (*rmData.aTypes)    = assetTypes;
-      (*rmData.aLods)     = assetLods;
-      (*rmData.aGeomDefs) = assetGeometries;
-      rmData.typeBuffer->invalidateData();
-      rmData.lodBuffer->invalidateData();
-      rmData.geomBuffer->invalidateData();
+      updateDefinitionBuffer(*rmData.typeBuffer, *rmData.aTypes,    assetTypes);
+      updateDefinitionBuffer(*rmData.lodBuffer,  *rmData.aLods,     assetLods);
+      updateDefinitionBuffer(*rmData.geomBuffer, *rmData.aGeomDefs, assetGeometries);
     }
     result = true;
   }
@@ -221,9 +268,9 @@ void AssetBuffer::cmdBindVertexIndexBuffer(const RenderContext& renderContext, C
   }
   VkBuffer vBuffer = prmit->second.vertexBuffer->getHandleBuffer(renderContext);
   VkBuffer iBuffer = prmit->second.indexBuffer->getHandleBuffer(renderContext);
-  VkDeviceSize offsets = 0;
+  VkDeviceSize offsets = prmit->second.vertexBuffer->getBufferOffset(renderContext);
   vkCmdBindVertexBuffers(commandBuffer->getHandle(), vertexBinding, 1, &vBuffer, &offsets);
-  vkCmdBindIndexBuffer(commandBuffer->getHandle(), iBuffer, 0, VK_INDEX_TYPE_UINT32);
+  vkCmdBindIndexBuffer(commandBuffer->getHandle(), iBuffer, prmit->second.indexBuffer->getBufferOffset(renderContext), prmit->second.indexType);
 }
 
 void AssetBuffer::cmdDrawObject(const RenderContext& renderContext, CommandBuffer* commandBuffer, uint32_t renderMask, uint32_t typeID, uint32_t firstInstance, float distanceToViewer) const
@@ -263,16 +310,17 @@ void AssetBuffer::cmdDrawObjectsIndirect(const RenderContext& renderContext, Com
 {
   std::lock_guard<std::mutex> lock(mutex);
 
-  auto buffer = drawCommands->getHandleBuffer(renderContext);
+  auto buffer       = drawCommands->getHandleBuffer(renderContext);
+  auto bufferOffset = drawCommands->getBufferOffset(renderContext);
 
   uint32_t drawCount = drawCommands->getData()->size();
 
   if (renderContext.device->physical.lock()->features.multiDrawIndirect == 1)
-    commandBuffer->cmdDrawIndexedIndirect(buffer, 0, drawCount, sizeof(DrawIndexedIndirectCommand));
+    commandBuffer->cmdDrawIndexedIndirect(buffer, bufferOffset, drawCount, sizeof(DrawIndexedIndirectCommand));
   else
   {
     for (uint32_t i = 0; i < drawCount; ++i)
-      commandBuffer->cmdDrawIndexedIndirect(buffer, 0 + i * sizeof(DrawIndexedIndirectCommand), 1, sizeof(DrawIndexedIndirectCommand));
+      commandBuffer->cmdDrawIndexedIndirect(buffer, bufferOffset + i * sizeof(DrawIndexedIndirectCommand), 1, sizeof(DrawIndexedIndirectCommand));
   }
 }
 
@@ -300,6 +348,14 @@ std::shared_ptr<Buffer<std::vector<AssetGeometryDefinition>>> AssetBuffer::getGe
   return it->second.geomBuffer;
 }
 
+VkIndexType AssetBuffer::getIndexType(uint32_t renderMask) const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = perRenderMaskData.find(renderMask);
+  CHECK_LOG_THROW(it == end(perRenderMaskData), "AssetBuffer::getIndexType() attempting to get an index type for nonexisting render mask");
+  return it->second.indexType;
+}
+
 void AssetBuffer::prepareDrawCommands(uint32_t renderMask, std::vector<DrawIndexedIndirectCommand>& drawCommands, std::vector<uint32_t>& typeOfGeometry) const
 {
   drawCommands.resize(0);
@@ -359,10 +415,10 @@ void AssetBuffer::invalidateNodeOwners()
 
 AssetBuffer::PerRenderMaskData::PerRenderMaskData(std::shared_ptr<DeviceMemoryAllocator> bufferAllocator, std::shared_ptr<DeviceMemoryAllocator> vertexIndexAllocator)
 {
-  vertices     = std::make_shared<std::vector<float>>();
-  indices      = std::make_shared<std::vector<uint32_t>>();
-  vertexBuffer = std::make_shared<Buffer<std::vector<float>>>(vertices, vertexIndexAllocator, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, pbPerDevice, swForEachImage);
-  indexBuffer  = std::make_shared<Buffer<std::vector<uint32_t>>>(indices, vertexIndexAllocator, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, pbPerDevice, swForEachImage);
+  vertices     = std::make_shared<std::vector<unsigned char>>();
+  indices      = std::make_shared<std::vector<unsigned char>>();
+  vertexBuffer = std::make_shared<Buffer<std::vector<unsigned char>>>(vertices, vertexIndexAllocator, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, pbPerDevice, swForEachImage);
+  indexBuffer  = std::make_shared<Buffer<std::vector<unsigned char>>>(indices, vertexIndexAllocator, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, pbPerDevice, swForEachImage);
 
   aTypes       = std::make_shared<std::vector<AssetTypeDefinition>>();
   aLods        = std::make_shared<std::vector<AssetLodDefinition>>();
@@ -152,7 +152,7 @@ uint32_t AssetBufferFilterNode::getDrawCount(uint32_t renderMask)
 AssetBufferFilterNode::PerRenderMaskData::PerRenderMaskData(std::shared_ptr<DeviceMemoryAllocator> allocator)
 {
   drawIndexedIndirectCommands = std::make_shared<std::vector<DrawIndexedIndirectCommand>>();
-  drawIndexedIndirectBuffer   = std::make_shared<Buffer<std::vector<DrawIndexedIndirectCommand>>>(drawIndexedIndirectCommands, allocator, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, pbPerSurface, swForEachImage);
+  drawIndexedIndirectBuffer   = std::make_shared<Buffer<std::vector<DrawIndexedIndirectCommand>>>(drawIndexedIndirectCommands, allocator, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, pbPerSurface, swForEachImage);
   maxOutputObjects            = 0;
 }
 
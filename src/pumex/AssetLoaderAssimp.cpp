@@ -32,6 +32,11 @@ AssetLoaderAssimp::AssetLoaderAssimp()
 {
 }
 
+uint64_t AssetLoaderAssimp::getSettingsID() const
+{
+  return importFlags;
+}
+
 glm::mat4 toMat4( const aiMatrix4x4& matrix )
 {
   return glm::mat4
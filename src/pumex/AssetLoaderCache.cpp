@@ -0,0 +1,481 @@
+//
+// Copyright(c) 2017-2018 Paweł Księżopolski ( pumexx )
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+
+#include <pumex/AssetLoaderCache.h>
+#include <pumex/Viewer.h>
+#include <pumex/utils/Log.h>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+#include <cstdio>
+#include <thread>
+#if defined(_WIN32)
+  #include <windows.h>
+#elif defined(__linux__)
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <fcntl.h>
+  #include <unistd.h>
+#endif
+
+using namespace pumex;
+
+namespace pumex
+{
+
+const uint32_t ASSET_FILE_MAGIC = 0x46415850; // "PXAF"
+// arrays are aligned in a file, so that they may be copied directly from mapped memory
+const size_t   ASSET_FILE_ARRAY_ALIGNMENT = 16;
+
+// read only file mapped into memory
+class MappedAssetFile
+{
+public:
+  explicit MappedAssetFile(const std::string& fileName);
+  ~MappedAssetFile();
+
+  const unsigned char* data = nullptr;
+  size_t               size = 0;
+protected:
+#if defined(_WIN32)
+  HANDLE fileHandle    = INVALID_HANDLE_VALUE;
+  HANDLE mappingHandle = NULL;
+#endif
+};
+
+class AssetFileWriter
+{
+public:
+  explicit AssetFileWriter(std::ostream& s)
+    : stream(s)
+  {
+  }
+  void writeBytes(const void* data, size_t size)
+  {
+    stream.write(reinterpret_cast<const char*>(data), size);
+    position += size;
+  }
+  template<typename T>
+  void write(const T& value)
+  {
+    writeBytes(&value, sizeof(T));
+  }
+  void write(const std::string& value)
+  {
+    write<uint32_t>(value.size());
+    writeBytes(value.data(), value.size());
+  }
+  template<typename T>
+  void writeArray(const std::vector<T>& values)
+  {
+    write<uint32_t>(values.size());
+    const char zeros[ASSET_FILE_ARRAY_ALIGNMENT] = {};
+    writeBytes(zeros, (ASSET_FILE_ARRAY_ALIGNMENT - position % ASSET_FILE_ARRAY_ALIGNMENT) % ASSET_FILE_ARRAY_ALIGNMENT);
+    writeBytes(values.data(), values.size() * sizeof(T));
+  }
+  void writeNames(const std::vector<std::string>& names, const std::map<std::string, std::size_t>& invNames)
+  {
+    write<uint32_t>(names.size());
+    for (const auto& n : names)
+      write(n);
+    write<uint32_t>(invNames.size());
+    for (const auto& n : invNames)
+    {
+      write(n.first);
+      write<uint64_t>(n.second);
+    }
+  }
+protected:
+  std::ostream& stream;
+  size_t        position = 0;
+};
+
+class AssetFileReader
+{
+public:
+  AssetFileReader(const std::string& fn, const unsigned char* d, size_t s)
+    : fileName{ fn }, data{ d }, size{ s }
+  {
+  }
+  void readBytes(void* target, size_t byteCount)
+  {
+    CHECK_LOG_THROW(byteCount > size - position, "Asset file is damaged : " << fileName);
+    std::memcpy(target, data + position, byteCount);
+    position += byteCount;
+  }
+  template<typename T>
+  T read()
+  {
+    T value;
+    readBytes(&value, sizeof(T));
+    return value;
+  }
+  std::string readString()
+  {
+    uint32_t length = read<uint32_t>();
+    CHECK_LOG_THROW(length > size - position, "Asset file is damaged : " << fileName);
+    std::string result(reinterpret_cast<const char*>(data + position), length);
+    position += length;
+    return result;
+  }
+  // array elements are copied straight from the mapped file
+  template<typename T>
+  void readArray(std::vector<T>& values)
+  {
+    uint32_t count = read<uint32_t>();
+    position += (ASSET_FILE_ARRAY_ALIGNMENT - position % ASSET_FILE_ARRAY_ALIGNMENT) % ASSET_FILE_ARRAY_ALIGNMENT;
+    CHECK_LOG_THROW(position > size || count > (size - position) / sizeof(T), "Asset file is damaged : " << fileName);
+    const T* first = reinterpret_cast<const T*>(data + position);
+    values.assign(first, first + count);
+    position += count * sizeof(T);
+  }
+  void readNames(std::vector<std::string>& names, std::map<std::string, std::size_t>& invNames)
+  {
+    uint32_t nameCount = read<uint32_t>();
+    names.reserve(nameCount);
+    for (uint32_t i = 0; i < nameCount; ++i)
+      names.push_back(readString());
+    uint32_t invNameCount = read<uint32_t>();
+    for (uint32_t i = 0; i < invNameCount; ++i)
+    {
+      std::string name = readString();
+      invNames.insert({ name, read<uint64_t>() });
+    }
+  }
+protected:
+  std::string          fileName;
+  const unsigned char* data;
+  size_t               size;
+  size_t               position = 0;
+};
+
+}
+
+MappedAssetFile::MappedAssetFile(const std::string& fileName)
+{
+#if defined(_WIN32)
+  fileHandle = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+  if (fileHandle == INVALID_HANDLE_VALUE)
+    return;
+  LARGE_INTEGER fileSize;
+  if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0)
+    return;
+  mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (mappingHandle == NULL)
+    return;
+  const void* address = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+  if (address == nullptr)
+    return;
+  data = static_cast<const unsigned char*>(address);
+  size = static_cast<size_t>(fileSize.QuadPart);
+#elif defined(__linux__)
+  int fileDescriptor = open(fileName.c_str(), O_RDONLY);
+  if (fileDescriptor < 0)
+    return;
+  struct stat fileStat;
+  if (fstat(fileDescriptor, &fileStat) == 0 && fileStat.st_size > 0)
+  {
+    void* address = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+    if (address != MAP_FAILED)
+    {
+      madvise(address, fileStat.st_size, MADV_SEQUENTIAL);
+      data = static_cast<const unsigned char*>(address);
+      size = static_cast<size_t>(fileStat.st_size);
+    }
+  }
+  // mapping stays valid after the file is closed
+  close(fileDescriptor);
+#endif
+}
+
+MappedAssetFile::~MappedAssetFile()
+{
+#if defined(_WIN32)
+  if (data != nullptr)
+    UnmapViewOfFile(data);
+  if (mappingHandle != NULL)
+    CloseHandle(mappingHandle);
+  if (fileHandle != INVALID_HANDLE_VALUE)
+    CloseHandle(fileHandle);
+#elif defined(__linux__)
+  if (data != nullptr)
+    munmap(const_cast<unsigned char*>(data), size);
+#endif
+}
+
+// FNV-1a hash
+static uint64_t hashAssetBytes(uint64_t hash, const void* data, size_t size)
+{
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  for (size_t i = 0; i < size; ++i)
+    hash = (hash ^ bytes[i]) * 1099511628211ULL;
+  return hash;
+}
+
+AssetLoaderCache::AssetLoaderCache(std::shared_ptr<AssetLoader> l, const std::string& cd)
+  : loader{ l }, cacheDirectory{ cd }
+{
+  CHECK_LOG_THROW(loader == nullptr, "AssetLoaderCache : loader is not defined");
+}
+
+std::shared_ptr<Asset> AssetLoaderCache::load(std::shared_ptr<Viewer> viewer, const std::string& fileName, bool animationOnly, const std::vector<VertexSemantic>& requiredSemantic)
+{
+  auto fullFileName = viewer->getAbsoluteFilePath(fileName);
+  CHECK_LOG_THROW(fullFileName.empty(), "Cannot find model file " << fileName);
+  std::string cacheFileName = getCacheFileName(fullFileName, animationOnly, requiredSemantic);
+  // source file cannot be memory mapped ( platforms other than Windows and Linux ) - cache is not used
+  if (cacheFileName.empty())
+    return loader->load(viewer, fileName, animationOnly, requiredSemantic);
+
+  std::shared_ptr<Asset> asset;
+  try
+  {
+    asset = readAssetFile(cacheFileName);
+  }
+  catch (const std::exception& e)
+  {
+    // damaged file will be written again
+    LOG_WARNING << e.what() << std::endl;
+  }
+  if (asset != nullptr)
+  {
+    asset->fileName = fileName;
+    return asset;
+  }
+
+  asset = loader->load(viewer, fileName, animationOnly, requiredSemantic);
+  // asset is loaded, so there's no reason to stop the application when it cannot be written to cache
+  try
+  {
+    std::error_code ec;
+    filesystem::create_directories(filesystem::path(cacheDirectory), ec);
+    writeAssetFile(*asset, cacheFileName);
+  }
+  catch (const std::exception& e)
+  {
+    LOG_WARNING << e.what() << std::endl;
+  }
+  return asset;
+}
+
+uint64_t AssetLoaderCache::getSettingsID() const
+{
+  return loader->getSettingsID();
+}
+
+std::string AssetLoaderCache::getCacheFileName(const std::string& fullFileName, bool animationOnly, const std::vector<VertexSemantic>& requiredSemantic) const
+{
+  MappedAssetFile sourceFile(fullFileName);
+  if (sourceFile.data == nullptr)
+    return std::string();
+
+  uint64_t hash     = 14695981039346656037ULL;
+  hash              = hashAssetBytes(hash, sourceFile.data, sourceFile.size);
+  uint32_t version  = ASSET_FILE_VERSION;
+  hash              = hashAssetBytes(hash, &version, sizeof(uint32_t));
+  uint32_t animOnly = animationOnly ? 1 : 0;
+  hash              = hashAssetBytes(hash, &animOnly, sizeof(uint32_t));
+  for (const auto& s : requiredSemantic)
+  {
+    uint32_t semanticData[] = { static_cast<uint32_t>(s.type), s.size, static_cast<uint32_t>(s.format) };
+    hash = hashAssetBytes(hash, semanticData, sizeof(semanticData));
+  }
+  uint64_t settingsID = getSettingsID();
+  hash                = hashAssetBytes(hash, &settingsID, sizeof(uint64_t));
+
+  std::ostringstream stream;
+  stream << filesystem::path(fullFileName).stem().string() << "_" << std::hex << std::setw(16) << std::setfill('0') << hash << ".pxa";
+  return (filesystem::path(cacheDirectory) / filesystem::path(stream.str())).string();
+}
+
+void pumex::writeAssetFile(const Asset& asset, const std::string& fileName)
+{
+  // file is written under temporary name, so that other processes never read partially written file. Name is unique for each thread, because
+  // the same asset may be loaded concurrently ( see AsyncAssetLoader )
+  std::ostringstream tempStream;
+  tempStream << fileName << "." << std::hex << std::hash<std::thread::id>()(std::this_thread::get_id()) << ".tmp";
+  std::string tempFileName = tempStream.str();
+  {
+    std::ofstream file(tempFileName, std::ios::out | std::ios::binary | std::ios::trunc);
+    CHECK_LOG_THROW(!file.is_open(), "Cannot create asset file : " << tempFileName);
+    AssetFileWriter writer(file);
+
+    writer.write<uint32_t>(ASSET_FILE_MAGIC);
+    writer.write<uint32_t>(ASSET_FILE_VERSION);
+    writer.write(asset.fileName);
+
+    writer.writeArray(asset.skeleton.bones);
+    writer.writeArray(asset.skeleton.children);
+    writer.write(asset.skeleton.invGlobalTransform);
+    writer.write(asset.skeleton.name);
+    writer.writeNames(asset.skeleton.boneNames, asset.skeleton.invBoneNames);
+
+    writer.write<uint32_t>(asset.geometries.size());
+    for (const auto& geometry : asset.geometries)
+    {
+      writer.write(geometry.name);
+      writer.write<uint32_t>(geometry.topology);
+      writer.write<uint32_t>(geometry.semantic.size());
+      for (const auto& s : geometry.semantic)
+      {
+        writer.write<uint32_t>(s.type);
+        writer.write<uint32_t>(s.size);
+        writer.write<uint32_t>(s.format);
+      }
+      writer.write<uint32_t>(geometry.materialIndex);
+      writer.write<uint32_t>(geometry.renderMask);
+      writer.writeArray(geometry.vertices);
+      writer.writeArray(geometry.indices);
+    }
+
+    writer.write<uint32_t>(asset.materials.size());
+    for (const auto& material : asset.materials)
+    {
+      writer.write(material.name);
+      writer.write<uint32_t>(material.textures.size());
+      for (const auto& t : material.textures)
+      {
+        writer.write<uint32_t>(t.first);
+        writer.write(t.second);
+      }
+      writer.write<uint32_t>(material.properties.size());
+      for (const auto& p : material.properties)
+      {
+        writer.write(p.first);
+        writer.write(p.second);
+      }
+    }
+
+    writer.write<uint32_t>(asset.animations.size());
+    for (const auto& animation : asset.animations)
+    {
+      writer.write(animation.name);
+      writer.write<uint32_t>(animation.channels.size());
+      for (const auto& channel : animation.channels)
+      {
+        writer.writeArray(channel.position);
+        writer.writeArray(channel.rotation);
+        writer.writeArray(channel.scale);
+        writer.write(channel.positionTimeBegin);
+        writer.write(channel.positionTimeEnd);
+        writer.write(channel.rotationTimeBegin);
+        writer.write(channel.rotationTimeEnd);
+        writer.write(channel.scaleTimeBegin);
+        writer.write(channel.scaleTimeEnd);
+      }
+      writer.writeArray(std::vector<uint32_t>(begin(animation.channelBefore), end(animation.channelBefore)));
+      writer.writeArray(std::vector<uint32_t>(begin(animation.channelAfter), end(animation.channelAfter)));
+      writer.writeNames(animation.channelNames, animation.invChannelNames);
+    }
+    CHECK_LOG_THROW(!file.good(), "Cannot write asset file : " << tempFileName);
+  }
+  std::remove(fileName.c_str());
+  CHECK_LOG_THROW(std::rename(tempFileName.c_str(), fileName.c_str()) != 0, "Cannot rename asset file " << tempFileName << " to " << fileName);
+}
+
+std::shared_ptr<Asset> pumex::readAssetFile(const std::string& fileName)
+{
+  MappedAssetFile file(fileName);
+  if (file.data == nullptr)
+    return nullptr;
+  AssetFileReader reader(fileName, file.data, file.size);
+  if (reader.read<uint32_t>() != ASSET_FILE_MAGIC || reader.read<uint32_t>() != ASSET_FILE_VERSION)
+    return nullptr;
+
+  std::shared_ptr<Asset> asset = std::make_shared<Asset>();
+  asset->fileName = reader.readString();
+
+  reader.readArray(asset->skeleton.bones);
+  reader.readArray(asset->skeleton.children);
+  asset->skeleton.invGlobalTransform = reader.read<glm::mat4>();
+  asset->skeleton.name               = reader.readString();
+  reader.readNames(asset->skeleton.boneNames, asset->skeleton.invBoneNames);
+
+  asset->geometries.resize(reader.read<uint32_t>());
+  for (auto& geometry : asset->geometries)
+  {
+    geometry.name     = reader.readString();
+    geometry.topology = static_cast<VkPrimitiveTopology>(reader.read<uint32_t>());
+    uint32_t semanticCount = reader.read<uint32_t>();
+    for (uint32_t i = 0; i < semanticCount; ++i)
+    {
+      VertexSemantic::Type   type   = static_cast<VertexSemantic::Type>(reader.read<uint32_t>());
+      uint32_t               size   = reader.read<uint32_t>();
+      uint32_t               format = reader.read<uint32_t>();
+      // vertex conversion and attribute packing rely on these values
+      CHECK_LOG_THROW(size < 1 || size > 4 || format > VertexSemantic::OctahedralSNorm16, "Asset file is damaged : " << fileName);
+      geometry.semantic.push_back(VertexSemantic(type, size, static_cast<VertexSemantic::Format>(format)));
+    }
+    geometry.materialIndex = reader.read<uint32_t>();
+    geometry.renderMask    = reader.read<uint32_t>();
+    reader.readArray(geometry.vertices);
+    reader.readArray(geometry.indices);
+  }
+
+  asset->materials.resize(reader.read<uint32_t>());
+  for (auto& material : asset->materials)
+  {
+    material.name = reader.readString();
+    uint32_t textureCount = reader.read<uint32_t>();
+    for (uint32_t i = 0; i < textureCount; ++i)
+    {
+      uint32_t textureType = reader.read<uint32_t>();
+      material.textures.insert({ textureType, reader.readString() });
+    }
+    uint32_t propertyCount = reader.read<uint32_t>();
+    for (uint32_t i = 0; i < propertyCount; ++i)
+    {
+      std::string propertyName = reader.readString();
+      material.properties.insert({ propertyName, reader.read<glm::vec4>() });
+    }
+  }
+
+  asset->animations.resize(reader.read<uint32_t>());
+  for (auto& animation : asset->animations)
+  {
+    animation.name = reader.readString();
+    animation.channels.resize(reader.read<uint32_t>());
+    for (auto& channel : animation.channels)
+    {
+      reader.readArray(channel.position);
+      reader.readArray(channel.rotation);
+      reader.readArray(channel.scale);
+      channel.positionTimeBegin = reader.read<float>();
+      channel.positionTimeEnd   = reader.read<float>();
+      channel.rotationTimeBegin = reader.read<float>();
+      channel.rotationTimeEnd   = reader.read<float>();
+      channel.scaleTimeBegin    = reader.read<float>();
+      channel.scaleTimeEnd      = reader.read<float>();
+    }
+    std::vector<uint32_t> states;
+    reader.readArray(states);
+    for (auto s : states)
+      animation.channelBefore.push_back(static_cast<Animation::Channel::State>(s));
+    reader.readArray(states);
+    for (auto s : states)
+      animation.channelAfter.push_back(static_cast<Animation::Channel::State>(s));
+    reader.readNames(animation.channelNames, animation.invChannelNames);
+  }
+  return asset;
+}
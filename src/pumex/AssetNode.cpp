@@ -31,7 +31,7 @@ using namespace pumex;
 AssetNode::AssetNode(std::shared_ptr<Asset> asset, std::shared_ptr<DeviceMemoryAllocator> ba, uint32_t rm, uint32_t vb)
   : DrawNode(), renderMask{ rm }, vertexBinding{ vb }
 {
-  vertices     = std::make_shared<std::vector<float>>();
+  vertices     = std::make_shared<std::vector<unsigned char>>();
   indices      = std::make_shared<std::vector<uint32_t>>();
 
   VkDeviceSize vertexCount = 0;
@@ -45,7 +45,7 @@ AssetNode::AssetNode(std::shared_ptr<Asset> asset, std::shared_ptr<DeviceMemoryA
     vertexCount += asset->geometries[i].getVertexCount();
   }
 
-  vertexBuffer = std::make_shared<Buffer<std::vector<float>>>(vertices, ba, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, pbPerDevice, swOnce);
+  vertexBuffer = std::make_shared<Buffer<std::vector<unsigned char>>>(vertices, ba, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, pbPerDevice, swOnce);
   indexBuffer  = std::make_shared<Buffer<std::vector<uint32_t>>>(indices, ba, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, pbPerDevice, swOnce);
 }
 
@@ -67,8 +67,8 @@ void AssetNode::cmdDraw(const RenderContext& renderContext, CommandBuffer* comma
   commandBuffer->addSource(this);
   VkBuffer vBuffer = vertexBuffer->getHandleBuffer(renderContext);
   VkBuffer iBuffer = indexBuffer->getHandleBuffer(renderContext);
-  VkDeviceSize offsets = 0;
+  VkDeviceSize offsets = vertexBuffer->getBufferOffset(renderContext);
   vkCmdBindVertexBuffers(commandBuffer->getHandle(), vertexBinding, 1, &vBuffer, &offsets);
-  vkCmdBindIndexBuffer(commandBuffer->getHandle(), iBuffer, 0, VK_INDEX_TYPE_UINT32);
+  vkCmdBindIndexBuffer(commandBuffer->getHandle(), iBuffer, indexBuffer->getBufferOffset(renderContext), VK_INDEX_TYPE_UINT32);
   commandBuffer->cmdDrawIndexed(indices->size(), 1, 0, 0, 0);
 }
@@ -0,0 +1,76 @@
+//
+// Copyright(c) 2017-2018 Paweł Księżopolski ( pumexx )
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+
+#include <pumex/AsyncAssetLoader.h>
+#include <pumex/Viewer.h>
+#include <pumex/utils/Log.h>
+
+using namespace pumex;
+
+AsyncAssetLoader::AsyncAssetLoader(LoaderFactory lf, int mc)
+  : loaderFactory{ lf }, arena( mc ), loaders( lf )
+{
+  CHECK_LOG_THROW(!loaderFactory, "AsyncAssetLoader : loader factory is not defined");
+}
+
+AsyncAssetLoader::~AsyncAssetLoader()
+{
+  wait();
+}
+
+std::future<std::shared_ptr<Asset>> AsyncAssetLoader::load(std::shared_ptr<Viewer> viewer, const std::string& fileName, bool animationOnly, const std::vector<VertexSemantic>& requiredSemantic, LoadCallback callback)
+{
+  auto promise = std::make_shared<std::promise<std::shared_ptr<Asset>>>();
+  auto result  = promise->get_future();
+  arena.execute([&]
+  {
+    taskGroup.run([this, viewer, fileName, animationOnly, requiredSemantic, callback, promise]
+    {
+      try
+      {
+        std::shared_ptr<Asset> asset = loaders.local()->load(viewer, fileName, animationOnly, requiredSemantic);
+        if (callback)
+          callback(asset);
+        promise->set_value(asset);
+      }
+      catch (...)
+      {
+        promise->set_exception(std::current_exception());
+      }
+    });
+  });
+  return result;
+}
+
+std::vector<std::future<std::shared_ptr<Asset>>> AsyncAssetLoader::load(std::shared_ptr<Viewer> viewer, const std::vector<std::string>& fileNames, bool animationOnly, const std::vector<VertexSemantic>& requiredSemantic)
+{
+  std::vector<std::future<std::shared_ptr<Asset>>> results;
+  for (const auto& fileName : fileNames)
+    results.push_back(load(viewer, fileName, animationOnly, requiredSemantic));
+  return results;
+}
+
+void AsyncAssetLoader::wait()
+{
+  arena.execute([this] { taskGroup.wait(); });
+}
@@ -21,6 +21,7 @@
 //
 
 #include <pumex/Command.h>
+#include <algorithm>
 #include <pumex/RenderPass.h>
 #include <pumex/RenderContext.h>
 #include <pumex/FrameBuffer.h>
@@ -68,9 +69,10 @@ VkCommandPool CommandPool::getHandle(VkDevice device) const
   return pddit->second.commandPool;
 }
 
-CommandBuffer::CommandBuffer(VkCommandBufferLevel bf, Device* d, std::shared_ptr<CommandPool> cp, uint32_t cbc)
-  : bufferLevel{ bf }, commandPool{ cp }, device{ d->device }
+CommandBuffer::CommandBuffer(VkCommandBufferLevel bf, Device* d, std::shared_ptr<CommandPool> cp, uint32_t cc, uint32_t vc)
+  : bufferLevel{ bf }, commandPool{ cp }, device{ d->device }, copyCount{ cc }, variantCount{ vc }
 {
+  uint32_t cbc = copyCount * variantCount;
   commandBuffer.resize(cbc);
   VkCommandBufferAllocateInfo cmdBufAllocateInfo{};
     cmdBufAllocateInfo.sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -92,7 +94,10 @@ void CommandBuffer::invalidate(uint32_t index)
   if (index == std::numeric_limits<uint32_t>::max())
     std::fill(begin(valid), end(valid), false);
   else 
-    valid[index % commandBuffer.size()] = false;
+  {
+    for (uint32_t i = 0; i < variantCount; ++i)
+      valid[i * copyCount + index % copyCount] = false;
+  }
 }
 
 void CommandBuffer::addSource(CommandBufferSource* source)
@@ -226,21 +231,63 @@ void CommandBuffer::cmdPipelineBarrier(const RenderContext& renderContext, const
 
   for (const auto& b : barriers)
   {
+    uint32_t srcQueueFamilyIndex = b.srcQueueFamilyIndex;
+    uint32_t dstQueueFamilyIndex = b.dstQueueFamilyIndex;
+    VkImageLayout oldLayout      = b.oldLayout;
+    // ownership is returned at the end of each frame, so there is nothing to acquire until resource is used by a submitted frame
+    bool firstUse = false;
+    if (b.queueTransfer == MemoryObjectBarrier::qtReturnAcquire)
+    {
+      SwapChainImageBehaviour scib = (b.objectType == MemoryObject::moBuffer) ? b.memoryObject->asMemoryBuffer()->getSwapChainImageBehaviour() : b.memoryObject->asMemoryImage()->getSwapChainImageBehaviour();
+      firstUse = !renderContext.surface->isOwnershipReturned(b.memoryObject.get(), getActiveIndex(renderContext, scib));
+    }
+    if (firstUse)
+    {
+      srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      oldLayout           = VK_IMAGE_LAYOUT_UNDEFINED;
+    }
+    else if (b.queueTransfer != MemoryObjectBarrier::qtNone)
+    {
+      srcQueueFamilyIndex = renderContext.surface->queues[b.srcQueueFamilyIndex]->familyIndex;
+      dstQueueFamilyIndex = renderContext.surface->queues[b.dstQueueFamilyIndex]->familyIndex;
+      // both queues belong to the same family, so there's no ownership transfer. Layout transition is performed by acquire barrier only
+      if (srcQueueFamilyIndex == dstQueueFamilyIndex)
+      {
+        if (b.queueTransfer == MemoryObjectBarrier::qtRelease)
+          continue;
+        srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      }
+    }
     switch (b.objectType)
     {
     case MemoryObject::moBuffer:
     {
       std::shared_ptr<MemoryBuffer> memoryBuffer = std::dynamic_pointer_cast<MemoryBuffer>(b.memoryObject);
+      VkDeviceSize                  bufferOffset = memoryBuffer->getBufferOffset(renderContext);
       VkBufferMemoryBarrier bufferBarrier;
         bufferBarrier.sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
         bufferBarrier.pNext               = nullptr;
         bufferBarrier.srcAccessMask       = b.srcAccessMask;
         bufferBarrier.dstAccessMask       = b.dstAccessMask;
-        bufferBarrier.srcQueueFamilyIndex = b.srcQueueFamilyIndex;
-        bufferBarrier.dstQueueFamilyIndex = b.dstQueueFamilyIndex;
+        bufferBarrier.srcQueueFamilyIndex = srcQueueFamilyIndex;
+        bufferBarrier.dstQueueFamilyIndex = dstQueueFamilyIndex;
         bufferBarrier.buffer              = memoryBuffer->getHandleBuffer(renderContext);
-        bufferBarrier.offset              = b.bufferRange.offset;
+        bufferBarrier.offset              = bufferOffset + b.bufferRange.offset;
         bufferBarrier.size                = b.bufferRange.range;
+      // pooled buffer shares VkBuffer with other buffers - barrier must not reach beyond its own data
+      if (memoryBuffer->isPooledRC(renderContext))
+      {
+        VkDeviceSize dataSize    = memoryBuffer->getDataSizeRC(renderContext);
+        VkDeviceSize rangeOffset = std::min(b.bufferRange.offset, dataSize);
+        bufferBarrier.offset     = bufferOffset + rangeOffset;
+        if (b.bufferRange.range == VK_WHOLE_SIZE || rangeOffset + b.bufferRange.range > dataSize)
+          bufferBarrier.size = dataSize - rangeOffset;
+        // range lies entirely beyond the data - there is nothing to synchronize
+        if (bufferBarrier.size == 0)
+          break;
+      }
       bufferBarriers.emplace_back(bufferBarrier);
       break;
     }
@@ -252,9 +299,9 @@ void CommandBuffer::cmdPipelineBarrier(const RenderContext& renderContext, const
         imageBarrier.pNext               = nullptr;
         imageBarrier.srcAccessMask       = b.srcAccessMask;
         imageBarrier.dstAccessMask       = b.dstAccessMask;
-        imageBarrier.srcQueueFamilyIndex = b.srcQueueFamilyIndex;
-        imageBarrier.dstQueueFamilyIndex = b.dstQueueFamilyIndex;
-        imageBarrier.oldLayout           = b.oldLayout;
+        imageBarrier.srcQueueFamilyIndex = srcQueueFamilyIndex;
+        imageBarrier.dstQueueFamilyIndex = dstQueueFamilyIndex;
+        imageBarrier.oldLayout           = oldLayout;
         imageBarrier.newLayout           = b.newLayout;
         imageBarrier.image               = memoryImage->getImage(renderContext)->getHandleImage();
         imageBarrier.subresourceRange    = b.imageRange.getSubresource();
@@ -294,21 +341,23 @@ void CommandBuffer::cmdBindPipeline(const RenderContext& renderContext, Graphics
 void CommandBuffer::cmdBindDescriptorSets(const RenderContext& renderContext, PipelineLayout* pipelineLayout, uint32_t firstSet, const std::vector<DescriptorSet*> descriptorSets)
 {
   std::vector<VkDescriptorSet> descSets;
+  std::vector<uint32_t>        dynamicOffsets;
   for (auto& d : descriptorSets)
   {
     addSource(d);
     descSets.push_back(d->getHandle(renderContext));
+    d->getDynamicOffsets(renderContext, dynamicOffsets);
   }
-  // TODO : dynamic offset counts
-  vkCmdBindDescriptorSets(commandBuffer[activeIndex], renderContext.currentBindPoint, pipelineLayout->getHandle(device), firstSet, descSets.size(), descSets.data(), 0, nullptr);
+  vkCmdBindDescriptorSets(commandBuffer[activeIndex], renderContext.currentBindPoint, pipelineLayout->getHandle(device), firstSet, descSets.size(), descSets.data(), dynamicOffsets.size(), dynamicOffsets.data());
 }
 
 void CommandBuffer::cmdBindDescriptorSets(const RenderContext& renderContext, PipelineLayout* pipelineLayout, uint32_t firstSet, DescriptorSet* descriptorSet)
 {
   addSource(descriptorSet);
   VkDescriptorSet descSet = descriptorSet->getHandle(renderContext);
-  // TODO : dynamic offset counts
-  vkCmdBindDescriptorSets(commandBuffer[activeIndex], renderContext.currentBindPoint, pipelineLayout->getHandle(device), firstSet, 1, &descSet, 0, nullptr);
+  std::vector<uint32_t> dynamicOffsets;
+  descriptorSet->getDynamicOffsets(renderContext, dynamicOffsets);
+  vkCmdBindDescriptorSets(commandBuffer[activeIndex], renderContext.currentBindPoint, pipelineLayout->getHandle(device), firstSet, 1, &descSet, dynamicOffsets.size(), dynamicOffsets.data());
 }
 
 void CommandBuffer::cmdDraw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t vertexOffset, uint32_t firstInstance) const
@@ -336,6 +385,11 @@ void CommandBuffer::cmdCopyBufferToImage(VkBuffer srcBuffer, const Image& image,
   vkCmdCopyBufferToImage(commandBuffer[activeIndex], srcBuffer, image.getHandleImage(), dstImageLayout, regions.size(), regions.data());
 }
 
+void CommandBuffer::cmdCopyImage(const Image& srcImage, VkImageLayout srcImageLayout, const Image& dstImage, VkImageLayout dstImageLayout, const std::vector<VkImageCopy>& regions) const
+{
+  vkCmdCopyImage(commandBuffer[activeIndex], srcImage.getHandleImage(), srcImageLayout, dstImage.getHandleImage(), dstImageLayout, regions.size(), regions.data());
+}
+
 void CommandBuffer::cmdClearColorImage(const Image& image, VkImageLayout imageLayout, VkClearValue color, std::vector<VkImageSubresourceRange> subresourceRanges)
 {
   vkCmdClearColorImage(commandBuffer[activeIndex], image.getHandleImage(), imageLayout, &color.color, subresourceRanges.size(), subresourceRanges.data());
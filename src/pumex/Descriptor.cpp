@@ -94,7 +94,7 @@ DescriptorPool::~DescriptorPool()
 
     if (poolDefinitions[index].maxSets == 0)
     {
-      uint32_t poolSize = poolDefinitions[index].registeredDescriptorSets * renderContext.imageCount * renderContext.surface->viewer.lock()->getNumSurfaces();
+      uint32_t poolSize = poolDefinitions[index].registeredDescriptorSets * renderContext.activeCount * renderContext.surface->viewer.lock()->getNumSurfaces();
       std::vector<VkDescriptorPoolSize> poolSizes = poolDefinitions[index].layout->getDescriptorPoolSize(poolSize);
       VkDescriptorPoolCreateInfo descriptorPoolCI{};
         descriptorPoolCI.sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
@@ -271,6 +271,14 @@ void Descriptor::getDescriptorValues(const RenderContext& renderContext, std::ve
   }
 }
 
+void Descriptor::getDynamicOffsets(const RenderContext& renderContext, std::vector<uint32_t>& offsets) const
+{
+  if (descriptorType != VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC && descriptorType != VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC)
+    return;
+  for (auto& res : resources)
+    offsets.push_back(res->getDynamicOffset(renderContext));
+}
+
 DescriptorSet::DescriptorSet(std::shared_ptr<DescriptorPool> p, std::shared_ptr<DescriptorSetLayout> l)
   : pool{ p }, layout{ l }
 {
@@ -300,9 +308,9 @@ void DescriptorSet::validate( const RenderContext& renderContext )
 
   // now check if descriptor set is dirty
   std::lock_guard<std::mutex> lock(mutex);
-  if (renderContext.imageCount > activeCount)
+  if (renderContext.activeCount > activeCount)
   {
-    activeCount = renderContext.imageCount;
+    activeCount = renderContext.activeCount;
     for (auto& pdd : perObjectData)
       pdd.second.resize(activeCount);
   }
@@ -378,6 +386,17 @@ VkDescriptorSet DescriptorSet::getHandle(const RenderContext& renderContext) con
   return pddit->second.data[renderContext.activeIndex].descriptorSet;
 }
 
+void DescriptorSet::getDynamicOffsets(const RenderContext& renderContext, std::vector<uint32_t>& offsets) const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  std::vector<uint32_t> bindings;
+  for (const auto& d : descriptors)
+    bindings.push_back(d.first);
+  std::sort(begin(bindings), end(bindings));
+  for (auto binding : bindings)
+    descriptors.at(binding)->getDynamicOffsets(renderContext, offsets);
+}
+
 void DescriptorSet::invalidateOwners()
 {
   for (auto& n : nodeOwners)
@@ -22,10 +22,13 @@
 
 #include <pumex/Device.h>
 #include <iterator>
+#include <algorithm>
 #include <pumex/Viewer.h>
 #include <pumex/PhysicalDevice.h>
 #include <pumex/Command.h>
 #include <pumex/Descriptor.h>
+#include <pumex/DeviceMemoryAllocator.h>
+#include <pumex/UploadManager.h>
 #include <pumex/utils/Log.h>
 #include <pumex/utils/Buffer.h>
 
@@ -60,6 +63,10 @@ void Device::realize()
 
   auto physicalDevice = physical.lock();
 
+  // upload queue is requested together with queues requested by surfaces
+  for (const auto& queueTraits : uploadQueueTraits)
+    requestedQueues.push_back(queueTraits);
+
   // we have to assign queues to available queue families
   std::vector<std::vector<uint32_t>> matchingFamilies;
   for (const auto& queueTraits : requestedQueues)
@@ -162,14 +169,43 @@ void Device::realize()
 
   // create descriptor pool
   descriptorPool = std::make_shared<DescriptorPool>();
+
+  // upload queue is reserved before surfaces reserve their queues
+  if (!uploadQueueTraits.empty())
+  {
+    auto uploadQueue = getQueue(uploadQueueTraits[0], true);
+    CHECK_LOG_THROW(uploadQueue == nullptr, "Device cannot deliver upload queue");
+    std::vector<uint32_t> queueFamilies;
+    for (auto& q : queues)
+      queueFamilies.push_back(q->familyIndex);
+    uploadManager = std::make_shared<UploadManager>(this, uploadQueue, queueFamilies);
+  }
 }
 
 void Device::cleanup()
 {
   if (device != VK_NULL_HANDLE)
   {
-    stagingBuffers.clear();
+    uploadManager  = nullptr;
+    vkDeviceWaitIdle(device);
+    for (auto& relocations : submittedRelocations)
+      for (auto& releaseFunction : relocations.releaseFunctions)
+        releaseFunction();
+    submittedRelocations.clear();
+    pendingRelocations.clear();
+    releasedStagingBuffers.clear();
+    stagingRing    = nullptr;
     descriptorPool = nullptr;
+    {
+      std::lock_guard<std::mutex> lock(frameAllocatorMutex);
+      for (auto& a : frameAllocators)
+      {
+        auto allocator = a.lock();
+        if (allocator != nullptr)
+          allocator->releaseDevice(device);
+      }
+      frameAllocators.clear();
+    }
     vkDestroyDevice(device, nullptr);
     device = VK_NULL_HANDLE;
     queues.clear();
@@ -208,39 +244,117 @@ std::shared_ptr<DescriptorPool> Device::getDescriptorPool()
 
 std::shared_ptr<StagingBuffer> Device::acquireStagingBuffer(const void* data, VkDeviceSize size)
 {
-  // find smallest staging buffer that is able to transfer data
-  VkDeviceSize smallestSize = std::numeric_limits<VkDeviceSize>::max();
   std::shared_ptr<StagingBuffer> resultBuffer;
-
-  std::lock_guard<std::mutex> lock(stagingMutex);
-  for (auto it = begin(stagingBuffers); it != end(stagingBuffers); ++it)
   {
-    if ( (*it)->isReserved() || (*it)->bufferSize() < size)
-      continue;
-    if ((*it)->bufferSize() < smallestSize)
-    {
-      smallestSize = (*it)->bufferSize();
-      resultBuffer = *it;
-    }
+    std::lock_guard<std::mutex> lock(stagingMutex);
+    if (stagingRing == nullptr && stagingRingSize > 0)
+      stagingRing = std::make_shared<StagingRing>(this, stagingRingSize);
+    // oversized uploads would exhaust the ring
+    if (stagingRing != nullptr && size <= stagingRing->getSize() / 4)
+      resultBuffer = stagingRing->allocate(size);
   }
-  if (resultBuffer.get() == nullptr)
-  {
+  // staging buffer is dedicated when data is too large or when the ring is full
+  if (resultBuffer == nullptr)
     resultBuffer = std::make_shared<StagingBuffer>( this, size );
-    stagingBuffers.push_back(resultBuffer);
-  }
   resultBuffer->setReserved(true);
   if (data != nullptr)
   {
     resultBuffer->fillBuffer(data, size);
   }
   return resultBuffer;
-
 }
 
 void Device::releaseStagingBuffer(std::shared_ptr<StagingBuffer> buffer)
 {
   std::lock_guard<std::mutex> lock(stagingMutex);
   buffer->setReserved(false);
+  // GPU may still read from staging buffer, so its memory is not reused until current frame is finished
+  if (buffer->isRingAllocated())
+    stagingRing->deallocate(*buffer);
+  else
+    releasedStagingBuffers.push_back({ frameNumber, buffer });
+}
+
+void Device::addFrameAllocator(std::shared_ptr<DeviceMemoryAllocator> allocator)
+{
+  std::lock_guard<std::mutex> lock(frameAllocatorMutex);
+  frameAllocators.push_back(allocator);
+}
+
+void Device::recordRelocation(std::shared_ptr<CommandPool> commandPool, const std::function<void(CommandBuffer*)>& recordFunction, std::function<void()> releaseFunction)
+{
+  std::lock_guard<std::mutex> lock(relocationMutex);
+  auto& relocations = pendingRelocations[commandPool->queueFamilyIndex];
+  if (relocations.commandBuffer == nullptr)
+  {
+    relocations.commandBuffer = std::make_shared<CommandBuffer>(VK_COMMAND_BUFFER_LEVEL_PRIMARY, this, commandPool);
+    relocations.commandBuffer->cmdBegin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+  }
+  recordFunction(relocations.commandBuffer.get());
+  relocations.releaseFunctions.push_back(releaseFunction);
+}
+
+void Device::submitRelocations(uint32_t queueFamilyIndex, VkQueue queue)
+{
+  std::lock_guard<std::mutex> lock(relocationMutex);
+  auto it = pendingRelocations.find(queueFamilyIndex);
+  if (it == end(pendingRelocations))
+    return;
+  // relocated objects are used by commands submitted after relocation copies
+  PipelineBarrier copyBarrier(VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT);
+  it->second.commandBuffer->cmdPipelineBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, copyBarrier);
+  it->second.commandBuffer->cmdEnd();
+  {
+    std::lock_guard<std::mutex> submitLock(submitMutex);
+    it->second.commandBuffer->queueSubmit(queue);
+  }
+  it->second.frameNumber = frameNumber;
+  submittedRelocations.push_back(it->second);
+  pendingRelocations.erase(it);
+}
+
+void Device::beginFrame(uint64_t fn, uint64_t cfn, uint32_t fif)
+{
+  framesInFlight = fif;
+  // finished uploads return their staging buffers before the staging ring reclaims memory
+  if (uploadManager != nullptr)
+    uploadManager->beginFrame(fn, cfn);
+  {
+    std::lock_guard<std::mutex> lock(stagingMutex);
+    frameNumber          = fn;
+    completedFrameNumber = cfn;
+    if (stagingRing != nullptr)
+      stagingRing->beginFrame(frameNumber, completedFrameNumber);
+    releasedStagingBuffers.erase(std::remove_if(begin(releasedStagingBuffers), end(releasedStagingBuffers), [cfn](const std::pair<uint64_t, std::shared_ptr<StagingBuffer>>& sb) { return sb.first <= cfn; }), end(releasedStagingBuffers));
+  }
+  // old places of relocated objects are not used by GPU anymore
+  std::vector<Relocations> finishedRelocations;
+  {
+    std::lock_guard<std::mutex> lock(relocationMutex);
+    for (auto it = begin(submittedRelocations); it != end(submittedRelocations); )
+    {
+      if (it->frameNumber <= cfn)
+      {
+        finishedRelocations.push_back(*it);
+        it = submittedRelocations.erase(it);
+      }
+      else
+        ++it;
+    }
+  }
+  for (auto& relocations : finishedRelocations)
+    for (auto& releaseFunction : relocations.releaseFunctions)
+      releaseFunction();
+  std::vector<std::shared_ptr<DeviceMemoryAllocator>> allocators;
+  {
+    std::lock_guard<std::mutex> lock(frameAllocatorMutex);
+    frameAllocators.erase(std::remove_if(begin(frameAllocators), end(frameAllocators), [](std::weak_ptr<DeviceMemoryAllocator> a) { return a.expired(); }), end(frameAllocators));
+    for (auto& a : frameAllocators)
+      allocators.push_back(a.lock());
+  }
+  for (auto& allocator : allocators)
+    if (allocator != nullptr)
+      allocator->beginFrame(device, frameNumber, completedFrameNumber);
 }
 
 bool Device::deviceExtensionEnabled(const char* extensionName) const
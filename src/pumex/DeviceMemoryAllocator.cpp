@@ -21,20 +21,27 @@
 //
 
 #include <cstring>
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
+#include <cmath>
+#include <limits>
+#include <locale>
 #include <pumex/DeviceMemoryAllocator.h>
 #include <pumex/Device.h>
 #include <pumex/PhysicalDevice.h>
+#include <pumex/TimeStatistics.h>
 #include <pumex/utils/Log.h>
 
 using namespace pumex;
 
 DeviceMemoryBlock::DeviceMemoryBlock()
-  : memory{ VK_NULL_HANDLE }, realOffset{ 0 }, alignedOffset{ 0 }, realSize{ 0 }, alignedSize{ 0 }
+  : memory{ VK_NULL_HANDLE }, realOffset{ 0 }, alignedOffset{ 0 }, realSize{ 0 }, alignedSize{ 0 }, blockIndex{ 0 }, memoryTypeIndex{ 0 }, mappedMemory{ nullptr }, nonCoherentAtomSize{ 0 }
 {
 }
 
 DeviceMemoryBlock::DeviceMemoryBlock(VkDeviceMemory m, VkDeviceSize ro, VkDeviceSize ao, VkDeviceSize rs, VkDeviceSize as)
-  : memory{ m }, realOffset{ ro }, alignedOffset{ ao }, realSize{ rs }, alignedSize{ as }
+  : memory{ m }, realOffset{ ro }, alignedOffset{ ao }, realSize{ rs }, alignedSize{ as }, blockIndex{ 0 }, memoryTypeIndex{ 0 }, mappedMemory{ nullptr }, nonCoherentAtomSize{ 0 }
 {
 }
 
@@ -47,77 +54,828 @@ AllocationStrategy::~AllocationStrategy()
 {
 }
 
-DeviceMemoryAllocator::DeviceMemoryAllocator(VkMemoryPropertyFlags pf, VkDeviceSize s, EnumStrategy st)
-  : propertyFlags{ pf }, size{ s }
+void AllocationStrategy::beginFrame(uint64_t frameNumber, uint64_t completedFrameNumber)
 {
-  switch (st)
+}
+
+bool AllocationStrategy::hasPendingMemory() const
+{
+  return false;
+}
+
+void DeviceMemoryStatistics::accumulate(const DeviceMemoryStatistics& statistics)
+{
+  memoryBlockCount   += statistics.memoryBlockCount;
+  memorySize         += statistics.memorySize;
+  usedBytes          += statistics.usedBytes;
+  freeBytes          += statistics.freeBytes;
+  largestFreeBlock    = std::max(largestFreeBlock, statistics.largestFreeBlock);
+  freeBlockCount     += statistics.freeBlockCount;
+  allocationCount    += statistics.allocationCount;
+  totalAllocations   += statistics.totalAllocations;
+  totalDeallocations += statistics.totalDeallocations;
+  failedAllocations  += statistics.failedAllocations;
+  allocationRate     += statistics.allocationRate;
+  deallocationRate   += statistics.deallocationRate;
+}
+
+MemoryGrowthPolicy::MemoryGrowthPolicy()
+  : maxBlockCount{ 1 }, growthFactor{ 1.0f }, maxBlockSize{ 0 }, emptyBlockLifetime{ 0.0 }
+{
+}
+
+MemoryGrowthPolicy::MemoryGrowthPolicy(uint32_t mbc, float gf, VkDeviceSize mbs, double ebl)
+  : maxBlockCount{ mbc }, growthFactor{ gf }, maxBlockSize{ mbs }, emptyBlockLifetime{ ebl }
+{
+}
+
+// Per-thread cache of small blocks used by BUDDY strategy. Each thread has separate cache for each allocator and device.
+// Allocation counters are added to allocator statistics when cache is refilled or drained
+struct DeviceMemoryAllocator::ThreadCache
+{
+  ThreadCache(std::shared_ptr<DeviceMemoryAllocator> allocator, VkDevice device);
+  ~ThreadCache();
+
+  struct Bucket
   {
-  case FIRST_FIT: allocationStrategy = std::make_unique<FirstFitAllocationStrategy>(); break;
-  }
+    std::vector<DeviceMemoryBlock> blocks;
+    uint32_t                       memoryTypeIndex = 0;
+  };
+  std::weak_ptr<DeviceMemoryAllocator>           allocator;
+  uint64_t                                       allocatorID;
+  VkDevice                                       device;
+  uint64_t                                       perDeviceDataID = 0; // 0 means that cache does not store blocks yet
+  uint64_t                                       releasedDevices = 0; // value of DeviceMemoryAllocator::releasedDevices when perDeviceDataID was checked
+  std::array<Bucket, THREAD_CACHE_CLASS_COUNT>   buckets;    // bucket with index I stores blocks not smaller than MIN_BLOCK_SIZE << I
+  uint64_t                                       allocations   = 0;
+  uint64_t                                       deallocations = 0;
+};
+
+DeviceMemoryAllocator::ThreadCache::ThreadCache(std::shared_ptr<DeviceMemoryAllocator> a, VkDevice d)
+  : allocator{ a }, allocatorID{ a->allocatorID }, device{ d }
+{
+}
+
+// blocks return to allocator when thread ends
+DeviceMemoryAllocator::ThreadCache::~ThreadCache()
+{
+  auto alloc = allocator.lock();
+  if (alloc == nullptr)
+    return;
+  for (uint32_t i = 0; i < THREAD_CACHE_CLASS_COUNT; ++i)
+    alloc->drainThreadCache(*this, i, 0);
+}
+
+static uint32_t getThreadCacheClass(VkDeviceSize size)
+{
+  uint32_t classIndex = 0;
+  while ((BuddyAllocationStrategy::MIN_BLOCK_SIZE << classIndex) < size)
+    classIndex++;
+  return classIndex;
+}
+
+// unique identifiers of allocators and their per device data. Value 0 is never used
+static std::atomic<uint64_t> nextAllocatorID{ 1 };
+
+const uint64_t     DeviceMemoryAllocator::RELOCATION_TIMEOUT;
+const VkDeviceSize DeviceMemoryAllocator::THREAD_CACHE_MAX_BLOCK_SIZE;
+const VkDeviceSize DeviceMemoryAllocator::THREAD_CACHE_REFILL_SIZE;
+const VkDeviceSize DeviceMemoryAllocator::THREAD_CACHE_MAX_CACHED_SIZE;
+const uint32_t     DeviceMemoryAllocator::THREAD_CACHE_CLASS_COUNT;
+
+DeviceMemoryAllocator::DeviceMemoryAllocator(VkMemoryPropertyFlags pf, VkDeviceSize s, EnumStrategy st, const MemoryGrowthPolicy& gp)
+  : propertyFlags{ pf }, size{ s }, strategy{ st }, growthPolicy{ gp }, reservedRelocations{ 0 }, allocatorID{ nextAllocatorID++ }, releasedDevices{ 0 }
+{
+  CHECK_LOG_THROW(growthPolicy.maxBlockCount == 0, "DeviceMemoryAllocator : maxBlockCount must be greater than 0");
 }
 
 DeviceMemoryAllocator::~DeviceMemoryAllocator()
 {
   for (auto& pddit : perDeviceData)
-    vkFreeMemory(pddit.first, pddit.second.storageMemory, nullptr);
+    for (auto& memoryBlock : pddit.second.memoryBlocks)
+      if (memoryBlock.memory != VK_NULL_HANDLE)
+        vkFreeMemory(pddit.first, memoryBlock.memory, nullptr);
+}
+
+DeviceMemoryBlock DeviceMemoryAllocator::allocate(Device* device, VkMemoryRequirements memoryRequirements, bool relocatable)
+{
+  // small allocations are served from per-thread cache without locking the mutex. These allocations are never relocated
+  if (usesThreadCache(std::max(memoryRequirements.size, memoryRequirements.alignment)))
+  {
+    DeviceMemoryBlock block = allocateFromThreadCache(device, memoryRequirements);
+    if (block.alignedSize > 0)
+      return block;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex);
+  PerDeviceData& pdd = getPerDeviceData(device);
+  DeviceMemoryBlock block = allocateBlock(device, pdd, memoryRequirements);
+  if (block.alignedSize == 0)
+    pdd.failedAllocations++;
+  CHECK_LOG_THROW(block.alignedSize == 0, "memory allocation failed : " << memoryRequirements.size);
+  pdd.totalAllocations++;
+  // ring strategy does not reuse memory in place, so it's never defragmented
+  if (relocatable && strategy != RING && !usesThreadCache(block.alignedSize))
+    pdd.relocatables.insert({ AllocationKey(block.blockIndex, block.alignedOffset), Relocation{ memoryRequirements, DeviceMemoryBlock(), 0 } });
+  releaseEmptyBlocks(device->device, pdd);
+  return block;
+}
+
+void DeviceMemoryAllocator::deallocate(VkDevice device, const DeviceMemoryBlock& block)
+{
+  if (usesThreadCache(block.alignedSize) && deallocateToThreadCache(device, block))
+    return;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  auto pddit = perDeviceData.find(device);
+  // memory of released device was already freed
+  if (pddit == end(perDeviceData))
+    return;
+  CHECK_LOG_THROW(block.blockIndex >= pddit->second.memoryBlocks.size() || pddit->second.memoryBlocks[block.blockIndex].memory != block.memory, "Cannot deallocate memory - block does not belong to this allocator");
+  // memory reserved for relocation is not needed anymore
+  auto rit = pddit->second.relocatables.find(AllocationKey(block.blockIndex, block.alignedOffset));
+  if (rit != end(pddit->second.relocatables))
+  {
+    if (rit->second.targetBlock.alignedSize > 0)
+    {
+      deallocateInMemoryBlock(pddit->second, rit->second.targetBlock);
+      reservedRelocations--;
+    }
+    pddit->second.relocatables.erase(rit);
+  }
+  deallocateInMemoryBlock(pddit->second, block);
+  pddit->second.totalDeallocations++;
+  pddit->second.defragmentationNeeded = true;
+  releaseEmptyBlocks(device, pddit->second);
 }
 
-DeviceMemoryBlock DeviceMemoryAllocator::allocate(Device* device, VkMemoryRequirements memoryRequirements)
+void DeviceMemoryAllocator::releaseEmptyBlocks()
 {
   std::lock_guard<std::mutex> lock(mutex);
+  for (auto& pdd : perDeviceData)
+    releaseEmptyBlocks(pdd.first, pdd.second);
+}
+
+void DeviceMemoryAllocator::beginFrame(VkDevice device, uint64_t frameNumber, uint64_t completedFrameNumber)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  auto pddit = perDeviceData.find(device);
+  if (pddit == end(perDeviceData))
+    return;
+  pddit->second.frameNumber          = frameNumber;
+  pddit->second.completedFrameNumber = completedFrameNumber;
+  for (auto& memoryBlock : pddit->second.memoryBlocks)
+    if (memoryBlock.memory != VK_NULL_HANDLE)
+      memoryBlock.allocationStrategy->beginFrame(frameNumber, completedFrameNumber);
+  defragment(pddit->second);
+  releaseEmptyBlocks(device, pddit->second);
+  updateRates(pddit->second);
+}
+
+void DeviceMemoryAllocator::releaseDevice(VkDevice device)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  auto pddit = perDeviceData.find(device);
+  if (pddit == end(perDeviceData))
+    return;
+  for (auto& relocatable : pddit->second.relocatables)
+    if (relocatable.second.targetBlock.alignedSize > 0)
+      reservedRelocations--;
+  for (auto& memoryBlock : pddit->second.memoryBlocks)
+    if (memoryBlock.memory != VK_NULL_HANDLE)
+      vkFreeMemory(device, memoryBlock.memory, nullptr);
+  perDeviceData.erase(pddit);
+  // thread caches cannot be reached from here - each thread checks its caches during next allocation
+  releasedDevices++;
+}
+
+DeviceMemoryBlock DeviceMemoryAllocator::acquireRelocation(VkDevice device, const DeviceMemoryBlock& block)
+{
+  if (reservedRelocations == 0)
+    return DeviceMemoryBlock();
+  std::lock_guard<std::mutex> lock(mutex);
+  auto pddit = perDeviceData.find(device);
+  if (pddit == end(perDeviceData))
+    return DeviceMemoryBlock();
+  auto rit = pddit->second.relocatables.find(AllocationKey(block.blockIndex, block.alignedOffset));
+  if (rit == end(pddit->second.relocatables) || rit->second.targetBlock.alignedSize == 0)
+    return DeviceMemoryBlock();
+  // reserved memory becomes a relocatable allocation. Old block stays allocated until caller deallocates it
+  DeviceMemoryBlock    targetBlock        = rit->second.targetBlock;
+  VkMemoryRequirements memoryRequirements = rit->second.memoryRequirements;
+  pddit->second.relocatables.erase(rit);
+  pddit->second.relocatables.insert({ AllocationKey(targetBlock.blockIndex, targetBlock.alignedOffset), Relocation{ memoryRequirements, DeviceMemoryBlock(), 0 } });
+  reservedRelocations--;
+  return targetBlock;
+}
+
+DeviceMemoryStatistics DeviceMemoryAllocator::getStatistics(VkDevice device) const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  auto pddit = perDeviceData.find(device);
+  if (pddit == end(perDeviceData))
+    return DeviceMemoryStatistics();
+  return getStatistics(pddit->second);
+}
+
+DeviceMemoryStatistics DeviceMemoryAllocator::getStatistics() const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  DeviceMemoryStatistics result;
+  for (const auto& pdd : perDeviceData)
+    result.accumulate(getStatistics(pdd.second));
+  return result;
+}
+
+// JSON objects written by getStatisticsJSON() are built only by this class, so that strings are escaped and numbers are formatted in one place
+class JSONObjectWriter
+{
+public:
+  JSONObjectWriter()
+  {
+    // decimal separator must not depend on user locale
+    ostr.imbue(std::locale::classic());
+    ostr << std::setprecision(std::numeric_limits<double>::digits10);
+  }
+  JSONObjectWriter& addString(const std::string& key, const std::string& value)
+  {
+    writeKey(key);
+    writeString(value);
+    return *this;
+  }
+  JSONObjectWriter& addNumber(const std::string& key, uint64_t value)
+  {
+    writeKey(key);
+    ostr << value;
+    return *this;
+  }
+  JSONObjectWriter& addNumber(const std::string& key, double value)
+  {
+    writeKey(key);
+    // JSON has no representation for infinity and NaN
+    if (std::isfinite(value))
+      ostr << value;
+    else
+      ostr << "null";
+    return *this;
+  }
+  JSONObjectWriter& addArray(const std::string& key, const std::vector<std::string>& jsonValues)
+  {
+    writeKey(key);
+    ostr << "[";
+    for (size_t i = 0; i < jsonValues.size(); ++i)
+      ostr << (i == 0 ? " " : ", ") << jsonValues[i];
+    ostr << " ]";
+    return *this;
+  }
+  std::string str() const
+  {
+    return ostr.str() + (empty ? "{}" : " }");
+  }
+protected:
+  void writeKey(const std::string& key)
+  {
+    ostr << (empty ? "{ " : ", ");
+    empty = false;
+    writeString(key);
+    ostr << " : ";
+  }
+  void writeString(const std::string& value)
+  {
+    ostr << '"';
+    for (auto c : value)
+    {
+      switch (c)
+      {
+      case '"':  ostr << "\\\""; break;
+      case '\\': ostr << "\\\\"; break;
+      case '\b': ostr << "\\b"; break;
+      case '\f': ostr << "\\f"; break;
+      case '\n': ostr << "\\n"; break;
+      case '\r': ostr << "\\r"; break;
+      case '\t': ostr << "\\t"; break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20)
+          ostr << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c) << std::dec << std::setfill(' ');
+        else
+          ostr << c;
+        break;
+      }
+    }
+    ostr << '"';
+  }
+
+  std::ostringstream ostr;
+  bool               empty = true;
+};
+
+std::string DeviceMemoryAllocator::getStatisticsJSON() const
+{
+  const char* strategyNames[] = { "FIRST_FIT", "TLSF", "RING", "BUDDY" };
+  std::lock_guard<std::mutex> lock(mutex);
+  std::vector<std::string> devices;
+  for (const auto& pdd : perDeviceData)
+  {
+    DeviceMemoryStatistics stats = getStatistics(pdd.second);
+    std::ostringstream deviceName;
+    deviceName << pdd.first;
+    devices.push_back(JSONObjectWriter()
+      .addString("device",             deviceName.str())
+      .addNumber("memoryBlockCount",   static_cast<uint64_t>(stats.memoryBlockCount))
+      .addNumber("memorySize",         static_cast<uint64_t>(stats.memorySize))
+      .addNumber("usedBytes",          static_cast<uint64_t>(stats.usedBytes))
+      .addNumber("freeBytes",          static_cast<uint64_t>(stats.freeBytes))
+      .addNumber("pendingBytes",       static_cast<uint64_t>(stats.getPendingBytes()))
+      .addNumber("largestFreeBlock",   static_cast<uint64_t>(stats.largestFreeBlock))
+      .addNumber("freeBlockCount",     static_cast<uint64_t>(stats.freeBlockCount))
+      .addNumber("fragmentation",      stats.getFragmentation())
+      .addNumber("allocationCount",    static_cast<uint64_t>(stats.allocationCount))
+      .addNumber("totalAllocations",   stats.totalAllocations)
+      .addNumber("totalDeallocations", stats.totalDeallocations)
+      .addNumber("failedAllocations",  stats.failedAllocations)
+      .addNumber("allocationRate",     stats.allocationRate)
+      .addNumber("deallocationRate",   stats.deallocationRate)
+      .str());
+  }
+  return JSONObjectWriter()
+    .addString("strategy",      strategyNames[strategy])
+    .addNumber("propertyFlags", static_cast<uint64_t>(propertyFlags))
+    .addNumber("size",          static_cast<uint64_t>(size))
+    .addArray("devices",        devices)
+    .str();
+}
+
+void DeviceMemoryAllocator::registerTimeStatistics(TimeStatistics* timeStatistics, uint32_t groupID, uint32_t firstChannelID, const std::wstring& groupName) const
+{
+  timeStatistics->registerGroup(groupID, groupName);
+  timeStatistics->registerChannel(firstChannelID + DMA_CHANNEL_USED_BYTES,         groupID, L"used",        glm::vec4(0.8f, 0.1f, 0.1f, 0.5f), TimeStatisticsChannel::vtSize);
+  timeStatistics->registerChannel(firstChannelID + DMA_CHANNEL_FREE_BYTES,         groupID, L"free",        glm::vec4(0.1f, 0.8f, 0.1f, 0.5f), TimeStatisticsChannel::vtSize);
+  timeStatistics->registerChannel(firstChannelID + DMA_CHANNEL_LARGEST_FREE_BLOCK, groupID, L"largest",     glm::vec4(0.1f, 0.5f, 0.1f, 0.5f), TimeStatisticsChannel::vtSize);
+  timeStatistics->registerChannel(firstChannelID + DMA_CHANNEL_FREE_BLOCK_COUNT,   groupID, L"free blocks", glm::vec4(0.1f, 0.1f, 0.8f, 0.5f), TimeStatisticsChannel::vtCounter);
+  timeStatistics->registerChannel(firstChannelID + DMA_CHANNEL_ALLOCATION_COUNT,   groupID, L"allocations", glm::vec4(0.8f, 0.8f, 0.1f, 0.5f), TimeStatisticsChannel::vtCounter);
+  timeStatistics->registerChannel(firstChannelID + DMA_CHANNEL_ALLOCATION_RATE,    groupID, L"alloc/s",     glm::vec4(0.8f, 0.1f, 0.8f, 0.5f), TimeStatisticsChannel::vtCounter);
+  timeStatistics->registerChannel(firstChannelID + DMA_CHANNEL_DEALLOCATION_RATE,  groupID, L"dealloc/s",   glm::vec4(0.1f, 0.8f, 0.8f, 0.5f), TimeStatisticsChannel::vtCounter);
+}
+
+void DeviceMemoryAllocator::setTimeStatisticsValues(TimeStatistics* timeStatistics, uint32_t firstChannelID, double time) const
+{
+  DeviceMemoryStatistics stats = getStatistics();
+  timeStatistics->setValues(firstChannelID + DMA_CHANNEL_USED_BYTES,         time, static_cast<double>(stats.usedBytes));
+  timeStatistics->setValues(firstChannelID + DMA_CHANNEL_FREE_BYTES,         time, static_cast<double>(stats.freeBytes));
+  timeStatistics->setValues(firstChannelID + DMA_CHANNEL_LARGEST_FREE_BLOCK, time, static_cast<double>(stats.largestFreeBlock));
+  timeStatistics->setValues(firstChannelID + DMA_CHANNEL_FREE_BLOCK_COUNT,   time, static_cast<double>(stats.freeBlockCount));
+  timeStatistics->setValues(firstChannelID + DMA_CHANNEL_ALLOCATION_COUNT,   time, static_cast<double>(stats.allocationCount));
+  timeStatistics->setValues(firstChannelID + DMA_CHANNEL_ALLOCATION_RATE,    time, stats.allocationRate);
+  timeStatistics->setValues(firstChannelID + DMA_CHANNEL_DEALLOCATION_RATE,  time, stats.deallocationRate);
+}
+
+std::unique_ptr<AllocationStrategy> DeviceMemoryAllocator::createAllocationStrategy(VkDeviceSize blockSize) const
+{
+  switch (strategy)
+  {
+  case FIRST_FIT: return std::make_unique<FirstFitAllocationStrategy>(blockSize);
+  case TLSF:      return std::make_unique<TLSFAllocationStrategy>(blockSize);
+  case RING:      return std::make_unique<FrameRingAllocationStrategy>(blockSize);
+  case BUDDY:     return std::make_unique<BuddyAllocationStrategy>(blockSize);
+  }
+  return nullptr;
+}
+
+DeviceMemoryAllocator::PerDeviceData& DeviceMemoryAllocator::getPerDeviceData(Device* device)
+{
   auto pddit = perDeviceData.find(device->device);
   if (pddit == end(perDeviceData))
+  {
     pddit = perDeviceData.insert({ device->device, PerDeviceData() }).first;
-  if (pddit->second.storageMemory == VK_NULL_HANDLE)
+    // VkDevice handle may be reused after device is destroyed, so thread caches identify device data by this value
+    pddit->second.id = nextAllocatorID++;
+    // ring strategy and defragmentation must know when frames are finished
+    device->addFrameAllocator(shared_from_this());
+  }
+  return pddit->second;
+}
+
+// returns empty block when memory cannot be allocated
+DeviceMemoryBlock DeviceMemoryAllocator::allocateBlock(Device* device, PerDeviceData& pdd, VkMemoryRequirements memoryRequirements)
+{
+  // try to allocate memory in existing blocks first
+  DeviceMemoryBlock block;
+  uint32_t blockCount = 0;
+  for (uint32_t i = 0; i < pdd.memoryBlocks.size(); ++i)
+  {
+    if (pdd.memoryBlocks[i].memory == VK_NULL_HANDLE)
+      continue;
+    blockCount++;
+    block = allocateInMemoryBlock(pdd, i, memoryRequirements);
+    if (block.alignedSize > 0)
+      return block;
+  }
+  // add a new block if growth policy allows it. Allocation strategy may be unable to place the request in a block that is big enough to hold it
+  // ( e.g. buddy strategy splits the block into power of two parts ), so such block is replaced with a bigger one
+  if (blockCount < growthPolicy.maxBlockCount)
   {
-    VkMemoryAllocateInfo memAlloc{};
-      memAlloc.sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-      memAlloc.allocationSize  = size;
-      memAlloc.memoryTypeIndex = device->physical.lock()->getMemoryType(memoryRequirements.memoryTypeBits, propertyFlags);
-    VK_CHECK_LOG_THROW(vkAllocateMemory(device->device, &memAlloc, nullptr, &pddit->second.storageMemory), "Cannot allocate memory in DeviceMemoryAllocator");
-    pddit->second.freeBlocks.push_front(FreeBlock(0, size));
+    VkDeviceSize minimumSize = memoryRequirements.size + memoryRequirements.alignment;
+    while (true)
+    {
+      uint32_t blockIndex = createMemoryBlock(device, pdd, memoryRequirements, minimumSize);
+      block = allocateInMemoryBlock(pdd, blockIndex, memoryRequirements);
+      if (block.alignedSize > 0)
+        break;
+      auto& memoryBlock = pdd.memoryBlocks[blockIndex];
+      minimumSize = 2 * memoryBlock.size;
+      vkFreeMemory(device->device, memoryBlock.memory, nullptr);
+      memoryBlock.memory       = VK_NULL_HANDLE;
+      memoryBlock.mappedMemory = nullptr;
+      memoryBlock.allocationStrategy.reset();
+    }
   }
-  return allocationStrategy->allocate(pddit->second.storageMemory, pddit->second.freeBlocks, memoryRequirements);
+  return block;
 }
 
-void DeviceMemoryAllocator::deallocate(VkDevice device, const DeviceMemoryBlock& block)
+bool DeviceMemoryAllocator::usesThreadCache(VkDeviceSize blockSize) const
+{
+  return strategy == BUDDY && blockSize <= THREAD_CACHE_MAX_BLOCK_SIZE;
+}
+
+DeviceMemoryAllocator::ThreadCache& DeviceMemoryAllocator::getThreadCache(VkDevice device)
 {
+  static thread_local std::vector<std::unique_ptr<ThreadCache>> threadCaches;
+  ThreadCache* result = nullptr;
+  for (auto& cache : threadCaches)
+  {
+    if (cache->allocatorID == allocatorID && cache->device == device)
+    {
+      result = cache.get();
+      break;
+    }
+  }
+  if (result == nullptr)
+  {
+    // caches of destroyed allocators are removed
+    threadCaches.erase(std::remove_if(begin(threadCaches), end(threadCaches), [](const std::unique_ptr<ThreadCache>& cache) { return cache->allocator.expired(); }), end(threadCaches));
+    threadCaches.push_back(std::make_unique<ThreadCache>(shared_from_this(), device));
+    result = threadCaches.back().get();
+  }
+  else if (result->releasedDevices == releasedDevices)
+    return *result;
+
+  // new cache, or some device was released since last check
   std::lock_guard<std::mutex> lock(mutex);
   auto pddit = perDeviceData.find(device);
-  CHECK_LOG_THROW(pddit == end(perDeviceData), "Cannot deallocate memory - device memory was never allocated");
-  allocationStrategy->deallocate(pddit->second.freeBlocks, block);
+  validateThreadCache(*result, (pddit != end(perDeviceData)) ? &pddit->second : nullptr);
+  return *result;
 }
 
-void DeviceMemoryAllocator::copyToDeviceMemory(Device* device, VkDeviceSize offset, const void* data, VkDeviceSize size, VkMemoryMapFlags flags) 
+// cached blocks are forgotten when device data they were allocated from does not exist anymore. Mutex must be locked
+void DeviceMemoryAllocator::validateThreadCache(ThreadCache& cache, PerDeviceData* pdd)
 {
-  if (size == 0)
+  cache.releasedDevices = releasedDevices;
+  uint64_t id = (pdd != nullptr) ? pdd->id : 0;
+  if (cache.perDeviceDataID == id)
     return;
+  for (auto& bucket : cache.buckets)
+    bucket.blocks.clear();
+  cache.allocations     = 0;
+  cache.deallocations   = 0;
+  cache.perDeviceDataID = id;
+}
+
+// returns empty block when cache cannot serve the allocation
+DeviceMemoryBlock DeviceMemoryAllocator::allocateFromThreadCache(Device* device, VkMemoryRequirements memoryRequirements)
+{
+  ThreadCache& cache  = getThreadCache(device->device);
+  uint32_t classIndex = getThreadCacheClass(std::max(memoryRequirements.size, memoryRequirements.alignment));
+  auto& bucket        = cache.buckets[classIndex];
+  if (bucket.blocks.empty())
+    refillThreadCache(device, cache, classIndex, memoryRequirements.memoryTypeBits);
+  if (bucket.blocks.empty() || (memoryRequirements.memoryTypeBits & (1 << bucket.memoryTypeIndex)) == 0)
+    return DeviceMemoryBlock();
+  DeviceMemoryBlock block = bucket.blocks.back();
+  bucket.blocks.pop_back();
+  block.realSize = memoryRequirements.size;
+  cache.allocations++;
+  return block;
+}
+
+// returns false when block must be returned to allocation strategy
+bool DeviceMemoryAllocator::deallocateToThreadCache(VkDevice device, const DeviceMemoryBlock& block)
+{
+  ThreadCache& cache  = getThreadCache(device);
+  uint32_t classIndex = getThreadCacheClass(block.alignedSize);
+  auto& bucket        = cache.buckets[classIndex];
+  // cache created before device data is not bound to it until first refill
+  if (cache.perDeviceDataID == 0 || (!bucket.blocks.empty() && bucket.memoryTypeIndex != block.memoryTypeIndex))
+    return false;
+  bucket.memoryTypeIndex = block.memoryTypeIndex;
+  bucket.blocks.push_back(block);
+  cache.deallocations++;
+  if (bucket.blocks.size() * block.alignedSize > THREAD_CACHE_MAX_CACHED_SIZE)
+    drainThreadCache(cache, classIndex, THREAD_CACHE_REFILL_SIZE);
+  return true;
+}
+
+// allocates THREAD_CACHE_REFILL_SIZE bytes and splits them into blocks of the cache class
+void DeviceMemoryAllocator::refillThreadCache(Device* device, ThreadCache& cache, uint32_t classIndex, uint32_t memoryTypeBits)
+{
   std::lock_guard<std::mutex> lock(mutex);
-  auto pddit = perDeviceData.find(device->device);
-  CHECK_LOG_THROW(pddit == end(perDeviceData), "DeviceMemoryAllocator::copyToDeviceMemory() : cannot copy to memory that not have been allocated yet");
-  uint8_t *pData;
-  VK_CHECK_LOG_THROW(vkMapMemory(device->device, pddit->second.storageMemory, offset, size, 0, (void **)&pData), "Cannot map memory");
-  std::memcpy(pData, data, size);
-  vkUnmapMemory(device->device, pddit->second.storageMemory);
+  PerDeviceData& pdd = getPerDeviceData(device);
+  validateThreadCache(cache, &pdd);
+  pdd.totalAllocations   += cache.allocations;
+  pdd.totalDeallocations += cache.deallocations;
+  cache.allocations       = 0;
+  cache.deallocations     = 0;
+
+  DeviceMemoryBlock refillBlock = allocateBlock(device, pdd, VkMemoryRequirements{ THREAD_CACHE_REFILL_SIZE, THREAD_CACHE_REFILL_SIZE, memoryTypeBits });
+  if (refillBlock.alignedSize == 0)
+    return;
+  auto& memoryBlock = pdd.memoryBlocks[refillBlock.blockIndex];
+  // blocks in non-coherent memory must not be smaller than nonCoherentAtomSize
+  VkDeviceSize partSize = std::max(BuddyAllocationStrategy::MIN_BLOCK_SIZE << classIndex, memoryBlock.nonCoherentAtomSize);
+  std::vector<DeviceMemoryBlock> parts;
+  static_cast<BuddyAllocationStrategy*>(memoryBlock.allocationStrategy.get())->split(refillBlock, partSize, parts);
+  memoryBlock.allocationCount += parts.size() - 1;
+
+  // blocks with lower addresses are used first
+  auto& bucket           = cache.buckets[classIndex];
+  bucket.memoryTypeIndex = memoryBlock.memoryTypeIndex;
+  bucket.blocks.insert(end(bucket.blocks), parts.rbegin(), parts.rend());
 }
 
-void DeviceMemoryAllocator::bindBufferMemory(Device* device, VkBuffer buffer, VkDeviceSize offset)
+// returns cached blocks to allocation strategy, so that cache keeps at most keptSize bytes
+void DeviceMemoryAllocator::drainThreadCache(ThreadCache& cache, uint32_t classIndex, VkDeviceSize keptSize)
 {
   std::lock_guard<std::mutex> lock(mutex);
-  auto pddit = perDeviceData.find(device->device);
-  CHECK_LOG_THROW(pddit == end(perDeviceData), "DeviceMemoryAllocator::bindBufferMemory() : cannot bind memory that not have been allocated yet");
-  VK_CHECK_LOG_THROW(vkBindBufferMemory(device->device, buffer, pddit->second.storageMemory, offset), "Cannot bind memory to buffer");
+  auto pddit = perDeviceData.find(cache.device);
+  validateThreadCache(cache, (pddit != end(perDeviceData)) ? &pddit->second : nullptr);
+  if (pddit == end(perDeviceData))
+    return;
+  pddit->second.totalAllocations   += cache.allocations;
+  pddit->second.totalDeallocations += cache.deallocations;
+  cache.allocations                 = 0;
+  cache.deallocations               = 0;
+
+  auto& blocks = cache.buckets[classIndex].blocks;
+  VkDeviceSize cachedSize = 0;
+  auto it = blocks.rbegin();
+  for (; it != blocks.rend() && cachedSize + it->alignedSize <= keptSize; ++it)
+    cachedSize += it->alignedSize;
+  auto drainEnd = it.base();
+  for (auto dit = begin(blocks); dit != drainEnd; ++dit)
+    deallocateInMemoryBlock(pddit->second, *dit);
+  blocks.erase(begin(blocks), drainEnd);
+  releaseEmptyBlocks(cache.device, pddit->second);
+}
+
+void DeviceMemoryAllocator::copyToDeviceMemory(Device* device, const DeviceMemoryBlock& block, VkDeviceSize offset, const void* data, VkDeviceSize size, VkMemoryMapFlags flags) 
+{
+  if (size == 0)
+    return;
+  CHECK_LOG_THROW(block.mappedMemory == nullptr, "DeviceMemoryAllocator::copyToDeviceMemory() : memory is not host visible or was not allocated yet");
+  std::memcpy(static_cast<uint8_t*>(block.mappedMemory) + offset, data, size);
+  flushMappedMemory(device->device, block, offset, size);
+}
+
+void DeviceMemoryAllocator::flushMappedMemory(VkDevice device, const DeviceMemoryBlock& block, VkDeviceSize offset, VkDeviceSize size)
+{
+  if (block.nonCoherentAtomSize == 0 || size == 0)
+    return;
+  VkMappedMemoryRange memoryRange = getMappedMemoryRange(block, offset, size);
+  VK_CHECK_LOG_THROW(vkFlushMappedMemoryRanges(device, 1, &memoryRange), "Cannot flush mapped memory");
+}
+
+void DeviceMemoryAllocator::invalidateMappedMemory(VkDevice device, const DeviceMemoryBlock& block, VkDeviceSize offset, VkDeviceSize size)
+{
+  if (block.nonCoherentAtomSize == 0 || size == 0)
+    return;
+  VkMappedMemoryRange memoryRange = getMappedMemoryRange(block, offset, size);
+  VK_CHECK_LOG_THROW(vkInvalidateMappedMemoryRanges(device, 1, &memoryRange), "Cannot invalidate mapped memory");
+}
+
+void DeviceMemoryAllocator::bindBufferMemory(Device* device, VkBuffer buffer, const DeviceMemoryBlock& block)
+{
+  CHECK_LOG_THROW(block.memory == VK_NULL_HANDLE, "DeviceMemoryAllocator::bindBufferMemory() : cannot bind memory that not have been allocated yet");
+  VK_CHECK_LOG_THROW(vkBindBufferMemory(device->device, buffer, block.memory, block.alignedOffset), "Cannot bind memory to buffer");
 }
 
-FirstFitAllocationStrategy::FirstFitAllocationStrategy()
+uint32_t DeviceMemoryAllocator::createMemoryBlock(Device* device, PerDeviceData& pdd, VkMemoryRequirements memoryRequirements, VkDeviceSize minimumSize)
 {
+  // first block has size defined by user, next blocks grow according to growth policy. Each block is able to hold the memory it is created for
+  VkDeviceSize blockSize = (pdd.nextBlockSize == 0) ? size : pdd.nextBlockSize;
+  if (growthPolicy.maxBlockSize > 0)
+    blockSize = std::min(blockSize, growthPolicy.maxBlockSize);
+  blockSize = std::max(blockSize, minimumSize);
+  pdd.nextBlockSize = static_cast<VkDeviceSize>(blockSize * growthPolicy.growthFactor);
+
+  auto physicalDevice = device->physical.lock();
+  auto it = std::find_if(begin(pdd.memoryBlocks), end(pdd.memoryBlocks), [](const MemoryBlock& mb) { return mb.memory == VK_NULL_HANDLE; });
+  if (it == end(pdd.memoryBlocks))
+    it = pdd.memoryBlocks.insert(end(pdd.memoryBlocks), MemoryBlock());
+
+  VkMemoryAllocateInfo memAlloc{};
+    memAlloc.sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    memAlloc.allocationSize  = blockSize;
+    memAlloc.memoryTypeIndex = physicalDevice->getMemoryType(memoryRequirements.memoryTypeBits, propertyFlags);
+
+  // size of non-coherent memory is a multiple of nonCoherentAtomSize, so that flushed ranges never cross the end of memory
+  VkMemoryPropertyFlags typeFlags = physicalDevice->memoryProperties.memoryTypes[memAlloc.memoryTypeIndex].propertyFlags;
+  bool isVisible  = (typeFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+  bool isCoherent = (typeFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+  it->nonCoherentAtomSize = (isVisible && !isCoherent) ? std::max<VkDeviceSize>(physicalDevice->properties.limits.nonCoherentAtomSize, 1) : 0;
+  if (it->nonCoherentAtomSize > 0)
+    memAlloc.allocationSize = ((blockSize + it->nonCoherentAtomSize - 1) / it->nonCoherentAtomSize) * it->nonCoherentAtomSize;
+
+  VK_CHECK_LOG_THROW(vkAllocateMemory(device->device, &memAlloc, nullptr, &it->memory), "Cannot allocate memory in DeviceMemoryAllocator");
+  // host visible memory stays mapped for the whole lifetime of the block
+  it->mappedMemory = nullptr;
+  if (isVisible)
+    VK_CHECK_LOG_THROW(vkMapMemory(device->device, it->memory, 0, VK_WHOLE_SIZE, 0, &it->mappedMemory), "Cannot map memory in DeviceMemoryAllocator");
+  it->memoryTypeIndex    = memAlloc.memoryTypeIndex;
+  it->size               = memAlloc.allocationSize;
+  it->allocationStrategy = createAllocationStrategy(memAlloc.allocationSize);
+  it->allocationStrategy->beginFrame(pdd.frameNumber, pdd.completedFrameNumber);
+  it->allocationCount    = 0;
+  return std::distance(begin(pdd.memoryBlocks), it);
+}
+
+DeviceMemoryBlock DeviceMemoryAllocator::allocateInMemoryBlock(PerDeviceData& pdd, uint32_t blockIndex, VkMemoryRequirements memoryRequirements)
+{
+  auto& memoryBlock = pdd.memoryBlocks[blockIndex];
+  if ((memoryRequirements.memoryTypeBits & (1 << memoryBlock.memoryTypeIndex)) == 0)
+    return DeviceMemoryBlock();
+  DeviceMemoryBlock block = memoryBlock.allocationStrategy->allocate(memoryBlock.memory, getBlockRequirements(memoryBlock, memoryRequirements));
+  if (block.alignedSize == 0)
+    return block;
+  block.blockIndex      = blockIndex;
+  block.memoryTypeIndex = memoryBlock.memoryTypeIndex;
+  memoryBlock.allocationCount++;
+  pdd.usedBytes += block.alignedSize;
+  if (memoryBlock.mappedMemory != nullptr)
+    block.mappedMemory      = static_cast<uint8_t*>(memoryBlock.mappedMemory) + block.alignedOffset;
+  block.nonCoherentAtomSize = memoryBlock.nonCoherentAtomSize;
+  return block;
+}
+
+void DeviceMemoryAllocator::deallocateInMemoryBlock(PerDeviceData& pdd, const DeviceMemoryBlock& block)
+{
+  auto& memoryBlock = pdd.memoryBlocks[block.blockIndex];
+  memoryBlock.allocationStrategy->deallocate(block);
+  pdd.usedBytes -= block.alignedSize;
+  if (--memoryBlock.allocationCount == 0)
+    memoryBlock.emptySince = HPClock::now();
+}
+
+// Defragmentation pass starts from the end of memory and tries to find lower place for each relocatable allocation.
+// Allocations may only move to lower addresses, so the pass always ends. Next pass starts after memory is deallocated.
+void DeviceMemoryAllocator::defragment(PerDeviceData& pdd)
+{
+  // cancel relocations that were not acquired by their owners
+  for (auto& relocatable : pdd.relocatables)
+  {
+    Relocation& relocation = relocatable.second;
+    if (relocation.targetBlock.alignedSize > 0 && pdd.frameNumber > relocation.reservationFrame + RELOCATION_TIMEOUT)
+    {
+      deallocateInMemoryBlock(pdd, relocation.targetBlock);
+      relocation.targetBlock = DeviceMemoryBlock();
+      reservedRelocations--;
+    }
+  }
+  if (defragmentationBudget == 0 || !pdd.defragmentationNeeded)
+    return;
+
+  VkDeviceSize budget          = defragmentationBudget;
+  bool         budgetExhausted = false;
+  for (auto it = pdd.relocatables.rbegin(); it != pdd.relocatables.rend(); ++it)
+  {
+    Relocation& relocation = it->second;
+    if (relocation.targetBlock.alignedSize > 0)
+      continue;
+    // allocations larger than the whole budget are never moved
+    if (relocation.memoryRequirements.size > budget)
+    {
+      budgetExhausted |= relocation.memoryRequirements.size <= defragmentationBudget;
+      continue;
+    }
+    // allocation may be moved to a place with lower address only
+    DeviceMemoryBlock targetBlock;
+    for (uint32_t i = 0; i <= it->first.first && targetBlock.alignedSize == 0; ++i)
+      if (pdd.memoryBlocks[i].memory != VK_NULL_HANDLE)
+        targetBlock = allocateInMemoryBlock(pdd, i, relocation.memoryRequirements);
+    if (targetBlock.alignedSize == 0)
+      continue;
+    if (AllocationKey(targetBlock.blockIndex, targetBlock.alignedOffset) >= it->first)
+    {
+      deallocateInMemoryBlock(pdd, targetBlock);
+      continue;
+    }
+    relocation.targetBlock      = targetBlock;
+    relocation.reservationFrame = pdd.frameNumber;
+    budget                     -= relocation.memoryRequirements.size;
+    reservedRelocations++;
+  }
+  pdd.defragmentationNeeded = budgetExhausted;
+}
+
+DeviceMemoryStatistics DeviceMemoryAllocator::getStatistics(const PerDeviceData& pdd) const
+{
+  DeviceMemoryStatistics result;
+  for (const auto& memoryBlock : pdd.memoryBlocks)
+  {
+    if (memoryBlock.memory == VK_NULL_HANDLE)
+      continue;
+    result.memoryBlockCount++;
+    result.memorySize      += memoryBlock.size;
+    result.allocationCount += memoryBlock.allocationCount;
+    memoryBlock.allocationStrategy->collectFreeSpace(result);
+  }
+  result.usedBytes          = pdd.usedBytes;
+  result.totalAllocations   = pdd.totalAllocations;
+  result.totalDeallocations = pdd.totalDeallocations;
+  result.failedAllocations  = pdd.failedAllocations;
+  result.allocationRate     = pdd.allocationRate;
+  result.deallocationRate   = pdd.deallocationRate;
+  return result;
+}
+
+void DeviceMemoryAllocator::updateRates(PerDeviceData& pdd)
+{
+  auto now = HPClock::now();
+  if (pdd.frameTime != HPClock::time_point())
+  {
+    double duration = inSeconds(now - pdd.frameTime);
+    if (duration > 0.0)
+    {
+      pdd.allocationRate   = (pdd.totalAllocations - pdd.frameAllocations) / duration;
+      pdd.deallocationRate = (pdd.totalDeallocations - pdd.frameDeallocations) / duration;
+    }
+  }
+  pdd.frameTime          = now;
+  pdd.frameAllocations   = pdd.totalAllocations;
+  pdd.frameDeallocations = pdd.totalDeallocations;
+}
+
+// allocations in non-coherent memory must not share nonCoherentAtomSize ranges with other allocations
+VkMemoryRequirements DeviceMemoryAllocator::getBlockRequirements(const MemoryBlock& memoryBlock, VkMemoryRequirements memoryRequirements)
+{
+  if (memoryBlock.nonCoherentAtomSize > 0)
+  {
+    memoryRequirements.alignment = std::max(memoryRequirements.alignment, memoryBlock.nonCoherentAtomSize);
+    memoryRequirements.size      = ((memoryRequirements.size + memoryBlock.nonCoherentAtomSize - 1) / memoryBlock.nonCoherentAtomSize) * memoryBlock.nonCoherentAtomSize;
+  }
+  return memoryRequirements;
+}
+
+VkMappedMemoryRange DeviceMemoryAllocator::getMappedMemoryRange(const DeviceMemoryBlock& block, VkDeviceSize offset, VkDeviceSize size)
+{
+  VkDeviceSize atomSize = block.nonCoherentAtomSize;
+  if (size == VK_WHOLE_SIZE)
+    size = block.realSize - offset;
+  VkDeviceSize rangeBegin = ((block.alignedOffset + offset) / atomSize) * atomSize;
+  VkDeviceSize rangeEnd   = ((block.alignedOffset + offset + size + atomSize - 1) / atomSize) * atomSize;
+
+  VkMappedMemoryRange memoryRange{};
+    memoryRange.sType  = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+    memoryRange.memory = block.memory;
+    memoryRange.offset = rangeBegin;
+    memoryRange.size   = rangeEnd - rangeBegin;
+  return memoryRange;
+}
+
+// First block is never released. Only one empty block ( the one that became empty most recently ) is kept as a spare during emptyBlockLifetime,
+// so that allocations following deallocations do not create new blocks. Other empty blocks are released immediately
+void DeviceMemoryAllocator::releaseEmptyBlocks(VkDevice device, PerDeviceData& pdd)
+{
+  auto now = HPClock::now();
+  uint32_t spareBlock = 0;
+  for (uint32_t i = 1; i < pdd.memoryBlocks.size(); ++i)
+  {
+    auto& memoryBlock = pdd.memoryBlocks[i];
+    if (memoryBlock.memory == VK_NULL_HANDLE || memoryBlock.allocationCount > 0 || memoryBlock.allocationStrategy->hasPendingMemory() || inSeconds(now - memoryBlock.emptySince) >= growthPolicy.emptyBlockLifetime)
+      continue;
+    if (spareBlock == 0 || pdd.memoryBlocks[spareBlock].emptySince < memoryBlock.emptySince)
+      spareBlock = i;
+  }
+  for (uint32_t i = 1; i < pdd.memoryBlocks.size(); ++i)
+  {
+    auto& memoryBlock = pdd.memoryBlocks[i];
+    if (i == spareBlock || memoryBlock.memory == VK_NULL_HANDLE || memoryBlock.allocationCount > 0 || memoryBlock.allocationStrategy->hasPendingMemory())
+      continue;
+    vkFreeMemory(device, memoryBlock.memory, nullptr);
+    memoryBlock.memory       = VK_NULL_HANDLE;
+    memoryBlock.mappedMemory = nullptr;
+    memoryBlock.allocationStrategy.reset();
+  }
+}
+
+FirstFitAllocationStrategy::FirstFitAllocationStrategy(VkDeviceSize size)
+{
+  freeBlocks.push_front(FreeBlock(0, size));
 }
 
 FirstFitAllocationStrategy::~FirstFitAllocationStrategy()
 {
 }
 
-DeviceMemoryBlock FirstFitAllocationStrategy::allocate(VkDeviceMemory storageMemory, std::list<FreeBlock>& freeBlocks, VkMemoryRequirements memoryRequirements)
+DeviceMemoryBlock FirstFitAllocationStrategy::allocate(VkDeviceMemory storageMemory, VkMemoryRequirements memoryRequirements)
 {
   auto it = begin(freeBlocks);
   VkDeviceSize additionalSize;
@@ -128,7 +886,8 @@ DeviceMemoryBlock FirstFitAllocationStrategy::allocate(VkDeviceMemory storageMem
     if (it->size >= memoryRequirements.size + additionalSize)
       break;
   }
-  CHECK_LOG_THROW(it == end(freeBlocks), "memory allocation failed : " << memoryRequirements.size);
+  if (it == end(freeBlocks))
+    return DeviceMemoryBlock();
 
   DeviceMemoryBlock block(storageMemory, it->offset, it->offset + additionalSize, memoryRequirements.size, memoryRequirements.size + additionalSize);
   it->offset += memoryRequirements.size + additionalSize;
@@ -138,9 +897,10 @@ DeviceMemoryBlock FirstFitAllocationStrategy::allocate(VkDeviceMemory storageMem
   return block;
 }
 
-void FirstFitAllocationStrategy::deallocate(std::list<FreeBlock>& freeBlocks, const DeviceMemoryBlock& block)
+void FirstFitAllocationStrategy::deallocate(const DeviceMemoryBlock& block)
 {
-  FreeBlock fBlock(block.realOffset, block.realSize);
+  // alignedSize contains also the padding between realOffset and alignedOffset
+  FreeBlock fBlock(block.realOffset, block.alignedSize);
   if (freeBlocks.empty())
   {
     freeBlocks.push_back(fBlock);
@@ -187,3 +947,451 @@ void FirstFitAllocationStrategy::deallocate(std::list<FreeBlock>& freeBlocks, co
     freeBlocks.erase(nit);
   }
 }
+
+void FirstFitAllocationStrategy::collectFreeSpace(DeviceMemoryStatistics& statistics) const
+{
+  for (const auto& freeBlock : freeBlocks)
+  {
+    statistics.freeBytes        += freeBlock.size;
+    statistics.largestFreeBlock  = std::max(statistics.largestFreeBlock, freeBlock.size);
+    statistics.freeBlockCount++;
+  }
+}
+
+// index of the most significant bit set. Value must be greater than 0
+uint32_t tlsfFindLastSet(uint64_t value)
+{
+  uint32_t result = 0;
+  if (value & 0xFFFFFFFF00000000ull) { value >>= 32; result += 32; }
+  if (value & 0x00000000FFFF0000ull) { value >>= 16; result += 16; }
+  if (value & 0x000000000000FF00ull) { value >>= 8;  result += 8; }
+  if (value & 0x00000000000000F0ull) { value >>= 4;  result += 4; }
+  if (value & 0x000000000000000Cull) { value >>= 2;  result += 2; }
+  if (value & 0x0000000000000002ull) { result += 1; }
+  return result;
+}
+
+// index of the least significant bit set. Value must be greater than 0
+uint32_t tlsfFindFirstSet(uint64_t value)
+{
+  return tlsfFindLastSet(value & (~value + 1));
+}
+
+// find indices of the list storing free blocks of given size
+void tlsfMappingInsert(VkDeviceSize size, uint32_t& fl, uint32_t& sl)
+{
+  if (size < TLSFAllocationStrategy::SMALL_BLOCK_SIZE)
+  {
+    fl = 0;
+    sl = static_cast<uint32_t>(size);
+  }
+  else
+  {
+    uint32_t t = tlsfFindLastSet(size);
+    sl = static_cast<uint32_t>(size >> (t - TLSFAllocationStrategy::SL_INDEX_COUNT_LOG2)) ^ TLSFAllocationStrategy::SL_INDEX_COUNT;
+    fl = t - (TLSFAllocationStrategy::SL_INDEX_COUNT_LOG2 - 1);
+  }
+}
+
+// find indices of the first list in which all free blocks are not smaller than given size
+void tlsfMappingSearch(VkDeviceSize size, uint32_t& fl, uint32_t& sl)
+{
+  if (size >= TLSFAllocationStrategy::SMALL_BLOCK_SIZE)
+    size += (1ull << (tlsfFindLastSet(size) - TLSFAllocationStrategy::SL_INDEX_COUNT_LOG2)) - 1;
+  tlsfMappingInsert(size, fl, sl);
+}
+
+const uint32_t TLSFAllocationStrategy::SL_INDEX_COUNT_LOG2;
+const uint32_t TLSFAllocationStrategy::SL_INDEX_COUNT;
+const uint32_t TLSFAllocationStrategy::FL_INDEX_COUNT;
+const uint32_t TLSFAllocationStrategy::SMALL_BLOCK_SIZE;
+const uint32_t TLSFAllocationStrategy::INVALID_BLOCK;
+
+TLSFAllocationStrategy::TLSFAllocationStrategy(VkDeviceSize size)
+{
+  slBitmap.fill(0);
+  for (auto& fl : freeLists)
+    fl.fill(INVALID_BLOCK);
+  insertFreeBlock(createBlock(0, size));
+}
+
+TLSFAllocationStrategy::~TLSFAllocationStrategy()
+{
+}
+
+DeviceMemoryBlock TLSFAllocationStrategy::allocate(VkDeviceMemory storageMemory, VkMemoryRequirements memoryRequirements)
+{
+  VkDeviceSize size      = std::max<VkDeviceSize>(memoryRequirements.size, 1);
+  VkDeviceSize alignment = std::max<VkDeviceSize>(memoryRequirements.alignment, 1);
+  auto getPadding = [this, alignment](uint32_t blockIndex) -> VkDeviceSize
+  {
+    VkDeviceSize modd = blocks[blockIndex].offset % alignment;
+    return (modd == 0) ? 0 : alignment - modd;
+  };
+
+  // first try to find a block ignoring the alignment. If found block is not aligned properly - find a block that fits in the worst case
+  uint32_t blockIndex = findFreeBlock(size);
+  if (blockIndex != INVALID_BLOCK && blocks[blockIndex].size < size + getPadding(blockIndex))
+    blockIndex = findFreeBlock(size + alignment - 1);
+  if (blockIndex == INVALID_BLOCK)
+    return DeviceMemoryBlock();
+  removeFreeBlock(blockIndex);
+
+  // padding in front of the allocation goes back to free lists as a separate block
+  VkDeviceSize padding = getPadding(blockIndex);
+  if (padding > 0)
+  {
+    uint32_t alignedBlockIndex = splitBlock(blockIndex, padding);
+    insertFreeBlock(blockIndex);
+    blockIndex = alignedBlockIndex;
+  }
+  if (blocks[blockIndex].size > size)
+    insertFreeBlock(splitBlock(blockIndex, size));
+
+  VkDeviceSize offset = blocks[blockIndex].offset;
+  usedBlocks.insert({ offset, blockIndex });
+  return DeviceMemoryBlock(storageMemory, offset, offset, memoryRequirements.size, size);
+}
+
+void TLSFAllocationStrategy::deallocate(const DeviceMemoryBlock& block)
+{
+  auto it = usedBlocks.find(block.realOffset);
+  CHECK_LOG_THROW(it == end(usedBlocks), "TLSFAllocationStrategy : cannot deallocate block that was not allocated : " << block.realOffset);
+  uint32_t blockIndex = it->second;
+  usedBlocks.erase(it);
+
+  // coalesce with free physical neighbours
+  uint32_t prevIndex = blocks[blockIndex].prevPhysical;
+  if (prevIndex != INVALID_BLOCK && blocks[prevIndex].isFree)
+  {
+    removeFreeBlock(prevIndex);
+    mergeBlocks(prevIndex, blockIndex);
+    blockIndex = prevIndex;
+  }
+  uint32_t nextIndex = blocks[blockIndex].nextPhysical;
+  if (nextIndex != INVALID_BLOCK && blocks[nextIndex].isFree)
+  {
+    removeFreeBlock(nextIndex);
+    mergeBlocks(blockIndex, nextIndex);
+  }
+  insertFreeBlock(blockIndex);
+}
+
+void TLSFAllocationStrategy::collectFreeSpace(DeviceMemoryStatistics& statistics) const
+{
+  for (uint32_t fl = 0; fl < FL_INDEX_COUNT; ++fl)
+  {
+    if ((flBitmap & (1ull << fl)) == 0)
+      continue;
+    for (uint32_t sl = 0; sl < SL_INDEX_COUNT; ++sl)
+    {
+      for (uint32_t blockIndex = freeLists[fl][sl]; blockIndex != INVALID_BLOCK; blockIndex = blocks[blockIndex].nextFree)
+      {
+        statistics.freeBytes        += blocks[blockIndex].size;
+        statistics.largestFreeBlock  = std::max(statistics.largestFreeBlock, blocks[blockIndex].size);
+        statistics.freeBlockCount++;
+      }
+    }
+  }
+}
+
+uint32_t TLSFAllocationStrategy::createBlock(VkDeviceSize offset, VkDeviceSize size)
+{
+  uint32_t blockIndex;
+  if (!unusedBlocks.empty())
+  {
+    blockIndex = unusedBlocks.back();
+    unusedBlocks.pop_back();
+  }
+  else
+  {
+    blockIndex = blocks.size();
+    blocks.push_back(Block());
+  }
+  blocks[blockIndex]        = Block();
+  blocks[blockIndex].offset = offset;
+  blocks[blockIndex].size   = size;
+  return blockIndex;
+}
+
+void TLSFAllocationStrategy::destroyBlock(uint32_t blockIndex)
+{
+  unusedBlocks.push_back(blockIndex);
+}
+
+void TLSFAllocationStrategy::insertFreeBlock(uint32_t blockIndex)
+{
+  uint32_t fl, sl;
+  tlsfMappingInsert(blocks[blockIndex].size, fl, sl);
+  Block& block   = blocks[blockIndex];
+  block.isFree   = true;
+  block.prevFree = INVALID_BLOCK;
+  block.nextFree = freeLists[fl][sl];
+  if (block.nextFree != INVALID_BLOCK)
+    blocks[block.nextFree].prevFree = blockIndex;
+  freeLists[fl][sl] = blockIndex;
+  flBitmap     |= 1ull << fl;
+  slBitmap[fl] |= 1u << sl;
+}
+
+void TLSFAllocationStrategy::removeFreeBlock(uint32_t blockIndex)
+{
+  uint32_t fl, sl;
+  tlsfMappingInsert(blocks[blockIndex].size, fl, sl);
+  Block& block = blocks[blockIndex];
+  if (block.prevFree != INVALID_BLOCK)
+    blocks[block.prevFree].nextFree = block.nextFree;
+  else
+    freeLists[fl][sl] = block.nextFree;
+  if (block.nextFree != INVALID_BLOCK)
+    blocks[block.nextFree].prevFree = block.prevFree;
+  if (freeLists[fl][sl] == INVALID_BLOCK)
+  {
+    slBitmap[fl] &= ~(1u << sl);
+    if (slBitmap[fl] == 0)
+      flBitmap &= ~(1ull << fl);
+  }
+  block.isFree   = false;
+  block.prevFree = INVALID_BLOCK;
+  block.nextFree = INVALID_BLOCK;
+}
+
+uint32_t TLSFAllocationStrategy::findFreeBlock(VkDeviceSize size) const
+{
+  uint32_t fl, sl;
+  tlsfMappingSearch(size, fl, sl);
+  if (fl >= FL_INDEX_COUNT)
+    return INVALID_BLOCK;
+  uint32_t slMap = slBitmap[fl] & (~0u << sl);
+  if (slMap == 0)
+  {
+    uint64_t flMap = (fl + 1 < FL_INDEX_COUNT) ? (flBitmap & (~0ull << (fl + 1))) : 0;
+    if (flMap == 0)
+      return INVALID_BLOCK;
+    fl    = tlsfFindFirstSet(flMap);
+    slMap = slBitmap[fl];
+  }
+  sl = tlsfFindFirstSet(slMap);
+  return freeLists[fl][sl];
+}
+
+// divide a block into two physical blocks, first of them with given size. Returns index of the second block
+uint32_t TLSFAllocationStrategy::splitBlock(uint32_t blockIndex, VkDeviceSize size)
+{
+  uint32_t newBlockIndex = createBlock(blocks[blockIndex].offset + size, blocks[blockIndex].size - size);
+  blocks[newBlockIndex].prevPhysical = blockIndex;
+  blocks[newBlockIndex].nextPhysical = blocks[blockIndex].nextPhysical;
+  if (blocks[blockIndex].nextPhysical != INVALID_BLOCK)
+    blocks[blocks[blockIndex].nextPhysical].prevPhysical = newBlockIndex;
+  blocks[blockIndex].nextPhysical = newBlockIndex;
+  blocks[blockIndex].size         = size;
+  return newBlockIndex;
+}
+
+// join a block with its next physical neighbour
+void TLSFAllocationStrategy::mergeBlocks(uint32_t blockIndex, uint32_t nextBlockIndex)
+{
+  blocks[blockIndex].size         += blocks[nextBlockIndex].size;
+  blocks[blockIndex].nextPhysical  = blocks[nextBlockIndex].nextPhysical;
+  if (blocks[blockIndex].nextPhysical != INVALID_BLOCK)
+    blocks[blocks[blockIndex].nextPhysical].prevPhysical = blockIndex;
+  destroyBlock(nextBlockIndex);
+}
+
+FrameRingAllocationStrategy::FrameRingAllocationStrategy(VkDeviceSize s)
+  : size{ s }
+{
+}
+
+FrameRingAllocationStrategy::~FrameRingAllocationStrategy()
+{
+}
+
+DeviceMemoryBlock FrameRingAllocationStrategy::allocate(VkDeviceMemory storageMemory, VkMemoryRequirements memoryRequirements)
+{
+  if (segments.empty())
+    head = 0;
+  // free space lies between head and the oldest segment. When head is behind the oldest segment - free space wraps around the end of memory block
+  VkDeviceSize tail      = segments.empty() ? 0 : segments.front().begin;
+  bool         wrapped   = !segments.empty() && head <= tail;
+  VkDeviceSize alignment = std::max<VkDeviceSize>(memoryRequirements.alignment, 1);
+  auto alignUp = [alignment](VkDeviceSize offset) { return ((offset + alignment - 1) / alignment) * alignment; };
+
+  VkDeviceSize realOffset    = head;
+  VkDeviceSize alignedOffset = alignUp(head);
+  if (!wrapped && alignedOffset + memoryRequirements.size > size)
+  {
+    // skip the end of memory block and start from the beginning
+    realOffset    = 0;
+    alignedOffset = 0;
+    wrapped       = !segments.empty();
+  }
+  VkDeviceSize limit = wrapped ? tail : size;
+  if (alignedOffset + memoryRequirements.size > limit)
+    return DeviceMemoryBlock();
+
+  // alignedSize contains also the padding between realOffset and alignedOffset
+  VkDeviceSize alignedSize = alignedOffset + memoryRequirements.size - realOffset;
+  if (segments.empty() || segments.back().frameNumber != frameNumber || segments.back().end != realOffset)
+    segments.push_back({ frameNumber, realOffset, realOffset, 0, frameNumber });
+  segments.back().end += alignedSize;
+  segments.back().allocationCount++;
+  head = realOffset + alignedSize;
+  return DeviceMemoryBlock(storageMemory, realOffset, alignedOffset, memoryRequirements.size, alignedSize);
+}
+
+void FrameRingAllocationStrategy::deallocate(const DeviceMemoryBlock& block)
+{
+  auto it = std::find_if(begin(segments), end(segments), [&block](const FrameSegment& segment) { return segment.begin <= block.realOffset && block.realOffset < segment.end; });
+  CHECK_LOG_THROW(it == end(segments) || it->allocationCount == 0, "FrameRingAllocationStrategy::deallocate() : block does not belong to any frame segment");
+  it->allocationCount--;
+  it->releaseFrameNumber = std::max(it->releaseFrameNumber, frameNumber);
+  reclaimSegments();
+}
+
+void FrameRingAllocationStrategy::beginFrame(uint64_t fn, uint64_t cfn)
+{
+  frameNumber          = fn;
+  completedFrameNumber = cfn;
+  reclaimSegments();
+}
+
+bool FrameRingAllocationStrategy::hasPendingMemory() const
+{
+  return !segments.empty();
+}
+
+// free space lies between head and the oldest segment, it may wrap around the end of memory block
+void FrameRingAllocationStrategy::collectFreeSpace(DeviceMemoryStatistics& statistics) const
+{
+  std::vector<VkDeviceSize> freeSizes;
+  if (segments.empty())
+    freeSizes.push_back(size);
+  else if (head > segments.front().begin)
+    freeSizes = { size - head, segments.front().begin };
+  else
+    freeSizes.push_back(segments.front().begin - head);
+  for (auto freeSize : freeSizes)
+  {
+    if (freeSize == 0)
+      continue;
+    statistics.freeBytes        += freeSize;
+    statistics.largestFreeBlock  = std::max(statistics.largestFreeBlock, freeSize);
+    statistics.freeBlockCount++;
+  }
+}
+
+void FrameRingAllocationStrategy::reclaimSegments()
+{
+  while (!segments.empty() && segments.front().allocationCount == 0 && segments.front().releaseFrameNumber <= completedFrameNumber)
+    segments.pop_front();
+}
+
+const VkDeviceSize BuddyAllocationStrategy::MIN_BLOCK_SIZE;
+
+// memory block is covered by root blocks of decreasing sizes, so that each root block is aligned to its size
+BuddyAllocationStrategy::BuddyAllocationStrategy(VkDeviceSize size)
+{
+  VkDeviceSize blockCount = size / MIN_BLOCK_SIZE;
+  VkDeviceSize offset     = 0;
+  for (uint32_t level = 64; level > 0; --level)
+  {
+    if ((blockCount & (1ull << (level - 1))) == 0)
+      continue;
+    if (freeBlocks.size() < level)
+      freeBlocks.resize(level);
+    freeBlocks[level - 1].insert(offset);
+    rootBlocks.insert({ offset, level - 1 });
+    offset += MIN_BLOCK_SIZE << (level - 1);
+  }
+}
+
+BuddyAllocationStrategy::~BuddyAllocationStrategy()
+{
+}
+
+DeviceMemoryBlock BuddyAllocationStrategy::allocate(VkDeviceMemory storageMemory, VkMemoryRequirements memoryRequirements)
+{
+  uint32_t level = getLevel(std::max(memoryRequirements.size, memoryRequirements.alignment));
+  uint32_t freeLevel = level;
+  while (freeLevel < freeBlocks.size() && freeBlocks[freeLevel].empty())
+    freeLevel++;
+  if (freeLevel >= freeBlocks.size())
+    return DeviceMemoryBlock();
+
+  // free block with the lowest address is split until it has required size. Second halves go to free lists
+  VkDeviceSize offset = *begin(freeBlocks[freeLevel]);
+  freeBlocks[freeLevel].erase(begin(freeBlocks[freeLevel]));
+  while (freeLevel > level)
+  {
+    freeLevel--;
+    freeBlocks[freeLevel].insert(offset + (MIN_BLOCK_SIZE << freeLevel));
+  }
+  usedBlocks.insert({ offset, level });
+  return DeviceMemoryBlock(storageMemory, offset, offset, memoryRequirements.size, MIN_BLOCK_SIZE << level);
+}
+
+void BuddyAllocationStrategy::deallocate(const DeviceMemoryBlock& block)
+{
+  auto it = usedBlocks.find(block.realOffset);
+  CHECK_LOG_THROW(it == end(usedBlocks), "BuddyAllocationStrategy : cannot deallocate block that was not allocated : " << block.realOffset);
+  VkDeviceSize offset = it->first;
+  uint32_t     level  = it->second;
+  usedBlocks.erase(it);
+
+  // merge with free buddies, but never above the root block
+  uint32_t rootLevel = std::prev(rootBlocks.upper_bound(offset))->second;
+  while (level < rootLevel)
+  {
+    auto bit = freeBlocks[level].find(offset ^ (MIN_BLOCK_SIZE << level));
+    if (bit == end(freeBlocks[level]))
+      break;
+    offset = std::min(offset, *bit);
+    freeBlocks[level].erase(bit);
+    level++;
+  }
+  freeBlocks[level].insert(offset);
+}
+
+void BuddyAllocationStrategy::collectFreeSpace(DeviceMemoryStatistics& statistics) const
+{
+  for (uint32_t level = 0; level < freeBlocks.size(); ++level)
+  {
+    if (freeBlocks[level].empty())
+      continue;
+    statistics.freeBytes        += freeBlocks[level].size() * (MIN_BLOCK_SIZE << level);
+    statistics.largestFreeBlock  = std::max(statistics.largestFreeBlock, MIN_BLOCK_SIZE << level);
+    statistics.freeBlockCount   += freeBlocks[level].size();
+  }
+}
+
+void BuddyAllocationStrategy::split(const DeviceMemoryBlock& block, VkDeviceSize partSize, std::vector<DeviceMemoryBlock>& parts)
+{
+  auto it = usedBlocks.find(block.realOffset);
+  CHECK_LOG_THROW(it == end(usedBlocks), "BuddyAllocationStrategy : cannot split block that was not allocated : " << block.realOffset);
+  uint32_t partLevel = std::min(getLevel(partSize), it->second);
+  VkDeviceSize blockSize = MIN_BLOCK_SIZE << it->second;
+  partSize               = MIN_BLOCK_SIZE << partLevel;
+  usedBlocks.erase(it);
+  for (VkDeviceSize offset = block.realOffset; offset < block.realOffset + blockSize; offset += partSize)
+  {
+    usedBlocks.insert({ offset, partLevel });
+    DeviceMemoryBlock part = block;
+    part.realOffset    = offset;
+    part.alignedOffset = offset;
+    part.realSize      = partSize;
+    part.alignedSize   = partSize;
+    if (block.mappedMemory != nullptr)
+      part.mappedMemory = static_cast<uint8_t*>(block.mappedMemory) + (offset - block.alignedOffset);
+    parts.push_back(part);
+  }
+}
+
+// level of the smallest block that is not smaller than size
+uint32_t BuddyAllocationStrategy::getLevel(VkDeviceSize size) const
+{
+  uint32_t level = 0;
+  while (level < 48 && (MIN_BLOCK_SIZE << level) < size)
+    level++;
+  return level;
+}
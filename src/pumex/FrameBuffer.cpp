@@ -44,7 +44,7 @@ FrameBufferImageDefinition::FrameBufferImageDefinition(AttachmentType at, VkForm
 }
 
 FrameBuffer::FrameBuffer(const AttachmentSize& fbs, const std::vector<FrameBufferImageDefinition>& fbid, std::shared_ptr<RenderPass> rp, std::map<std::string, std::shared_ptr<MemoryImage>> mi, std::map<std::string, std::shared_ptr<ImageView>> iv)
-  : frameBufferSize{fbs}, imageDefinitions(fbid), renderPass{ rp }, activeCount{ 1 }
+  : frameBufferSize{fbs}, imageDefinitions(fbid), renderPass{ rp }, activeCount{ 1 }, swapChainImageBehaviour{ swForEachImage }
 {
   for (uint32_t i = 0; i < imageDefinitions.size(); i++)
   {
@@ -57,6 +57,9 @@ FrameBuffer::FrameBuffer(const AttachmentSize& fbs, const std::vector<FrameBuffe
     auto vit = iv.find(definition.name);
     CHECK_LOG_THROW(vit == end(iv), "FrameBuffer::FrameBuffer() : not all memory image views have been supplied");
     imageViews.push_back(vit->second);
+
+    if (definition.attachmentType == atSurface)
+      swapChainImageBehaviour = swForEachSwapChainImage;
   }
 }
 
@@ -75,16 +78,19 @@ void FrameBuffer::validate(const RenderContext& renderContext)
   rp->validate(renderContext);
 
   std::lock_guard<std::mutex> lock(mutex);
-  if (renderContext.imageCount > activeCount)
+  if (getActiveCount(renderContext, swapChainImageBehaviour) > activeCount)
   {
-    activeCount = renderContext.imageCount;
+    activeCount = getActiveCount(renderContext, swapChainImageBehaviour);
     for (auto& pdd : perObjectData)
       pdd.second.resize(activeCount);
   }
   auto pddit = perObjectData.find(renderContext.vkSurface);
   if (pddit == end(perObjectData))
-    pddit = perObjectData.insert({ renderContext.vkSurface, FrameBufferData(renderContext.vkDevice, renderContext.vkSurface, activeCount, swForEachImage) }).first;
-  uint32_t activeIndex = renderContext.activeIndex % activeCount;
+    pddit = perObjectData.insert({ renderContext.vkSurface, FrameBufferData(renderContext.vkDevice, renderContext.vkSurface, activeCount, swapChainImageBehaviour) }).first;
+
+  // surface keeps a variant of its command buffers for each swapchain image, so they are not recorded again
+  // when frame in flight renders to a different swapchain image
+  uint32_t activeIndex = getActiveIndex(renderContext, swapChainImageBehaviour) % activeCount;
   if (pddit->second.valid[activeIndex])
     return;
 
@@ -134,7 +140,11 @@ void FrameBuffer::validate(const RenderContext& renderContext)
     frameBufferCreateInfo.layers          = 1;
   VK_CHECK_LOG_THROW(vkCreateFramebuffer(renderContext.vkDevice, &frameBufferCreateInfo, nullptr, &pddit->second.data[activeIndex].frameBuffer), "Could not create frame buffer " << activeIndex);
   pddit->second.valid[activeIndex] = true;
-  notifyCommandBuffers();
+  // frame buffer created for swapchain image may be used by any frame in flight
+  if (swapChainImageBehaviour == swForEachSwapChainImage)
+    notifyCommandBuffers();
+  else
+    notifyCommandBuffers(activeIndex);
 }
 
 void FrameBuffer::invalidate(const RenderContext& renderContext)
@@ -142,7 +152,7 @@ void FrameBuffer::invalidate(const RenderContext& renderContext)
   std::lock_guard<std::mutex> lock(mutex);
   auto pddit = perObjectData.find(renderContext.vkSurface);
   if (pddit == end(perObjectData))
-    pddit = perObjectData.insert({ renderContext.vkSurface, FrameBufferData(renderContext.vkDevice, renderContext.vkSurface, activeCount, swForEachImage) }).first;
+    pddit = perObjectData.insert({ renderContext.vkSurface, FrameBufferData(renderContext.vkDevice, renderContext.vkSurface, activeCount, swapChainImageBehaviour) }).first;
   pddit->second.invalidate();
 }
 
@@ -247,5 +257,5 @@ VkFramebuffer FrameBuffer::getHandleFrameBuffer(const RenderContext& renderConte
   auto pddit = perObjectData.find(renderContext.vkSurface);
   if (pddit == end(perObjectData))
     return VK_NULL_HANDLE;
-  return pddit->second.data[renderContext.activeIndex % activeCount].frameBuffer;
+  return pddit->second.data[getActiveIndex(renderContext, swapChainImageBehaviour) % activeCount].frameBuffer;
 }
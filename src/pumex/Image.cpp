@@ -21,6 +21,7 @@
 //
 
 #include <pumex/Image.h>
+#include <algorithm>
 #include <pumex/Device.h>
 #include <pumex/utils/Log.h>
 
@@ -57,34 +58,50 @@ ImageTraits& ImageTraits::operator=(const ImageTraits& traits)
   return *this;
 }
 
-Image::Image(Device* d, const ImageTraits& it, std::shared_ptr<DeviceMemoryAllocator> a)
+AliasedMemoryBlock::AliasedMemoryBlock(VkDevice d, std::shared_ptr<DeviceMemoryAllocator> a, const DeviceMemoryBlock& mb)
+  : device{ d }, allocator{ a }, memoryBlock{ mb }
+{
+}
+
+AliasedMemoryBlock::~AliasedMemoryBlock()
+{
+  allocator->deallocate(device, memoryBlock);
+}
+
+Image::Image(Device* d, const ImageTraits& it, std::shared_ptr<DeviceMemoryAllocator> a, bool relocatable)
   : imageTraits{ it }, device(d->device), allocator{ a }, ownsImage{ true }
 {
-  VkImageCreateInfo imageCI{};
-    imageCI.sType         = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-    imageCI.flags         = imageTraits.imageCreate;
-    imageCI.imageType     = imageTraits.imageType;
-    imageCI.format        = imageTraits.format;
-    imageCI.extent        = imageTraits.extent;
-    imageCI.mipLevels     = imageTraits.mipLevels;
-    imageCI.arrayLayers   = imageTraits.arrayLayers;
-    imageCI.samples       = imageTraits.samples;
-    imageCI.tiling        = imageTraits.linearTiling ? VK_IMAGE_TILING_LINEAR : VK_IMAGE_TILING_OPTIMAL;
-    imageCI.usage         = imageTraits.usage;
-    imageCI.sharingMode   = imageTraits.sharingMode;
-//    imageCI.queueFamilyIndexCount;
-//    imageCI.pQueueFamilyIndices;
-    imageCI.initialLayout = imageTraits.initialLayout;
-  VK_CHECK_LOG_THROW(vkCreateImage(device, &imageCI, nullptr, &image), "failed vkCreateImage");
+  image = createVulkanImage(device, imageTraits);
 
   VkMemoryRequirements memReqs;
   vkGetImageMemoryRequirements(device, image, &memReqs);
 
-  memoryBlock = allocator->allocate(d, memReqs);
+  memoryBlock = allocator->allocate(d, memReqs, relocatable);
   CHECK_LOG_THROW(memoryBlock.alignedSize == 0, "Cannot allocate memory for Image");
   VK_CHECK_LOG_THROW(vkBindImageMemory(device, image, memoryBlock.memory, memoryBlock.alignedOffset), "failed vkBindImageMemory");
 }
 
+Image::Image(Device* d, const ImageTraits& it, std::shared_ptr<DeviceMemoryAllocator> a, const DeviceMemoryBlock& mb)
+  : imageTraits{ it }, device(d->device), allocator{ a }, memoryBlock{ mb }, ownsImage{ true }
+{
+  CHECK_LOG_THROW(memoryBlock.alignedSize == 0, "Cannot create Image without memory");
+  image = createVulkanImage(device, imageTraits);
+  VK_CHECK_LOG_THROW(vkBindImageMemory(device, image, memoryBlock.memory, memoryBlock.alignedOffset), "failed vkBindImageMemory");
+}
+
+Image::Image(Device* d, const ImageTraits& it, std::shared_ptr<ImageMemoryAliasGroup> aliasGroup, uint32_t aliasKey)
+  : imageTraits{ it }, device(d->device), allocator{ aliasGroup->getAllocator() }, ownsImage{ true }
+{
+  image = createVulkanImage(device, imageTraits);
+
+  VkMemoryRequirements memReqs;
+  vkGetImageMemoryRequirements(device, image, &memReqs);
+
+  aliasedMemory = aliasGroup->acquire(d, aliasKey, memReqs);
+  memoryBlock   = aliasedMemory->memoryBlock;
+  VK_CHECK_LOG_THROW(vkBindImageMemory(device, image, memoryBlock.memory, memoryBlock.alignedOffset), "failed vkBindImageMemory");
+}
+
 Image::Image(Device* d, VkImage i, VkFormat format, const VkExtent3D& extent, uint32_t mipLevels, uint32_t arrayLayers)
   : device(d->device), image{ i }, ownsImage{  false }
 {
@@ -101,7 +118,9 @@ Image::~Image()
   {
     if (image != VK_NULL_HANDLE)
       vkDestroyImage(device, image, nullptr);
-    allocator->deallocate(device, memoryBlock);
+    // aliased memory is returned to allocator by the last image that uses it
+    if (aliasedMemory == nullptr)
+      allocator->deallocate(device, memoryBlock);
   }
 }
 
@@ -113,19 +132,100 @@ void Image::getImageSubresourceLayout(VkImageSubresource& subRes, VkSubresourceL
 
 void* Image::mapMemory(size_t offset, size_t range, VkMemoryMapFlags flags)
 {
+  // memory from host visible allocators is persistently mapped
+  if (memoryBlock.mappedMemory != nullptr)
+  {
+    allocator->invalidateMappedMemory(device, memoryBlock, offset, range);
+    return static_cast<uint8_t*>(memoryBlock.mappedMemory) + offset;
+  }
   void* data;
-  VK_CHECK_LOG_THROW(vkMapMemory(device, memoryBlock.memory, memoryBlock.alignedSize + offset, range, flags, &data), "Cannot map memory to image");
+  VK_CHECK_LOG_THROW(vkMapMemory(device, memoryBlock.memory, memoryBlock.alignedOffset + offset, range, flags, &data), "Cannot map memory to image");
   return data;
 }
 
 void Image::unmapMemory()
 {
-  vkUnmapMemory(device, memoryBlock.memory);
+  if (memoryBlock.mappedMemory != nullptr)
+    allocator->flushMappedMemory(device, memoryBlock, 0, VK_WHOLE_SIZE);
+  else
+    vkUnmapMemory(device, memoryBlock.memory);
+}
+
+ImageMemoryAliasGroup::ImageMemoryAliasGroup(std::shared_ptr<DeviceMemoryAllocator> a)
+  : allocator{ a }
+{
+}
+
+ImageMemoryAliasGroup::~ImageMemoryAliasGroup()
+{
+}
+
+void ImageMemoryAliasGroup::setImageTraits(uint32_t key, const void* member, const ImageTraits& traits)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  auto& keyData = perKeyData[key];
+  keyData.memberTraits[member] = traits;
+  keyData.valid                = false;
+}
+
+std::shared_ptr<AliasedMemoryBlock> ImageMemoryAliasGroup::acquire(Device* device, uint32_t key, const VkMemoryRequirements& memoryRequirements)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  auto& keyData = perKeyData[key];
+  auto memory   = keyData.memory.lock();
+  if (keyData.valid && memory != nullptr && memory->device == device->device && memory->memoryBlock.realSize >= memoryRequirements.size && (memory->memoryBlock.alignedOffset % memoryRequirements.alignment) == 0)
+    return memory;
+
+  // traits have changed or there is no memory yet. Memory requirements are not known until VkImage is created,
+  // so we create temporary images for all members in order to find requirements common to all of them
+  VkMemoryRequirements commonRequirements = memoryRequirements;
+  for (auto& mt : keyData.memberTraits)
+  {
+    VkImage probeImage = createVulkanImage(device->device, mt.second);
+    VkMemoryRequirements memReqs;
+    vkGetImageMemoryRequirements(device->device, probeImage, &memReqs);
+    vkDestroyImage(device->device, probeImage, nullptr);
+
+    commonRequirements.size            = std::max(commonRequirements.size, memReqs.size);
+    // alignments are powers of two
+    commonRequirements.alignment       = std::max(commonRequirements.alignment, memReqs.alignment);
+    commonRequirements.memoryTypeBits &= memReqs.memoryTypeBits;
+  }
+  CHECK_LOG_THROW(commonRequirements.memoryTypeBits == 0, "ImageMemoryAliasGroup::acquire() : aliased images do not have common memory type");
+
+  DeviceMemoryBlock memoryBlock = allocator->allocate(device, commonRequirements);
+  CHECK_LOG_THROW(memoryBlock.alignedSize == 0, "Cannot allocate memory for aliased images");
+  memory         = std::make_shared<AliasedMemoryBlock>(device->device, allocator, memoryBlock);
+  keyData.memory = memory;
+  keyData.valid  = true;
+  return memory;
 }
 
 namespace pumex
 {
 
+VkImage createVulkanImage(VkDevice device, const ImageTraits& imageTraits)
+{
+  VkImageCreateInfo imageCI{};
+    imageCI.sType         = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageCI.flags         = imageTraits.imageCreate;
+    imageCI.imageType     = imageTraits.imageType;
+    imageCI.format        = imageTraits.format;
+    imageCI.extent        = imageTraits.extent;
+    imageCI.mipLevels     = imageTraits.mipLevels;
+    imageCI.arrayLayers   = imageTraits.arrayLayers;
+    imageCI.samples       = imageTraits.samples;
+    imageCI.tiling        = imageTraits.linearTiling ? VK_IMAGE_TILING_LINEAR : VK_IMAGE_TILING_OPTIMAL;
+    imageCI.usage         = imageTraits.usage;
+    imageCI.sharingMode   = imageTraits.sharingMode;
+//    imageCI.queueFamilyIndexCount;
+//    imageCI.pQueueFamilyIndices;
+    imageCI.initialLayout = imageTraits.initialLayout;
+  VkImage image;
+  VK_CHECK_LOG_THROW(vkCreateImage(device, &imageCI, nullptr, &image), "failed vkCreateImage");
+  return image;
+}
+
 ImageTraits getImageTraitsFromTexture(const gli::texture& texture, VkImageUsageFlags usage)
 {
   auto t = texture.extent(0);
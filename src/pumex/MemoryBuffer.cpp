@@ -26,6 +26,8 @@
 #include <pumex/RenderContext.h>
 #include <pumex/Resource.h>
 #include <algorithm>
+#include <cmath>
+#include <cstring>
 
 using namespace pumex;
 
@@ -44,11 +46,110 @@ bool BufferSubresourceRange::contains(const BufferSubresourceRange& subRange) co
   return (offset <= subRange.offset) && (offset + range >= subRange.offset + subRange.range);
 }
 
+void pumex::mergeBufferSubresourceRange(std::vector<BufferSubresourceRange>& ranges, const BufferSubresourceRange& range)
+{
+  if (range.range == 0)
+    return;
+  VkDeviceSize first = range.offset;
+  VkDeviceSize last  = range.offset + range.range;
+  // find first range that ends at or after the beginning of the new range
+  auto it = std::lower_bound(begin(ranges), end(ranges), first, [](const BufferSubresourceRange& r, VkDeviceSize value) { return r.offset + r.range < value; });
+  auto jt = it;
+  for (; jt != end(ranges) && jt->offset <= last; ++jt)
+  {
+    first = std::min(first, jt->offset);
+    last  = std::max(last, jt->offset + jt->range);
+  }
+  it = ranges.erase(it, jt);
+  ranges.insert(it, BufferSubresourceRange(first, last - first));
+}
+
+void pumex::getBufferUsageScope(VkBufferUsageFlags bufferUsage, VkPipelineStageFlags& stageMask, VkAccessFlags& accessMask)
+{
+  const VkPipelineStageFlags shaderStages = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_TESSELLATION_CONTROL_SHADER_BIT | VK_PIPELINE_STAGE_TESSELLATION_EVALUATION_SHADER_BIT |
+    VK_PIPELINE_STAGE_GEOMETRY_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+  stageMask  = 0;
+  accessMask = 0;
+  if (bufferUsage & VK_BUFFER_USAGE_VERTEX_BUFFER_BIT)
+  {
+    stageMask  |= VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+    accessMask |= VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+  }
+  if (bufferUsage & VK_BUFFER_USAGE_INDEX_BUFFER_BIT)
+  {
+    stageMask  |= VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+    accessMask |= VK_ACCESS_INDEX_READ_BIT;
+  }
+  if (bufferUsage & VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT)
+  {
+    stageMask  |= VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+    accessMask |= VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+  }
+  if (bufferUsage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT)
+  {
+    stageMask  |= shaderStages;
+    accessMask |= VK_ACCESS_UNIFORM_READ_BIT;
+  }
+  if (bufferUsage & VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT)
+  {
+    stageMask  |= shaderStages;
+    accessMask |= VK_ACCESS_SHADER_READ_BIT;
+  }
+  if (bufferUsage & (VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_TEXEL_BUFFER_BIT))
+  {
+    stageMask  |= shaderStages;
+    accessMask |= VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  }
+  if (bufferUsage & VK_BUFFER_USAGE_TRANSFER_SRC_BIT)
+  {
+    stageMask  |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+    accessMask |= VK_ACCESS_TRANSFER_READ_BIT;
+  }
+  if (bufferUsage & VK_BUFFER_USAGE_TRANSFER_DST_BIT)
+  {
+    stageMask  |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+    accessMask |= VK_ACCESS_TRANSFER_WRITE_BIT;
+  }
+  // stage mask must not be empty
+  if (stageMask == 0)
+    stageMask = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+}
+
+BufferCapacityPolicy::BufferCapacityPolicy()
+  : growthFactor{ 1.5f }, shrinkThreshold{ 0.25f }, minimumCapacity{ 1 }
+{
+}
+
+BufferCapacityPolicy::BufferCapacityPolicy(float gf, float st, VkDeviceSize mc)
+  : growthFactor{ gf }, shrinkThreshold{ st }, minimumCapacity{ std::max<VkDeviceSize>(1, mc) }
+{
+  CHECK_LOG_THROW(growthFactor < 1.0f, "BufferCapacityPolicy : growth factor must not be smaller than 1.0");
+  CHECK_LOG_THROW(shrinkThreshold < 0.0f || shrinkThreshold >= 1.0f, "BufferCapacityPolicy : shrink threshold must be in range [0.0, 1.0)");
+}
+
+VkDeviceSize BufferCapacityPolicy::getCapacity(VkDeviceSize currentCapacity, VkDeviceSize dataSize) const
+{
+  // current buffer is big enough and not too big
+  if (currentCapacity > 0 && currentCapacity >= dataSize && (currentCapacity <= minimumCapacity || dataSize >= shrinkThreshold * currentCapacity))
+    return currentCapacity;
+  VkDeviceSize capacity = dataSize;
+  // buffer that was resized once will probably be resized again - leave some space for it
+  if (currentCapacity > 0)
+  {
+    VkDeviceSize base = (dataSize > currentCapacity) ? currentCapacity : dataSize;
+    capacity = std::max(dataSize, static_cast<VkDeviceSize>(std::ceil(growthFactor * base)));
+  }
+  return std::max(minimumCapacity, capacity);
+}
+
 MemoryBuffer::MemoryBuffer(std::shared_ptr<DeviceMemoryAllocator> a, VkBufferUsageFlags bu, PerObjectBehaviour pob, SwapChainImageBehaviour scib, bool sdpo, bool usdm)
   : MemoryObject(MemoryObject::moBuffer), perObjectBehaviour{ pob }, swapChainImageBehaviour{ scib }, sameDataPerObject{ sdpo }, allocator{ a }, bufferUsage{ bu }, activeCount{ 1 }
 {
   if (usdm)
     bufferUsage = bufferUsage | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+  // buffers created for each swapchain image may be moved during defragmentation - they must be readable by transfer operations
+  if (usdm && swapChainImageBehaviour == swForEachImage)
+    bufferUsage = bufferUsage | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
 }
 
 MemoryBuffer::~MemoryBuffer()
@@ -57,11 +158,14 @@ MemoryBuffer::~MemoryBuffer()
   for (auto& pdd : perObjectData)
   {
     for (uint32_t i = 0; i < pdd.second.data.size(); ++i)
-    {
-      vkDestroyBuffer(pdd.second.device, pdd.second.data[i].buffer, nullptr);
-      allocator->deallocate(pdd.second.device, pdd.second.data[i].memoryBlock);
-    }
+      if (findSharedBuffer(pdd.second.device, pdd.second.data[i]) == end(sharedBuffers))
+        destroyBuffer(pdd.second.device, pdd.second.data[i]);
   }
+  // shared buffers are destroyed once, not by each of their users
+  for (auto& sb : sharedBuffers)
+    destroyBuffer(sb.device, sb.internals);
+  for (auto& sb : releasedSharedBuffers)
+    destroyBuffer(sb.device, sb.internals);
 }
 
 MemoryBuffer* MemoryBuffer::asMemoryBuffer()
@@ -78,6 +182,60 @@ VkBuffer MemoryBuffer::getHandleBuffer(const RenderContext& renderContext) const
   return pddit->second.data[renderContext.activeIndex % activeCount].buffer;
 }
 
+VkDeviceSize MemoryBuffer::getBufferOffset(const RenderContext& renderContext) const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  auto pddit = perObjectData.find(getKeyID(renderContext, perObjectBehaviour));
+  if (pddit == end(perObjectData))
+    return 0;
+  return pddit->second.data[renderContext.activeIndex % activeCount].bufferOffset;
+}
+
+bool MemoryBuffer::isPooledRC(const RenderContext& renderContext) const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  auto pddit = perObjectData.find(getKeyID(renderContext, perObjectBehaviour));
+  if (pddit == end(perObjectData))
+    return false;
+  return pddit->second.data[renderContext.activeIndex % activeCount].pooled;
+}
+
+void MemoryBuffer::setBufferPool(std::shared_ptr<BufferPool> bp)
+{
+  if (bp != nullptr)
+  {
+    CHECK_LOG_THROW((bufferUsage & ~bp->getBufferUsage()) != 0, "MemoryBuffer::setBufferPool() : buffer pool does not support all buffer usage flags");
+    CHECK_LOG_THROW(bp->getAllocator()->getMemoryPropertyFlags() != allocator->getMemoryPropertyFlags(), "MemoryBuffer::setBufferPool() : buffer pool uses memory with different properties");
+  }
+  std::lock_guard<std::mutex> lock(mutex);
+  for (auto& pdd : perObjectData)
+    for (auto& d : pdd.second.data)
+      CHECK_LOG_THROW(d.buffer != VK_NULL_HANDLE, "MemoryBuffer::setBufferPool() : cannot change buffer pool after buffer was created");
+  bufferPool = bp;
+}
+
+uint32_t MemoryBuffer::getDynamicOffset(const RenderContext& renderContext) const
+{
+  return 0;
+}
+
+void MemoryBuffer::setSurfaceDataSharing(bool sd, size_t msds)
+{
+  CHECK_LOG_THROW(sd && perObjectBehaviour != pbPerSurface, "MemoryBuffer::setSurfaceDataSharing() : only buffers created per surface may share data between surfaces");
+  std::lock_guard<std::mutex> lock(mutex);
+  for (auto& pdd : perObjectData)
+    for (auto& d : pdd.second.data)
+      CHECK_LOG_THROW(d.buffer != VK_NULL_HANDLE, "MemoryBuffer::setSurfaceDataSharing() : cannot change data sharing after buffer was created");
+  shareSurfaceData  = sd;
+  maxSharedDataSize = msds;
+}
+
+void MemoryBuffer::setCapacityPolicy(const BufferCapacityPolicy& cp)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  capacityPolicy = cp;
+}
+
 size_t MemoryBuffer::getDataSizeRC(const RenderContext& renderContext) const
 {
   std::lock_guard<std::mutex> lock(mutex);
@@ -87,12 +245,21 @@ size_t MemoryBuffer::getDataSizeRC(const RenderContext& renderContext) const
   return pddit->second.data[renderContext.activeIndex % activeCount].dataSize;
 }
 
+VkDeviceSize MemoryBuffer::getCapacityRC(const RenderContext& renderContext) const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  auto pddit = perObjectData.find(getKeyID(renderContext, perObjectBehaviour));
+  if (pddit == end(perObjectData))
+    return 0;
+  return pddit->second.data[renderContext.activeIndex % activeCount].capacity;
+}
+
 void MemoryBuffer::validate(const RenderContext& renderContext)
 {
   std::lock_guard<std::mutex> lock(mutex);
-  if (swapChainImageBehaviour == swForEachImage && renderContext.imageCount > activeCount)
+  if (swapChainImageBehaviour == swForEachImage && renderContext.activeCount > activeCount)
   {
-    activeCount = renderContext.imageCount;
+    activeCount = renderContext.activeCount;
     for (auto& pdd : perObjectData)
     {
       pdd.second.resize(activeCount);
@@ -105,6 +272,22 @@ void MemoryBuffer::validate(const RenderContext& renderContext)
   if (pddit == end(perObjectData))
     pddit = perObjectData.insert({ keyValue, MemoryBufferData(renderContext, swapChainImageBehaviour) }).first;
   uint32_t activeIndex = renderContext.activeIndex % activeCount;
+  // shared buffers released by all surfaces are destroyed when GPU finished frames that used them
+  if (!releasedSharedBuffers.empty())
+  {
+    uint64_t completedFrameNumber = renderContext.device->getCompletedFrameNumber();
+    releasedSharedBuffers.remove_if([&](SharedBuffer& sb)
+    {
+      if (sb.device != renderContext.vkDevice || sb.releaseFrameNumber > completedFrameNumber)
+        return false;
+      destroyBuffer(sb.device, sb.internals);
+      return true;
+    });
+  }
+  // allocator may ask to move the buffer during defragmentation. Buffer waiting for operations is not moved, because operations
+  // sent through upload manager would write to the new buffer concurrently with the relocation copy
+  if (pddit->second.data[activeIndex].buffer != VK_NULL_HANDLE && pddit->second.commonData.bufferOperations.empty())
+    relocate(renderContext, pddit->second.data[activeIndex]);
   if (pddit->second.valid[activeIndex])
     return;
 
@@ -118,28 +301,21 @@ void MemoryBuffer::validate(const RenderContext& renderContext)
   // images are created here, when Texture uses sameTraitsPerObject - otherwise it's a reponsibility of the user to create them through setImageTraits() call
   if (pddit->second.data[activeIndex].buffer == nullptr && sameDataPerObject)
   {
-    VkBufferCreateInfo bufferCreateInfo{};
-      bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-      bufferCreateInfo.usage = bufferUsage;
-      bufferCreateInfo.size  = std::max<VkDeviceSize>(1, getDataSize());
-    VK_CHECK_LOG_THROW(vkCreateBuffer(pddit->second.device, &bufferCreateInfo, nullptr, &pddit->second.data[activeIndex].buffer), "Cannot create a buffer");
-    VkMemoryRequirements memReqs;
-    vkGetBufferMemoryRequirements(pddit->second.device, pddit->second.data[activeIndex].buffer, &memReqs);
-    pddit->second.data[activeIndex].dataSize    = bufferCreateInfo.size;
-    pddit->second.data[activeIndex].memoryBlock = allocator->allocate(renderContext.device, memReqs);
-    CHECK_LOG_THROW(pddit->second.data[activeIndex].memoryBlock.alignedSize == 0, "Cannot create a bufer");
-    allocator->bindBufferMemory(renderContext.device, pddit->second.data[activeIndex].buffer, pddit->second.data[activeIndex].memoryBlock.alignedOffset);
-
-    BufferSubresourceRange allBufferRange(0, getDataSize());
-    notifyCommandBufferSources(renderContext);
-    notifyBufferViews(renderContext, allBufferRange);
-    notifyResources(renderContext);
+    resizeBuffer(renderContext, pddit->second.data[activeIndex], getDataSize());
     // if there's a data - it must be sent now
     sendDataToBuffer(keyValue, renderContext.vkDevice, renderContext.vkSurface);
   }
   // if there are some pending texture operations
   if (!pddit->second.commonData.bufferOperations.empty())
   {
+    // data may be already uploaded by other surface on the same device
+    uint64_t dataHash = 0;
+    std::vector<unsigned char> sharedData;
+    if (shareSurfaceData && acquireSharedBuffer(renderContext, pddit->second, activeIndex, dataHash, sharedData))
+    {
+      pddit->second.valid[activeIndex] = true;
+      return;
+    }
     // perform all operations in a single command buffer
     auto cmdBuffer = renderContext.device->beginSingleTimeCommands(renderContext.commandPool);
     bool submit = false;
@@ -157,8 +333,236 @@ void MemoryBuffer::validate(const RenderContext& renderContext)
       bufop->releaseResources(renderContext);
     // if all operations are done for each index - remove them from list
     pddit->second.commonData.bufferOperations.remove_if(([](std::shared_ptr<Operation> bufop) { return bufop->allUpdated(); }));
+    pddit->second.data[activeIndex].inUse = true;
+    // other surfaces may use this buffer from now on
+    if (!sharedData.empty())
+      sharedBuffers.push_back(SharedBuffer{ pddit->second.device, dataHash, std::move(sharedData), pddit->second.data[activeIndex], 1 });
   }
-  pddit->second.valid[activeIndex] = true;
+  pddit->second.data[activeIndex].inUse = true;
+  pddit->second.valid[activeIndex]      = true;
+}
+
+// Returns true when surface received a buffer with the same data uploaded for other surface. Otherwise buffer used by surface
+// is detached from other surfaces, so that operations may modify it. sharedData is filled when operations define whole buffer content
+bool MemoryBuffer::acquireSharedBuffer(const RenderContext& renderContext, MemoryBufferData& pdd, uint32_t activeIndex, uint64_t& dataHash, std::vector<unsigned char>& sharedData)
+{
+  auto& internals = pdd.data[activeIndex];
+  const void* dataPointer = nullptr;
+  size_t dataSize         = 0;
+  bool pending            = false;
+  bool wholeData          = false;
+  for (auto& bufop : pdd.commonData.bufferOperations)
+  {
+    if (bufop->updated[activeIndex])
+      continue;
+    pending   = true;
+    wholeData = bufop->getSourceData(dataPointer, dataSize);
+  }
+  if (!pending)
+    return false;
+
+  // large buffers are not compared - hashing them on each update would cost more than the upload
+  if (wholeData && dataSize > 0 && dataSize <= maxSharedDataSize)
+  {
+    const unsigned char* srcData = static_cast<const unsigned char*>(dataPointer);
+    // FNV-1a hash
+    dataHash = 14695981039346656037ULL;
+    for (size_t i = 0; i < dataSize; ++i)
+      dataHash = (dataHash ^ srcData[i]) * 1099511628211ULL;
+
+    auto sit = std::find_if(begin(sharedBuffers), end(sharedBuffers), [&](const SharedBuffer& sb) { return sb.device == pdd.device && sb.dataHash == dataHash && sb.internals.buffer != internals.buffer && sb.data.size() == dataSize && std::memcmp(sb.data.data(), srcData, dataSize) == 0; });
+    if (sit != end(sharedBuffers))
+    {
+      releaseBuffer(renderContext, internals);
+      internals = sit->internals;
+      sit->userCount++;
+      for (auto& bufop : pdd.commonData.bufferOperations)
+        bufop->updated[activeIndex] = true;
+      pdd.commonData.bufferOperations.remove_if(([](std::shared_ptr<Operation> bufop) { return bufop->allUpdated(); }));
+
+      notifyCommandBufferSources(renderContext);
+      notifyBufferViews(renderContext, BufferSubresourceRange(0, internals.dataSize));
+      notifyResources(renderContext);
+      return true;
+    }
+    // data copy is registered after upload, so that other surfaces may compare with it
+    sharedData.assign(srcData, srcData + dataSize);
+  }
+
+  // buffer that is still used by other surfaces must not be modified - surface will receive a new one.
+  // The last user may modify it only when GPU finished all frames in which other surfaces used it
+  auto sit = findSharedBuffer(pdd.device, internals);
+  if (sit != end(sharedBuffers))
+  {
+    if (sit->userCount > 1 || sit->releaseFrameNumber > renderContext.device->getCompletedFrameNumber())
+      releaseBuffer(renderContext, internals);
+    else
+      sharedBuffers.erase(sit);
+  }
+  return false;
+}
+
+std::list<MemoryBuffer::SharedBuffer>::iterator MemoryBuffer::findSharedBuffer(VkDevice device, const MemoryBufferInternal& internals)
+{
+  if (internals.buffer == VK_NULL_HANDLE)
+    return end(sharedBuffers);
+  return std::find_if(begin(sharedBuffers), end(sharedBuffers), [&](const SharedBuffer& sb) { return sb.device == device && sb.internals.buffer == internals.buffer && sb.internals.bufferOffset == internals.bufferOffset; });
+}
+
+void MemoryBuffer::releaseBuffer(const RenderContext& renderContext, MemoryBufferInternal& internals)
+{
+  auto sit = findSharedBuffer(renderContext.vkDevice, internals);
+  if (sit != end(sharedBuffers))
+  {
+    // surface that stops using the buffer may still have frames in flight that refer to it
+    sit->releaseFrameNumber = renderContext.device->getFrameNumber();
+    if (--sit->userCount == 0)
+      releasedSharedBuffers.splice(end(releasedSharedBuffers), sharedBuffers, sit);
+    internals = MemoryBufferInternal();
+    return;
+  }
+  destroyBuffer(renderContext.vkDevice, internals);
+}
+
+// buffer is copied to memory reserved by allocator. Only buffers created for each swapchain image are relocatable,
+// so the old buffer is not used by GPU when validate() is called for its index. Copy is recorded into relocation command buffer of the device
+// and the old buffer is destroyed when GPU finishes the frame in which the copy was submitted
+void MemoryBuffer::relocate(const RenderContext& renderContext, MemoryBufferInternal& internals)
+{
+  // buffer shared between surfaces may be still used by GPU
+  if (internals.pooled || findSharedBuffer(renderContext.vkDevice, internals) != end(sharedBuffers))
+    return;
+  DeviceMemoryBlock newMemoryBlock = allocator->acquireRelocation(renderContext.vkDevice, internals.memoryBlock);
+  if (newMemoryBlock.alignedSize == 0)
+    return;
+  // buffer is not moved until its data is sent by upload manager
+  auto uploadManager = renderContext.device->getUploadManager();
+  if (uploadManager != nullptr && uploadManager->hasPendingCopies(internals.buffer))
+  {
+    allocator->deallocate(renderContext.vkDevice, newMemoryBlock);
+    return;
+  }
+
+  VkBuffer newBuffer;
+  VkBufferCreateInfo bufferCreateInfo{};
+    bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferCreateInfo.usage = bufferUsage;
+    bufferCreateInfo.size  = internals.capacity;
+  if (uploadManager != nullptr)
+    uploadManager->setSharingMode(bufferCreateInfo);
+  VK_CHECK_LOG_THROW(vkCreateBuffer(renderContext.vkDevice, &bufferCreateInfo, nullptr, &newBuffer), "Cannot create a buffer");
+  allocator->bindBufferMemory(renderContext.device, newBuffer, newMemoryBlock);
+
+  VkBuffer          oldBuffer      = internals.buffer;
+  DeviceMemoryBlock oldMemoryBlock = internals.memoryBlock;
+  VkDevice          vkDevice       = renderContext.vkDevice;
+  auto              oldAllocator   = allocator;
+  VkBufferCopy copyRegion{};
+    copyRegion.size = internals.dataSize;
+  renderContext.device->recordRelocation(renderContext.commandPool,
+    [oldBuffer, newBuffer, copyRegion](CommandBuffer* commandBuffer) { commandBuffer->cmdCopyBuffer(oldBuffer, newBuffer, copyRegion); },
+    [vkDevice, oldBuffer, oldMemoryBlock, oldAllocator]() { vkDestroyBuffer(vkDevice, oldBuffer, nullptr); oldAllocator->deallocate(vkDevice, oldMemoryBlock); });
+
+  internals.buffer      = newBuffer;
+  internals.memoryBlock = newMemoryBlock;
+
+  notifyCommandBufferSources(renderContext);
+  notifyBufferViews(renderContext, BufferSubresourceRange(0, internals.dataSize));
+  notifyResources(renderContext);
+}
+
+void MemoryBuffer::createBuffer(Device* device, MemoryBufferInternal& internals, VkDeviceSize size)
+{
+  internals.uploadManager = device->getUploadManager();
+  if (bufferPool != nullptr && bufferPool->allocate(device, size, internals.buffer, internals.bufferOffset, internals.memoryBlock))
+  {
+    internals.dataSize = size;
+    internals.capacity = size;
+    internals.pooled   = true;
+    internals.inUse    = false;
+    return;
+  }
+
+  VkBufferCreateInfo bufferCreateInfo{};
+    bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferCreateInfo.usage = bufferUsage;
+    bufferCreateInfo.size  = size;
+  if (!internals.uploadManager.expired())
+    internals.uploadManager.lock()->setSharingMode(bufferCreateInfo);
+  VK_CHECK_LOG_THROW(vkCreateBuffer(device->device, &bufferCreateInfo, nullptr, &internals.buffer), "Cannot create a buffer");
+  VkMemoryRequirements memReqs;
+  vkGetBufferMemoryRequirements(device->device, internals.buffer, &memReqs);
+  internals.bufferOffset = 0;
+  internals.dataSize     = size;
+  internals.capacity     = size;
+  internals.pooled       = false;
+  internals.inUse        = false;
+  internals.memoryBlock  = allocator->allocate(device, memReqs, isRelocatable());
+  CHECK_LOG_THROW(internals.memoryBlock.alignedSize == 0, "Cannot create a buffer");
+  allocator->bindBufferMemory(device, internals.buffer, internals.memoryBlock);
+}
+
+bool MemoryBuffer::isCopyIdle(const RenderContext& renderContext, const MemoryBufferInternal& internals) const
+{
+  if (!internals.inUse)
+    return true;
+  // copy is used only by frames with the same frame in flight index when the number of copies equals the number of frames in flight.
+  // Validation starts after all surfaces waited for the previous frame with current index ( see Surface::beginFrame() ), so GPU does not read that copy anymore
+  if (swapChainImageBehaviour != swForEachImage || shareSurfaceData || renderContext.activeCount != activeCount)
+    return false;
+  // buffer created per device is used by all surfaces of the device
+  return perObjectBehaviour == pbPerSurface || renderContext.device->getFramesInFlight() == activeCount;
+}
+
+void MemoryBuffer::destroyBuffer(VkDevice device, MemoryBufferInternal& internals)
+{
+  if (internals.buffer == VK_NULL_HANDLE)
+    return;
+  auto uploadManager = internals.uploadManager.lock();
+  if (uploadManager != nullptr)
+    uploadManager->discardBufferCopies(internals.buffer, internals.bufferOffset, internals.capacity);
+  if (internals.pooled)
+  {
+    bufferPool->deallocate(device, internals.bufferOffset);
+  }
+  else
+  {
+    vkDestroyBuffer(device, internals.buffer, nullptr);
+    allocator->deallocate(device, internals.memoryBlock);
+  }
+  internals.buffer       = VK_NULL_HANDLE;
+  internals.bufferOffset = 0;
+  internals.dataSize     = 0;
+  internals.capacity     = 0;
+  internals.memoryBlock  = DeviceMemoryBlock();
+  internals.pooled       = false;
+  internals.inUse        = false;
+}
+
+bool MemoryBuffer::resizeBuffer(const RenderContext& renderContext, MemoryBufferInternal& internals, VkDeviceSize dataSize)
+{
+  // descriptors cannot have empty range
+  dataSize = std::max<VkDeviceSize>(1, dataSize);
+  VkDeviceSize capacity = capacityPolicy.getCapacity(internals.capacity, dataSize);
+  if (internals.buffer != VK_NULL_HANDLE && capacity == internals.capacity)
+  {
+    // buffer stays the same - only descriptors and buffer views must know about new data size
+    if (internals.dataSize != dataSize)
+    {
+      internals.dataSize = dataSize;
+      notifyBufferViews(renderContext, BufferSubresourceRange(0, dataSize));
+      notifyResources(renderContext);
+    }
+    return false;
+  }
+  destroyBuffer(renderContext.vkDevice, internals);
+  createBuffer(renderContext.device, internals, capacity);
+  internals.dataSize = dataSize;
+
+  notifyCommandBufferSources(renderContext);
+  notifyBufferViews(renderContext, BufferSubresourceRange(0, dataSize));
+  notifyResources(renderContext);
+  return true;
 }
 
 void MemoryBuffer::addCommandBufferSource(std::shared_ptr<CommandBufferSource> cbSource)
@@ -214,6 +618,84 @@ void MemoryBuffer::notifyBufferViews(const RenderContext& renderContext, const B
   bufferViews.erase(eit, end(bufferViews));
 }
 
+BufferPool::BufferPool(std::shared_ptr<DeviceMemoryAllocator> a, VkBufferUsageFlags bu, VkDeviceSize ps)
+  : allocator{ a }, bufferUsage{ bu | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT }, poolSize{ ps }
+{
+}
+
+BufferPool::~BufferPool()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  for (auto& pdd : perDeviceData)
+  {
+    vkDestroyBuffer(pdd.first, pdd.second.buffer, nullptr);
+    allocator->deallocate(pdd.first, pdd.second.memoryBlock);
+  }
+}
+
+bool BufferPool::allocate(Device* device, VkDeviceSize size, VkBuffer& buffer, VkDeviceSize& offset, DeviceMemoryBlock& memoryBlock)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  auto pddit = perDeviceData.find(device->device);
+  if (pddit == end(perDeviceData))
+  {
+    PerDeviceData pdd;
+    VkBufferCreateInfo bufferCreateInfo{};
+      bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+      bufferCreateInfo.usage = bufferUsage;
+      bufferCreateInfo.size  = poolSize;
+    auto uploadManager = device->getUploadManager();
+    if (uploadManager != nullptr)
+      uploadManager->setSharingMode(bufferCreateInfo);
+    VK_CHECK_LOG_THROW(vkCreateBuffer(device->device, &bufferCreateInfo, nullptr, &pdd.buffer), "Cannot create a buffer pool");
+    VkMemoryRequirements memReqs;
+    vkGetBufferMemoryRequirements(device->device, pdd.buffer, &memReqs);
+    pdd.memoryBlock = allocator->allocate(device, memReqs);
+    if (pdd.memoryBlock.alignedSize == 0)
+    {
+      vkDestroyBuffer(device->device, pdd.buffer, nullptr);
+      LOG_ERROR << "Cannot allocate memory for buffer pool" << std::endl;
+      return false;
+    }
+    allocator->bindBufferMemory(device, pdd.buffer, pdd.memoryBlock);
+
+    // all alignments are powers of two
+    const VkPhysicalDeviceLimits& limits = device->physical.lock()->properties.limits;
+    pdd.alignment = std::max<VkDeviceSize>({ 16, memReqs.alignment, limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment, limits.minTexelBufferOffsetAlignment });
+    pdd.strategy  = std::make_unique<TLSFAllocationStrategy>(poolSize);
+    pddit = perDeviceData.insert({ device->device, std::move(pdd) }).first;
+  }
+
+  VkMemoryRequirements memReqs{ size, pddit->second.alignment, 0 };
+  DeviceMemoryBlock block = pddit->second.strategy->allocate(VK_NULL_HANDLE, memReqs);
+  if (block.alignedSize == 0)
+    return false;
+  pddit->second.allocations.insert({ block.alignedOffset, block });
+
+  // memory block describes the part of pool memory that belongs to the allocation, so that it may be written and flushed directly
+  const DeviceMemoryBlock& poolBlock = pddit->second.memoryBlock;
+  buffer                          = pddit->second.buffer;
+  offset                          = block.alignedOffset;
+  memoryBlock                     = poolBlock;
+  memoryBlock.realOffset          = poolBlock.alignedOffset + block.alignedOffset;
+  memoryBlock.alignedOffset       = poolBlock.alignedOffset + block.alignedOffset;
+  memoryBlock.realSize            = block.alignedSize;
+  memoryBlock.alignedSize         = block.alignedSize;
+  memoryBlock.mappedMemory        = (poolBlock.mappedMemory != nullptr) ? static_cast<uint8_t*>(poolBlock.mappedMemory) + block.alignedOffset : nullptr;
+  return true;
+}
+
+void BufferPool::deallocate(VkDevice device, VkDeviceSize offset)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  auto pddit = perDeviceData.find(device);
+  CHECK_LOG_THROW(pddit == end(perDeviceData), "BufferPool::deallocate() : unknown device");
+  auto it = pddit->second.allocations.find(offset);
+  CHECK_LOG_THROW(it == end(pddit->second.allocations), "BufferPool::deallocate() : cannot deallocate block that was not allocated : " << offset);
+  pddit->second.strategy->deallocate(it->second);
+  pddit->second.allocations.erase(it);
+}
+
 BufferView::BufferView(std::shared_ptr<MemoryBuffer> b, const BufferSubresourceRange& r, VkFormat f)
   : std::enable_shared_from_this<BufferView>(), memBuffer{ b }, subresourceRange{ r }, format{ f }
 {
@@ -251,9 +733,9 @@ void BufferView::validate(const RenderContext& renderContext)
   }
   memBuffer->validate(renderContext);
   std::lock_guard<std::mutex> lock(mutex);
-  if (memBuffer->getSwapChainImageBehaviour() == swForEachImage && renderContext.imageCount > activeCount)
+  if (memBuffer->getSwapChainImageBehaviour() == swForEachImage && renderContext.activeCount > activeCount)
   {
-    activeCount = renderContext.imageCount;
+    activeCount = renderContext.activeCount;
     for (auto& pdd : perObjectData)
       pdd.second.resize(activeCount);
   }
@@ -276,7 +758,7 @@ void BufferView::validate(const RenderContext& renderContext)
     bufferViewCI.flags  = 0;
     bufferViewCI.buffer = getHandleBuffer(renderContext);
     bufferViewCI.format = format;
-    bufferViewCI.offset = subresourceRange.offset;
+    bufferViewCI.offset = memBuffer->getBufferOffset(renderContext) + subresourceRange.offset;
     bufferViewCI.range  = subresourceRange.range;
   VK_CHECK_LOG_THROW(vkCreateBufferView(pddit->second.device, &bufferViewCI, nullptr, &pddit->second.data[activeIndex].bufferView), "failed vkCreateBufferView");
 
@@ -26,12 +26,16 @@
 #include <pumex/Command.h>
 #include <pumex/RenderContext.h>
 #include <pumex/Resource.h>
+#include <pumex/UploadManager.h>
 #include <pumex/utils/Buffer.h>
 #include <pumex/utils/Log.h>
 #include <algorithm>
 
 using namespace pumex;
 
+// images used as attachments change their layouts during rendering, so they are never relocated
+static const VkImageUsageFlags ATTACHMENT_USAGE_FLAGS = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+
 ImageSubresourceRange::ImageSubresourceRange()
   : aspectMask{ VK_IMAGE_ASPECT_COLOR_BIT }, baseMipLevel{ 0 }, levelCount{ VK_REMAINING_MIP_LEVELS }, baseArrayLayer{ 0 }, layerCount{ VK_REMAINING_ARRAY_LAYERS }
 {
@@ -72,7 +76,13 @@ struct SetImageTraitsOperation : public MemoryImage::Operation
   bool perform(const RenderContext& renderContext, MemoryImage::MemoryImageInternal& internals, std::shared_ptr<CommandBuffer> commandBuffer) override
   {
     internals.image = nullptr; // release image before creating a new one
-    internals.image = std::make_shared<Image>(renderContext.device, imageTraits, owner->getAllocator());
+    auto aliasGroup = owner->getMemoryAliasGroup();
+    if (aliasGroup != nullptr)
+      internals.image = std::make_shared<Image>(renderContext.device, imageTraits, aliasGroup, getKeyID(renderContext, owner->getPerObjectBehaviour()));
+    else
+      internals.image = std::make_shared<Image>(renderContext.device, imageTraits, owner->getAllocator(), owner->isRelocatable(imageTraits));
+    internals.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    internals.inUse  = false;
     owner->notifyCommandBufferSources(renderContext);
     owner->notifyImageViews(renderContext, imageRange);
     // no operations sent to command buffer
@@ -89,6 +99,8 @@ struct SetImageOperation : public MemoryImage::Operation
   bool perform(const RenderContext& renderContext, MemoryImage::MemoryImageInternal& internals, std::shared_ptr<CommandBuffer> commandBuffer) override
   {
     CHECK_LOG_THROW(internals.image == nullptr, "Image was not created before call to setImage operation, which should not happen because this call is made automatically during setImage() setup...");
+    // each way of sending data leaves the image in VK_IMAGE_LAYOUT_GENERAL
+    internals.layout = VK_IMAGE_LAYOUT_GENERAL;
     gli::texture::extent_type extent = texture->extent();
     const ImageTraits& imageTraits   = internals.image->getImageTraits();
     VkExtent3D currExtent            = imageTraits.extent;
@@ -130,13 +142,22 @@ struct SetImageOperation : public MemoryImage::Operation
             bufferCopyRegion.imageExtent.width               = static_cast<uint32_t>(mipMapExtents.x);
             bufferCopyRegion.imageExtent.height              = static_cast<uint32_t>(mipMapExtents.y);
             bufferCopyRegion.imageExtent.depth               = static_cast<uint32_t>(mipMapExtents.z);
-            bufferCopyRegion.bufferOffset                    = offset;
+            bufferCopyRegion.bufferOffset                    = stagingBuffer->offset + offset;
           bufferCopyRegions.push_back(bufferCopyRegion);
     
           // Increase offset into staging buffer for next level / face
           offset += texture->size(level);
         }
       }
+      // images have exclusive sharing mode, so upload manager may copy them only when its queue belongs to the same queue family as other queues.
+      // Upload queue does not wait for frames in flight, so images already used by rendering are updated on the queue of the surface
+      auto uploadManager = renderContext.device->getUploadManager();
+      if (uploadManager != nullptr && uploadManager->sharesQueueFamily() && !internals.inUse)
+      {
+        uploadManager->copyBufferToImage(stagingBuffer, internals.image, aspectMask, bufferCopyRegions);
+        return false;
+      }
+
       // Image barrier for optimal image (target)
       // Optimal image will be used as destination for the copy
       commandBuffer->setImageLayout( *(internals.image), aspectMask, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
@@ -219,6 +240,7 @@ struct ClearImageOperation : public MemoryImage::Operation
     else
       commandBuffer->cmdClearDepthStencilImage(*internals.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, clearValue, subResources);
     commandBuffer->setImageLayout(*(internals.image), imageRange.aspectMask, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL);
+    internals.layout = VK_IMAGE_LAYOUT_GENERAL;
     return true;
   }
   VkClearValue clearValue;
@@ -229,6 +251,9 @@ MemoryImage::MemoryImage(const ImageTraits& it, std::shared_ptr<DeviceMemoryAllo
 {
   if(useSetImageMethods)
     imageTraits.usage = imageTraits.usage | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+  // images created for each swapchain image may be moved during defragmentation - they must be readable by transfer operations. Attachments are never moved
+  if (useSetImageMethods && swapChainImageBehaviour == swForEachImage && (imageTraits.usage & ATTACHMENT_USAGE_FLAGS) == 0)
+    imageTraits.usage = imageTraits.usage | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
 }
 
 MemoryImage::MemoryImage(std::shared_ptr<gli::texture> tex, std::shared_ptr<DeviceMemoryAllocator> a, VkImageAspectFlags am, VkImageUsageFlags iu, PerObjectBehaviour pob)
@@ -290,6 +315,12 @@ void MemoryImage::setImageTraits(Device* device, const ImageTraits& traits)
   internalSetImageTraits(device->getID(), device->device, VK_NULL_HANDLE, traits, aspectMask);
 }
 
+void MemoryImage::setMemoryAliasGroup(std::shared_ptr<ImageMemoryAliasGroup> aliasGroup)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  memoryAliasGroup = aliasGroup;
+}
+
 void MemoryImage::invalidateImage()
 {
   CHECK_LOG_THROW(texture == nullptr, "Cannot invalidate texture - wrong constructor used to create an object");
@@ -413,15 +444,15 @@ Image* MemoryImage::getImage(const RenderContext& renderContext) const
   auto pddit = perObjectData.find(getKeyID(renderContext, perObjectBehaviour));
   if (pddit == end(perObjectData))
     return nullptr;
-  return pddit->second.data[renderContext.activeIndex % activeCount].image.get();
+  return pddit->second.data[getActiveIndex(renderContext, swapChainImageBehaviour) % activeCount].image.get();
 }
 
 void MemoryImage::validate(const RenderContext& renderContext)
 {
   std::lock_guard<std::mutex> lock(mutex);
-  if (swapChainImageBehaviour == swForEachImage && renderContext.imageCount > activeCount)
+  if (getActiveCount(renderContext, swapChainImageBehaviour) > activeCount)
   {
-    activeCount = renderContext.imageCount;
+    activeCount = getActiveCount(renderContext, swapChainImageBehaviour);
     for (auto& pdd : perObjectData)
     {
       pdd.second.resize(activeCount);
@@ -433,7 +464,10 @@ void MemoryImage::validate(const RenderContext& renderContext)
   auto pddit = perObjectData.find(keyValue);
   if (pddit == end(perObjectData))
     pddit = perObjectData.insert({ keyValue, MemoryImageData(renderContext, swapChainImageBehaviour) }).first;
-  uint32_t activeIndex = renderContext.activeIndex % activeCount;
+  uint32_t activeIndex = getActiveIndex(renderContext, swapChainImageBehaviour) % activeCount;
+  // allocator may ask to move the image during defragmentation
+  if (pddit->second.data[activeIndex].image != nullptr)
+    relocate(renderContext, pddit->second.data[activeIndex]);
   if (pddit->second.valid[activeIndex])
     return;
 
@@ -447,7 +481,15 @@ void MemoryImage::validate(const RenderContext& renderContext)
   // images are created here, when MemoryImage uses sameTraitsPerObject - otherwise it's a reponsibility of the user to create them through setImageTraits() call
   if (pddit->second.data[activeIndex].image == nullptr && sameTraitsPerObject)
   {
-    pddit->second.data[activeIndex].image = std::make_shared<Image>(renderContext.device, imageTraits, allocator);
+    if (memoryAliasGroup != nullptr)
+    {
+      memoryAliasGroup->setImageTraits(keyValue, this, imageTraits);
+      pddit->second.data[activeIndex].image = std::make_shared<Image>(renderContext.device, imageTraits, memoryAliasGroup, keyValue);
+    }
+    else
+      pddit->second.data[activeIndex].image = std::make_shared<Image>(renderContext.device, imageTraits, allocator, isRelocatable(imageTraits));
+    pddit->second.data[activeIndex].layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    pddit->second.data[activeIndex].inUse  = false;
     notifyCommandBufferSources(renderContext);
     notifyImageViews(renderContext, ImageSubresourceRange(aspectMask, 0, imageTraits.mipLevels, 0, imageTraits.arrayLayers));
     // if there's a texture - it must be sent now
@@ -475,7 +517,60 @@ void MemoryImage::validate(const RenderContext& renderContext)
     // if all operations are done for each index - remove them from list
     pddit->second.commonData.imageOperations.remove_if(([](std::shared_ptr<Operation> texop) { return texop->allUpdated(); }));
   }
-  pddit->second.valid[activeIndex] = true;
+  pddit->second.data[activeIndex].inUse = true;
+  pddit->second.valid[activeIndex]      = true;
+}
+
+bool MemoryImage::isRelocatable(const ImageTraits& traits) const
+{
+  return swapChainImageBehaviour == swForEachImage && memoryAliasGroup == nullptr && (traits.usage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) != 0 && (traits.usage & ATTACHMENT_USAGE_FLAGS) == 0;
+}
+
+// image is copied to memory reserved by allocator. Relocatable images are not attachments, so they stay in the layout left by the last
+// SetImage/ClearImage operation. Only images created for each swapchain image are relocatable, so the old image is not used by GPU.
+// Copy is recorded into relocation command buffer of the device and the old image is destroyed when GPU finishes the frame in which the copy was submitted
+void MemoryImage::relocate(const RenderContext& renderContext, MemoryImageInternal& internals)
+{
+  DeviceMemoryBlock newMemoryBlock = allocator->acquireRelocation(renderContext.vkDevice, internals.image->getMemoryBlock());
+  if (newMemoryBlock.alignedSize == 0)
+    return;
+  const ImageTraits& traits = internals.image->getImageTraits();
+  auto newImage = std::make_shared<Image>(renderContext.device, traits, allocator, newMemoryBlock);
+  auto oldImage = internals.image;
+  internals.image = newImage;
+
+  std::vector<VkImageCopy> copyRegions;
+  for (uint32_t level = 0; level < traits.mipLevels; ++level)
+  {
+    VkImageCopy copyRegion{};
+      copyRegion.srcSubresource.aspectMask     = aspectMask;
+      copyRegion.srcSubresource.mipLevel       = level;
+      copyRegion.srcSubresource.baseArrayLayer = 0;
+      copyRegion.srcSubresource.layerCount     = traits.arrayLayers;
+      copyRegion.dstSubresource                = copyRegion.srcSubresource;
+      copyRegion.extent.width                  = std::max(1u, traits.extent.width >> level);
+      copyRegion.extent.height                 = std::max(1u, traits.extent.height >> level);
+      copyRegion.extent.depth                  = std::max(1u, traits.extent.depth >> level);
+    copyRegions.push_back(copyRegion);
+  }
+  VkImageLayout      layout = internals.layout;
+  VkImageAspectFlags am     = aspectMask;
+  renderContext.device->recordRelocation(renderContext.commandPool,
+    [oldImage, newImage, layout, am, copyRegions](CommandBuffer* commandBuffer)
+    {
+      // image that was never filled has no content to copy
+      if (layout == VK_IMAGE_LAYOUT_UNDEFINED)
+        return;
+      commandBuffer->setImageLayout(*oldImage, am, layout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+      commandBuffer->setImageLayout(*newImage, am, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+      commandBuffer->cmdCopyImage(*oldImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, *newImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, copyRegions);
+      commandBuffer->setImageLayout(*newImage, am, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, layout);
+    },
+    // old image lives until GPU finishes the copy, then it returns its memory to allocator
+    [oldImage]() {});
+
+  notifyCommandBufferSources(renderContext);
+  notifyImageViews(renderContext, ImageSubresourceRange(aspectMask, 0, traits.mipLevels, 0, traits.arrayLayers));
 }
 
 ImageSubresourceRange MemoryImage::getFullImageRange()
@@ -529,6 +624,9 @@ void MemoryImage::internalSetImageTraits(uint32_t key, VkDevice device, VkSurfac
 
   // remove all previous calls to setImageTraits
   pddit->second.commonData.imageOperations.remove_if([](std::shared_ptr<Operation> texop) { return texop->type == MemoryImage::Operation::SetImageTraits; });
+  // images sharing memory must know each other's traits before memory is allocated
+  if (memoryAliasGroup != nullptr)
+    memoryAliasGroup->setImageTraits(key, this, traits);
   // add setImageTraits operation
   pddit->second.commonData.imageOperations.push_back(std::make_shared<SetImageTraitsOperation>(this, traits, aMask, activeCount));
   pddit->second.invalidate();
@@ -566,7 +664,7 @@ void MemoryImage::internalSetImages(uint32_t key, VkDevice device, VkSurfaceKHR
     CHECK_LOG_THROW(images[i]->getDevice() != device, "Cannot set foreign images for this texture - mismatched devices");
   }
 
-  if (swapChainImageBehaviour == swForEachImage && images.size() > activeCount)
+  if (swapChainImageBehaviour != swOnce && images.size() > activeCount)
   {
     activeCount = images.size();
     for (auto& pdd : perObjectData)
@@ -581,8 +679,10 @@ void MemoryImage::internalSetImages(uint32_t key, VkDevice device, VkSurfaceKHR
     pddit = perObjectData.insert({ key, MemoryImageData(device, surface, activeCount, swapChainImageBehaviour) }).first;
   for (uint32_t i = 0; i < images.size(); i++)
   {
-    pddit->second.data[i].image = nullptr;
-    pddit->second.data[i].image = images[i];
+    pddit->second.data[i].image  = nullptr;
+    pddit->second.data[i].image  = images[i];
+    pddit->second.data[i].layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    pddit->second.data[i].inUse  = false;
   }
   pddit->second.commonData.imageOperations.clear();
   ImageSubresourceRange range(aspectMask, 0, images[0]->getImageTraits().mipLevels, 0, images[0]->getImageTraits().arrayLayers);
@@ -636,7 +736,7 @@ VkImageView ImageView::getImageView(const RenderContext& renderContext) const
   auto pddit = perObjectData.find(keyValue);
   if (pddit == perObjectData.end())
     return VK_NULL_HANDLE;
-  uint32_t activeIndex = renderContext.activeIndex % activeCount;
+  uint32_t activeIndex = getActiveIndex(renderContext, memoryImage->getSwapChainImageBehaviour()) % activeCount;
   return pddit->second.data[activeIndex].imageView;
 }
 
@@ -649,9 +749,9 @@ void ImageView::validate(const RenderContext& renderContext)
   }
   memoryImage->validate(renderContext);
   std::lock_guard<std::mutex> lock(mutex);
-  if (memoryImage->getSwapChainImageBehaviour() == swForEachImage && renderContext.imageCount > activeCount)
+  if (getActiveCount(renderContext, memoryImage->getSwapChainImageBehaviour()) > activeCount)
   {
-    activeCount = renderContext.imageCount;
+    activeCount = getActiveCount(renderContext, memoryImage->getSwapChainImageBehaviour());
     for (auto& pdd : perObjectData)
       pdd.second.resize(activeCount);
   }
@@ -659,7 +759,7 @@ void ImageView::validate(const RenderContext& renderContext)
   auto pddit = perObjectData.find(keyValue);
   if (pddit == end(perObjectData))
     pddit = perObjectData.insert({ keyValue, ImageViewData(renderContext, memoryImage->getSwapChainImageBehaviour()) }).first;
-  uint32_t activeIndex = renderContext.activeIndex % activeCount;
+  uint32_t activeIndex = getActiveIndex(renderContext, memoryImage->getSwapChainImageBehaviour()) % activeCount;
   if (pddit->second.valid[activeIndex])
     return;
 
@@ -41,7 +41,7 @@ MemoryObjectBarrier::MemoryObjectBarrier(VkAccessFlags sam, VkAccessFlags dam, u
 
 MemoryObjectBarrier::MemoryObjectBarrier(const MemoryObjectBarrier& rhs)
   : objectType(rhs.objectType), srcAccessMask{ rhs.srcAccessMask }, dstAccessMask{ rhs.dstAccessMask }, srcQueueFamilyIndex{ rhs.srcQueueFamilyIndex }, dstQueueFamilyIndex{ rhs.dstQueueFamilyIndex }, memoryObject{ rhs.memoryObject },
-    oldLayout{ rhs.oldLayout }, newLayout{ rhs.newLayout }, imageRange{ rhs.imageRange }, bufferRange{ rhs.bufferRange }
+    queueTransfer{ rhs.queueTransfer }, oldLayout{ rhs.oldLayout }, newLayout{ rhs.newLayout }, imageRange{ rhs.imageRange }, bufferRange{ rhs.bufferRange }
 {
 }
 
@@ -55,6 +55,7 @@ MemoryObjectBarrier& MemoryObjectBarrier::operator=(const MemoryObjectBarrier& r
     srcQueueFamilyIndex   = rhs.srcQueueFamilyIndex;
     dstQueueFamilyIndex   = rhs.dstQueueFamilyIndex;
     memoryObject          = rhs.memoryObject;
+    queueTransfer         = rhs.queueTransfer;
     oldLayout             = rhs.oldLayout;
     newLayout             = rhs.newLayout;
     imageRange            = rhs.imageRange;
@@ -118,9 +118,9 @@ std::shared_ptr<DescriptorSet> Node::getDescriptorSet(uint32_t index)
 bool Node::nodeValidate(const RenderContext& renderContext)
 {
   std::lock_guard<std::mutex> lock(mutex);
-  if (activeCount < renderContext.imageCount)
+  if (activeCount < renderContext.activeCount)
   {
-    activeCount = renderContext.imageCount;
+    activeCount = renderContext.activeCount;
     for (auto& pdd : perObjectData)
       pdd.second.resize(activeCount);
   }
@@ -165,9 +165,9 @@ void Node::invalidateNodeAndParents()
 
 void Node::invalidateNodeAndParents(Surface* surface)
 {
-  if (activeCount < surface->getImageCount())
+  if (activeCount < surface->getFramesInFlight())
   {
-    activeCount = surface->getImageCount();
+    activeCount = surface->getFramesInFlight();
     for (auto& pdd : perObjectData)
       pdd.second.resize(activeCount);
   }
@@ -199,9 +199,9 @@ void Node::invalidateDescriptorsAndParents()
 
 void Node::invalidateDescriptorsAndParents(Surface* surface)
 {
-  if (activeCount < surface->getImageCount())
+  if (activeCount < surface->getFramesInFlight())
   {
-    activeCount = surface->getImageCount();
+    activeCount = surface->getFramesInFlight();
     for (auto& pdd : perObjectData)
       pdd.second.resize(activeCount);
   }
@@ -235,9 +235,9 @@ void Node::useSecondaryBuffer()
 std::shared_ptr<CommandBuffer> Node::getSecondaryBuffer(const RenderContext& renderContext)
 { 
   std::lock_guard<std::mutex> lock(mutex);
-  if (activeCount < renderContext.imageCount)
+  if (activeCount < renderContext.activeCount)
   {
-    activeCount = renderContext.imageCount;
+    activeCount = renderContext.activeCount;
     for (auto& pdd : perObjectData)
       pdd.second.resize(activeCount);
   }
@@ -257,9 +257,9 @@ std::shared_ptr<CommandBuffer> Node::getSecondaryBuffer(const RenderContext& ren
 std::shared_ptr<CommandPool> Node::getSecondaryCommandPool(const RenderContext& renderContext)
 {
   std::lock_guard<std::mutex> lock(mutex);
-  if (activeCount < renderContext.imageCount)
+  if (activeCount < renderContext.activeCount)
   {
-    activeCount = renderContext.imageCount;
+    activeCount = renderContext.activeCount;
     for (auto& pdd : perObjectData)
       pdd.second.resize(activeCount);
   }
@@ -302,9 +302,9 @@ void Node::invalidateParentsNode()
 
 void Node::invalidateParentsNode(Surface* surface)
 {
-  if (activeCount < surface->getImageCount())
+  if (activeCount < surface->getFramesInFlight())
   {
-    activeCount = surface->getImageCount();
+    activeCount = surface->getFramesInFlight();
     for (auto& pdd : perObjectData)
       pdd.second.resize(activeCount);
   }
@@ -354,9 +354,9 @@ void Node::invalidateParentsDescriptor()
 
 void Node::invalidateParentsDescriptor(Surface* surface)
 {
-  if (activeCount < surface->getImageCount())
+  if (activeCount < surface->getFramesInFlight())
   {
-    activeCount = surface->getImageCount();
+    activeCount = surface->getFramesInFlight();
     for (auto& pdd : perObjectData)
       pdd.second.resize(activeCount);
   }
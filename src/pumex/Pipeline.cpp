@@ -227,9 +227,9 @@ void GraphicsPipeline::validate(const RenderContext& renderContext)
   pipelineCache->validate(renderContext);
   pipelineLayout->validate(renderContext);
 
-  if (renderContext.imageCount > activeCount)
+  if (renderContext.activeCount > activeCount)
   {
-    activeCount = renderContext.imageCount;
+    activeCount = renderContext.activeCount;
     for (auto& pdd : perDeviceData)
       pdd.second.resize(activeCount);
   }
@@ -266,7 +266,7 @@ void GraphicsPipeline::validate(const RenderContext& renderContext)
   {
     VkVertexInputBindingDescription inputDescription{};
       inputDescription.binding                 = state.binding;
-      inputDescription.stride                  = calcVertexSize(state.semantic) * sizeof(float);
+      inputDescription.stride                  = calcVertexByteSize(state.semantic);
       inputDescription.inputRate               = state.inputRate;
     bindingDescriptions.emplace_back(inputDescription);
 
@@ -274,7 +274,7 @@ void GraphicsPipeline::validate(const RenderContext& renderContext)
     uint32_t attribLocation = 0;
     for (const auto& attrib : state.semantic)
     {
-      uint32_t attribSize = attrib.size * sizeof(float);
+      uint32_t attribSize = attrib.getByteSize();
       VkVertexInputAttributeDescription inputAttribDescription{};
         inputAttribDescription.location        = attribLocation++;
         inputAttribDescription.binding         = state.binding;
@@ -450,9 +450,9 @@ void ComputePipeline::validate(const RenderContext& renderContext)
   pipelineCache->validate(renderContext);
   pipelineLayout->validate(renderContext);
 
-  if (renderContext.imageCount > activeCount)
+  if (renderContext.activeCount > activeCount)
   {
-    activeCount = renderContext.imageCount;
+    activeCount = renderContext.activeCount;
     for (auto& pdd : perDeviceData)
       pdd.second.resize(activeCount);
   }
@@ -0,0 +1,145 @@
+//
+// Copyright(c) 2017-2018 Paweł Księżopolski ( pumexx )
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+
+
+#include <pumex/ReadbackManager.h>
+#include <algorithm>
+#include <pumex/Device.h>
+#include <pumex/Command.h>
+#include <pumex/MemoryBuffer.h>
+#include <pumex/RenderContext.h>
+#include <pumex/utils/Buffer.h>
+#include <pumex/utils/Log.h>
+
+using namespace pumex;
+
+ReadbackManager::ReadbackManager(Device* d, uint32_t framesInFlight, VkDeviceSize ringSize)
+  : device{ d }, recordedRequests(framesInFlight), recordedCopies(framesInFlight, false)
+{
+  if (ringSize > 0)
+    readbackRing = std::make_unique<StagingRing>(device, ringSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+}
+
+ReadbackManager::~ReadbackManager()
+{
+  // readback buffers must be destroyed before the ring they were allocated from
+  pendingRequests.clear();
+  recordedRequests.clear();
+}
+
+void ReadbackManager::readBuffer(std::shared_ptr<MemoryBuffer> memoryBuffer, VkDeviceSize offset, VkDeviceSize size, Callback callback)
+{
+  CHECK_LOG_THROW(memoryBuffer == nullptr, "ReadbackManager::readBuffer() : memory buffer not defined");
+  CHECK_LOG_THROW((memoryBuffer->getBufferUsage() & VK_BUFFER_USAGE_TRANSFER_SRC_BIT) == 0, "ReadbackManager::readBuffer() : memory buffer must have VK_BUFFER_USAGE_TRANSFER_SRC_BIT usage");
+  Request request;
+    request.memoryBuffer = memoryBuffer;
+    request.offset       = offset;
+    request.size         = size;
+    request.callback     = callback;
+  std::lock_guard<std::mutex> lock(mutex);
+  pendingRequests.push_back(request);
+}
+
+std::future<std::vector<uint8_t>> ReadbackManager::readBuffer(std::shared_ptr<MemoryBuffer> memoryBuffer, VkDeviceSize offset, VkDeviceSize size)
+{
+  auto promise = std::make_shared<std::promise<std::vector<uint8_t>>>();
+  auto result  = promise->get_future();
+  readBuffer(memoryBuffer, offset, size, [promise](const void* data, VkDeviceSize dataSize)
+  {
+    auto bytes = static_cast<const uint8_t*>(data);
+    promise->set_value(std::vector<uint8_t>(bytes, bytes + dataSize));
+  });
+  return result;
+}
+
+bool ReadbackManager::needsRecording(uint32_t frameIndex) const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return !pendingRequests.empty() || recordedCopies[frameIndex % recordedCopies.size()] != 0;
+}
+
+void ReadbackManager::recordCopies(const RenderContext& renderContext, CommandBuffer* commandBuffer)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  uint32_t frameIndex = renderContext.activeIndex % recordedRequests.size();
+  std::vector<Request> waitingRequests;
+  std::vector<std::pair<std::pair<VkBuffer, VkBuffer>, VkBufferCopy>> copies;
+  for (auto& request : pendingRequests)
+  {
+    VkBuffer srcBuffer = request.memoryBuffer->getHandleBuffer(renderContext);
+    if (srcBuffer == VK_NULL_HANDLE)
+    {
+      waitingRequests.push_back(request);
+      continue;
+    }
+    VkDeviceSize dataSize = request.memoryBuffer->getDataSizeRC(renderContext);
+    request.readbackSize  = (request.offset < dataSize) ? std::min(request.size, dataSize - request.offset) : 0;
+    if (request.readbackSize > 0)
+    {
+      // large readbacks would exhaust the ring, so they get dedicated buffers ( the same happens when the ring is full )
+      if (readbackRing != nullptr && request.readbackSize <= readbackRing->getSize() / 4)
+        request.readbackBuffer = readbackRing->allocate(request.readbackSize);
+      if (request.readbackBuffer == nullptr)
+        request.readbackBuffer = std::make_shared<StagingBuffer>(device, request.readbackSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+      copies.push_back({ { srcBuffer, request.readbackBuffer->buffer }, VkBufferCopy{ request.memoryBuffer->getBufferOffset(renderContext) + request.offset, request.readbackBuffer->offset, request.readbackSize } });
+    }
+    recordedRequests[frameIndex].push_back(request);
+  }
+  pendingRequests = waitingRequests;
+  recordedCopies[frameIndex] = !copies.empty();
+  if (copies.empty())
+    return;
+
+  // present command buffer is submitted after all other submissions of a frame have finished
+  commandBuffer->cmdPipelineBarrier(VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, PipelineBarrier(VK_ACCESS_MEMORY_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT));
+  for (auto& copy : copies)
+    commandBuffer->cmdCopyBuffer(copy.first.first, copy.first.second, copy.second);
+  commandBuffer->cmdPipelineBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, PipelineBarrier(VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_HOST_READ_BIT));
+}
+
+void ReadbackManager::frameFinished(uint32_t frameIndex, uint64_t frameNumber, uint64_t completedFrameNumber)
+{
+  std::vector<Request> finishedRequests;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (readbackRing != nullptr)
+      readbackRing->beginFrame(frameNumber, completedFrameNumber);
+    finishedRequests.swap(recordedRequests[frameIndex % recordedRequests.size()]);
+  }
+  // callbacks are called without lock, so that they may request next readbacks
+  for (auto& request : finishedRequests)
+  {
+    if (request.readbackBuffer != nullptr)
+    {
+      // readback memory is host cached when possible, so it may be not coherent
+      request.readbackBuffer->invalidateMemory(request.readbackSize);
+      request.callback(request.readbackBuffer->mapMemory(request.readbackSize), request.readbackSize);
+    }
+    else
+      request.callback(nullptr, 0);
+  }
+  std::lock_guard<std::mutex> lock(mutex);
+  for (auto& request : finishedRequests)
+    if (request.readbackBuffer != nullptr && request.readbackBuffer->isRingAllocated())
+      readbackRing->deallocate(*request.readbackBuffer);
+}
@@ -33,7 +33,7 @@ using namespace pumex;
 RenderContext::RenderContext(Surface* s, uint32_t queueNumber)
   : surface { s }, vkSurface{ s->surface }, commandPool{ s->commandPools[queueNumber] }, queue{s->queues[queueNumber]->queue},
     device{ s->device.lock().get() }, vkDevice{ device->device }, descriptorPool{ device->getDescriptorPool().get() },
-    activeIndex{ s->getImageIndex() }, imageCount{ s->getImageCount() }
+    activeIndex{ s->getFrameIndex() }, activeCount{ s->getFramesInFlight() }, imageIndex{ s->getImageIndex() }, imageCount{ s->getImageCount() }
 {
 }
 
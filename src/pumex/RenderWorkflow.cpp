@@ -24,6 +24,8 @@
 #include <algorithm>
 #include <sstream>
 #include <iterator>
+#include <queue>
+#include <tuple>
 #include <pumex/Device.h>
 #include <pumex/DeviceMemoryAllocator.h>
 #include <pumex/FrameBuffer.h>
@@ -123,6 +125,11 @@ ResourceTransition::~ResourceTransition()
 {
 }
 
+QueueSubmission::QueueSubmission(uint32_t qn)
+  : queueNumber{ qn }
+{
+}
+
 RenderWorkflowResults::RenderWorkflowResults()
 {
 }
@@ -587,60 +594,70 @@ float StandardRenderWorkflowCostCalculator::calculateWorkflowCost(const RenderWo
   return result;
 }
 
-std::vector<std::shared_ptr<RenderOperation>> recursiveScheduleOperations(const RenderWorkflow& workflow, const std::set<std::shared_ptr<RenderOperation>>& doneOperations, StandardRenderWorkflowCostCalculator* costCalculator)
+std::vector<std::shared_ptr<RenderOperation>> scheduleOperations(const RenderWorkflow& workflow, const StandardRenderWorkflowCostCalculator& costCalculator)
 {
-  std::set<std::shared_ptr<RenderOperation>> newDoneOperations;
+  // List scheduling ( Kahn's algorithm with priorities ) :
+  // - operation is ready when all operations generating its inputs are already scheduled
+  // - from all ready operations we prefer the one with the same tag as the last scheduled operation ( subpass grouping )
+  // - if there's no such operation - we choose the tag that is shared by the largest number of ready operations
+  // Complexity is O(n^2 + e) where n is the number of operations and e is the number of edges in a workflow graph
   auto operationNames = workflow.getRenderOperationNames();
-  if (doneOperations.empty())
+  std::sort(begin(operationNames), end(operationNames));
+
+  std::unordered_map<std::string, uint32_t>     operationIndex;
+  std::vector<std::shared_ptr<RenderOperation>> operations;
+  for (auto& operationName : operationNames)
   {
-    for (auto& operationName : operationNames)
+    operationIndex.insert({ operationName, static_cast<uint32_t>(operations.size()) });
+    operations.push_back(workflow.getRenderOperation(operationName));
+  }
+
+  std::vector<std::vector<uint32_t>> nextOperations(operations.size());
+  std::vector<uint32_t>              inputCount(operations.size(), 0);
+  std::vector<int>                   tags(operations.size(), -1);
+  for (uint32_t i = 0; i < operations.size(); ++i)
+  {
+    tags[i] = costCalculator.attachmentTag.at(operations[i]->name);
+    for (auto& nextOp : workflow.getNextOperations(operations[i]->name))
     {
-      auto operation = workflow.getRenderOperation(operationName);
-      auto nextOperations = workflow.getNextOperations(operationName);
-      if (nextOperations.empty())
-        newDoneOperations.insert(operation);
+      uint32_t j = operationIndex.at(nextOp->name);
+      nextOperations[i].push_back(j);
+      inputCount[j]++;
     }
   }
-  else
+
+  std::vector<uint32_t> readyOperations;
+  for (uint32_t i = 0; i < operations.size(); ++i)
+    if (inputCount[i] == 0)
+      readyOperations.push_back(i);
+
+  std::vector<std::shared_ptr<RenderOperation>> results;
+  std::unordered_map<int, uint32_t>             readyTagCount;
+  int lastTag = -1;
+  while (!readyOperations.empty())
   {
-    for (auto& operationName : operationNames)
+    auto chosen = std::find_if(begin(readyOperations), end(readyOperations), [&tags, lastTag](uint32_t i) { return tags[i] == lastTag; });
+    if (chosen == end(readyOperations))
     {
-      auto operation = workflow.getRenderOperation(operationName);
-      if (doneOperations.find(operation) != end(doneOperations))
-        continue;
-      auto nextOperations = workflow.getNextOperations(operationName);
-      bool final = true;
-      // check if ALL outputs point at operations in doneOperations
-      for (auto& nextOp : nextOperations)
-      {
-        if (doneOperations.find(nextOp) == end(doneOperations))
-        {
-          final = false;
-          break;
-        }
-      }
-      if (final)
-        newDoneOperations.insert(operation);
+      readyTagCount.clear();
+      for (auto i : readyOperations)
+        readyTagCount[tags[i]]++;
+      chosen = begin(readyOperations);
+      for (auto it = begin(readyOperations); it != end(readyOperations); ++it)
+        if (readyTagCount[tags[*it]] > readyTagCount[tags[*chosen]])
+          chosen = it;
     }
+    uint32_t opIndex = *chosen;
+    readyOperations.erase(chosen);
+    results.push_back(operations[opIndex]);
+    lastTag = tags[opIndex];
+
+    for (auto nextOp : nextOperations[opIndex])
+      if (--inputCount[nextOp] == 0)
+        readyOperations.push_back(nextOp);
   }
-  if (newDoneOperations.empty())
-    return std::vector<std::shared_ptr<RenderOperation>>();
-
-  std::vector<std::vector<std::shared_ptr<RenderOperation>>> results;
-  std::vector<float> cost;
-  for (const auto& x : newDoneOperations)
-  {
-    auto a = doneOperations;
-    a.insert(x);
-    auto xx = recursiveScheduleOperations(workflow, a, costCalculator);
-    xx.push_back(x);
-    cost.push_back(costCalculator->calculateWorkflowCost(workflow, xx));
-    results.push_back(xx);
-  }
-  // return a result with lowest cost
-  auto minit = std::min_element(begin(cost), end(cost));
-  auto i = std::distance(begin(cost), minit);
-  return results[i];
+  CHECK_LOG_THROW(results.size() != operations.size(), "RenderWorkflow : cannot schedule operations. Workflow contains a loop");
+  return results;
 }
 
 std::shared_ptr<RenderWorkflowResults> SingleQueueWorkflowCompiler::compile(RenderWorkflow& workflow)
@@ -667,16 +684,9 @@ std::shared_ptr<RenderWorkflowResults> SingleQueueWorkflowCompiler::compile(Rend
   // - two graphics operations with different attachment size get different tag
   costCalculator.tagOperationByAttachmentType(workflow);
 
-  // Build a vector storing proper sequence of operations - FIXME : IT ONLY WORKS FOR ONE QUEUE NOW.
-  // TARGET FOR THE FUTURE  : build as many operation sequences as there is queues, take VkQueueFlags into consideration
-  // ( be aware that scheduling algorithms may be NP-complete ).
+  // Build a vector storing proper sequence of operations for each queue ( sequence index is equal to queue index )
   std::vector<std::vector<std::shared_ptr<RenderOperation>>> operationSequences;
-  {
-    // FIXME : IT ONLY GENERATES ONE SEQUENCE NOW, ALSO IGNORES TYPE OF THE QUEUE
-    std::set<std::shared_ptr<RenderOperation>> doneOperations;
-    auto operationSequence = recursiveScheduleOperations(workflow, doneOperations, &costCalculator);
-    operationSequences.push_back(operationSequence);
-  }
+  createOperationSequences(workflow, operationSequences);
 
   // find resources that may be reused
   findAliasedResources(workflow, operationSequences, workflowResults);
@@ -719,9 +729,153 @@ std::shared_ptr<RenderWorkflowResults> SingleQueueWorkflowCompiler::compile(Rend
   // create pipeline barriers
   createPipelineBarriers(workflow, commands, workflowResults);
 
+  // images sharing memory must not overwrite each other
+  createMemoryAliasDependencies(workflow, commands, workflowResults);
+
+  // divide command sequences into queue submissions synchronized with semaphores
+  createQueueSubmissions(workflow, commands, workflowResults);
+
   return workflowResults;
 }
 
+void SingleQueueWorkflowCompiler::createOperationSequences(const RenderWorkflow& workflow, std::vector<std::vector<std::shared_ptr<RenderOperation>>>& operationSequences)
+{
+  // all operations are sent to the first queue ( be aware that optimal scheduling is NP-complete - we use list scheduling heuristic instead )
+  operationSequences.clear();
+  operationSequences.push_back(scheduleOperations(workflow, costCalculator));
+}
+
+void SingleQueueWorkflowCompiler::createQueueSubmissions(const RenderWorkflow& workflow, const std::vector<std::vector<std::shared_ptr<RenderCommand>>>& commandSequences, std::shared_ptr<RenderWorkflowResults> workflowResults)
+{
+  std::map<std::string, std::pair<uint32_t, uint32_t>> commandPosition;
+  for (uint32_t i = 0; i < commandSequences.size(); ++i)
+    for (uint32_t j = 0; j < commandSequences[i].size(); ++j)
+      commandPosition.insert({ commandSequences[i][j]->operation->name, { i, j } });
+
+  // Render pass must begin and end in the same command buffer, so command sequence may only be divided between render passes.
+  // Submission that generates a resource for other queue may end later and the submission that consumes it may start earlier
+  auto isInsideRenderPass = [&commandSequences](uint32_t queueIndex, uint32_t commandIndex) -> bool
+  {
+    if (commandIndex == 0 || commandIndex >= commandSequences[queueIndex].size())
+      return false;
+    auto subpass = commandSequences[queueIndex][commandIndex]->asRenderSubPass();
+    return subpass != nullptr && subpass->subpassIndex > 0;
+  };
+
+  // find dependencies between queues. Each sequence is divided after the command generating a resource and before the command consuming it
+  std::vector<std::set<uint32_t>> divisions(commandSequences.size());
+  std::vector<std::tuple<std::pair<uint32_t, uint32_t>, std::pair<uint32_t, uint32_t>, VkPipelineStageFlags>> dependencies;
+  auto resourceNames = workflow.getResourceNames();
+  for (auto& resourceName : resourceNames)
+  {
+    auto generatingTransitions = workflow.getResourceIO(resourceName, rttAllOutputs);
+    if (generatingTransitions.empty())
+      continue;
+    auto generatingPosition  = commandPosition.at(generatingTransitions[0]->operation->name);
+    auto consumingTransitions = workflow.getResourceIO(resourceName, rttAllInputs);
+    for (auto& consumingTransition : consumingTransitions)
+    {
+      auto consumingPosition = commandPosition.at(consumingTransition->operation->name);
+      if (generatingPosition.first == consumingPosition.first)
+        continue;
+      VkPipelineStageFlags srcStageMask = 0, dstStageMask = 0;
+      getPipelineStageMasks(generatingTransitions[0], consumingTransition, srcStageMask, dstStageMask);
+      dependencies.push_back(std::make_tuple(generatingPosition, consumingPosition, dstStageMask));
+
+      uint32_t afterGenerating = generatingPosition.second + 1;
+      while (isInsideRenderPass(generatingPosition.first, afterGenerating))
+        afterGenerating++;
+      divisions[generatingPosition.first].insert(afterGenerating);
+
+      uint32_t beforeConsuming = consumingPosition.second;
+      while (isInsideRenderPass(consumingPosition.first, beforeConsuming))
+        beforeConsuming--;
+      divisions[consumingPosition.first].insert(beforeConsuming);
+    }
+  }
+
+  // create submissions from divided sequences
+  struct SubmissionRange
+  {
+    uint32_t queueIndex;
+    uint32_t firstCommand;
+    uint32_t lastCommand;
+  };
+  std::vector<SubmissionRange>       ranges;
+  std::vector<std::vector<uint32_t>> commandRange(commandSequences.size());
+  for (uint32_t i = 0; i < commandSequences.size(); ++i)
+  {
+    commandRange[i].resize(commandSequences[i].size());
+    uint32_t firstCommand = 0;
+    for (uint32_t j = 0; j < commandSequences[i].size(); ++j)
+    {
+      if (j + 1 == commandSequences[i].size() || divisions[i].find(j + 1) != end(divisions[i]))
+      {
+        for (uint32_t k = firstCommand; k <= j; ++k)
+          commandRange[i][k] = ranges.size();
+        ranges.push_back({ i, firstCommand, j });
+        firstCommand = j + 1;
+      }
+    }
+  }
+
+  // each range waits for the previous range from the same queue and for ranges generating resources it consumes
+  std::vector<std::map<uint32_t, VkPipelineStageFlags>> waits(ranges.size());
+  for (auto& dependency : dependencies)
+  {
+    auto generatingRange = commandRange[std::get<0>(dependency).first][std::get<0>(dependency).second];
+    auto consumingRange  = commandRange[std::get<1>(dependency).first][std::get<1>(dependency).second];
+    waits[consumingRange][generatingRange] |= std::get<2>(dependency);
+  }
+
+  // sort ranges in submission order ( semaphore must be signaled by a submission sent earlier than a submission waiting for it )
+  std::vector<uint32_t>              waitCount(ranges.size(), 0);
+  std::vector<std::vector<uint32_t>> nextRanges(ranges.size());
+  for (uint32_t i = 0; i < ranges.size(); ++i)
+  {
+    if (i > 0 && ranges[i - 1].queueIndex == ranges[i].queueIndex)
+    {
+      nextRanges[i - 1].push_back(i);
+      waitCount[i]++;
+    }
+    for (auto& w : waits[i])
+    {
+      nextRanges[w.first].push_back(i);
+      waitCount[i]++;
+    }
+  }
+  std::vector<uint32_t> readyRanges, rangeOrder, submissionIndex(ranges.size());
+  for (uint32_t i = 0; i < ranges.size(); ++i)
+    if (waitCount[i] == 0)
+      readyRanges.push_back(i);
+  while (!readyRanges.empty())
+  {
+    uint32_t rangeIndex = readyRanges.back();
+    readyRanges.pop_back();
+    submissionIndex[rangeIndex] = rangeOrder.size();
+    rangeOrder.push_back(rangeIndex);
+    for (auto nextRange : nextRanges[rangeIndex])
+      if (--waitCount[nextRange] == 0)
+        readyRanges.push_back(nextRange);
+  }
+  CHECK_LOG_THROW(rangeOrder.size() != ranges.size(), "RenderWorkflow : cannot create queue submissions. Queues wait for each other");
+
+  workflowResults->commands.clear();
+  workflowResults->submissions.clear();
+  for (auto rangeIndex : rangeOrder)
+  {
+    const SubmissionRange& range = ranges[rangeIndex];
+    workflowResults->commands.push_back(std::vector<std::shared_ptr<RenderCommand>>(begin(commandSequences[range.queueIndex]) + range.firstCommand, begin(commandSequences[range.queueIndex]) + range.lastCommand + 1));
+    QueueSubmission submission(range.queueIndex);
+    for (auto& w : waits[rangeIndex])
+    {
+      submission.waitSubmissions.push_back(submissionIndex[w.first]);
+      submission.waitStages.push_back(w.second);
+    }
+    workflowResults->submissions.push_back(submission);
+  }
+}
+
 void SingleQueueWorkflowCompiler::verifyOperations(const RenderWorkflow& workflow)
 {
   std::ostringstream os;
@@ -847,56 +1001,10 @@ void SingleQueueWorkflowCompiler::calculateAttachmentLayouts(const RenderWorkflo
   }
 }
 
-std::vector<std::string> recursiveLongestPath(const std::vector<std::pair<std::string, std::string>>& resourcePairs, const std::set<std::string>& doneVertices = std::set<std::string>())
-{
-  std::set<std::string> vertices;
-  if (doneVertices.empty())
-  {
-    for (auto& rp : resourcePairs)
-      vertices.insert(rp.first);
-    for (auto& rp : resourcePairs)
-      vertices.erase(rp.second);
-  }
-  else
-  {
-    for (auto& rp : resourcePairs)
-    {
-      if (doneVertices.find(rp.first) == end(doneVertices))
-        continue;
-      if (doneVertices.find(rp.second) != end(doneVertices))
-        continue;
-      vertices.insert(rp.second);
-    }
-  }
-  if (vertices.empty())
-    return std::vector<std::string>();
-
-
-  std::vector<std::vector<std::string>> results;
-  for (const auto& x : vertices)
-  {
-    auto a = doneVertices;
-    a.insert(x);
-    auto xx = recursiveLongestPath(resourcePairs, a);
-    xx.push_back(x);
-    results.push_back(xx);
-  }
-  uint32_t maxSize = 0;
-  int maxElt = -1;
-  for (uint32_t i = 0; i<results.size(); ++i)
-  {
-    if (results[i].size() > maxSize)
-    {
-      maxSize = results[i].size();
-      maxElt = i;
-    }
-  }
-  return results[maxElt];
-}
-
 void SingleQueueWorkflowCompiler::findAliasedResources(const RenderWorkflow& workflow, const std::vector<std::vector<std::shared_ptr<RenderOperation>>>& operationSequences, std::shared_ptr<RenderWorkflowResults> workflowResults)
 {
   workflowResults->resourceAlias.clear();
+  workflowResults->memoryAlias.clear();
 
   std::map<std::string, std::pair<uint32_t,uint32_t>> operationIndex;
   for (uint32_t i = 0; i < operationSequences.size(); ++i)
@@ -942,68 +1050,126 @@ void SingleQueueWorkflowCompiler::findAliasedResources(const RenderWorkflow& wor
     aliasingPossible.insert( { resourceName,std::make_tuple( outQueueIndex, outOpIndex, inQueueIndex, inOpFirst, inOpLast ) } );
   }
 
-  // OK, so we have a group of resources where resource reuse is possible. First - we build pairs of resources that may be reused
-  // Remark : algorithm complexity is n^2
-  std::vector<std::pair<std::string, std::string>> resourcePairs;
-  for (auto it0 = begin(aliasingPossible); it0 != end(aliasingPossible); ++it0)
+  // OK, so we have a group of resources where resource reuse is possible. Each resource has its lifetime interval [ generation, last consumption ]
+  // in a queue, so the problem of minimizing the number of resources is an interval graph colouring problem, that may be solved greedily :
+  // - resources are sorted according to the index of the generating operation
+  // - each resource takes over a chain of compatible resources whose last consumption happened before its generation ( min-heap ordered by end of lifetime )
+  //   or starts a new chain when there is no such chain
+  // - all resources in a chain are aliased to the first resource in a chain
+  // Remark : algorithm complexity is n log n
+  struct AliasingInterval
   {
-    auto resource0 = workflow.getResource(it0->first);
-    // cannot overwrite a resource marked as persistent
-    if (resource0->resourceType->persistent)
-      continue;
-    int r0oq, r0op, r0iq, r0ip0, r0ip1;
-    std::tie(r0oq, r0op, r0iq, r0ip0, r0ip1) = it0->second;
+    std::string name;
+    int         outQueue;
+    int         outOp;
+    int         inQueue;
+    int         inOp;
+    bool        persistent;
+    uint32_t    typeGroup;
+  };
+  std::vector<AliasingInterval>                            intervals;
+  std::vector<std::shared_ptr<RenderWorkflowResourceType>> typeGroups;
+  // attachments with equal definitions ( compare with AttachmentData::isEqual() ) belong to the same type group.
+  // Resource types that are not equal to themselves ( buffers, images ) get a type group of their own
+  typedef std::tuple<VkFormat, VkSampleCountFlagBits, AttachmentType, AttachmentSize::Type, float, float, float> AttachmentDefinitionKey;
+  std::map<AttachmentDefinitionKey, uint32_t>              typeGroupIndex;
+  for (auto& ap : aliasingPossible)
+  {
+    int oq, op, iq, ip0, ip1;
+    std::tie(oq, op, iq, ip0, ip1) = ap.second;
     // let's skip some empty resources ( this shouldnt happen, but... )
-    if (r0oq == -1 && r0iq == -1)
+    if (oq == -1 && iq == -1)
       continue;
-    // Question : what to do with resources that are generated but are not persistent and are not used later (r0iq==-1) ?
+    // Question : what to do with resources that are generated but are not persistent and are not used later (iq==-1) ?
     // For now we will assume that this resource may be used later in the same queue
-    if (r0iq == -1)
+    if (iq == -1)
     {
-      r0iq  = r0oq;
-      r0ip0 = r0ip1 = r0op;
+      iq  = oq;
+      ip1 = op;
     }
-    for (auto it1 = begin(aliasingPossible); it1 != end(aliasingPossible); ++it1)
+    auto resourceType  = workflow.getResource(ap.first)->resourceType;
+    uint32_t typeGroup = static_cast<uint32_t>(typeGroups.size());
+    if (resourceType->metaType == RenderWorkflowResourceType::Attachment)
     {
-      // cannot merge resource with itself
-      if (it0 == it1) continue;
-      auto resource1 = workflow.getResource(it1->first);
-      if (!resource0->resourceType->isEqual(*(resource1->resourceType)))
-        continue;
-      int r1oq, r1op, r1iq, r1ip0, r1ip1;
-      std::tie(r1oq, r1op, r1iq, r1ip0, r1ip1) = it1->second;
-      // if resource r1 is not generated ( r1oq==-1 ) then it is sent from outside the workflow and we should not try to merge r0->r1
-      if (r1oq == -1)
-        continue;
-
-      // skip it if last use of r0 is in other queue than creation of r1
-      if (r0iq != r1oq)
-        continue;
-      // if last consumption of r0 happens after generation of r1
-      if (r0ip1 >= r1op) continue;
-
-      resourcePairs.push_back({ it0->first , it1->first });
+      const auto& attachment = resourceType->attachment;
+      AttachmentDefinitionKey key = std::make_tuple(attachment.format, attachment.samples, attachment.attachmentType, attachment.attachmentSize.attachmentSize, attachment.attachmentSize.imageSize.x, attachment.attachmentSize.imageSize.y, attachment.attachmentSize.imageSize.z);
+      typeGroup = typeGroupIndex.insert({ key, typeGroup }).first->second;
     }
+    if (typeGroup == typeGroups.size())
+      typeGroups.push_back(resourceType);
+    intervals.push_back({ ap.first, oq, op, iq, ip1, resourceType->persistent, typeGroup });
   }
-  // we can find reuse schema having graph from resource pairs that can be reused. This algorithm should minimize the number of output elements
-  while (!resourcePairs.empty())
+  std::stable_sort(begin(intervals), end(intervals), [](const AliasingInterval& lhs, const AliasingInterval& rhs) { return lhs.outOp < rhs.outOp; });
+
+  // chain is identified by the name of its first resource. Chains are stored in heaps identified by queue index of the last consumption and type group
+  typedef std::pair<int, std::string> AliasingChain;
+  std::map<std::pair<int, uint32_t>, std::priority_queue<AliasingChain, std::vector<AliasingChain>, std::greater<AliasingChain>>> freeChains;
+  // lifetime of each chain is needed later to find chains that may share memory
+  std::map<std::string, AliasingInterval> chainIntervals;
+  for (auto& interval : intervals)
   {
-    auto longestPath = recursiveLongestPath(resourcePairs);
+    std::string chainName = interval.name;
+    // if resource is not generated ( outQueue==-1 ) then it is sent from outside the workflow and we should not try to merge it with other resources.
+    // Resource types that are not equal to themselves ( buffers, images ) cannot be merged either
+    if (interval.outQueue != -1 && typeGroups[interval.typeGroup]->isEqual(*typeGroups[interval.typeGroup]))
+    {
+      auto fcit = freeChains.find({ interval.outQueue, interval.typeGroup });
+      // last consumption of the chain must happen before generation of the resource
+      if (fcit != end(freeChains) && !fcit->second.empty() && fcit->second.top().first < interval.outOp)
+      {
+        chainName = fcit->second.top().second;
+        fcit->second.pop();
+        workflowResults->resourceAlias[interval.name] = chainName;
+      }
+    }
+    // cannot overwrite a resource marked as persistent
+    if (!interval.persistent)
+      freeChains[{ interval.inQueue, interval.typeGroup }].push({ interval.inOp, chainName });
 
-    std::vector<std::pair<std::string, std::string>> rp;
-    std::copy_if(begin(resourcePairs), end(resourcePairs), std::back_inserter(rp), 
-      [&longestPath](const std::pair<std::string, std::string>& thisPair) { return std::find(begin(longestPath), end(longestPath), thisPair.first) == end(longestPath) && std::find(begin(longestPath), end(longestPath), thisPair.second) == end(longestPath); });
-    resourcePairs = rp;
+    auto ciit = chainIntervals.find(chainName);
+    if (ciit == end(chainIntervals))
+      chainIntervals.insert({ chainName, interval });
+    else
+    {
+      ciit->second.inQueue    = interval.inQueue;
+      ciit->second.inOp       = interval.inOp;
+      ciit->second.persistent = ciit->second.persistent || interval.persistent;
+    }
+  }
 
-    if (longestPath.size() > 1)
+  // Chains of attachments that are not compatible with each other ( different formats, sizes, etc ) still cannot be used at the same time.
+  // Images from chains with disjoint lifetimes may be placed in the same device memory ( memory aliasing ), so we colour chains again, this time ignoring types.
+  // Memory of a persistent resource cannot be shared, because its content must survive until the next frame
+  std::vector<AliasingInterval> chains;
+  for (auto& ci : chainIntervals)
+  {
+    if (ci.second.outQueue == -1 || ci.second.persistent)
+      continue;
+    if (workflow.getResource(ci.first)->resourceType->metaType != RenderWorkflowResourceType::Attachment)
+      continue;
+    chains.push_back(ci.second);
+  }
+  std::stable_sort(begin(chains), end(chains), [](const AliasingInterval& lhs, const AliasingInterval& rhs) { return lhs.outOp < rhs.outOp; });
+
+  std::map<int, std::priority_queue<AliasingChain, std::vector<AliasingChain>, std::greater<AliasingChain>>> freeMemory;
+  std::map<std::string, uint32_t> memoryGroupSize;
+  for (auto& chain : chains)
+  {
+    std::string groupName = chain.name;
+    auto fmit = freeMemory.find(chain.outQueue);
+    if (fmit != end(freeMemory) && !fmit->second.empty() && fmit->second.top().first < chain.outOp)
     {
-      auto target = longestPath.back();
-      longestPath.pop_back();
-      for (auto& p : longestPath)
-        workflowResults->resourceAlias[p] = target;
+      groupName = fmit->second.top().second;
+      fmit->second.pop();
     }
-    else break;
+    workflowResults->memoryAlias[chain.name] = groupName;
+    memoryGroupSize[groupName]++;
+    freeMemory[chain.inQueue].push({ chain.inOp, groupName });
   }
+  // there's no point in sharing memory with nobody
+  for (auto& mgs : memoryGroupSize)
+    if (mgs.second < 2)
+      workflowResults->memoryAlias.erase(mgs.first);
 }
 
 void SingleQueueWorkflowCompiler::createCommandSequence(const std::vector<std::shared_ptr<RenderOperation>>& operationSequence, std::vector<std::shared_ptr<RenderCommand>>& commands)
@@ -1078,6 +1244,9 @@ void SingleQueueWorkflowCompiler::buildFrameBuffersAndRenderPasses(const RenderW
     }
   }
 
+  // images that share memory with other images ( memoryAlias ) use common alias group
+  std::map<std::string, std::shared_ptr<ImageMemoryAliasGroup>> memoryAliasGroups;
+
   // build framebuffers
   for (auto& renderPass : renderPasses)
   {
@@ -1102,8 +1271,16 @@ void SingleQueueWorkflowCompiler::buildFrameBuffersAndRenderPasses(const RenderW
         if (ait == end(workflowResults->registeredMemoryImages))
         {
           ImageTraits imageTraits(resourceType->attachment.imageUsage, resourceType->attachment.format, imSize, 1, layerCount, resourceType->attachment.samples, false, VK_IMAGE_LAYOUT_UNDEFINED, 0, VK_IMAGE_TYPE_2D, VK_SHARING_MODE_EXCLUSIVE);
-          SwapChainImageBehaviour scib = (resourceType->attachment.attachmentType == atSurface) ? swForEachImage : swOnce;
+          SwapChainImageBehaviour scib = (resourceType->attachment.attachmentType == atSurface) ? swForEachSwapChainImage : swOnce;
           ait = workflowResults->registeredMemoryImages.insert({ resourceName, std::make_shared<MemoryImage>(imageTraits, workflow.frameBufferAllocator, aspectMask, pbPerSurface, scib, false, false) }).first;
+          auto mait = workflowResults->memoryAlias.find(resourceName);
+          if (mait != end(workflowResults->memoryAlias))
+          {
+            auto& aliasGroup = memoryAliasGroups[mait->second];
+            if (aliasGroup == nullptr)
+              aliasGroup = std::make_shared<ImageMemoryAliasGroup>(workflow.frameBufferAllocator);
+            ait->second->setMemoryAliasGroup(aliasGroup);
+          }
         }
         auto aiv = workflowResults->registeredImageViews.find(resourceName);
         if (aiv == end(workflowResults->registeredImageViews))
@@ -1141,6 +1318,7 @@ void SingleQueueWorkflowCompiler::buildFrameBuffersAndRenderPasses(const RenderW
     std::vector<AttachmentDefinition> attachments;
     std::vector<VkClearValue>         clearValues(frameBufferDefinitions.size(), makeColorClearValue(glm::vec4(0.0f)));
     std::vector<char>                 clearValuesInitialized(frameBufferDefinitions.size(), false);
+    std::vector<char>                 attachmentUsed(frameBufferDefinitions.size(), false);
     for (uint32_t i = 0; i < frameBufferDefinitions.size(); ++i)
     {
       attachments.push_back(AttachmentDefinition(
@@ -1153,7 +1331,7 @@ void SingleQueueWorkflowCompiler::buildFrameBuffersAndRenderPasses(const RenderW
         VK_ATTACHMENT_STORE_OP_DONT_CARE,
         rpInitialLayouts[i],
         rpInitialLayouts[i],
-        0
+        (workflowResults->memoryAlias.find(frameBufferDefinitions[i].name) != end(workflowResults->memoryAlias)) ? VK_ATTACHMENT_DESCRIPTION_MAY_ALIAS_BIT : 0
       ));
     }
 
@@ -1183,7 +1361,12 @@ void SingleQueueWorkflowCompiler::buildFrameBuffersAndRenderPasses(const RenderW
         {
           if (attachments[attIndex].initialLayout == VK_IMAGE_LAYOUT_UNDEFINED)
             attachments[attIndex].initialLayout = transition->layout;
+          // memory of an aliased image is overwritten by other images, so its layout is lost when render pass starts with it
+          bool memoryAliased = workflowResults->memoryAlias.find(resourceName) != end(workflowResults->memoryAlias);
+          if (memoryAliased && !attachmentUsed[attIndex] && transition->load.loadType != LoadOp::Load)
+            attachments[attIndex].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
         }
+        attachmentUsed[attIndex] = true;
 
         // if it's an input transition
         if ((transition->transitionType & rttAllInputs) != 0)
@@ -1368,13 +1551,152 @@ void SingleQueueWorkflowCompiler::createPipelineBarriers(const RenderWorkflow& w
     });
 
     // for now we will create a barrier/subpass dependency for each transition. It should be later optimized ( some barriers are not necessary )
+    // Transitions from other queues are collected, because queue family ownership is transferred only once for each queue
+    std::map<int, std::pair<std::vector<std::shared_ptr<ResourceTransition>>, std::vector<std::shared_ptr<RenderCommand>>>> otherQueueTransitions;
     for (auto& consumingTransition : consumingTransitions)
     {
-      if( ((generatingTransitions[0]->transitionType & rttAllAttachmentOutputs) != 0) && ((consumingTransition->transitionType & rttAllAttachmentInputs) != 0) )
+      // subpass dependencies work only within the same queue
+      bool sameQueue = queueNumber[generatingTransitions[0]->operation->name] == queueNumber[consumingTransition->operation->name];
+      if (!sameQueue)
+      {
+        auto& oqt = otherQueueTransitions[queueNumber[consumingTransition->operation->name]];
+        oqt.first.push_back(consumingTransition);
+        oqt.second.push_back(commandMap[consumingTransition->operation->name]);
+      }
+      else if( ((generatingTransitions[0]->transitionType & rttAllAttachmentOutputs) != 0) && ((consumingTransition->transitionType & rttAllAttachmentInputs) != 0) )
         createSubpassDependency(generatingTransitions[0], commandMap[generatingTransitions[0]->operation->name], consumingTransition, commandMap[consumingTransition->operation->name], queueNumber[generatingTransitions[0]->operation->name], queueNumber[consumingTransition->operation->name], workflowResults);
       else
         createPipelineBarrier(generatingTransitions[0], commandMap[generatingTransitions[0]->operation->name], consumingTransition, commandMap[consumingTransition->operation->name], queueNumber[generatingTransitions[0]->operation->name], queueNumber[consumingTransition->operation->name], workflowResults);
     }
+    for (auto& oqt : otherQueueTransitions)
+      createQueueTransferBarriers(generatingTransitions[0], commandMap[generatingTransitions[0]->operation->name], oqt.second.first, oqt.second.second, generatingQueueNumber, oqt.first, workflowResults);
+  }
+}
+
+// pipeline stages and access types in which a transition uses an image
+void getImageUsageMasks(std::shared_ptr<ResourceTransition> transition, VkPipelineStageFlags& stageMask, VkAccessFlags& accessMask)
+{
+  const VkPipelineStageFlags allShaderStages = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_TESSELLATION_CONTROL_SHADER_BIT | VK_PIPELINE_STAGE_TESSELLATION_EVALUATION_SHADER_BIT | VK_PIPELINE_STAGE_GEOMETRY_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+  bool output = (transition->transitionType & rttAllOutputs) != 0;
+  switch (transition->layout)
+  {
+  case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
+    stageMask  = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    accessMask = output ? VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT : VK_ACCESS_COLOR_ATTACHMENT_READ_BIT;
+    break;
+  case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
+    stageMask  = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    accessMask = output ? VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT : VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+    break;
+  case VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL:
+    stageMask  = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    accessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+    break;
+  case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+    stageMask  = allShaderStages;
+    accessMask = (transition->transitionType == rttAttachmentInput) ? VK_ACCESS_INPUT_ATTACHMENT_READ_BIT : VK_ACCESS_SHADER_READ_BIT;
+    break;
+  case VK_IMAGE_LAYOUT_GENERAL:
+    stageMask  = allShaderStages;
+    accessMask = output ? VK_ACCESS_SHADER_WRITE_BIT : VK_ACCESS_SHADER_READ_BIT;
+    break;
+  default:
+    stageMask  = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    accessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+    break;
+  }
+}
+
+void SingleQueueWorkflowCompiler::createMemoryAliasDependencies(const RenderWorkflow& workflow, std::vector<std::vector<std::shared_ptr<RenderCommand>>>& commandSequences, std::shared_ptr<RenderWorkflowResults> workflowResults)
+{
+  // Images from the same memory alias group ( look at findAliasedResources() ) use the same memory one after another in the same queue.
+  // Operation that uses the next image for the first time must wait until the last operation using the previous image is finished
+  if (workflowResults->memoryAlias.empty())
+    return;
+
+  std::map<std::string, int> operationNumber;
+  std::map<std::string, std::shared_ptr<RenderCommand>> commandMap;
+  for (auto& commandSequence : commandSequences)
+  {
+    int operationIndex = 0;
+    for (auto& command : commandSequence)
+    {
+      operationNumber[command->operation->name] = operationIndex++;
+      commandMap[command->operation->name]      = command;
+    }
+  }
+
+  // find the first and the last transition using each image ( image is shared by all resources aliased to it )
+  std::map<std::string, std::pair<std::shared_ptr<ResourceTransition>, std::shared_ptr<ResourceTransition>>> imageUsage;
+  for (auto& resourceName : workflow.getResourceNames())
+  {
+    auto imageName = workflowResults->resourceAlias.at(resourceName);
+    if (workflowResults->memoryAlias.find(imageName) == end(workflowResults->memoryAlias))
+      continue;
+    auto& usage = imageUsage[imageName];
+    for (auto& transition : workflow.getResourceIO(resourceName, rttAllInputsOutputs))
+    {
+      int opNumber = operationNumber.at(transition->operation->name);
+      if (usage.first == nullptr || opNumber < operationNumber.at(usage.first->operation->name))
+        usage.first = transition;
+      if (usage.second == nullptr || opNumber > operationNumber.at(usage.second->operation->name))
+        usage.second = transition;
+    }
+  }
+
+  std::map<std::string, std::vector<std::string>> memoryGroups;
+  for (auto& ma : workflowResults->memoryAlias)
+    memoryGroups[ma.second].push_back(ma.first);
+  for (auto& memoryGroup : memoryGroups)
+  {
+    auto& images = memoryGroup.second;
+    std::sort(begin(images), end(images), [&imageUsage, &operationNumber](const std::string& lhs, const std::string& rhs)
+    {
+      return operationNumber.at(imageUsage.at(lhs).first->operation->name) < operationNumber.at(imageUsage.at(rhs).first->operation->name);
+    });
+    for (uint32_t i = 1; i < images.size(); ++i)
+    {
+      auto previousTransition = imageUsage.at(images[i - 1]).second;
+      auto nextTransition     = imageUsage.at(images[i]).first;
+      auto previousCommand    = commandMap.at(previousTransition->operation->name);
+      auto nextCommand        = commandMap.at(nextTransition->operation->name);
+
+      VkPipelineStageFlags srcStageMask, dstStageMask;
+      VkAccessFlags        srcAccessMask, dstAccessMask;
+      getImageUsageMasks(previousTransition, srcStageMask, srcAccessMask);
+      getImageUsageMasks(nextTransition, dstStageMask, dstAccessMask);
+
+      if (nextCommand->commandType == RenderCommand::ctRenderSubPass)
+      {
+        // images may use different regions of the same memory, so the dependency cannot be local to a region
+        auto nextSubpass         = std::dynamic_pointer_cast<RenderSubPass>(nextCommand);
+        uint32_t srcSubpassIndex = VK_SUBPASS_EXTERNAL;
+        if (previousCommand->commandType == RenderCommand::ctRenderSubPass)
+        {
+          auto previousSubpass = std::dynamic_pointer_cast<RenderSubPass>(previousCommand);
+          if (previousSubpass->renderPass.get() == nextSubpass->renderPass.get())
+            srcSubpassIndex = previousSubpass->subpassIndex;
+        }
+        uint32_t dstSubpassIndex = nextSubpass->subpassIndex;
+        auto& dependencies = nextSubpass->renderPass->dependencies;
+        auto dep = std::find_if(begin(dependencies), end(dependencies),
+          [srcSubpassIndex, dstSubpassIndex](const SubpassDependencyDefinition& sd) -> bool { return sd.srcSubpass == srcSubpassIndex && sd.dstSubpass == dstSubpassIndex && sd.dependencyFlags == 0; });
+        if (dep == end(dependencies))
+          dep = dependencies.insert(end(dependencies), SubpassDependencyDefinition(srcSubpassIndex, dstSubpassIndex, 0, 0, 0, 0, 0));
+        dep->srcStageMask  |= srcStageMask;
+        dep->dstStageMask  |= dstStageMask;
+        dep->srcAccessMask |= srcAccessMask;
+        dep->dstAccessMask |= dstAccessMask;
+      }
+      else
+      {
+        // image is used for the first time outside of a render pass - its previous content is discarded by transition from undefined layout
+        auto imit = workflowResults->registeredMemoryImages.find(images[i]);
+        if (imit == end(workflowResults->registeredMemoryImages))
+          continue;
+        nextCommand->barriersBeforeOp[MemoryObjectBarrierGroup(srcStageMask, dstStageMask, 0)].push_back(MemoryObjectBarrier(srcAccessMask, dstAccessMask, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, imit->second, VK_IMAGE_LAYOUT_UNDEFINED, nextTransition->layout, nextTransition->imageSubresourceRange));
+      }
+    }
   }
 }
 
@@ -1444,12 +1766,6 @@ void SingleQueueWorkflowCompiler::createPipelineBarrier(std::shared_ptr<Resource
     memoryObject = it->second;
   }
 
-  uint32_t srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED, dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-  if (generatingQueueIndex != consumingQueueIndex)
-  {
-    // TODO - find family indices for both queues
-  }
-
   VkPipelineStageFlags srcStageMask = 0,  dstStageMask = 0;
   VkAccessFlags        srcAccessMask = 0, dstAccessMask = 0;
   getPipelineStageMasks(generatingTransition, consumingTransition, srcStageMask, dstStageMask);
@@ -1457,10 +1773,77 @@ void SingleQueueWorkflowCompiler::createPipelineBarrier(std::shared_ptr<Resource
 
   VkDependencyFlags dependencyFlags = 0; // FIXME
 
-  MemoryObjectBarrierGroup rbg(srcStageMask, dstStageMask, dependencyFlags);
-  auto rbgit = consumingCommand->barriersBeforeOp.find(rbg);
-  if (rbgit == end(consumingCommand->barriersBeforeOp))
-    rbgit = consumingCommand->barriersBeforeOp.insert({ rbg, std::vector<MemoryObjectBarrier>() }).first;
+  addPipelineBarrier(consumingCommand->barriersBeforeOp, MemoryObjectBarrierGroup(srcStageMask, dstStageMask, dependencyFlags), 
+    srcAccessMask, dstAccessMask, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, MemoryObjectBarrier::qtNone, memoryObject, generatingTransition, consumingTransition);
+}
+
+void SingleQueueWorkflowCompiler::createQueueTransferBarriers(std::shared_ptr<ResourceTransition> generatingTransition, std::shared_ptr<RenderCommand> generatingCommand, const std::vector<std::shared_ptr<ResourceTransition>>& consumingTransitions, const std::vector<std::shared_ptr<RenderCommand>>& consumingCommands, uint32_t generatingQueueIndex, uint32_t consumingQueueIndex, std::shared_ptr<RenderWorkflowResults> workflowResults)
+{
+  auto workflow = generatingTransition->operation->renderWorkflow.lock();
+
+  auto memoryObject = workflow->getAssociatedMemoryObject(generatingTransition->resource->name);
+  if (memoryObject == nullptr)
+  {
+    auto it = workflowResults->registeredMemoryImages.find(workflowResults->resourceAlias.at(generatingTransition->resource->name));
+    if (it == end(workflowResults->registeredMemoryImages))
+      return;
+    memoryObject = it->second;
+  }
+
+  // consuming transitions are sorted in order of operations. Acquire barrier must make resource visible for all of them
+  VkPipelineStageFlags srcStageMask = 0,  dstStageMask = 0;
+  VkAccessFlags        srcAccessMask = 0, dstAccessMask = 0;
+  for (auto& consumingTransition : consumingTransitions)
+  {
+    VkPipelineStageFlags srcStage = 0,  dstStage = 0;
+    VkAccessFlags        srcAccess = 0, dstAccess = 0;
+    getPipelineStageMasks(generatingTransition, consumingTransition, srcStage, dstStage);
+    getAccessMasks(generatingTransition, consumingTransition, srcAccess, dstAccess);
+    srcStageMask  |= srcStage;
+    dstStageMask  |= dstStage;
+    srcAccessMask |= srcAccess;
+    dstAccessMask |= dstAccess;
+  }
+  auto firstTransition = consumingTransitions.front();
+  auto lastTransition  = consumingTransitions.back();
+
+  // Barriers cannot be recorded inside render pass, so they are moved to the render pass boundaries
+  auto renderPassBegin = [](std::shared_ptr<RenderCommand> command) -> std::shared_ptr<RenderCommand>
+  {
+    if (command->commandType != RenderCommand::ctRenderSubPass)
+      return command;
+    return std::dynamic_pointer_cast<RenderSubPass>(command)->renderPass->subPasses.front().lock();
+  };
+  auto renderPassEnd = [](std::shared_ptr<RenderCommand> command) -> std::shared_ptr<RenderCommand>
+  {
+    if (command->commandType != RenderCommand::ctRenderSubPass)
+      return command;
+    return std::dynamic_pointer_cast<RenderSubPass>(command)->renderPass->subPasses.back().lock();
+  };
+
+  VkDependencyFlags dependencyFlags = 0;
+  // Resource is transferred between queues : release barrier is added after generating command and acquire barrier is added before the first consuming command.
+  // Queues are synchronized by semaphores, so release barrier does not need to make memory visible and acquire barrier does not need to make it available.
+  addPipelineBarrier(renderPassEnd(generatingCommand)->barriersAfterOp, MemoryObjectBarrierGroup(srcStageMask, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, dependencyFlags),
+    srcAccessMask, 0, generatingQueueIndex, consumingQueueIndex, MemoryObjectBarrier::qtRelease, memoryObject, generatingTransition, firstTransition);
+  addPipelineBarrier(renderPassBegin(consumingCommands.front())->barriersBeforeOp, MemoryObjectBarrierGroup(dstStageMask, dstStageMask, dependencyFlags),
+    0, dstAccessMask, generatingQueueIndex, consumingQueueIndex, MemoryObjectBarrier::qtAcquire, memoryObject, generatingTransition, firstTransition);
+
+  // In the next frame the generating command writes to the resource again, so the ownership must be returned to its queue family :
+  // release barrier is added after the last consuming command and acquire barrier is added before generating command.
+  // Generating queue waits for the next frame's frame buffer ready semaphore, that is signaled on the presentation queue after all work of the previous frame submitted to it.
+  // In the first frame that uses the resource there is no matching release - surface records a transition from undefined layout instead ( see Surface::isOwnershipReturned() )
+  addPipelineBarrier(renderPassEnd(consumingCommands.back())->barriersAfterOp, MemoryObjectBarrierGroup(dstStageMask, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, dependencyFlags),
+    0, 0, consumingQueueIndex, generatingQueueIndex, MemoryObjectBarrier::qtRelease, memoryObject, lastTransition, generatingTransition);
+  addPipelineBarrier(renderPassBegin(generatingCommand)->barriersBeforeOp, MemoryObjectBarrierGroup(srcStageMask, srcStageMask, dependencyFlags),
+    0, srcAccessMask, consumingQueueIndex, generatingQueueIndex, MemoryObjectBarrier::qtReturnAcquire, memoryObject, lastTransition, generatingTransition);
+}
+
+void SingleQueueWorkflowCompiler::addPipelineBarrier(std::map<MemoryObjectBarrierGroup, std::vector<MemoryObjectBarrier>>& barriers, const MemoryObjectBarrierGroup& barrierGroup, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask, uint32_t srcQueueFamilyIndex, uint32_t dstQueueFamilyIndex, MemoryObjectBarrier::QueueTransfer queueTransfer, std::shared_ptr<MemoryObject> memoryObject, std::shared_ptr<ResourceTransition> generatingTransition, std::shared_ptr<ResourceTransition> consumingTransition)
+{
+  auto rbgit = barriers.find(barrierGroup);
+  if (rbgit == end(barriers))
+    rbgit = barriers.insert({ barrierGroup, std::vector<MemoryObjectBarrier>() }).first;
   switch (generatingTransition->resource->resourceType->metaType)
   {
   case RenderWorkflowResourceType::Buffer:
@@ -1479,6 +1862,53 @@ void SingleQueueWorkflowCompiler::createPipelineBarrier(std::shared_ptr<Resource
     break;
   }
   default:
-    break;
+    return;
+  }
+  rbgit->second.back().queueTransfer = queueTransfer;
+}
+
+void MultiQueueWorkflowCompiler::createOperationSequences(const RenderWorkflow& workflow, std::vector<std::vector<std::shared_ptr<RenderOperation>>>& operationSequences)
+{
+  const auto& queueTraits = workflow.getQueueTraits();
+  uint32_t graphicsQueue = queueTraits.size(), computeQueue = queueTraits.size();
+  for (uint32_t i = 0; i < queueTraits.size(); ++i)
+  {
+    if (graphicsQueue == queueTraits.size() && (queueTraits[i].mustHave & VK_QUEUE_GRAPHICS_BIT))
+      graphicsQueue = i;
+    else if (computeQueue == queueTraits.size() && (queueTraits[i].mustHave & VK_QUEUE_COMPUTE_BIT) && !(queueTraits[i].mustHave & VK_QUEUE_GRAPHICS_BIT))
+      computeQueue = i;
+  }
+  CHECK_LOG_THROW(graphicsQueue == queueTraits.size(), "MultiQueueWorkflowCompiler : workflow " << workflow.name << " does not define graphics queue");
+
+  // Operations are divided between queues, but each queue keeps the order of the global schedule.
+  // Compute operation is sent to compute queue only when its inputs are not generated on graphics queue, so compute queue never waits for graphics queue
+  // ( graphics operations with the same tag may be merged into one render pass when compute operations are removed from between them )
+  auto operationSchedule = scheduleOperations(workflow, costCalculator);
+  operationSequences.clear();
+  operationSequences.resize(queueTraits.size());
+  std::set<std::string> computeOperations;
+  for (auto& operation : operationSchedule)
+  {
+    bool sendToComputeQueue = (computeQueue != queueTraits.size()) && (operation->operationType == RenderOperation::Compute);
+    if (sendToComputeQueue)
+    {
+      auto inputTransitions = workflow.getOperationIO(operation->name, rttAllInputs);
+      for (auto& inputTransition : inputTransitions)
+      {
+        auto generatingTransitions = workflow.getResourceIO(inputTransition->resource->name, rttAllOutputs);
+        if (!generatingTransitions.empty() && computeOperations.find(generatingTransitions[0]->operation->name) == end(computeOperations))
+        {
+          sendToComputeQueue = false;
+          break;
+        }
+      }
+    }
+    if (sendToComputeQueue)
+    {
+      operationSequences[computeQueue].push_back(operation);
+      computeOperations.insert(operation->name);
+    }
+    else
+      operationSequences[graphicsQueue].push_back(operation);
   }
 }
@@ -84,6 +84,11 @@ void Resource::notifyDescriptors(const RenderContext& renderContext)
     ds.lock()->notifyDescriptorSet(renderContext);
 }
 
+uint32_t Resource::getDynamicOffset(const RenderContext& renderContext)
+{
+  return 0;
+}
+
 std::pair<bool, VkDescriptorType> Resource::getDefaultDescriptorType()
 {
   CHECK_LOG_THROW(true, "This resource does not have default descriptor type");
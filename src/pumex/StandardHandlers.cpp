@@ -44,7 +44,7 @@ using namespace pumex;
 TimeStatisticsHandler::TimeStatisticsHandler(std::shared_ptr<Viewer> viewer, std::shared_ptr<PipelineCache> pipelineCache, std::shared_ptr<DeviceMemoryAllocator> buffersAllocator, std::shared_ptr<DeviceMemoryAllocator> texturesAllocator, std::shared_ptr<MemoryBuffer> textCameraBuffer, VkSampleCountFlagBits rasterizationSamples )
 {
   showfFPS                   = { false, true, true };
-  viewerStatisticsToCollect  = { 0,  TSV_STAT_RENDER, TSV_STAT_UPDATE | TSV_STAT_RENDER | TSV_STAT_RENDER_EVENTS };
+  viewerStatisticsToCollect  = { 0,  TSV_STAT_RENDER, TSV_STAT_UPDATE | TSV_STAT_RENDER | TSV_STAT_RENDER_EVENTS | TSV_STAT_MEMORY };
   surfaceStatisticsToCollect = { 0,  0,              TSS_STAT_BASIC | TSS_STAT_BUFFERS | TSS_STAT_EVENTS };
   viewerStatisticsGroups     = { {}, {}, { TSV_GROUP_UPDATE, TSV_GROUP_RENDER, TSV_GROUP_RENDER_EVENTS} };
   surfaceStatisticsGroups    = { {}, {}, { TSS_GROUP_BASIC, TSS_GROUP_EVENTS, TSS_GROUP_SECONDARY_BUFFERS, TSS_GROUP_PRIMARY_BUFFERS, TSS_GROUP_PRIMARY_BUFFERS+1, TSS_GROUP_PRIMARY_BUFFERS+2, TSS_GROUP_PRIMARY_BUFFERS+3 } };
@@ -165,6 +165,20 @@ TimeStatisticsHandler::TimeStatisticsHandler(std::shared_ptr<Viewer> viewer, std
   textSmall->setDescriptorSet(0, textSmallDescriptorSet);
 }
 
+// channels that do not store durations are shown as text with their last value
+static std::wstring getChannelValueText(const TimeStatisticsChannel& channel)
+{
+  double valueBegin, value;
+  channel.getLastValues(valueBegin, value);
+  std::wstringstream stream;
+  stream << channel.getChannelName() << L" : " << std::fixed;
+  if (channel.getValueType() == TimeStatisticsChannel::vtSize)
+    stream << std::setprecision(1) << value / (1024.0 * 1024.0) << L" MB";
+  else
+    stream << std::setprecision(0) << value;
+  return stream.str();
+}
+
 void TimeStatisticsHandler::addChannelData(float minVal, uint32_t vertexSize, float h0, float h1, VertexAccumulator& acc, const TimeStatisticsChannel& channel, std::vector<float>& vertices, std::vector<uint32_t>& indices)
 {
   std::vector<double> start, duration;
@@ -286,11 +300,17 @@ void TimeStatisticsHandler::collectData(Surface* surface, TimeStatistics* viewer
       continue;
     textSmall->setText(surface, 100 + group.first, glm::vec2(5, channelHeight -0.2*dHeight), glm::vec4(1.0f, 1.0f, 1.0f, 1.0f), group.second);
     auto channelIDs = viewerStatistics->getGroupChannelIDs(group.first);
+    uint32_t textIndex = 0;
     for (auto channelID : channelIDs)
     {
       if (channelID == TSV_CHANNEL_FRAME)
         continue;
       const auto& channel = viewerStatistics->getChannel(channelID);
+      if (channel.getValueType() != TimeStatisticsChannel::vtDuration)
+      {
+        textSmall->setText(surface, 1000 + channelID, glm::vec2(130 + 150 * textIndex++, channelHeight - 0.2*dHeight), channel.getColor(), getChannelValueText(channel));
+        continue;
+      }
       addChannelData(minTime, vertexSize, channelHeight, channelHeight - 0.8f*dHeight, acc, channel, vertices, indices);
     }
     channelHeight += dHeight;
@@ -33,17 +33,22 @@
 #include <pumex/utils/Log.h>
 #include <pumex/RenderWorkflow.h>
 #include <pumex/TimeStatistics.h>
+#include <pumex/UploadManager.h>
+#include <pumex/ReadbackManager.h>
 
 using namespace pumex;
 
-SurfaceTraits::SurfaceTraits(uint32_t ic, VkColorSpaceKHR ics, uint32_t ial, VkPresentModeKHR  spm, VkSurfaceTransformFlagBitsKHR pt, VkCompositeAlphaFlagBitsKHR ca)
-  : imageCount{ ic }, imageColorSpace{ ics }, imageArrayLayers{ ial }, swapchainPresentMode{ spm }, preTransform{ pt }, compositeAlpha{ ca }
+SurfaceTraits::SurfaceTraits(uint32_t ic, VkColorSpaceKHR ics, uint32_t ial, VkPresentModeKHR  spm, VkSurfaceTransformFlagBitsKHR pt, VkCompositeAlphaFlagBitsKHR ca, uint32_t fif)
+  : imageCount{ ic }, framesInFlight{ fif }, imageColorSpace{ ics }, imageArrayLayers{ ial }, swapchainPresentMode{ spm }, preTransform{ pt }, compositeAlpha{ ca }
 {
 }
 
 Surface::Surface(std::shared_ptr<Viewer> v, std::shared_ptr<Window> w, std::shared_ptr<Device> d, VkSurfaceKHR s, const SurfaceTraits& st)
   : viewer{ v }, window{ w }, device{ d }, surface{ s }, surfaceTraits(st)
 {
+  // more frames in flight than swapchain images is pointless - acquiring next image would wait anyway
+  framesInFlight = (surfaceTraits.framesInFlight == 0) ? surfaceTraits.imageCount : std::min(surfaceTraits.framesInFlight, surfaceTraits.imageCount);
+  CHECK_LOG_THROW(framesInFlight == 0, "Surface must have at least one frame in flight");
   timeStatistics = std::make_unique<TimeStatistics>(32);
 
   timeStatistics->registerGroup(TSS_GROUP_BASIC,             L"Surface operations");
@@ -103,34 +108,25 @@ void Surface::realize()
   VkSemaphoreCreateInfo semaphoreCreateInfo{};
     semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-  // get all queues and create command pools and command buffers for them
-  for (auto& q : workflowResults->queueTraits)
+  // get all queues and create command pools for them. Only presentation queue must support presenting to this surface
+  for (uint32_t i = 0; i < workflowResults->queueTraits.size(); ++i)
   {
-    std::shared_ptr<Queue> queue = deviceSh->getQueue(q, true);
+    std::shared_ptr<Queue> queue = deviceSh->getQueue(workflowResults->queueTraits[i], true);
     CHECK_LOG_THROW(queue.get() == nullptr, "Cannot get the queue for this surface");
-    CHECK_LOG_THROW(supportsPresent[queue->familyIndex] == VK_FALSE, "Support not present for(device,surface,familyIndex) : " << queue->familyIndex);
+    CHECK_LOG_THROW(i == workflowResults->presentationQueueIndex && supportsPresent[queue->familyIndex] == VK_FALSE, "Support not present for(device,surface,familyIndex) : " << queue->familyIndex);
     queues.push_back(queue);
 
     auto commandPool = std::make_shared<CommandPool>(queue->familyIndex);
     commandPool->validate(deviceSh.get());
     commandPools.push_back(commandPool);
-
-    auto commandBuffer = std::make_shared<CommandBuffer>(VK_COMMAND_BUFFER_LEVEL_PRIMARY, deviceSh.get(), commandPool, surfaceTraits.imageCount);
-    primaryCommandBuffers.push_back(commandBuffer);
-
-    // Create a semaphore used to synchronize command submission
-    // Ensures that the image is not presented until all commands have been sumbitted and executed
-    VkSemaphore semaphore0;
-    VK_CHECK_LOG_THROW(vkCreateSemaphore(vkDevice, &semaphoreCreateInfo, nullptr, &semaphore0), "Could not create render complete semaphore");
-    frameBufferReadySemaphores.emplace_back(semaphore0);
-
-    VkSemaphore semaphore1;
-    VK_CHECK_LOG_THROW(vkCreateSemaphore(vkDevice, &semaphoreCreateInfo, nullptr, &semaphore1), "Could not create render complete semaphore");
-    renderCompleteSemaphores.emplace_back(semaphore1);
   }
+  // create command buffers and semaphores for all queue submissions
+  createSubmissions();
+
   // define basic command buffers required to render a frame
-  prepareCommandBuffer = std::make_shared<CommandBuffer>(VK_COMMAND_BUFFER_LEVEL_PRIMARY, deviceSh.get(), commandPools[workflowResults->presentationQueueIndex], surfaceTraits.imageCount);
-  presentCommandBuffer = std::make_shared<CommandBuffer>(VK_COMMAND_BUFFER_LEVEL_PRIMARY, deviceSh.get(), commandPools[workflowResults->presentationQueueIndex], surfaceTraits.imageCount);
+  // prepare and present command buffers refer to swapchain image directly, so each frame in flight keeps one variant for each swapchain image
+  prepareCommandBuffer = std::make_shared<CommandBuffer>(VK_COMMAND_BUFFER_LEVEL_PRIMARY, deviceSh.get(), commandPools[workflowResults->presentationQueueIndex], framesInFlight, surfaceTraits.imageCount);
+  presentCommandBuffer = std::make_shared<CommandBuffer>(VK_COMMAND_BUFFER_LEVEL_PRIMARY, deviceSh.get(), commandPools[workflowResults->presentationQueueIndex], framesInFlight, surfaceTraits.imageCount);
 
   // create all semaphores required to render a frame
   VK_CHECK_LOG_THROW( vkCreateSemaphore(vkDevice, &semaphoreCreateInfo, nullptr, &imageAvailableSemaphore), "Could not create image available semaphore");
@@ -139,16 +135,27 @@ void Surface::realize()
   VkFenceCreateInfo fenceCreateInfo{};
     fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
     fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-  waitFences.resize(surfaceTraits.imageCount);
+  waitFences.resize(framesInFlight);
+  waitFenceFrameNumbers.resize(framesInFlight, 0);
   for (auto& fence : waitFences)
     VK_CHECK_LOG_THROW(vkCreateFence(vkDevice, &fenceCreateInfo, nullptr, &fence), "Could not create a surface wait fence");
 
+  readbackManager = std::make_shared<ReadbackManager>(deviceSh.get(), framesInFlight);
+
+  auto uploadManager = deviceSh->getUploadManager();
+  if (uploadManager != nullptr)
+    uploadManager->registerWaiter(getID());
+
   realized = true;
 }
 
 void Surface::cleanup()
 {
-  VkDevice dev = device.lock()->device;
+  auto deviceSh = device.lock();
+  VkDevice dev = deviceSh->device;
+  auto uploadManager = deviceSh->getUploadManager();
+  if (uploadManager != nullptr)
+    uploadManager->unregisterWaiter(getID());
   eventSurfaceRenderStart  = nullptr;
   eventSurfaceRenderFinish = nullptr;
   if (swapChain != VK_NULL_HANDLE)
@@ -168,15 +175,13 @@ void Surface::cleanup()
     for (auto& fence : waitFences)
       vkDestroyFence(dev, fence, nullptr);
 
-    for (auto sem : renderCompleteSemaphores)
-      vkDestroySemaphore(dev, sem, nullptr);
-    for (auto sem : frameBufferReadySemaphores)
-      vkDestroySemaphore(dev, sem, nullptr);
+    destroySubmissions();
     if(renderFinishedSemaphore != VK_NULL_HANDLE)
       vkDestroySemaphore(dev, renderFinishedSemaphore, nullptr);
     if (imageAvailableSemaphore != VK_NULL_HANDLE)
       vkDestroySemaphore(dev, imageAvailableSemaphore, nullptr);
     primaryCommandBuffers.clear();
+    readbackManager      = nullptr;
     presentCommandBuffer = nullptr;
     prepareCommandBuffer = nullptr;
     commandPools.clear();
@@ -260,6 +265,14 @@ bool Surface::checkWorkflow()
 
     workflowResults = renderWorkflow->workflowResults;
 
+    // queue submissions have changed - command buffers and semaphores must be created again
+    if (isRealized())
+    {
+      vkDeviceWaitIdle(deviceSh->device);
+      destroySubmissions();
+      createSubmissions();
+    }
+
     for (uint32_t i = 0; i < workflowResults->queueTraits.size(); ++i)
     {
       std::wstringstream ostr;
@@ -284,6 +297,92 @@ bool Surface::checkWorkflow()
   return false;
 }
 
+// Submission waiting for frame buffer images should not block stages that are executed before first command of submission is able to touch them
+static VkPipelineStageFlags getFrameBufferWaitStages(const std::vector<std::shared_ptr<RenderCommand>>& commands)
+{
+  VkPipelineStageFlags result = VK_PIPELINE_STAGE_TRANSFER_BIT;
+  for (auto& command : commands)
+  {
+    switch (command->commandType)
+    {
+    case RenderCommand::ctRenderSubPass:
+      result |= VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+      break;
+    case RenderCommand::ctComputePass:
+      result |= VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+      break;
+    }
+  }
+  return result;
+}
+
+void Surface::createSubmissions()
+{
+  auto deviceSh     = device.lock();
+  VkDevice vkDevice = deviceSh->device;
+  VkSemaphoreCreateInfo semaphoreCreateInfo{};
+    semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+  const auto& submissions = workflowResults->submissions;
+  submissionWaitSemaphores.resize(submissions.size());
+  submissionWaitStages.resize(submissions.size());
+  submissionSignalSemaphores.resize(submissions.size());
+  for (uint32_t i = 0; i < submissions.size(); ++i)
+  {
+    // render passes use frame buffers created for each swapchain image, so each frame in flight keeps one variant for each swapchain image
+    auto commandBuffer = std::make_shared<CommandBuffer>(VK_COMMAND_BUFFER_LEVEL_PRIMARY, deviceSh.get(), commandPools[submissions[i].queueNumber], framesInFlight, surfaceTraits.imageCount);
+    primaryCommandBuffers.push_back(commandBuffer);
+
+    // submission that does not wait for other submissions waits for frame buffer images to be ready
+    if (submissions[i].waitSubmissions.empty())
+    {
+      VkSemaphore semaphore;
+      VK_CHECK_LOG_THROW(vkCreateSemaphore(vkDevice, &semaphoreCreateInfo, nullptr, &semaphore), "Could not create frame buffer ready semaphore");
+      frameBufferReadySemaphores.push_back(semaphore);
+      submissionWaitSemaphores[i].push_back(semaphore);
+      submissionWaitStages[i].push_back(getFrameBufferWaitStages(workflowResults->commands[i]));
+    }
+    for (uint32_t j = 0; j < submissions[i].waitSubmissions.size(); ++j)
+    {
+      VkSemaphore semaphore;
+      VK_CHECK_LOG_THROW(vkCreateSemaphore(vkDevice, &semaphoreCreateInfo, nullptr, &semaphore), "Could not create queue semaphore");
+      queueSemaphores.push_back(semaphore);
+      submissionWaitSemaphores[i].push_back(semaphore);
+      submissionWaitStages[i].push_back(submissions[i].waitStages[j]);
+      submissionSignalSemaphores[submissions[i].waitSubmissions[j]].push_back(semaphore);
+    }
+  }
+  // Ensures that the image is not presented until all submissions have been executed
+  for (uint32_t i = 0; i < submissions.size(); ++i)
+  {
+    if (!submissionSignalSemaphores[i].empty())
+      continue;
+    VkSemaphore semaphore;
+    VK_CHECK_LOG_THROW(vkCreateSemaphore(vkDevice, &semaphoreCreateInfo, nullptr, &semaphore), "Could not create render complete semaphore");
+    renderCompleteSemaphores.push_back(semaphore);
+    submissionSignalSemaphores[i].push_back(semaphore);
+  }
+}
+
+void Surface::destroySubmissions()
+{
+  VkDevice vkDevice = device.lock()->device;
+  for (auto sem : renderCompleteSemaphores)
+    vkDestroySemaphore(vkDevice, sem, nullptr);
+  for (auto sem : frameBufferReadySemaphores)
+    vkDestroySemaphore(vkDevice, sem, nullptr);
+  for (auto sem : queueSemaphores)
+    vkDestroySemaphore(vkDevice, sem, nullptr);
+  renderCompleteSemaphores.clear();
+  frameBufferReadySemaphores.clear();
+  queueSemaphores.clear();
+  submissionWaitSemaphores.clear();
+  submissionWaitStages.clear();
+  submissionSignalSemaphores.clear();
+  primaryCommandBuffers.clear();
+}
+
 void Surface::beginFrame()
 {
   resized = false;
@@ -296,6 +395,17 @@ void Surface::beginFrame()
     resized = true;
   }
 
+  // wait until GPU finishes the frame that previously used resources of this frame in flight
+  auto viewerSh = viewer.lock();
+  frameIndex    = viewerSh->getFrameNumber() % framesInFlight;
+  VK_CHECK_LOG_THROW(vkWaitForFences(deviceSh->device, 1, &waitFences[frameIndex], VK_TRUE, UINT64_MAX), "failed to wait for fence");
+  VK_CHECK_LOG_THROW(vkResetFences(deviceSh->device, 1, &waitFences[frameIndex]), "failed to reset a fence");
+  // frame submitted with this fence is finished
+  completedFrameNumber = std::max(completedFrameNumber, waitFenceFrameNumbers[frameIndex]);
+  waitFenceFrameNumbers[frameIndex] = viewerSh->getFrameNumber();
+  // data copied by the finished frame may be delivered now
+  readbackManager->frameFinished(frameIndex, waitFenceFrameNumbers[frameIndex], completedFrameNumber);
+
   VkResult result = vkAcquireNextImageKHR(deviceSh->device, swapChain, UINT64_MAX, imageAvailableSemaphore, (VkFence)nullptr, &swapChainImageIndex);
   if ((result == VK_ERROR_OUT_OF_DATE_KHR) || (result == VK_SUBOPTIMAL_KHR))
   {
@@ -306,9 +416,6 @@ void Surface::beginFrame()
     result = vkAcquireNextImageKHR(deviceSh->device, swapChain, UINT64_MAX, imageAvailableSemaphore, (VkFence)nullptr, &swapChainImageIndex);
   }
   VK_CHECK_LOG_THROW(result, "failed vkAcquireNextImageKHR");
-
-  VK_CHECK_LOG_THROW(vkWaitForFences(deviceSh->device, 1, &waitFences[swapChainImageIndex], VK_TRUE, UINT64_MAX), "failed to wait for fence");
-  VK_CHECK_LOG_THROW(vkResetFences(deviceSh->device, 1, &waitFences[swapChainImageIndex]), "failed to reset a fence");
 }
 
 void Surface::validateWorkflow()
@@ -316,6 +423,11 @@ void Surface::validateWorkflow()
   RenderContext renderContext(this, workflowResults->presentationQueueIndex);
   if (checkWorkflow() || resized)
   {
+    // frame buffer images are created again, so they have no owner
+    {
+      std::lock_guard<std::mutex> lock(ownershipMutex);
+      returnedOwnerships.clear();
+    }
     for (auto& frameBuffer : workflowResults->frameBuffers)
     {
       frameBuffer->prepareMemoryImages(renderContext, swapChainImages);
@@ -326,11 +438,12 @@ void Surface::validateWorkflow()
     frameBuffer->validate(renderContext);
 
   // create/update render passes and compute passes for current surface
-  for (auto& command : workflowResults->commands[workflowResults->presentationQueueIndex])
-    command->validate(renderContext);
+  for (auto& commandSequence : workflowResults->commands)
+    for (auto& command : commandSequence)
+      command->validate(renderContext);
 
   // at the beginning of render we must transform frame buffer images into appropriate image layouts
-  prepareCommandBuffer->setActiveIndex(swapChainImageIndex);
+  prepareCommandBuffer->setActiveIndex(frameIndex, swapChainImageIndex);
   if (!prepareCommandBuffer->isValid())
   {
     prepareCommandBuffer->cmdBegin();
@@ -399,10 +512,14 @@ void Surface::validateWorkflow()
     prepareCommandBuffer->cmdEnd();
   }
 
-  presentCommandBuffer->setActiveIndex(swapChainImageIndex);
+  presentCommandBuffer->setActiveIndex(frameIndex, swapChainImageIndex);
+  // readback copies are recorded into present command buffer, so it must be recorded again whenever the set of copies changes
+  if (readbackManager->needsRecording(frameIndex))
+    presentCommandBuffer->invalidate(frameIndex);
   if (!presentCommandBuffer->isValid())
   {
     presentCommandBuffer->cmdBegin();
+    readbackManager->recordCopies(renderContext, presentCommandBuffer.get());
     PipelineBarrier presentBarrier
     (
       VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, 
@@ -422,14 +539,14 @@ void Surface::validateWorkflow()
 void Surface::setCommandBufferIndices()
 {
   for (uint32_t i = 0; i < primaryCommandBuffers.size(); ++i)
-    primaryCommandBuffers[i]->setActiveIndex(swapChainImageIndex);
+    primaryCommandBuffers[i]->setActiveIndex(frameIndex, swapChainImageIndex);
 
   RenderContext renderContext(this, workflowResults->presentationQueueIndex);
   for (uint32_t i = 0; i < secondaryCommandBufferNodes.size(); ++i)
   {
     auto commandBuffer = secondaryCommandBufferNodes[i]->getSecondaryBuffer(renderContext);
     CHECK_LOG_THROW(commandBuffer == nullptr, "Secondary buffer not defined for node " << secondaryCommandBufferNodes[i]->getName());
-    commandBuffer->setActiveIndex(swapChainImageIndex);
+    commandBuffer->setActiveIndex(frameIndex);
   }
 }
 
@@ -437,32 +554,46 @@ void Surface::validatePrimaryNodes(uint32_t queueNumber)
 {
   RenderContext renderContext(this, workflowResults->presentationQueueIndex);
   ValidateNodeVisitor validateNodeVisitor(renderContext, true);
-  for (auto& command : workflowResults->commands[queueNumber])
-    command->applyRenderContextVisitor(validateNodeVisitor);
+  for (uint32_t i = 0; i < workflowResults->submissions.size(); ++i)
+  {
+    if (workflowResults->submissions[i].queueNumber != queueNumber)
+      continue;
+    for (auto& command : workflowResults->commands[i])
+      command->applyRenderContextVisitor(validateNodeVisitor);
+  }
 }
 
 void Surface::validatePrimaryDescriptors(uint32_t queueNumber)
 {
   RenderContext renderContext(this, workflowResults->presentationQueueIndex);
   ValidateDescriptorVisitor validateDescriptorVisitor(renderContext, true);
-  for (auto& command : workflowResults->commands[queueNumber])
-    command->applyRenderContextVisitor(validateDescriptorVisitor);
+  for (uint32_t i = 0; i < workflowResults->submissions.size(); ++i)
+  {
+    if (workflowResults->submissions[i].queueNumber != queueNumber)
+      continue;
+    for (auto& command : workflowResults->commands[i])
+      command->applyRenderContextVisitor(validateDescriptorVisitor);
+  }
 }
 
 void Surface::buildPrimaryCommandBuffer(uint32_t queueNumber)
 {
   RenderContext renderContext(this, workflowResults->presentationQueueIndex);
-  primaryCommandBuffers[queueNumber]->setActiveIndex(swapChainImageIndex);
-  if (!primaryCommandBuffers[queueNumber]->isValid())
+  for (uint32_t i = 0; i < workflowResults->submissions.size(); ++i)
   {
-    BuildCommandBufferVisitor cbVisitor(renderContext, primaryCommandBuffers[queueNumber].get(), true);
+    if (workflowResults->submissions[i].queueNumber != queueNumber)
+      continue;
+    primaryCommandBuffers[i]->setActiveIndex(frameIndex, swapChainImageIndex);
+    if (primaryCommandBuffers[i]->isValid())
+      continue;
+    BuildCommandBufferVisitor cbVisitor(renderContext, primaryCommandBuffers[i].get(), true);
 
-    primaryCommandBuffers[queueNumber]->cmdBegin();
+    primaryCommandBuffers[i]->cmdBegin();
 
-    for (auto& command : workflowResults->commands[queueNumber])
+    for (auto& command : workflowResults->commands[i])
       command->buildCommandBuffer(cbVisitor);
 
-    primaryCommandBuffers[queueNumber]->cmdEnd();
+    primaryCommandBuffers[i]->cmdEnd();
   }
 }
 
@@ -525,7 +656,7 @@ void Surface::buildSecondaryCommandBuffers()
           RenderContext renderContext(this, workflowResults->presentationQueueIndex);
           auto commandBuffer = secondaryCommandBufferNodes[i]->getSecondaryBuffer(renderContext);
           CHECK_LOG_THROW(commandBuffer == nullptr, "Secondary buffer not defined for node " << secondaryCommandBufferNodes[i]->getName());
-          commandBuffer->setActiveIndex(swapChainImageIndex);
+          commandBuffer->setActiveIndex(frameIndex);
           if (!commandBuffer->isValid())
           {
             // The problem is that above defined render context needs to use elements defined up the tree ( currentPipelineLayout, currentAssetBuffer and currentRenderMask )
@@ -551,21 +682,54 @@ void Surface::buildSecondaryCommandBuffers()
 
 void Surface::draw()
 {
-  prepareCommandBuffer->queueSubmit(queues[workflowResults->presentationQueueIndex]->queue, { imageAvailableSemaphore }, { VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT }, frameBufferReadySemaphores, VK_NULL_HANDLE );
+  // all submissions wait for frameBufferReadySemaphores, so data uploaded on upload queue is waited for in the first submission
+  std::vector<VkSemaphore>          waitSemaphores{ imageAvailableSemaphore };
+  std::vector<VkPipelineStageFlags> waitStages{ VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT };
+  auto uploadManager = device.lock()->getUploadManager();
+  if (uploadManager != nullptr)
+  {
+    auto uploadSemaphores = uploadManager->submit(getID(), viewer.lock()->getFrameNumber());
+    waitSemaphores.insert(end(waitSemaphores), begin(uploadSemaphores), end(uploadSemaphores));
+    // uploaded data is read by transfers, indirect draws, vertex input and shaders ( tessellation and geometry stages are logically later than vertex input )
+    VkPipelineStageFlags uploadWaitStages = VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+      VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    waitStages.resize(waitSemaphores.size(), uploadWaitStages);
+  }
+  // objects moved during defragmentation must be copied before any command uses them
+  device.lock()->submitRelocations(commandPools[workflowResults->presentationQueueIndex]->queueFamilyIndex, queues[workflowResults->presentationQueueIndex]->queue);
+  prepareCommandBuffer->queueSubmit(queues[workflowResults->presentationQueueIndex]->queue, waitSemaphores, waitStages, frameBufferReadySemaphores, VK_NULL_HANDLE );
+
+  // submissions are sorted, so that each semaphore is signaled by a submission sent before the submission that waits for it
+  for (uint32_t i = 0; i < workflowResults->submissions.size(); ++i)
+    primaryCommandBuffers[i]->queueSubmit(queues[workflowResults->submissions[i].queueNumber]->queue, submissionWaitSemaphores[i], submissionWaitStages[i], submissionSignalSemaphores[i], VK_NULL_HANDLE);
 
-  for (uint32_t i = 0; i < queues.size(); ++i)
+  // resources used for the first time are returned to generating queue at the end of this frame, so next frames must acquire them
+  std::lock_guard<std::mutex> lock(ownershipMutex);
+  if (!firstOwnershipUses.empty())
   {
-    // submit command buffer to each queue with a semaphore signaling ent of work (renderCompleteSemaphores[i])
-    primaryCommandBuffers[i]->queueSubmit(queues[i]->queue, { frameBufferReadySemaphores[i] }, { VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT }, { renderCompleteSemaphores[i] }, VK_NULL_HANDLE);
+    returnedOwnerships.insert(begin(firstOwnershipUses), end(firstOwnershipUses));
+    firstOwnershipUses.clear();
+    for (auto& commandBuffer : primaryCommandBuffers)
+      commandBuffer->invalidate(frameIndex);
   }
 }
 
+bool Surface::isOwnershipReturned(MemoryObject* memoryObject, uint32_t copyIndex)
+{
+  std::lock_guard<std::mutex> lock(ownershipMutex);
+  auto key = std::make_pair(memoryObject, copyIndex);
+  if (returnedOwnerships.find(key) != end(returnedOwnerships))
+    return true;
+  firstOwnershipUses.insert(key);
+  return false;
+}
+
 void Surface::endFrame()
 {
   // wait for all queues to finish work ( using renderCompleteSemaphores ), then submit command buffer converting output image to VK_IMAGE_LAYOUT_PRESENT_SRC_KHR layout
   std::vector<VkPipelineStageFlags> waitStages;
   waitStages.resize(renderCompleteSemaphores.size(), VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
-  presentCommandBuffer->queueSubmit(queues[workflowResults->presentationQueueIndex]->queue, renderCompleteSemaphores, waitStages, { renderFinishedSemaphore }, waitFences[swapChainImageIndex]);
+  presentCommandBuffer->queueSubmit(queues[workflowResults->presentationQueueIndex]->queue, renderCompleteSemaphores, waitStages, { renderFinishedSemaphore }, waitFences[frameIndex]);
 
   // present output image when its layout is transformed into VK_IMAGE_LAYOUT_PRESENT_SRC_KHR 
   VkPresentInfoKHR presentInfo{};
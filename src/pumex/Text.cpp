@@ -138,6 +138,8 @@ Text::Text(std::shared_ptr<Font> f, std::shared_ptr<DeviceMemoryAllocator> buffe
   : DrawNode(), font{ f }
 {
   vertexBuffer = std::make_shared<Buffer<std::vector<SymbolData>>>(bufferAllocator, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, pbPerSurface, swForEachImage);
+  // the same text displayed on many surfaces is sent to GPU only once
+  vertexBuffer->setSurfaceDataSharing(true);
   textVertexSemantic = { { VertexSemantic::Position, 4 },{ VertexSemantic::TexCoord, 4 } , { VertexSemantic::Color, 4 } };
 }
 
@@ -186,7 +188,7 @@ void Text::cmdDraw(const RenderContext& renderContext, CommandBuffer* commandBuf
 
   commandBuffer->addSource(this);
   VkBuffer     vBuffer = vertexBuffer->getHandleBuffer(renderContext);
-  VkDeviceSize offsets = 0;
+  VkDeviceSize offsets = vertexBuffer->getBufferOffset(renderContext);
   vkCmdBindVertexBuffers(commandBuffer->getHandle(), 0, 1, &vBuffer, &offsets);
   commandBuffer->cmdDraw(sit->second->size(), 1, 0, 0, 0);
 }
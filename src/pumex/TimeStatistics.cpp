@@ -26,8 +26,8 @@
 
 using namespace pumex;
 
-TimeStatisticsChannel::TimeStatisticsChannel(uint32_t valueCount, const std::wstring& chn, const glm::vec4& c)
-  : sumValue{ 0.0 }, currentIndex{ 0 }, channelName{ chn }, color{ c }
+TimeStatisticsChannel::TimeStatisticsChannel(uint32_t valueCount, const std::wstring& chn, const glm::vec4& c, ValueType vt)
+  : sumValue{ 0.0 }, currentIndex{ 0 }, channelName{ chn }, color{ c }, valueType{ vt }
 {
   CHECK_LOG_THROW(valueCount == 0, "Cannot make StatisticsChannel with value == 0");
 
@@ -96,7 +96,7 @@ void TimeStatistics::unregisterGroup(uint32_t groupID)
   groups.erase(git);
 }
 
-void TimeStatistics::registerChannel(uint32_t channelID, uint32_t groupID, const std::wstring& channelName, const glm::vec4& color)
+void TimeStatistics::registerChannel(uint32_t channelID, uint32_t groupID, const std::wstring& channelName, const glm::vec4& color, TimeStatisticsChannel::ValueType valueType)
 {
   std::lock_guard<std::mutex> lock(mutex);
   auto it = channelIndices.find(channelID);
@@ -110,12 +110,12 @@ void TimeStatistics::registerChannel(uint32_t channelID, uint32_t groupID, const
     uint32_t newChannel = freeChannels.back();
     freeChannels.pop_back();
     channelIndices[channelID]      = newChannel;
-    channels[newChannel]           = TimeStatisticsChannel(valueCount,channelName, color);
+    channels[newChannel]           = TimeStatisticsChannel(valueCount,channelName, color, valueType);
   }
   else
   {
     channelIndices[channelID] = channels.size();
-    channels.push_back(TimeStatisticsChannel(valueCount, channelName, color));
+    channels.push_back(TimeStatisticsChannel(valueCount, channelName, color, valueType));
   }
   groupChannelIndices[channelID] = groupID;
 }
@@ -68,5 +68,10 @@ void UniformBuffer::validate(const RenderContext& renderContext)
 
 DescriptorValue UniformBuffer::getDescriptorValue(const RenderContext& renderContext)
 {
-  return DescriptorValue(memoryBuffer->getHandleBuffer(renderContext), 0, memoryBuffer->getDataSizeRC(renderContext));
+  return DescriptorValue(memoryBuffer->getHandleBuffer(renderContext), memoryBuffer->getBufferOffset(renderContext), memoryBuffer->getDataSizeRC(renderContext));
+}
+
+uint32_t UniformBuffer::getDynamicOffset(const RenderContext& renderContext)
+{
+  return memoryBuffer->getDynamicOffset(renderContext);
 }
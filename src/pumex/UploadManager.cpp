@@ -0,0 +1,251 @@
+//
+// Copyright(c) 2017-2018 Paweł Księżopolski ( pumexx )
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+
+#include <pumex/UploadManager.h>
+#include <algorithm>
+#include <limits>
+#include <pumex/Device.h>
+#include <pumex/Command.h>
+#include <pumex/Image.h>
+#include <pumex/utils/Buffer.h>
+#include <pumex/utils/Log.h>
+
+using namespace pumex;
+
+UploadManager::UploadManager(Device* d, std::shared_ptr<Queue> q, const std::vector<uint32_t>& deviceQueueFamilies)
+  : device{ d }, queue{ q }
+{
+  CHECK_LOG_THROW(queue == nullptr, "UploadManager : upload queue not defined");
+  commandPool = std::make_shared<CommandPool>(queue->familyIndex);
+  commandPool->validate(device);
+
+  // buffers written on upload queue and read on other queues must be shared between queue families
+  if (std::any_of(begin(deviceQueueFamilies), end(deviceQueueFamilies), [this](uint32_t family) { return family != queue->familyIndex; }))
+  {
+    concurrentQueueFamilies = deviceQueueFamilies;
+    concurrentQueueFamilies.push_back(queue->familyIndex);
+    std::sort(begin(concurrentQueueFamilies), end(concurrentQueueFamilies));
+    concurrentQueueFamilies.erase(std::unique(begin(concurrentQueueFamilies), end(concurrentQueueFamilies)), end(concurrentQueueFamilies));
+  }
+}
+
+UploadManager::~UploadManager()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  for (auto& submission : submissions)
+  {
+    VK_CHECK_LOG_THROW(vkWaitForFences(device->device, 1, &submission.fence, VK_TRUE, UINT64_MAX), "Waiting for a fence failed");
+    vkDestroyFence(device->device, submission.fence, nullptr);
+    for (auto semaphore : submission.semaphores)
+      vkDestroySemaphore(device->device, semaphore, nullptr);
+    for (auto& stagingBuffer : submission.stagingBuffers)
+      device->releaseStagingBuffer(stagingBuffer);
+  }
+  for (auto& stagingBuffer : pendingStagingBuffers)
+    device->releaseStagingBuffer(stagingBuffer);
+}
+
+void UploadManager::copyBuffer(std::shared_ptr<StagingBuffer> stagingBuffer, VkBuffer dstBuffer, const std::vector<VkBufferCopy>& regions)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  for (const auto& region : regions)
+  {
+    // copies writing to the same memory must be separated by a barrier, so such copy starts a new copy group
+    bool overlaps = pendingCopies.empty();
+    if (!overlaps)
+    {
+      for (const auto& copies : pendingCopies.back())
+      {
+        if (copies.first.second != dstBuffer)
+          continue;
+        overlaps |= std::any_of(begin(copies.second), end(copies.second), [&region](const VkBufferCopy& c) { return c.dstOffset < region.dstOffset + region.size && region.dstOffset < c.dstOffset + c.size; });
+      }
+    }
+    if (overlaps)
+      pendingCopies.push_back(CopyGroup());
+    pendingCopies.back()[std::make_pair(stagingBuffer->buffer, dstBuffer)].push_back(region);
+  }
+  pendingStagingBuffers.push_back(stagingBuffer);
+}
+
+void UploadManager::copyBufferToImage(std::shared_ptr<StagingBuffer> stagingBuffer, std::shared_ptr<Image> image, VkImageAspectFlags aspectMask, const std::vector<VkBufferImageCopy>& regions)
+{
+  CHECK_LOG_THROW(!sharesQueueFamily(), "UploadManager::copyBufferToImage() : images may be uploaded only when all queues belong to the same queue family");
+  std::lock_guard<std::mutex> lock(mutex);
+  pendingImageUploads.push_back({ image, aspectMask, stagingBuffer->buffer, regions });
+  pendingStagingBuffers.push_back(stagingBuffer);
+}
+
+void UploadManager::discardBufferCopies(VkBuffer dstBuffer, VkDeviceSize offset, VkDeviceSize size)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  VkDeviceSize end = (size == VK_WHOLE_SIZE) ? std::numeric_limits<VkDeviceSize>::max() : offset + size;
+  for (auto& copyGroup : pendingCopies)
+  {
+    for (auto it = begin(copyGroup); it != std::end(copyGroup); )
+    {
+      if (it->first.second == dstBuffer)
+        it->second.erase(std::remove_if(begin(it->second), std::end(it->second), [offset, end](const VkBufferCopy& c) { return c.dstOffset < end && offset < c.dstOffset + c.size; }), std::end(it->second));
+      if (it->second.empty())
+        it = copyGroup.erase(it);
+      else
+        ++it;
+    }
+  }
+}
+
+bool UploadManager::hasPendingCopies(VkBuffer dstBuffer) const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  for (const auto& copyGroup : pendingCopies)
+    for (const auto& copies : copyGroup)
+      if (copies.first.second == dstBuffer)
+        return true;
+  return false;
+}
+
+void UploadManager::registerWaiter(uint32_t waiterID)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  waiterSemaphores.insert({ waiterID, std::vector<VkSemaphore>() });
+}
+
+void UploadManager::unregisterWaiter(uint32_t waiterID)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  // semaphores not waited for are destroyed when their submission is finished
+  waiterSemaphores.erase(waiterID);
+}
+
+std::vector<VkSemaphore> UploadManager::submit(uint32_t waiterID, uint64_t frameNumber)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  releaseSubmissions();
+
+  bool hasCopies = !pendingImageUploads.empty() || std::any_of(begin(pendingCopies), end(pendingCopies), [](const CopyGroup& copyGroup) { return !copyGroup.empty(); });
+  if (hasCopies)
+  {
+    Submission submission;
+    submission.commandBuffer = std::make_shared<CommandBuffer>(VK_COMMAND_BUFFER_LEVEL_PRIMARY, device, commandPool);
+    submission.commandBuffer->cmdBegin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    bool firstGroup = true;
+    for (auto& copyGroup : pendingCopies)
+    {
+      if (copyGroup.empty())
+        continue;
+      if (!firstGroup)
+        submission.commandBuffer->cmdPipelineBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, PipelineBarrier(VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_WRITE_BIT));
+      for (auto& copies : copyGroup)
+        submission.commandBuffer->cmdCopyBuffer(copies.first.first, copies.first.second, copies.second);
+      firstGroup = false;
+    }
+    for (auto& imageUpload : pendingImageUploads)
+    {
+      submission.commandBuffer->setImageLayout(*imageUpload.image, imageUpload.aspectMask, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+      submission.commandBuffer->cmdCopyBufferToImage(imageUpload.srcBuffer, *imageUpload.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, imageUpload.regions);
+      submission.commandBuffer->setImageLayout(*imageUpload.image, imageUpload.aspectMask, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL);
+      submission.images.push_back(imageUpload.image);
+    }
+    submission.commandBuffer->cmdEnd();
+
+    VkFenceCreateInfo fenceCreateInfo{};
+      fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    VK_CHECK_LOG_THROW(vkCreateFence(device->device, &fenceCreateInfo, nullptr, &submission.fence), "Cannot create fence");
+    // each waiter receives its own semaphore
+    VkSemaphoreCreateInfo semaphoreCreateInfo{};
+      semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    for (auto& ws : waiterSemaphores)
+    {
+      VkSemaphore semaphore;
+      VK_CHECK_LOG_THROW(vkCreateSemaphore(device->device, &semaphoreCreateInfo, nullptr, &semaphore), "Could not create upload semaphore");
+      submission.semaphores.push_back(semaphore);
+      ws.second.push_back(semaphore);
+    }
+    submission.commandBuffer->queueSubmit(queue->queue, {}, {}, submission.semaphores, submission.fence);
+    submission.stagingBuffers = std::move(pendingStagingBuffers);
+    submissions.push_back(std::move(submission));
+  }
+  else
+  {
+    // all copies were discarded - staging buffers were not used by GPU
+    for (auto& stagingBuffer : pendingStagingBuffers)
+      device->releaseStagingBuffer(stagingBuffer);
+  }
+  pendingCopies.clear();
+  pendingImageUploads.clear();
+  pendingStagingBuffers.clear();
+
+  auto it = waiterSemaphores.find(waiterID);
+  if (it == end(waiterSemaphores))
+    return std::vector<VkSemaphore>();
+  std::vector<VkSemaphore> results;
+  std::swap(results, it->second);
+  for (auto& submission : submissions)
+    if (std::any_of(begin(submission.semaphores), end(submission.semaphores), [&results](VkSemaphore s) { return std::find(begin(results), end(results), s) != end(results); }))
+      submission.lastWaitFrame = std::max(submission.lastWaitFrame, frameNumber);
+  return results;
+}
+
+void UploadManager::beginFrame(uint64_t frameNumber, uint64_t cfn)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  completedFrameNumber = cfn;
+  releaseSubmissions();
+}
+
+uint32_t UploadManager::getQueueFamilyIndex() const
+{
+  return queue->familyIndex;
+}
+
+void UploadManager::setSharingMode(VkBufferCreateInfo& bufferCreateInfo) const
+{
+  if (sharesQueueFamily())
+    return;
+  bufferCreateInfo.sharingMode           = VK_SHARING_MODE_CONCURRENT;
+  bufferCreateInfo.queueFamilyIndexCount = static_cast<uint32_t>(concurrentQueueFamilies.size());
+  bufferCreateInfo.pQueueFamilyIndices   = concurrentQueueFamilies.data();
+}
+
+// submission resources may be released when submission is finished and all frames waiting for its semaphores are finished too
+void UploadManager::releaseSubmissions()
+{
+  for (auto it = begin(submissions); it != end(submissions); )
+  {
+    bool semaphoresPending = std::any_of(begin(waiterSemaphores), end(waiterSemaphores), [&it](const std::pair<const uint32_t, std::vector<VkSemaphore>>& ws)
+    {
+      return std::any_of(begin(ws.second), end(ws.second), [&it](VkSemaphore s) { return std::find(begin(it->semaphores), end(it->semaphores), s) != end(it->semaphores); });
+    });
+    if (semaphoresPending || it->lastWaitFrame >= completedFrameNumber || vkGetFenceStatus(device->device, it->fence) != VK_SUCCESS)
+    {
+      ++it;
+      continue;
+    }
+    vkDestroyFence(device->device, it->fence, nullptr);
+    for (auto semaphore : it->semaphores)
+      vkDestroySemaphore(device->device, semaphore, nullptr);
+    for (auto& stagingBuffer : it->stagingBuffers)
+      device->releaseStagingBuffer(stagingBuffer);
+    it = submissions.erase(it);
+  }
+}
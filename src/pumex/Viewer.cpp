@@ -29,6 +29,7 @@
 #include <pumex/Surface.h>
 #include <pumex/RenderWorkflow.h>
 #include <pumex/TimeStatistics.h>
+#include <pumex/DeviceMemoryAllocator.h>
 #include <pumex/InputEvent.h>
 #include <pumex/Version.h>
 #if defined(_WIN32)
@@ -70,7 +71,7 @@ Viewer::Viewer(const ViewerTraits& vt)
   timeStatistics->registerChannel(TSV_CHANNEL_FRAME,               TSV_GROUP_RENDER,        L"Frame time",                 glm::vec4(0.5f, 0.5f, 0.5f, 0.5f));
   timeStatistics->registerChannel(TSV_CHANNEL_EVENT_RENDER_START,  TSV_GROUP_RENDER_EVENTS, L"Viewer event render start",  glm::vec4(0.8f, 0.8f, 0.1f, 0.5f));
   timeStatistics->registerChannel(TSV_CHANNEL_EVENT_RENDER_FINISH, TSV_GROUP_RENDER_EVENTS, L"Viewer event render finish", glm::vec4(0.8f, 0.1f, 0.1f, 0.5f));
-  timeStatistics->setFlags(TSV_STAT_UPDATE | TSV_STAT_RENDER | TSV_STAT_RENDER_EVENTS);
+  timeStatistics->setFlags(TSV_STAT_UPDATE | TSV_STAT_RENDER | TSV_STAT_RENDER_EVENTS | TSV_STAT_MEMORY);
 
   // register basic directories - directories listed in PUMEX_DATA_DIR environment variable, separated by colon or semicolon
   const char* dataDirVariable = std::getenv("PUMEX_DATA_DIR");
@@ -244,6 +245,7 @@ void Viewer::run()
       try
       {
         frameNumber++;
+        beginDeviceFrames();
         renderContinueRun = !terminating();
         if (renderContinueRun)
         {
@@ -264,6 +266,15 @@ void Viewer::run()
         timeStatistics->setValues(TSV_CHANNEL_RENDER, inSeconds(renderStartTime - viewerStartTime), inSeconds(renderEndTime - renderStartTime));
         timeStatistics->setValues(TSV_CHANNEL_FRAME, inSeconds(prevRenderStartTime - viewerStartTime), inSeconds(renderStartTime - prevRenderStartTime));
       }
+      if (timeStatistics->hasFlags(TSV_STAT_MEMORY))
+      {
+        for (uint32_t i = 0; i < statisticsAllocators.size(); ++i)
+        {
+          auto allocator = statisticsAllocators[i].lock();
+          if (allocator != nullptr)
+            allocator->setTimeStatisticsValues(timeStatistics.get(), TSV_CHANNEL_MEMORY + 10 * i, inSeconds(renderStartTime - viewerStartTime));
+        }
+      }
 
       if (!renderContinueRun || !updateContinueRun)
       {
@@ -464,6 +475,13 @@ void Viewer::removeInputEventHandler(std::shared_ptr<InputEventHandler> eventHan
   inputEventHandlers.erase(std::remove_if(begin(inputEventHandlers), end(inputEventHandlers), [&](std::shared_ptr<InputEventHandler> ie) { return ie.get() == eventHandler.get();  }), end(inputEventHandlers));
 }
 
+void Viewer::addMemoryStatistics(std::shared_ptr<DeviceMemoryAllocator> allocator, const std::wstring& name)
+{
+  uint32_t index = statisticsAllocators.size();
+  allocator->registerTimeStatistics(timeStatistics.get(), TSV_GROUP_MEMORY + index, TSV_CHANNEL_MEMORY + 10 * index, name);
+  statisticsAllocators.push_back(allocator);
+}
+
 void Viewer::addDefaultDirectory(const filesystem::path & directory) 
 {
   std::error_code ec;
@@ -576,6 +594,26 @@ uint32_t   Viewer::getNextRenderSlot() const
   return slot;
 }
 
+// inform devices which frame is the last one finished by GPU on all surfaces
+void Viewer::beginDeviceFrames()
+{
+  for (auto& d : devices)
+  {
+    uint64_t completedFrameNumber = frameNumber - 1;
+    uint32_t framesInFlight       = 0;
+    bool     firstSurface         = true;
+    for (auto& s : surfaces)
+    {
+      if (s.second->device.lock() != d.second)
+        continue;
+      completedFrameNumber = std::min<uint64_t>(completedFrameNumber, s.second->getCompletedFrameNumber());
+      framesInFlight       = (firstSurface || framesInFlight == s.second->getFramesInFlight()) ? s.second->getFramesInFlight() : 0;
+      firstSurface         = false;
+    }
+    d.second->beginFrame(frameNumber, completedFrameNumber, framesInFlight);
+  }
+}
+
 void Viewer::onEventRenderStart() 
 { 
   HPClock::time_point tickStart;
@@ -848,10 +886,13 @@ void Viewer::buildRenderGraph()
     });
   }
 
-  tbb::flow::make_edge(opRenderGraphStart, opRenderGraphEventRenderStart);
+  // render start event may write data used by current frame in flight ( see StreamingBuffer ), so it waits until surfaces finish waiting for GPU
+  if (surfacePointers.empty())
+    tbb::flow::make_edge(opRenderGraphStart, opRenderGraphEventRenderStart);
   for (uint32_t i = 0; i < surfacePointers.size(); ++i)
   {
     tbb::flow::make_edge(opRenderGraphStart, opSurfaceBeginFrame[i]);
+    tbb::flow::make_edge(opSurfaceBeginFrame[i], opRenderGraphEventRenderStart);
     tbb::flow::make_edge(opRenderGraphStart, opSurfaceEventRenderStart[i]);
     
     tbb::flow::make_edge(opSurfaceBeginFrame[i], opSurfaceValidateWorkflow[i]);
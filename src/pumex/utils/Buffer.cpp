@@ -136,36 +136,136 @@ void destroyBuffers(VkDevice device, std::vector<NBufferMemory>& multiBuffer, Vk
   vkFreeMemory(device, memory, nullptr);
 }
 
-StagingBuffer::StagingBuffer(Device* d, VkDeviceSize s)
+// GPU writes to readback memory and host reads from it. Reads from uncached memory are very slow, so host cached memory is preferred
+// for buffers with VK_BUFFER_USAGE_TRANSFER_DST_BIT usage even when it is not coherent. Returns size of allocated memory
+static VkDeviceSize createStagingMemory(Device* device, VkBufferUsageFlags usageFlags, VkDeviceSize size, VkBuffer* buffer, VkDeviceMemory* memory, VkDeviceSize& nonCoherentAtomSize)
+{
+  std::vector<VkMemoryPropertyFlags> preferredProperties;
+  if ((usageFlags & VK_BUFFER_USAGE_TRANSFER_DST_BIT) != 0)
+  {
+    preferredProperties.push_back(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    preferredProperties.push_back(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+  }
+  preferredProperties.push_back(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+  VkBufferCreateInfo bufferCreateInfo{};
+    bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferCreateInfo.usage = usageFlags;
+    bufferCreateInfo.size  = std::max<VkDeviceSize>(1, size);
+  VK_CHECK_LOG_THROW(vkCreateBuffer(device->device, &bufferCreateInfo, nullptr, buffer), "Cannot create buffer");
+  VkMemoryRequirements memReqs;
+  vkGetBufferMemoryRequirements(device->device, *buffer, &memReqs);
+
+  auto physicalDevice = device->physical.lock();
+  VkMemoryAllocateInfo memAlloc{};
+    memAlloc.sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    memAlloc.allocationSize  = memReqs.size;
+  VkBool32 memTypeFound = false;
+  for (auto properties : preferredProperties)
+  {
+    memAlloc.memoryTypeIndex = physicalDevice->getMemoryType(memReqs.memoryTypeBits, properties, &memTypeFound);
+    if (memTypeFound)
+      break;
+  }
+  CHECK_LOG_THROW(!memTypeFound, "Cannot find host visible memory for staging buffer");
+  VK_CHECK_LOG_THROW(vkAllocateMemory(device->device, &memAlloc, nullptr, memory), "Cannot allocate memory for buffer");
+  VK_CHECK_LOG_THROW(vkBindBufferMemory(device->device, *buffer, *memory, 0), "Cannot bind memory to buffer");
+
+  bool coherent       = (physicalDevice->memoryProperties.memoryTypes[memAlloc.memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+  nonCoherentAtomSize = coherent ? 0 : physicalDevice->properties.limits.nonCoherentAtomSize;
+  return memAlloc.allocationSize;
+}
+
+StagingBuffer::StagingBuffer(Device* d, VkDeviceSize s, VkBufferUsageFlags u)
   : device{ d->device }
 {
-  memorySize = createBuffer(d, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, s, &buffer, &memory);
+  memorySize = createStagingMemory(d, u, s, &buffer, &memory, nonCoherentAtomSize);
   CHECK_LOG_THROW(memorySize == 0, "Cannot create staging buffer");
+  allocationSize = memorySize;
+  VK_CHECK_LOG_THROW(vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &mappedMemory), "Cannot map memory");
+}
+
+StagingBuffer::StagingBuffer(VkDevice d, VkBuffer b, VkDeviceMemory m, VkDeviceSize as, VkDeviceSize ncas, VkDeviceSize o, VkDeviceSize s, void* mm)
+  : buffer{ b }, offset{ o }, device{ d }, memory{ m }, memorySize{ s }, allocationSize{ as }, nonCoherentAtomSize{ ncas }, mappedMemory{ mm }, ringAllocated{ true }
+{
 }
 
 StagingBuffer::~StagingBuffer()
 {
+  // memory of the ring allocated staging buffer belongs to StagingRing
+  if (isRingAllocated())
+    return;
+  vkUnmapMemory(device, memory);
   destroyBuffer(device, buffer, memory);
 }
 
 void StagingBuffer::fillBuffer(const void* data, VkDeviceSize size)
 {
-  void *mapAddress;
-  VK_CHECK_LOG_THROW(vkMapMemory(device, memory, 0, size, 0, &mapAddress), "Cannot map memory");
-  std::memcpy(mapAddress, data, size);
-  vkUnmapMemory(device, memory);
+  CHECK_LOG_THROW(size > memorySize, "StagingBuffer::fillBuffer() : data does not fit into staging buffer");
+  std::memcpy(mappedMemory, data, size);
 }
 
 void* StagingBuffer::mapMemory(VkDeviceSize size)
 {
-  void *mapAddress;
-  VK_CHECK_LOG_THROW(vkMapMemory(device, memory, 0, size, 0, &mapAddress), "Cannot map memory");
-  return mapAddress;
+  CHECK_LOG_THROW(size > memorySize, "StagingBuffer::mapMemory() : data does not fit into staging buffer");
+  return mappedMemory;
 }
 
 void StagingBuffer::unmapMemory()
+{
+}
+
+void StagingBuffer::invalidateMemory(VkDeviceSize size)
+{
+  if (nonCoherentAtomSize == 0 || size == 0)
+    return;
+  // range must be aligned to nonCoherentAtomSize or reach the end of the memory
+  VkMappedMemoryRange memoryRange{};
+    memoryRange.sType  = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+    memoryRange.memory = memory;
+    memoryRange.offset = offset - (offset % nonCoherentAtomSize);
+    memoryRange.size   = ((offset + size + nonCoherentAtomSize - 1) / nonCoherentAtomSize) * nonCoherentAtomSize - memoryRange.offset;
+  if (memoryRange.offset + memoryRange.size > allocationSize)
+    memoryRange.size = VK_WHOLE_SIZE;
+  VK_CHECK_LOG_THROW(vkInvalidateMappedMemoryRanges(device, 1, &memoryRange), "Cannot invalidate mapped memory");
+}
+
+StagingRing::StagingRing(Device* d, VkDeviceSize s, VkBufferUsageFlags u)
+  : device{ d->device }, strategy{ s }
+{
+  allocationSize = createStagingMemory(d, u, s, &buffer, &memory, nonCoherentAtomSize);
+  CHECK_LOG_THROW(allocationSize == 0, "Cannot create staging ring");
+  // memory may be larger than requested, but only requested size is managed by the strategy
+  size = s;
+  VK_CHECK_LOG_THROW(vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &mappedMemory), "Cannot map memory");
+  // buffer to image copies require offsets aligned to texel block size, which is never greater than 16 bytes
+  alignment = std::max<VkDeviceSize>(alignment, d->physical.lock()->properties.limits.optimalBufferCopyOffsetAlignment);
+}
+
+StagingRing::~StagingRing()
 {
   vkUnmapMemory(device, memory);
+  destroyBuffer(device, buffer, memory);
+}
+
+std::shared_ptr<StagingBuffer> StagingRing::allocate(VkDeviceSize s)
+{
+  VkMemoryRequirements memReqs{ std::max<VkDeviceSize>(1, s), alignment, 0 };
+  DeviceMemoryBlock block = strategy.allocate(VK_NULL_HANDLE, memReqs);
+  if (block.alignedSize == 0)
+    return std::shared_ptr<StagingBuffer>();
+  return std::make_shared<StagingBuffer>(device, buffer, memory, allocationSize, nonCoherentAtomSize, block.alignedOffset, s, static_cast<uint8_t*>(mappedMemory) + block.alignedOffset);
+}
+
+void StagingRing::deallocate(const StagingBuffer& stagingBuffer)
+{
+  DeviceMemoryBlock block(VK_NULL_HANDLE, stagingBuffer.offset, stagingBuffer.offset, stagingBuffer.bufferSize(), stagingBuffer.bufferSize());
+  strategy.deallocate(block);
+}
+
+void StagingRing::beginFrame(uint64_t frameNumber, uint64_t completedFrameNumber)
+{
+  strategy.beginFrame(frameNumber, completedFrameNumber);
 }
 
 
@@ -0,0 +1,325 @@
+//
+// Copyright(c) 2017-2018 Paweł Księżopolski ( pumexx )
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+
+#include <pumex/utils/GeometryOptimizer.h>
+#include <algorithm>
+#include <limits>
+#include <pumex/utils/Log.h>
+
+namespace pumex
+{
+
+const uint32_t INVALID_VERTEX = std::numeric_limits<uint32_t>::max();
+
+static bool isTriangleList(const Geometry& geometry)
+{
+  return geometry.topology == VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST && geometry.indices.size() >= 3 && geometry.indices.size() % 3 == 0;
+}
+
+// number of vertices referenced by indices ( highest index + 1 )
+static uint32_t getIndexedVertexCount(const std::vector<uint32_t>& indices)
+{
+  uint32_t result = 0;
+  for (auto index : indices)
+    result = std::max(result, index + 1);
+  return result;
+}
+
+// simulates FIFO vertex cache for triangles in range [firstTriangle, lastTriangle). Cache may be flushed by adding cacheSize+1 to timeStamp
+static uint32_t countCacheMisses(const std::vector<uint32_t>& indices, uint32_t firstTriangle, uint32_t lastTriangle, uint32_t cacheSize, std::vector<uint32_t>& cacheTime, uint32_t& timeStamp)
+{
+  uint32_t misses = 0;
+  for (uint32_t i = 3 * firstTriangle; i < 3 * lastTriangle; ++i)
+  {
+    uint32_t vertex = indices[i];
+    if (timeStamp - cacheTime[vertex] > cacheSize)
+    {
+      cacheTime[vertex] = timeStamp++;
+      misses++;
+    }
+  }
+  return misses;
+}
+
+// list of triangles that use each vertex
+struct VertexAdjacency
+{
+  VertexAdjacency(const std::vector<uint32_t>& indices, uint32_t vertexCount)
+    : offsets(vertexCount + 1, 0), triangles(indices.size())
+  {
+    for (auto index : indices)
+      offsets[index + 1]++;
+    for (uint32_t v = 0; v < vertexCount; ++v)
+      offsets[v + 1] += offsets[v];
+    std::vector<uint32_t> fillOffsets(begin(offsets), end(offsets) - 1);
+    for (uint32_t i = 0; i < indices.size(); ++i)
+      triangles[fillOffsets[indices[i]]++] = i / 3;
+  }
+  std::vector<uint32_t> offsets;
+  std::vector<uint32_t> triangles;
+};
+
+float calculateACMR(const Geometry& geometry, uint32_t cacheSize)
+{
+  if (!isTriangleList(geometry))
+    return 0.0f;
+  uint32_t              triangleCount = geometry.indices.size() / 3;
+  std::vector<uint32_t> cacheTime(getIndexedVertexCount(geometry.indices), 0);
+  uint32_t              timeStamp     = cacheSize + 1;
+  return static_cast<float>(countCacheMisses(geometry.indices, 0, triangleCount, cacheSize, cacheTime, timeStamp)) / static_cast<float>(triangleCount);
+}
+
+void optimizeVertexCache(Geometry& geometry, uint32_t cacheSize, std::vector<uint32_t>* clusters)
+{
+  if (clusters != nullptr)
+    clusters->clear();
+  if (!isTriangleList(geometry))
+    return;
+  const std::vector<uint32_t>& indices = geometry.indices;
+  uint32_t        vertexCount          = getIndexedVertexCount(indices);
+  uint32_t        triangleCount        = indices.size() / 3;
+  VertexAdjacency adjacency(indices, vertexCount);
+
+  std::vector<uint32_t> liveTriangles(vertexCount);
+  for (uint32_t v = 0; v < vertexCount; ++v)
+    liveTriangles[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+  std::vector<uint32_t> cacheTime(vertexCount, 0);
+  std::vector<bool>     emitted(triangleCount, false);
+  std::vector<uint32_t> deadEnd;
+  std::vector<uint32_t> candidates;
+  std::vector<uint32_t> results;
+  deadEnd.reserve(indices.size());
+  results.reserve(indices.size());
+
+  uint32_t timeStamp     = cacheSize + 1;
+  uint32_t cursor        = 0;
+  uint32_t fanningVertex = 0;
+  if (clusters != nullptr)
+    clusters->push_back(0);
+  while (fanningVertex != INVALID_VERTEX)
+  {
+    // emit all triangles around fanning vertex
+    candidates.clear();
+    for (uint32_t a = adjacency.offsets[fanningVertex]; a < adjacency.offsets[fanningVertex + 1]; ++a)
+    {
+      uint32_t triangle = adjacency.triangles[a];
+      if (emitted[triangle])
+        continue;
+      for (uint32_t k = 0; k < 3; ++k)
+      {
+        uint32_t vertex = indices[3 * triangle + k];
+        results.push_back(vertex);
+        deadEnd.push_back(vertex);
+        candidates.push_back(vertex);
+        liveTriangles[vertex]--;
+        if (timeStamp - cacheTime[vertex] > cacheSize)
+          cacheTime[vertex] = timeStamp++;
+      }
+      emitted[triangle] = true;
+    }
+
+    // next fanning vertex is the one that will stay longest in cache after emitting its triangles
+    uint32_t nextVertex   = INVALID_VERTEX;
+    int64_t  bestPriority = -1;
+    for (auto vertex : candidates)
+    {
+      if (liveTriangles[vertex] == 0)
+        continue;
+      int64_t priority = 0;
+      if (timeStamp - cacheTime[vertex] + 2 * liveTriangles[vertex] <= cacheSize)
+        priority = timeStamp - cacheTime[vertex];
+      if (priority > bestPriority)
+      {
+        bestPriority = priority;
+        nextVertex   = vertex;
+      }
+    }
+
+    // dead end - take the most recently used vertex with live triangles or the next vertex in input order
+    if (nextVertex == INVALID_VERTEX)
+    {
+      while (!deadEnd.empty() && nextVertex == INVALID_VERTEX)
+      {
+        uint32_t vertex = deadEnd.back();
+        deadEnd.pop_back();
+        if (liveTriangles[vertex] > 0)
+          nextVertex = vertex;
+      }
+      while (cursor < vertexCount && nextVertex == INVALID_VERTEX)
+      {
+        if (liveTriangles[cursor] > 0)
+          nextVertex = cursor;
+        cursor++;
+      }
+      uint32_t emittedTriangles = results.size() / 3;
+      if (clusters != nullptr && nextVertex != INVALID_VERTEX && clusters->back() != emittedTriangles)
+        clusters->push_back(emittedTriangles);
+    }
+    fanningVertex = nextVertex;
+  }
+  geometry.indices = results;
+}
+
+void optimizeOverdraw(Geometry& geometry, const std::vector<uint32_t>& clusters, uint32_t cacheSize, float threshold)
+{
+  if (!isTriangleList(geometry) || clusters.empty())
+    return;
+  uint32_t positionOffset = 0;
+  auto     pit            = begin(geometry.semantic);
+  for (; pit != end(geometry.semantic); ++pit)
+  {
+    if (pit->type == VertexSemantic::Position && pit->size >= 3)
+      break;
+    positionOffset += pit->size;
+  }
+  if (pit == end(geometry.semantic))
+    return;
+  const std::vector<uint32_t>& indices = geometry.indices;
+  uint32_t vertexSize    = calcVertexSize(geometry.semantic);
+  uint32_t triangleCount = indices.size() / 3;
+  CHECK_LOG_THROW(getIndexedVertexCount(indices) > geometry.getVertexCount(), "optimizeOverdraw() : index out of range");
+
+  // split clusters into smaller ones as long as it does not raise ACMR above threshold
+  std::vector<uint32_t> boundaries;
+  std::vector<uint32_t> cacheTime(geometry.getVertexCount(), 0);
+  uint32_t              timeStamp = cacheSize + 1;
+  for (uint32_t c = 0; c < clusters.size(); ++c)
+  {
+    uint32_t firstTriangle = clusters[c];
+    uint32_t lastTriangle  = (c + 1 < clusters.size()) ? clusters[c + 1] : triangleCount;
+    if (firstTriangle >= lastTriangle)
+      continue;
+    timeStamp += cacheSize + 1;
+    float clusterThreshold = threshold * countCacheMisses(indices, firstTriangle, lastTriangle, cacheSize, cacheTime, timeStamp) / static_cast<float>(lastTriangle - firstTriangle);
+
+    boundaries.push_back(firstTriangle);
+    timeStamp += cacheSize + 1;
+    uint32_t clusterStart = firstTriangle;
+    uint32_t misses       = 0;
+    for (uint32_t t = firstTriangle; t + 1 < lastTriangle; ++t)
+    {
+      misses += countCacheMisses(indices, t, t + 1, cacheSize, cacheTime, timeStamp);
+      if (misses <= clusterThreshold * (t + 1 - clusterStart))
+      {
+        boundaries.push_back(t + 1);
+        clusterStart = t + 1;
+        misses       = 0;
+        timeStamp   += cacheSize + 1;
+      }
+    }
+  }
+
+  // clusters facing outwards from the center of the model are drawn first
+  struct ClusterData
+  {
+    uint32_t  firstTriangle;
+    uint32_t  lastTriangle;
+    glm::vec3 centroid;
+    glm::vec3 normal;
+    float     area;
+    float     sortKey;
+  };
+  std::vector<ClusterData> clusterData;
+  glm::vec3                meshCentroid(0.0f, 0.0f, 0.0f);
+  float                    meshArea = 0.0f;
+  for (uint32_t c = 0; c < boundaries.size(); ++c)
+  {
+    ClusterData cluster{ boundaries[c], (c + 1 < boundaries.size()) ? boundaries[c + 1] : triangleCount, glm::vec3(0.0f), glm::vec3(0.0f), 0.0f, 0.0f };
+    for (uint32_t t = cluster.firstTriangle; t < cluster.lastTriangle; ++t)
+    {
+      glm::vec3 p[3];
+      for (uint32_t k = 0; k < 3; ++k)
+      {
+        const float* position = &geometry.vertices[indices[3 * t + k] * vertexSize + positionOffset];
+        p[k] = glm::vec3(position[0], position[1], position[2]);
+      }
+      glm::vec3 normal   = glm::cross(p[1] - p[0], p[2] - p[0]);
+      float     area     = 0.5f * glm::length(normal);
+      cluster.normal    += normal;
+      cluster.centroid  += area * (p[0] + p[1] + p[2]) / 3.0f;
+      cluster.area      += area;
+    }
+    meshCentroid += cluster.centroid;
+    meshArea     += cluster.area;
+    if (cluster.area > 0.0f)
+      cluster.centroid /= cluster.area;
+    clusterData.push_back(cluster);
+  }
+  if (meshArea > 0.0f)
+    meshCentroid /= meshArea;
+  for (auto& cluster : clusterData)
+  {
+    float normalLength = glm::length(cluster.normal);
+    cluster.sortKey = (normalLength > 0.0f) ? glm::dot(cluster.centroid - meshCentroid, cluster.normal / normalLength) : 0.0f;
+  }
+  std::stable_sort(begin(clusterData), end(clusterData), [](const ClusterData& lhs, const ClusterData& rhs) { return lhs.sortKey > rhs.sortKey; });
+
+  std::vector<uint32_t> results;
+  results.reserve(indices.size());
+  for (const auto& cluster : clusterData)
+    results.insert(end(results), begin(indices) + 3 * cluster.firstTriangle, begin(indices) + 3 * cluster.lastTriangle);
+  geometry.indices = results;
+}
+
+void optimizeVertexFetch(Geometry& geometry)
+{
+  uint32_t vertexSize  = calcVertexSize(geometry.semantic);
+  uint32_t vertexCount = (vertexSize > 0) ? geometry.getVertexCount() : 0;
+  if (vertexCount == 0)
+    return;
+  CHECK_LOG_THROW(getIndexedVertexCount(geometry.indices) > vertexCount, "optimizeVertexFetch() : index out of range");
+
+  std::vector<uint32_t> remap(vertexCount, INVALID_VERTEX);
+  uint32_t              nextVertex = 0;
+  for (auto& index : geometry.indices)
+  {
+    if (remap[index] == INVALID_VERTEX)
+      remap[index] = nextVertex++;
+    index = remap[index];
+  }
+  for (auto& r : remap)
+  {
+    if (r == INVALID_VERTEX)
+      r = nextVertex++;
+  }
+
+  std::vector<float> vertices(geometry.vertices.size());
+  for (uint32_t v = 0; v < vertexCount; ++v)
+    std::copy(begin(geometry.vertices) + v * vertexSize, begin(geometry.vertices) + (v + 1) * vertexSize, begin(vertices) + remap[v] * vertexSize);
+  geometry.vertices = vertices;
+}
+
+void optimizeAsset(Asset& asset, uint32_t cacheSize, float overdrawThreshold)
+{
+  for (auto& geometry : asset.geometries)
+  {
+    if (!isTriangleList(geometry))
+      continue;
+    std::vector<uint32_t> clusters;
+    optimizeVertexCache(geometry, cacheSize, &clusters);
+    optimizeOverdraw(geometry, clusters, cacheSize, overdrawThreshold);
+    optimizeVertexFetch(geometry);
+  }
+}
+
+}